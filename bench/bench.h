@@ -0,0 +1,92 @@
+/*
+   helpers shared by the benchmarks in this directory, include after dirutil.h with the implementation.
+
+   bench_now         - monotonic time in seconds.
+   bench_make_tree   - creates a synthetic tree, 'fanout' sub-directories per directory 'depth' levels deep and
+                       'files' files of 'file_size' bytes in each directory. returns the number of items created.
+   bench_count_items - walk callback counting the items into the unsigned int pointed to by userdata.
+*/
+#ifndef DIRUTIL_BENCH_H_INCLUDED
+#define DIRUTIL_BENCH_H_INCLUDED
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* every benchmark includes all helpers, inline so that the ones it does not call are not warned about */
+#if defined( _MSC_VER ) && !defined( __cplusplus )
+   #define BENCH_INLINE static __inline
+#else
+   #define BENCH_INLINE static inline
+#endif
+
+#if defined( _WIN32 )
+BENCH_INLINE double bench_now( void )
+{
+   LARGE_INTEGER freq, now;
+   QueryPerformanceFrequency( &freq );
+   QueryPerformanceCounter( &now );
+   return (double)now.QuadPart / (double)freq.QuadPart;
+}
+#else
+#include <time.h>
+BENCH_INLINE double bench_now( void )
+{
+   struct timespec now;
+   clock_gettime( CLOCK_MONOTONIC, &now );
+   return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+#endif
+
+BENCH_INLINE unsigned int bench_make_tree_rec( char* path, size_t path_len, unsigned int depth, unsigned int fanout, unsigned int files, unsigned int file_size, const char* content )
+{
+   unsigned int i, created = 0;
+
+   if ( dir_mktree( path ) != DIR_ERROR_OK )
+      return 0;
+
+   for ( i = 0; i < files; ++i )
+   {
+      FILE* file;
+      sprintf( path + path_len, "/file_%u.dat", i );
+      file = fopen( path, "wb" );
+      if ( file == 0x0 )
+         continue;
+      if ( file_size )
+         fwrite( content, 1, file_size, file );
+      fclose( file );
+      ++created;
+   }
+
+   if ( depth )
+   {
+      for ( i = 0; i < fanout; ++i )
+      {
+         size_t len = path_len + (size_t)sprintf( path + path_len, "/dir_%u", i );
+         created += 1 + bench_make_tree_rec( path, len, depth - 1, fanout, files, file_size, content );
+      }
+   }
+   path[path_len] = '\0';
+   return created;
+}
+
+BENCH_INLINE unsigned int bench_make_tree( const char* root, unsigned int depth, unsigned int fanout, unsigned int files, unsigned int file_size )
+{
+   char path[4096];
+   unsigned int created;
+   char* content = (char*)calloc( 1, file_size ? file_size : 1 );
+
+   strcpy( path, root );
+   created = bench_make_tree_rec( path, strlen( path ), depth, fanout, files, file_size, content );
+   free( content );
+   return created;
+}
+
+BENCH_INLINE int bench_count_items( const char* path, unsigned int path_len, enum dir_item_type type, void* userdata )
+{
+   (void)path; (void)path_len; (void)type;
+   ++*(unsigned int*)userdata;
+   return DIR_WALK_CONTINUE;
+}
+
+#endif
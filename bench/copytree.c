@@ -0,0 +1,116 @@
+/*
+   dir_copytree on two synthetic trees, one with many small files (3 levels, 6 sub-directories and 40 files of 1KB per
+   directory) and one with a few large files (1 level, 2 sub-directories and 2 files of 32MB per directory), in items
+   and MB per second. each tree is copied on one thread and on one per hardware thread, with files cloned where the
+   file system supports it and with DIR_COPY_NO_REFLINK, and with DIR_COPY_PRESERVE. best of 3 runs, the copy is
+   removed and the file systems synced between runs. posix only.
+
+   build and run from the root of the repository:
+      cc -O2 -pthread -o bench_copytree bench/copytree.c && ./bench_copytree
+*/
+#define _DEFAULT_SOURCE
+#define DIRUTIL_IMPLEMENTATION
+#include "../dirutil.h"
+#include "bench.h"
+
+#define BENCH_SRC    "dirutil_bench_copytree_src"
+#define BENCH_DST    "dirutil_bench_copytree_dst"
+#define BENCH_RUNS   3
+
+struct bench_tree
+{
+   const char* name;
+   unsigned int depth;
+   unsigned int fanout;
+   unsigned int files;
+   unsigned int file_size;
+};
+
+static const struct bench_tree bench_trees[] =
+{
+   { "small files", 3, 6, 40, 1024 },
+   { "large files", 1, 2, 2,  32 * 1024 * 1024 }
+};
+
+struct bench_copy
+{
+   const char* name;
+   unsigned int flags;
+   unsigned int num_threads;
+};
+
+static const struct bench_copy bench_copies[] =
+{
+   { "1 thread",             0,                   1 },
+   { "1 thread, no reflink", DIR_COPY_NO_REFLINK, 1 },
+   { "threads",              0,                   0 },
+   { "threads, no reflink",  DIR_COPY_NO_REFLINK, 0 },
+   { "threads, preserve",    DIR_COPY_PRESERVE,   0 }
+};
+
+/* best time per copy in seconds, or a negative value if the copy failed or is not complete */
+static double bench_copy( const struct bench_copy* copy, unsigned int created )
+{
+   unsigned int run, count;
+   double best = 1e9;
+
+   for ( run = 0; run < BENCH_RUNS; ++run )
+   {
+      double start, elapsed;
+      /* the writeback of the previous copy and its removal is not part of the next one */
+      dir_rmtree( BENCH_DST );
+      sync();
+      start = bench_now();
+      if ( dir_copytree( BENCH_SRC, BENCH_DST, copy->flags, 0x0, 0x0, copy->num_threads, 0x0, 0 ) != DIR_ERROR_OK )
+         return -1.0;
+      elapsed = bench_now() - start;
+      best = elapsed < best ? elapsed : best;
+
+      count = 0;
+      if ( dir_walk( BENCH_DST, 0, bench_count_items, &count ) != DIR_ERROR_OK || count != created )
+         return -1.0;
+   }
+   return best;
+}
+
+int main( void )
+{
+   unsigned int t, c;
+   int ok = 1;
+
+   printf( "%-12s %-22s %7s %12s %10s\n", "tree", "copy", "items", "items/s", "MB/s" );
+   for ( t = 0; t < sizeof( bench_trees ) / sizeof( bench_trees[0] ); ++t )
+   {
+      const struct bench_tree* tree = &bench_trees[t];
+      unsigned int created, num_dirs = 0, level_dirs = 1, level;
+      double bytes;
+
+      dir_rmtree( BENCH_SRC );
+      created = bench_make_tree( BENCH_SRC, tree->depth, tree->fanout, tree->files, tree->file_size );
+      if ( created == 0 )
+      {
+         printf( "failed to create '%s'\n", BENCH_SRC );
+         return 1;
+      }
+      for ( level = 0; level <= tree->depth; ++level, level_dirs *= tree->fanout )
+         num_dirs += level_dirs;
+      bytes = (double)num_dirs * tree->files * tree->file_size;
+
+      for ( c = 0; c < sizeof( bench_copies ) / sizeof( bench_copies[0] ); ++c )
+      {
+         double elapsed = bench_copy( &bench_copies[c], created );
+         if ( elapsed < 0.0 )
+         {
+            printf( "%-12s %-22s copy failed or is not complete\n", tree->name, bench_copies[c].name );
+            ok = 0;
+            continue;
+         }
+         printf( "%-12s %-22s %7u %12.0f %10.1f\n", tree->name, bench_copies[c].name, created,
+                 (double)created / elapsed, bytes / elapsed / ( 1024.0 * 1024.0 ) );
+      }
+   }
+
+   dir_rmtree( BENCH_DST );
+   dir_rmtree( BENCH_SRC );
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,157 @@
+/*
+   dir_glob_match, interpreting the pattern for each path, against dir_glob_compile + dir_glob_match_compiled in ns
+   per path. file patterns are matched against the names and directory patterns against the relative paths of all
+   items below a directory, /usr/include or the directory given on the command line. best of 5 runs.
+
+   the compiled pattern is also matched with its length, last char, prefix and suffix checks turned off, so that all
+   ops are executed for each path, 'rejected' is the share of the paths that those checks turn away up front.
+
+   build and run from the root of the repository:
+      cc -O2 -o bench_glob bench/glob.c && ./bench_glob [directory]
+*/
+#define _DEFAULT_SOURCE
+#define DIRUTIL_IMPLEMENTATION
+#include "../dirutil.h"
+#include "bench.h"
+
+#define BENCH_RUNS     5
+#define BENCH_MATCHES  2000000 /* matches per run and pattern, at least */
+
+struct bench_pattern
+{
+   const char* pattern;
+   int match_path; /* vs the relative path instead of the name */
+};
+
+static const struct bench_pattern bench_patterns[] =
+{
+   { "*.h",        0 },
+   { "*.{c,h}",    0 },
+   { "*.py",       0 },
+   { "Makefile",   0 },
+   { "*_test.c",   0 },
+   { "**/net",     1 },
+   { "**/*.h",     1 },
+   { "linux/*.h",  1 },
+   { "sys/**",     1 }
+};
+
+struct bench_paths
+{
+   char** paths;
+   char** names; /* points into paths */
+   unsigned int count;
+   unsigned int capacity;
+};
+
+static int bench_collect( const char* path, unsigned int path_len, enum dir_item_type type, void* userdata )
+{
+   struct bench_paths* paths = (struct bench_paths*)userdata;
+   char* copy;
+   (void)type;
+
+   if ( paths->count == paths->capacity )
+   {
+      paths->capacity = paths->capacity ? paths->capacity * 2 : 1024;
+      paths->paths = (char**)realloc( paths->paths, paths->capacity * sizeof( char* ) );
+      paths->names = (char**)realloc( paths->names, paths->capacity * sizeof( char* ) );
+   }
+   copy = (char*)malloc( path_len + 1 );
+   memcpy( copy, path, path_len + 1 );
+   paths->paths[paths->count] = copy;
+   paths->names[paths->count] = strrchr( copy, '/' ) ? strrchr( copy, '/' ) + 1 : copy;
+   ++paths->count;
+   return DIR_WALK_CONTINUE;
+}
+
+/* the checks done before the ops are executed in dir_glob_match_compiled_impl */
+static int bench_rejected_early( const struct dir_glob* glob, const char* path )
+{
+   unsigned int path_len = (unsigned int)strlen( path );
+   unsigned char c = path_len ? (unsigned char)path[path_len - 1] : 0;
+
+   if ( path_len < glob->min_len )
+      return 1;
+   if ( glob->has_last_chars && !( glob->last_chars[c >> 3] & ( 1 << ( c & 7 ) ) ) )
+      return 1;
+   if ( glob->prefix_len && memcmp( path, glob->strings + glob->ops[0].offset, glob->prefix_len ) != 0 )
+      return 1;
+   return glob->suffix_len && memcmp( path + path_len - glob->suffix_len, glob->strings + glob->ops[glob->num_ops - 1].offset, glob->suffix_len ) != 0;
+}
+
+/* best time per path in seconds, 'matches' is set to the number of matching paths */
+static double bench_match( const struct bench_pattern* pattern, const struct dir_glob* glob, char** paths, unsigned int count, unsigned int* matches )
+{
+   unsigned int run, rep, i, reps = BENCH_MATCHES / count + 1;
+   double best = 1e9;
+
+   for ( run = 0; run < BENCH_RUNS; ++run )
+   {
+      double start = bench_now(), elapsed;
+      *matches = 0;
+      for ( rep = 0; rep < reps; ++rep )
+      {
+         for ( i = 0; i < count; ++i )
+         {
+            enum dir_glob_result res = glob ? dir_glob_match_compiled( glob, paths[i] ) : dir_glob_match( pattern->pattern, paths[i] );
+            *matches += res == DIR_GLOB_MATCH;
+         }
+      }
+      elapsed = ( bench_now() - start ) / ( (double)reps * count );
+      best = elapsed < best ? elapsed : best;
+   }
+   *matches /= reps;
+   return best;
+}
+
+int main( int argc, char** argv )
+{
+   const char* root = argc > 1 ? argv[1] : "/usr/include";
+   struct bench_paths paths;
+   unsigned int i;
+   int ok = 1;
+
+   memset( &paths, 0, sizeof( paths ) );
+   if ( dir_walkex( root, DIR_WALK_ROOT_RELATIVE_PATHS | DIR_WALK_PATHS_SLASH_FORWARD, 0x0, 0x0, bench_collect, &paths ) != DIR_ERROR_OK || paths.count == 0 )
+   {
+      printf( "failed to walk '%s'\n", root );
+      return 1;
+   }
+
+   printf( "%u items below '%s', ns per path\n", paths.count, root );
+   printf( "%-12s %8s %9s %12s %10s %10s\n", "pattern", "matches", "rejected", "interpreted", "compiled", "no checks" );
+   for ( i = 0; i < sizeof( bench_patterns ) / sizeof( bench_patterns[0] ); ++i )
+   {
+      const struct bench_pattern* pattern = &bench_patterns[i];
+      char** subjects = pattern->match_path ? paths.paths : paths.names;
+      struct dir_glob* glob = dir_glob_compile( pattern->pattern );
+      struct dir_glob no_checks = *glob;
+      unsigned int interpreted_matches, compiled_matches, no_checks_matches, rejected = 0, j;
+      double interpreted, compiled, all_ops;
+
+      no_checks.min_len = no_checks.prefix_len = no_checks.suffix_len = 0;
+      no_checks.has_last_chars = 0;
+      for ( j = 0; j < paths.count; ++j )
+         rejected += bench_rejected_early( glob, subjects[j] );
+
+      interpreted = bench_match( pattern, 0x0, subjects, paths.count, &interpreted_matches );
+      compiled = bench_match( pattern, glob, subjects, paths.count, &compiled_matches );
+      all_ops = bench_match( pattern, &no_checks, subjects, paths.count, &no_checks_matches );
+
+      printf( "%-12s %8u %8.1f%% %12.1f %10.1f %10.1f\n", pattern->pattern, compiled_matches, 100.0 * rejected / paths.count,
+              interpreted * 1e9, compiled * 1e9, all_ops * 1e9 );
+      if ( interpreted_matches != compiled_matches || no_checks_matches != compiled_matches )
+      {
+         printf( "   '%s' matched %u paths interpreted, %u compiled and %u without checks\n", pattern->pattern,
+                 interpreted_matches, compiled_matches, no_checks_matches );
+         ok = 0;
+      }
+      dir_glob_free( glob );
+   }
+
+   for ( i = 0; i < paths.count; ++i )
+      free( paths.paths[i] );
+   free( paths.paths );
+   free( paths.names );
+   return ok ? 0 : 1;
+}
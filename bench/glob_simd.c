@@ -0,0 +1,97 @@
+/*
+   glob matching on long paths, where the '*'/'**' segments and literal runs are scanned with SIMD, in ns per call
+   for dir_glob_match and dir_glob_match_compiled. best of 5 runs.
+
+   build and run from the root of the repository, the second line measures the scalar build:
+      cc -O2 -o bench_glob_simd bench/glob_simd.c && ./bench_glob_simd
+      cc -O2 -DDIRUTIL_NO_SIMD -o bench_glob_simd bench/glob_simd.c && ./bench_glob_simd
+*/
+#define _DEFAULT_SOURCE
+#define DIRUTIL_IMPLEMENTATION
+#include "../dirutil.h"
+#include "bench.h"
+
+#define BENCH_RUNS   5
+#define BENCH_CALLS  2000000 /* per run */
+
+struct bench_case
+{
+   const char* pattern;
+   const char* path;
+};
+
+static const struct bench_case bench_cases[] =
+{
+   { "*.txt",                         "a_rather_long_file_name_used_to_measure_how_quickly_star_scans_to_the_extension.txt" },
+   { "**/*.txt",                      "projects/dirutil/documentation/generated/reference/manual_for_the_glob_matcher.txt" },
+   { "assets/**/textures/*.png",      "assets/characters/player/models/high_detail/textures/player_body_diffuse_color_map.png" },
+   { "src/*/include/detail/config.h", "src/a_library_with_a_fairly_long_directory_name/include/detail/config.h" },
+   { "{third_party/vendor/libraries/one,third_party/vendor/libraries/two}/*.c",
+                                      "third_party/vendor/libraries/two/implementation_of_the_second_library.c" },
+   { "*_test.c",                      "the_first_underscore_ends_the_match_early_test.c" },
+   { "**/*.h",                        "a/very/deep/tree/of/directories/that/goes/on/and/on/for/quite/a/while/before/it/finally/reaches/"
+                                      "the/header/file/we/are/looking/for/with/some/more/levels/added/to/make/it/longer/than/two/"
+                                      "hundred/and/fifty/chars/header.h" }
+};
+
+static const char* bench_kernel( void )
+{
+#if defined( DIR_SIMD_AVX2 )
+   if ( __builtin_cpu_supports( "avx2" ) )
+      return "avx2";
+#endif
+#if defined( DIR_SIMD_SSE2 )
+   return "sse2";
+#else
+   return "scalar";
+#endif
+}
+
+/* best time per call in seconds, 'result' is set to the result of the match */
+static double bench_match( const struct bench_case* c, const struct dir_glob* glob, enum dir_glob_result* result )
+{
+   unsigned int run, n, matches = 0;
+   double best = 1e9;
+
+   for ( run = 0; run < BENCH_RUNS; ++run )
+   {
+      double start = bench_now(), elapsed;
+      for ( n = 0; n < BENCH_CALLS; ++n )
+      {
+         *result = glob ? dir_glob_match_compiled( glob, c->path ) : dir_glob_match( c->pattern, c->path );
+         matches += *result == DIR_GLOB_MATCH;
+      }
+      elapsed = ( bench_now() - start ) / BENCH_CALLS;
+      best = elapsed < best ? elapsed : best;
+   }
+   if ( matches == 1 )
+      printf( "\n" );
+   return best;
+}
+
+int main( void )
+{
+   unsigned int i;
+   int ok = 1;
+
+   printf( "%s, ns per call\n", bench_kernel() );
+   printf( "%-32s %5s %6s %12s %10s\n", "pattern", "chars", "match", "interpreted", "compiled" );
+   for ( i = 0; i < sizeof( bench_cases ) / sizeof( bench_cases[0] ); ++i )
+   {
+      const struct bench_case* c = &bench_cases[i];
+      struct dir_glob* glob = dir_glob_compile( c->pattern );
+      enum dir_glob_result interpreted_result, compiled_result;
+      double interpreted = bench_match( c, 0x0, &interpreted_result );
+      double compiled = bench_match( c, glob, &compiled_result );
+
+      printf( "%-32.32s %5u %6s %12.1f %10.1f\n", c->pattern, (unsigned int)strlen( c->path ),
+              compiled_result == DIR_GLOB_MATCH ? "yes" : "no", interpreted * 1e9, compiled * 1e9 );
+      if ( interpreted_result != compiled_result )
+      {
+         printf( "   '%s' is %d interpreted but %d compiled\n", c->pattern, (int)interpreted_result, (int)compiled_result );
+         ok = 0;
+      }
+      dir_glob_free( glob );
+   }
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+/*
+   dir_walkex_info fetching size and mtime for each item, over a synthetic tree (3 levels, 6 sub-directories and 100
+   files per directory) in items per second. best of 5 runs. linux only.
+
+   the way the information is fetched is chosen when the implementation is compiled, build and run from the root of
+   the repository with fstatat (the default), with synchronous statx and with statx batched on io_uring:
+      cc -O2 -o bench_info bench/info.c && ./bench_info
+      cc -O2 -DDIRUTIL_USE_STATX -o bench_info bench/info.c && ./bench_info
+      cc -O2 -DDIRUTIL_USE_IO_URING -o bench_info bench/info.c && ./bench_info
+
+   run as root with 'cold' as argument to drop the page, dentry and inode caches before each run, that is where
+   io_uring can fetch inodes concurrently. if io_uring is not available at runtime the synchronous path is measured.
+*/
+#define _DEFAULT_SOURCE
+#define DIRUTIL_IMPLEMENTATION
+#include "../dirutil.h"
+#include "bench.h"
+
+#define BENCH_ROOT   "dirutil_bench_info"
+#define BENCH_RUNS   5
+#define BENCH_INFO   ( DIR_ITEM_INFO_SIZE | DIR_ITEM_INFO_MTIME )
+
+#if defined( DIRUTIL_USE_IO_URING )
+   #define BENCH_BACKEND "io_uring statx"
+#elif defined( DIRUTIL_USE_STATX )
+   #define BENCH_BACKEND "statx"
+#else
+   #define BENCH_BACKEND "fstatat"
+#endif
+
+struct bench_result
+{
+   unsigned int items;
+   dir_uint64 size; /* sum, so that the information is used */
+};
+
+static int bench_info_callback( const char* path, unsigned int path_len, enum dir_item_type type, const struct dir_item_info* info, void* userdata )
+{
+   struct bench_result* result = (struct bench_result*)userdata;
+   (void)path; (void)path_len; (void)type;
+   ++result->items;
+   result->size += info->size;
+   return DIR_WALK_CONTINUE;
+}
+
+static int bench_drop_caches( void )
+{
+   FILE* file;
+   sync();
+   file = fopen( "/proc/sys/vm/drop_caches", "w" );
+   if ( file == 0x0 )
+      return 0;
+   fputs( "3", file );
+   fclose( file );
+   return 1;
+}
+
+int main( int argc, char** argv )
+{
+   int cold = argc > 1 && strcmp( argv[1], "cold" ) == 0;
+   unsigned int created, run;
+   double best = 1e9;
+
+   dir_rmtree( BENCH_ROOT );
+   created = bench_make_tree( BENCH_ROOT, 3, 6, 100, 1 );
+   if ( created == 0 )
+   {
+      printf( "failed to create '%s'\n", BENCH_ROOT );
+      return 1;
+   }
+
+   for ( run = 0; run < BENCH_RUNS; ++run )
+   {
+      struct bench_result result;
+      double start, elapsed;
+
+      if ( cold && !bench_drop_caches() )
+      {
+         printf( "failed to drop the caches, 'cold' needs root\n" );
+         dir_rmtree( BENCH_ROOT );
+         return 1;
+      }
+
+      memset( &result, 0, sizeof( result ) );
+      start = bench_now();
+      if ( dir_walkex_info( BENCH_ROOT, 0, BENCH_INFO, 0x0, 0x0, bench_info_callback, &result ) != DIR_ERROR_OK || result.items != created )
+      {
+         printf( "walk reported %u of %u items\n", result.items, created );
+         dir_rmtree( BENCH_ROOT );
+         return 1;
+      }
+      elapsed = bench_now() - start;
+      best = elapsed < best ? elapsed : best;
+   }
+
+   printf( "%-15s %-4s %u items: %8.3f ms/walk %10.0f items/s\n", BENCH_BACKEND, cold ? "cold" : "warm", created, best * 1e3, (double)created / best );
+   dir_rmtree( BENCH_ROOT );
+   return 0;
+}
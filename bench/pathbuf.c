@@ -0,0 +1,58 @@
+/*
+   cost of the growable walk path buffer on trees of normal depth, warm dir_walkex over a synthetic tree (4 levels,
+   6 sub-directories and 10 files per directory) in items per second. best of 7 runs.
+
+   build and run from the root of the repository. the first line measures the current header, the second one the
+   header from before the path buffer could grow (fixed char[4096]), the third one forces every path of the walk onto
+   the heap by making the inline part of the buffer smaller than the paths:
+      cc -O2 -o bench_pathbuf bench/pathbuf.c && ./bench_pathbuf
+      git show f98f8ae~1:dirutil.h > /tmp/dirutil_fixed.h && cc -O2 -DBENCH_DIRUTIL_H='"/tmp/dirutil_fixed.h"' -o bench_pathbuf bench/pathbuf.c && ./bench_pathbuf
+      cc -O2 -DDIRUTIL_PATH_BUFFER_INLINE_SIZE=16 -o bench_pathbuf bench/pathbuf.c && ./bench_pathbuf
+*/
+#define _DEFAULT_SOURCE
+#define DIRUTIL_IMPLEMENTATION
+#if defined( BENCH_DIRUTIL_H )
+   #include BENCH_DIRUTIL_H
+#else
+   #include "../dirutil.h"
+#endif
+#include "bench.h"
+
+#define BENCH_ROOT   "dirutil_bench_pathbuf"
+#define BENCH_RUNS   7
+#define BENCH_WALKS  20 /* walks per run */
+
+int main( void )
+{
+   unsigned int created, run, walk, count = 0;
+   double best = 1e9;
+
+   dir_rmtree( BENCH_ROOT );
+   created = bench_make_tree( BENCH_ROOT, 4, 6, 10, 0 );
+   if ( created == 0 )
+   {
+      printf( "failed to create '%s'\n", BENCH_ROOT );
+      return 1;
+   }
+
+   for ( run = 0; run < BENCH_RUNS; ++run )
+   {
+      double start = bench_now(), elapsed;
+      for ( walk = 0; walk < BENCH_WALKS; ++walk )
+      {
+         count = 0;
+         if ( dir_walkex( BENCH_ROOT, 0, 0x0, 0x0, bench_count_items, &count ) != DIR_ERROR_OK || count != created )
+         {
+            printf( "walk reported %u of %u items\n", count, created );
+            dir_rmtree( BENCH_ROOT );
+            return 1;
+         }
+      }
+      elapsed = ( bench_now() - start ) / BENCH_WALKS;
+      best = elapsed < best ? elapsed : best;
+   }
+
+   printf( "dir_walkex, %u items: %8.3f ms/walk %10.0f items/s\n", created, best * 1e3, (double)created / best );
+   dir_rmtree( BENCH_ROOT );
+   return 0;
+}
@@ -0,0 +1,139 @@
+/*
+   live walks against walks replayed from a snapshot, dir_walkex and dir_walkex_info against dir_snapshot_walkex with
+   the same flags and glob patterns, over a synthetic tree (3 levels, 6 sub-directories and 20 files per directory) in
+   items per second. the time to save and open the snapshot is printed once. best of 7 runs.
+
+   build and run from the root of the repository:
+      cc -O2 -o bench_snapshot bench/snapshot.c && ./bench_snapshot
+*/
+#define _DEFAULT_SOURCE
+#define DIRUTIL_IMPLEMENTATION
+#include "../dirutil.h"
+#include "bench.h"
+
+#define BENCH_ROOT   "dirutil_bench_snapshot"
+#define BENCH_FILE   "dirutil_bench_snapshot.snap"
+#define BENCH_RUNS   7
+#define BENCH_WALKS  10 /* walks per run */
+#define BENCH_INFO   ( DIR_ITEM_INFO_SIZE | DIR_ITEM_INFO_MTIME )
+
+struct bench_walk
+{
+   const char* name;
+   unsigned int flags;
+   unsigned int info_fields;
+   const char* glob_directories;
+   const char* glob_files;
+};
+
+static const struct bench_walk bench_walks[] =
+{
+   { "all",          0,                                                   0,           0x0,             0x0      },
+   { "only files",   DIR_WALK_ONLY_FILES | DIR_WALK_ROOT_RELATIVE_PATHS,  0,           0x0,             0x0      },
+   { "globs",        DIR_WALK_ROOT_RELATIVE_PATHS,                        0,           "**/dir_[0-2]",  "file_1*" },
+   { "depth 2",      DIR_WALK_MAX_DEPTH( 2 ),                             0,           0x0,             0x0      },
+   { "all, info",    0,                                                   BENCH_INFO,  0x0,             0x0      },
+   { "globs, info",  DIR_WALK_ROOT_RELATIVE_PATHS,                        BENCH_INFO,  "**/dir_[0-2]",  "file_1*" }
+};
+
+struct bench_result
+{
+   unsigned int items;
+   dir_uint64 size; /* sum, so that the information is used */
+};
+
+static int bench_info_callback( const char* path, unsigned int path_len, enum dir_item_type type, const struct dir_item_info* info, void* userdata )
+{
+   struct bench_result* result = (struct bench_result*)userdata;
+   (void)path; (void)path_len; (void)type;
+   ++result->items;
+   result->size += info ? info->size : 0;
+   return DIR_WALK_CONTINUE;
+}
+
+/* best time per walk in seconds, or a negative value if the walk failed, 'result' is set by the last walk */
+static double bench_run( const struct bench_walk* walk, const struct dir_snapshot* snapshot, struct bench_result* result )
+{
+   unsigned int run, n;
+   double best = 1e9;
+
+   for ( run = 0; run < BENCH_RUNS; ++run )
+   {
+      double start = bench_now(), elapsed;
+      for ( n = 0; n < BENCH_WALKS; ++n )
+      {
+         enum dir_error err;
+         memset( result, 0, sizeof( *result ) );
+         if ( snapshot )
+            err = dir_snapshot_walkex( snapshot, walk->flags, walk->info_fields, walk->glob_directories, walk->glob_files, bench_info_callback, result );
+         else if ( walk->info_fields )
+            err = dir_walkex_info( BENCH_ROOT, walk->flags, walk->info_fields, walk->glob_directories, walk->glob_files, bench_info_callback, result );
+         else
+            err = dir_walkex( BENCH_ROOT, walk->flags, walk->glob_directories, walk->glob_files, bench_count_items, &result->items );
+         if ( err != DIR_ERROR_OK )
+            return -1.0;
+      }
+      elapsed = ( bench_now() - start ) / BENCH_WALKS;
+      best = elapsed < best ? elapsed : best;
+   }
+   return best;
+}
+
+int main( void )
+{
+   struct dir_snapshot* snapshot;
+   unsigned int created, i;
+   double start, saved, opened;
+   int ok = 1;
+
+   dir_rmtree( BENCH_ROOT );
+   created = bench_make_tree( BENCH_ROOT, 3, 6, 20, 1 );
+   if ( created == 0 )
+   {
+      printf( "failed to create '%s'\n", BENCH_ROOT );
+      return 1;
+   }
+
+   start = bench_now();
+   if ( dir_snapshot_save( BENCH_ROOT, BENCH_INFO, BENCH_FILE ) != DIR_ERROR_OK )
+   {
+      printf( "failed to save '%s'\n", BENCH_FILE );
+      dir_rmtree( BENCH_ROOT );
+      return 1;
+   }
+   saved = bench_now() - start;
+   start = bench_now();
+   if ( dir_snapshot_open( BENCH_FILE, &snapshot ) != DIR_ERROR_OK )
+   {
+      printf( "failed to open '%s'\n", BENCH_FILE );
+      remove( BENCH_FILE );
+      dir_rmtree( BENCH_ROOT );
+      return 1;
+   }
+   opened = bench_now() - start;
+
+   printf( "%u items, save %.3f ms, open %.3f ms\n", created, saved * 1e3, opened * 1e3 );
+   printf( "%-12s %7s %14s %14s %8s\n", "walk", "items", "live items/s", "snap items/s", "speedup" );
+   for ( i = 0; i < sizeof( bench_walks ) / sizeof( bench_walks[0] ); ++i )
+   {
+      const struct bench_walk* walk = &bench_walks[i];
+      struct bench_result live_result, snapshot_result;
+      double live = bench_run( walk, 0x0, &live_result );
+      double replayed = bench_run( walk, snapshot, &snapshot_result );
+
+      if ( live < 0.0 || replayed < 0.0 || live_result.items != snapshot_result.items ||
+          ( walk->info_fields && live_result.size != snapshot_result.size ) )
+      {
+         printf( "%-12s walk failed or differs, %u items live and %u replayed\n", walk->name, live_result.items, snapshot_result.items );
+         ok = 0;
+         continue;
+      }
+      printf( "%-12s %7u %14.0f %14.0f %7.1fx\n", walk->name, live_result.items,
+              (double)live_result.items / live, (double)snapshot_result.items / replayed, live / replayed );
+   }
+
+   dir_snapshot_close( snapshot );
+   remove( BENCH_FILE );
+   dir_rmtree( BENCH_ROOT );
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+/*
+   dir_path_tidy throughput in GB/s against the three-pass tidy it replaced (copied below as bench_tidy_old), on
+   already tidy paths and on paths where about 5% of the separators are doubled. best of 7 runs.
+
+   build and run from the root of the repository, the second line measures the scalar build:
+      cc -O2 -o bench_tidy bench/tidy.c && ./bench_tidy
+      cc -O2 -DDIRUTIL_NO_SIMD -o bench_tidy bench/tidy.c && ./bench_tidy
+*/
+#define _DEFAULT_SOURCE
+#define DIRUTIL_IMPLEMENTATION
+#include "../dirutil.h"
+#include "bench.h"
+
+#define BENCH_RUNS     7
+#define BENCH_BYTES    ( 256u * 1024u * 1024u ) /* tidied per run */
+
+typedef unsigned int (*bench_tidy_func)( char* path, char slash, unsigned int path_len );
+
+static int bench_iswhite( int c )
+{
+   return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+static unsigned int bench_tidy_old( char* path, char slash, unsigned int path_len )
+{
+   char c;
+   char *p = path, *runner, *dest;
+
+   path_len = path_len ? path_len : (unsigned int)strlen( path );
+   while ( ( path_len && bench_iswhite( path[path_len - 1] ) ) || ( path[path_len - 1] == '"' ) )
+      --path_len;
+   while ( ( path_len && bench_iswhite( *p ) ) || *p == '"' )
+      --path_len, ++p;
+   if ( p != path )
+      memmove( path, p, path_len );
+   path[path_len] = '\0';
+
+   runner = dest = path;
+   while ( ( c = *runner++ ) )
+   {
+      switch ( c ) {
+      case '/':
+      case '\\': {
+         c = slash;
+         if ( DIR_IS_SEP( *runner ) )
+            break;
+      }
+      /* FALLTHRU */
+      default:
+         *dest++ = c;
+      }
+   }
+   *dest = '\0';
+   path_len = (unsigned int)( dest - path );
+
+   if ( path_len && DIR_IS_SEP( path[path_len - 1] ) )
+      path[--path_len] = '\0';
+   return path_len;
+}
+
+/* segments of 3-12 letters, separators of both kinds, every 20th one doubled if 'doubled' */
+static void bench_make_path( char* path, unsigned int len, int doubled )
+{
+   unsigned int i = 0, n = 0, seed = 1;
+   while ( i < len )
+   {
+      unsigned int seg = 3 + ( seed = seed * 1103515245u + 12345u ) % 10;
+      while ( seg-- && i < len )
+         path[i++] = (char)( 'a' + ( ( seed = seed * 1103515245u + 12345u ) >> 16 ) % 26 );
+      if ( i < len - 1 )
+         path[i++] = ( n & 1 ) ? '\\' : '/';
+      if ( doubled && ++n % 20 == 0 && i < len - 1 )
+         path[i++] = '/';
+   }
+   path[len] = '\0';
+}
+
+static double bench_run( bench_tidy_func func, const char* input, unsigned int len )
+{
+   static char path[8192];
+   unsigned int n, iterations = BENCH_BYTES / len;
+   unsigned int sink = 0;
+   double best = 1e30;
+   int run;
+
+   for ( run = 0; run < BENCH_RUNS; ++run )
+   {
+      double start = bench_now(), elapsed;
+      for ( n = 0; n < iterations; ++n )
+      {
+         memcpy( path, input, len + 1 );
+         sink += func( path, '/', len );
+      }
+      elapsed = bench_now() - start;
+      best = elapsed < best ? elapsed : best;
+   }
+   if ( sink == 0xffffffff )
+      printf( "\n" );
+   return (double)iterations * len / best / 1e9;
+}
+
+int main( void )
+{
+   static const unsigned int lengths[] = { 31, 127, 254, 1015, 4070 };
+   static char input[8192];
+   unsigned int i;
+   int doubled;
+
+   for ( doubled = 0; doubled < 2; ++doubled )
+   {
+      printf( "%s\n", doubled ? "5% doubled separators, GB/s:" : "already tidy, GB/s:" );
+      for ( i = 0; i < sizeof( lengths ) / sizeof( lengths[0] ); ++i )
+      {
+         double old_gbs, new_gbs;
+         bench_make_path( input, lengths[i], doubled );
+         old_gbs = bench_run( bench_tidy_old, input, lengths[i] );
+         new_gbs = bench_run( dir_path_tidy, input, lengths[i] );
+         printf( "   %5u B: old %6.2f  new %6.2f\n", lengths[i], old_gbs, new_gbs );
+      }
+   }
+   return 0;
+}
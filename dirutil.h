@@ -78,6 +78,7 @@ enum dir_error
    DIR_ERROR_FAILED,
    DIR_ERROR_PATH_TOO_DEEP,
    DIR_ERROR_PATH_DO_NOT_EXIST,
+   DIR_ERROR_ABORTED, /* walk was stopped by callback returning DIR_WALK_ABORT */
 
    DIR_ERROR_FORCEINT = 65536 /* force the enum to be signed integer */
 };
@@ -102,13 +103,70 @@ DIRUTIL_API enum dir_error dir_mktree( const char* path );
  */
 DIRUTIL_API enum dir_error dir_rmtree( const char* path );
 
+#if !defined( DIRUTIL_NO_THREADS )
+/**
+ * Remove directory recursively using multiple threads.
+ * Sub-trees are distributed over the workers, files are removed relative to their open parent
+ * directory and each directory is removed as soon as everything in it has been removed.
+ *
+ * @param path dir to remove
+ * @param num_threads number of workers, including the calling thread, 0 (zero) to use one per hardware thread.
+ * @param failed_path _optional_ buffer receiving the path of the first item that could not be removed.
+ * @param failed_path_size size of failed_path buffer, the path is truncated if it does not fit.
+ *
+ * @note the removal stops at the first failure.
+ * @note this is not an atomic operation and if it fails it might leave the directory partly removed.
+ */
+DIRUTIL_API enum dir_error dir_rmtree_parallel( const char* path, unsigned int num_threads, char* failed_path, unsigned int failed_path_size );
+
+/* flags to dir_copytree, in addition to the flags of the walk */
+enum dir_copy_flags
+{
+   DIR_COPY_PRESERVE = 1 << 16,   /* copy permission bits and access/modification times of files and directories */
+   DIR_COPY_NO_REFLINK = 1 << 17, /* always copy the data, even if the file system could share it between the files */
+
+   DIR_COPY_FORCEINT = 0x7fffffff /* force the enum to be signed integer */
+};
+
+/**
+ * Copy directory recursively using multiple threads, sub-trees are distributed over the workers as with dir_walk_parallel.
+ *
+ * Directories are created relative to their open parent in dst. Files are cloned with 'FICLONE' on file systems
+ * that supports sharing data between files, otherwise copied in the kernel with 'copy_file_range', otherwise with
+ * a read/write loop through a buffer of DIRUTIL_COPY_BUFFER_SIZE bytes per worker. On Windows files are copied with 'CopyFileA'.
+ * Symlinks are copied as symlinks, other special files are skipped.
+ *
+ * @param src dir to copy.
+ * @param dst dir to copy to, created if it does not exist. existing files in it are overwritten.
+ * @param flags mask of enum dir_copy_flags and of DIR_WALK_SINGLE_DIRECTORY, DIR_WALK_ONLY_DIRECTORIES,
+ *              DIR_WALK_IGNORE_DOT_DIRECTORIES, DIR_WALK_IGNORE_DOT_FILES, DIR_WALK_SAME_FILESYSTEM, DIR_WALK_FOLLOW_SYMLINKS
+ *              and DIR_WALK_MAX_DEPTH that have the same meaning as for dir_walkex. directories the walk is stopped at
+ *              are copied as empty directories, and with DIR_WALK_FOLLOW_SYMLINKS symlinks to directories are copied as
+ *              directories.
+ * @param optional_glob_directories _optional_ glob pattern for directories, as for dir_walkex.
+ * @param optional_glob_files _optional_ glob pattern for files, as for dir_walkex.
+ * @param num_threads number of workers, including the calling thread, 0 (zero) to use one per hardware thread.
+ * @param failed_path _optional_ buffer receiving the path in src of the first item that could not be copied.
+ * @param failed_path_size size of failed_path buffer, the path is truncated if it does not fit.
+ *
+ * @note the items copied are the ones dir_walkex reports, plus the directories walked to reach matching directories.
+ * @note without DIR_COPY_PRESERVE files are created with the permission bits of the source masked by the umask and
+ *       directories with the default permissions.
+ * @note the copy stops at the first failure.
+ * @note dst may be inside src, it is not copied into itself. this is not detected on Windows.
+ */
+DIRUTIL_API enum dir_error dir_copytree( const char* src, const char* dst, unsigned int flags,
+   const char* optional_glob_directories, const char* optional_glob_files,
+   unsigned int num_threads, char* failed_path, unsigned int failed_path_size );
+#endif
+
 /**
  * Callback called for each item with dir_walk.
  * @param path full path to current item with input path to dir_walk() as a base.
  * @param type item type, file or dir.
  * @param userdata passed to dir_walk.
  *
- * @return 0 (zero) to keep iterating, non-zero to stop iterating (NB: NYI - currently return value is ignored)
+ * @return one of enum dir_walk_result, DIR_WALK_CONTINUE (zero) to keep iterating.
  */
 enum dir_item_type
 {
@@ -124,6 +182,18 @@ enum dir_item_type
  */
 typedef int ( *dir_walk_callback )( const char* path, unsigned int path_len, enum dir_item_type type, void* userdata );
 
+/* return values of the walk callbacks */
+enum dir_walk_result
+{
+   DIR_WALK_CONTINUE = 0,     /* keep iterating */
+   DIR_WALK_ABORT = 1,        /* stop the walk, all open directories are closed and the walk returns DIR_ERROR_ABORTED.
+                                 any other non-zero value not listed here is treated as DIR_WALK_ABORT */
+   DIR_WALK_SKIP_SUBTREE = 2, /* do not walk into the directory passed to the callback. only meaningful for directories
+                                 without DIR_WALK_DEPTH_FIRST, otherwise treated as DIR_WALK_CONTINUE */
+
+   DIR_WALK_RESULT_FORCEINT = 65536 /* force the enum to be signed integer */
+};
+
 enum dir_walk_flags
 {
    DIR_WALK_NO_FLAGS = 0,
@@ -144,6 +214,41 @@ enum dir_walk_flags
                                                    item = "local/folder/subfolder" -> "subfolder" (in user callback)
                                                    item = "local/folder/subfolder/file.txt" -> "subfolder/file.txt" (in user callback)
                                              */
+   DIR_WALK_SORTED = 1 << 8,                 /* read all entries of each directory and visit them sorted byte-wise by name (as strcmp), so
+                                                that the walk is the same on every file system. items are then ordered by path compared
+                                                one path-segment at a time, i.e. "a", "a/b", "a-b" (with DIR_WALK_DEPTH_FIRST "a/b", "a", "a-b").
+                                                the entries are kept in one buffer per directory level that is reused, so the memory used is
+                                                bounded by the widest directories and not by the size of the tree.
+                                                ignored by the parallel walks.
+                                             */
+   DIR_WALK_SAME_FILESYSTEM = 1 << 9,        /* do not walk into directories on another file system (device) than the input/root-directory,
+                                                as 'find -xdev'. the directories where other file systems are mounted are still reported.
+                                             */
+   DIR_WALK_FOLLOW_SYMLINKS = 1 << 10,       /* symlinks to directories are reported and walked as directories. a directory, by device and
+                                                inode, is not walked below itself, so a link to one of the directories it is reached through
+                                                is reported but not walked. a directory reached through several links, or through a link
+                                                and its real path, is walked each time, as 'find -L'. the item information still describes
+                                                the symlink itself.
+                                             */
+   DIR_WALK_GITIGNORE = 1 << 11,             /* read the rules in '.gitignore' and '.ignore' of each walked directory, as git does, and do not
+                                                report the items they ignore nor walk the directories they ignore. rules in deeper directories
+                                                override the ones above them, and '.ignore' overrides '.gitignore' of the same directory.
+                                                rule files above the input/root-directory are not read, and items named '.git' are never
+                                                reported nor walked. ignored by the parallel walks, dir_walk_incremental, dir_watch_open
+                                                and when replaying a snapshot.
+                                             */
+   /**
+    * walk at most this many levels below the input/root-directory, 0 for no limit. items in the input/root-directory are at
+    * depth 1, so DIR_WALK_MAX_DEPTH( 1 ) is the same as DIR_WALK_SINGLE_DIRECTORY. directories at the max depth are still reported.
+    * set with DIR_WALK_MAX_DEPTH( depth ), depth in range [0, 255].
+    *
+    * DIR_WALK_MAX_DEPTH, DIR_WALK_SAME_FILESYSTEM and DIR_WALK_FOLLOW_SYMLINKS are checked before a directory is opened, also by the
+    * parallel walks where a directory that is not walked is completed as an empty directory. DIR_WALK_SAME_FILESYSTEM and
+    * DIR_WALK_FOLLOW_SYMLINKS are ignored when replaying a snapshot and on Windows, where symlinks to directories and junctions are
+    * always walked as directories.
+    */
+   DIR_WALK_MAX_DEPTH_MASK = 0x0ff00000,
+
    /**
     * either specify slash-type or get platform default ('\' on Windows and '/' elsewhere)
     * all items in the invoked callback will have paths with this selected (or default) path separator
@@ -153,9 +258,11 @@ enum dir_walk_flags
 
    DIR_WALK_PATHS_SLASH_MASK = 0xc000,
 
-   DIR_WALK_FORCEINT = 65536 /* force the enum to be signed integer */
+   DIR_WALK_FORCEINT = 0x7fffffff /* force the enum to be signed integer */
 };
 
+#define DIR_WALK_MAX_DEPTH( depth ) ( ( (unsigned int)( depth ) << 20 ) & DIR_WALK_MAX_DEPTH_MASK )
+
 /**
  * Invokes callback for item, depending on flags and _optional_ glob patterns,
  * in in the directory and it's sub-directories.
@@ -175,13 +282,435 @@ enum dir_walk_flags
  *
  * @note the glob pattern for files matches against the file-part of the full filepath and _NOT_ the full path.
  *
+ * @note directories that do not match the glob pattern for directories but that might have sub-directories that
+ *       match (see dir_glob_match_partial) are walked, but neither they nor the files in them are reported.
+ *       i.e. with "assets/{one,two}/textures" the directories 'assets' and 'assets/one' are walked to reach 'assets/one/textures'.
+ *       files directly in the input/root-directory are always reported (if they match the file glob pattern).
+ *
  */
 DIRUTIL_API enum dir_error dir_walkex( const char* path, unsigned int flags,
    const char* optional_glob_directories, const char* optional_glob_files,
    dir_walk_callback callback, void* userdata );
+
+struct dir_glob_set;
+
+/**
+ * Same as dir_walkex but with glob-pattern sets, see dir_glob_set_compile, to filter directories and files.
+ * A directory or file is reported if it is included by the set. The sets are matched as the single patterns
+ * passed to dir_walkex, i.e. the directory set vs the path below input/root-directory and the file set vs the file-part.
+ *
+ * @param optional_directories _optional_ glob pattern set for directories
+ * @param optional_files _optional_ glob pattern set for files
+ */
+DIRUTIL_API enum dir_error dir_walkex_globset( const char* path, unsigned int flags,
+   const struct dir_glob_set* optional_directories, const struct dir_glob_set* optional_files,
+   dir_walk_callback callback, void* userdata );
+
+#if defined( _MSC_VER )
+   typedef __int64 dir_int64;
+   typedef unsigned __int64 dir_uint64;
+#else
+   #include <stdint.h>
+   typedef int64_t dir_int64;
+   typedef uint64_t dir_uint64;
+#endif
+
+/* fields of struct dir_item_info, used to select what information to fetch for each item in a walk */
+enum dir_item_info_fields
+{
+   DIR_ITEM_INFO_SIZE    = 1 << 0,
+   DIR_ITEM_INFO_MTIME   = 1 << 1,
+   DIR_ITEM_INFO_INODE   = 1 << 2, /* 'inode' and 'device', not available on Windows */
+   DIR_ITEM_INFO_MODE    = 1 << 3,
+   DIR_ITEM_INFO_SYMLINK = 1 << 4,
+
+   DIR_ITEM_INFO_ALL = 0x1f
+};
+
+/**
+ * Information about an item in a walk. It describes the item itself, i.e. symlinks are not followed.
+ */
+struct dir_item_info
+{
+   unsigned int valid;      /* mask of enum dir_item_info_fields that are set, requested fields that could not be fetched are not set */
+   dir_uint64 size;         /* size in bytes */
+   dir_int64 mtime;         /* modification time in seconds since 1970-01-01 UTC */
+   unsigned int mtime_nsec; /* nanoseconds part of modification time */
+   dir_uint64 inode;
+   dir_uint64 device;
+   unsigned int mode;       /* type and permission bits as 'st_mode' from 'stat', on Windows derived from the file attributes */
+   int is_symlink;
+};
+
+/**
+ * Callback called for each item with dir_walkex_info.
+ * @param info information about item, fields not requested by the walk is not valid.
+ * @see dir_walk_callback.
+ */
+typedef int ( *dir_walk_info_callback )( const char* path, unsigned int path_len, enum dir_item_type type, const struct dir_item_info* info, void* userdata );
+
+/**
+ * Same as dir_walkex but the callback also receives information about the item.
+ *
+ * On POSIX the information is fetched with 'fstatat' relative to the directory being read, or with 'statx' asking only for
+ * the requested fields if DIRUTIL_USE_STATX is defined. Only symlink-ness, if that is all that is requested, is taken from the
+ * directory entry without an extra syscall. On Windows all information except inode/device comes with the directory entry.
+ *
+ * @param info_fields mask of enum dir_item_info_fields to fetch for each reported item, 0 to fetch nothing.
+ */
+DIRUTIL_API enum dir_error dir_walkex_info( const char* path, unsigned int flags, unsigned int info_fields,
+   const char* optional_glob_directories, const char* optional_glob_files,
+   dir_walk_info_callback callback, void* userdata );
+
 /* convenience (and backward compatibility) macro when no glob patterns is used */
 #define dir_walk( path, flags, callback, userdata ) dir_walkex( path, flags, 0, 0, callback, userdata )
 
+/* iterator over the same items, and in the same order, as dir_walkex_info reports them */
+struct dir_iter;
+
+/* item returned by dir_iter_next */
+struct dir_iter_item
+{
+   const char* path;       /* same path as passed to dir_walk_callback, valid until the next call to dir_iter_next */
+   unsigned int path_len;
+   enum dir_item_type type;
+   struct dir_item_info info;
+};
+
+/**
+ * Start iterating over path, flags, info_fields and glob patterns have the same meaning as for dir_walkex_info.
+ * The walk is driven by calls to dir_iter_next instead of callbacks, using one path buffer and a stack of open
+ * directories that are only grown when the walk gets deeper or longer than before, i.e. no allocations per item.
+ *
+ * @param iter set to the new iterator if DIR_ERROR_OK is returned, must be closed with dir_iter_close.
+ *
+ * @return the same errors as dir_walkex_info returns if the input/root-directory can not be read.
+ */
+DIRUTIL_API enum dir_error dir_iter_open( const char* path, unsigned int flags, unsigned int info_fields,
+   const char* optional_glob_directories, const char* optional_glob_files, struct dir_iter** iter );
+
+/**
+ * Fetch next item in the walk.
+ * @param item set to the next item, only valid if 1 is returned.
+ * @return 1 if an item was returned, 0 when the walk is done.
+ */
+DIRUTIL_API int dir_iter_next( struct dir_iter* iter, struct dir_iter_item* item );
+
+/**
+ * Do not walk into the directory returned by the last call to dir_iter_next, same as returning
+ * DIR_WALK_SKIP_SUBTREE from a callback. Ignored for files and with DIR_WALK_DEPTH_FIRST.
+ */
+DIRUTIL_API void dir_iter_skip_subtree( struct dir_iter* iter );
+
+/**
+ * Close all directories still open and free iter, the iteration can be stopped at any time.
+ * @return the error that stopped the walk of the input/root-directory early, same as dir_walkex_info would return, otherwise DIR_ERROR_OK.
+ */
+DIRUTIL_API enum dir_error dir_iter_close( struct dir_iter* iter );
+
+/**
+ * The reported items of one directory in dir_walkex_batch, as arrays with one element per item.
+ * Everything is owned by the walk and only valid during the callback.
+ */
+struct dir_item_batch
+{
+   const char* dir_path;              /* path to the directory, as the paths passed to dir_walk_callback. "" for the input/root-directory with DIR_WALK_ROOT_RELATIVE_PATHS */
+   unsigned int dir_path_len;
+   unsigned int count;                /* number of items */
+   const char* names;                 /* null-terminated names of the items, at 'name_offsets' */
+   const unsigned int* name_offsets;
+   const unsigned int* name_lens;
+   const unsigned char* types;        /* enum dir_item_type */
+   const dir_uint64* inodes;          /* inode as read from the directory entry, 0x0 on Windows */
+   const struct dir_item_info* infos; /* information requested by 'info_fields', 0x0 if no fields were requested */
+};
+
+/**
+ * Callback called for each directory with reported items with dir_walkex_batch.
+ * @return one of enum dir_walk_result. DIR_WALK_SKIP_SUBTREE skips all sub-directories of the batch, only meaningful
+ *         without DIR_WALK_DEPTH_FIRST.
+ */
+typedef int ( *dir_walk_batch_callback )( const struct dir_item_batch* batch, void* userdata );
+
+/**
+ * Same as dir_walkex_info but the items are handed to callback one directory at a time, all items of a
+ * directory in one batch. Directories without reported items are not passed to the callback.
+ *
+ * @note the items of a directory are read before its sub-directories are walked, without DIR_WALK_DEPTH_FIRST the batch of a
+ *       directory is passed before the batches of its sub-directories and with DIR_WALK_DEPTH_FIRST after them. the
+ *       information of the sub-directories is fetched as they are read in both cases.
+ */
+DIRUTIL_API enum dir_error dir_walkex_batch( const char* path, unsigned int flags, unsigned int info_fields,
+   const char* optional_glob_directories, const char* optional_glob_files,
+   dir_walk_batch_callback callback, void* userdata );
+
+/* a walked tree loaded from a file written by dir_snapshot_save */
+struct dir_snapshot;
+
+/**
+ * Walk path and store every item in it in snapshot_file, so that walks can be replayed from the file with
+ * dir_snapshot_walkex instead of reading the file system again.
+ *
+ * The file is versioned and meant to be mapped into memory and used as is, in native byte-order: a table of all
+ * directories with the index of their parent and the range of their entries, a table of all entries with name, type
+ * and the directory it leads to, optional information per entry and one pool of null-terminated names. The file is
+ * written next to snapshot_file and renamed over it when complete, so an open snapshot is never modified.
+ *
+ * Nothing is filtered and symlinks are not followed. Directories that can not be opened are stored, but not walked when replayed.
+ *
+ * @param info_fields mask of enum dir_item_info_fields to store for each entry, 0 to store only names and types.
+ *
+ * @return DIR_ERROR_PATH_DO_NOT_EXIST if path can not be read, DIR_ERROR_FAILED if the file could not be written.
+ */
+DIRUTIL_API enum dir_error dir_snapshot_save( const char* path, unsigned int info_fields, const char* snapshot_file );
+
+/**
+ * Map a file written by dir_snapshot_save into memory.
+ * @param snapshot set to the loaded snapshot if DIR_ERROR_OK is returned, must be closed with dir_snapshot_close.
+ * @return DIR_ERROR_FAILED if the file is not a snapshot, is written by another version or is damaged.
+ */
+DIRUTIL_API enum dir_error dir_snapshot_open( const char* snapshot_file, struct dir_snapshot** snapshot );
+
+DIRUTIL_API void dir_snapshot_close( struct dir_snapshot* snapshot );
+
+/**
+ * Same as dir_walkex_info on the path the snapshot was saved from, but replayed from the snapshot. Items are reported
+ * in the same order and with the same paths, flags and glob patterns are applied as in a live walk.
+ *
+ * @param info_fields mask of enum dir_item_info_fields to report, only fields stored in the snapshot are valid.
+ */
+DIRUTIL_API enum dir_error dir_snapshot_walkex( const struct dir_snapshot* snapshot, unsigned int flags, unsigned int info_fields,
+   const char* optional_glob_directories, const char* optional_glob_files,
+   dir_walk_info_callback callback, void* userdata );
+
+/* change of an item reported by dir_walk_incremental */
+enum dir_change
+{
+   DIR_CHANGE_ADDED,
+   DIR_CHANGE_REMOVED,
+   DIR_CHANGE_MODIFIED /* only files, when the information stored in the snapshot differs */
+};
+
+/**
+ * Callback called for each changed item with dir_walk_incremental.
+ * @param info information stored in the snapshot for removed items, otherwise as it is now. The fields are the ones the
+ *             snapshot was saved with, symlink-ness is always set if it could be fetched.
+ * @return one of enum dir_walk_result, only DIR_WALK_ABORT has any effect.
+ */
+typedef int ( *dir_walk_change_callback )( const char* path, unsigned int path_len, enum dir_item_type type, enum dir_change change,
+   const struct dir_item_info* info, void* userdata );
+
+/**
+ * Walk path and report what was added, removed and modified since previous_snapshot was saved from it.
+ *
+ * Only directories whose mtime, ctime, inode or device changed are read again, the stored entries are reused for the
+ * others, so a walk of a tree where little has changed costs about one 'fstatat' per directory. Directories are
+ * compared by their position in the tree, so path may be another path to the same tree, e.g. after it was moved.
+ *
+ * Files are only reported as modified when they are in a directory that is read again and the information stored
+ * in the snapshot, if any, differs. Writing to an existing file does not change the directory it is in, so content
+ * changes are not detected by this walk alone.
+ *
+ * Removed directories are reported after everything that was in them, added directories before everything in them.
+ *
+ * @param flags DIR_WALK_ROOT_RELATIVE_PATHS, DIR_WALK_ONLY_FILES, DIR_WALK_ONLY_DIRECTORIES and the path-separator flags, other
+ *              flags are ignored.
+ * @param optional_snapshot_file if not 0x0, the current state of the tree is saved to it, with the same information as
+ *                               previous_snapshot, when the walk completes. may be the file previous_snapshot was opened from.
+ */
+DIRUTIL_API enum dir_error dir_walk_incremental( const char* path, const struct dir_snapshot* previous_snapshot, unsigned int flags,
+   dir_walk_change_callback callback, void* userdata, const char* optional_snapshot_file );
+
+#if defined( __linux__ )
+/* a walked tree kept current by watching each walked directory with inotify, linux only */
+struct dir_watch;
+
+/**
+ * Walk path and start watching it for changes, flags and glob patterns have the same meaning as for dir_walkex.
+ *
+ * Each directory is watched before it is read, so an item created while the tree is walked is either found by the
+ * walk or reported by a later dir_watch_poll, never missed. The same holds for directories created later.
+ * A directory reachable at two paths in the tree, e.g. through a bind mount, is only watched and walked at the first.
+ *
+ * @param callback if not 0x0, called with DIR_CHANGE_ADDED for each item found by the walk, directories before the items
+ *                 in them. returning DIR_WALK_ABORT closes the watch and DIR_ERROR_ABORTED is returned.
+ * @param watch set to the new watch if DIR_ERROR_OK is returned, must be closed with dir_watch_close.
+ *
+ * @return the same errors as dir_walkex if path can not be read, DIR_ERROR_FAILED if inotify is not available or a
+ *         directory could not be watched, e.g. when the limit on watches per user is reached.
+ */
+DIRUTIL_API enum dir_error dir_watch_open( const char* path, unsigned int flags, const char* optional_glob_directories, const char* optional_glob_files,
+   dir_walk_change_callback callback, void* userdata, struct dir_watch** watch );
+
+/* file descriptor that is readable when dir_watch_poll has changes to report, to wait for it together with other descriptors */
+DIRUTIL_API int dir_watch_fd( const struct dir_watch* watch );
+
+/**
+ * Wait up to timeout_ms milliseconds, or forever if negative, for changes and report them.
+ *
+ * After the first change arrives, changes are collected until none has arrived for DIRUTIL_WATCH_COALESCE_MS or
+ * for at most 10 such periods, and are reported as one batch with at most one change per item: an item added and
+ * then modified is reported as added, one added and then removed is not reported, one removed and then added again
+ * is reported as modified. Directories added in the batch are reported before what is in them and removed ones after.
+ *
+ * If the kernel queue of changes overflows, every watched directory whose mtime or ctime changed since it was read
+ * is read again and compared with the view. Files that were only modified while the queue overflowed are missed.
+ *
+ * @param callback info is always empty, no information is fetched for the changed items.
+ *                 returning DIR_WALK_ABORT drops the rest of the batch and DIR_ERROR_ABORTED is returned.
+ *
+ * @return DIR_ERROR_OK also if there were no changes, DIR_ERROR_PATH_DO_NOT_EXIST if the watched directory was
+ *         removed or moved, after everything in it was reported as removed. DIR_ERROR_FAILED if an added directory
+ *         could not be watched, changes in it are missed but everything else is reported.
+ */
+DIRUTIL_API enum dir_error dir_watch_poll( struct dir_watch* watch, int timeout_ms, dir_walk_change_callback callback, void* userdata );
+
+DIRUTIL_API void dir_watch_close( struct dir_watch* watch );
+#endif
+
+#if !defined( DIRUTIL_NO_THREADS )
+/**
+ * Callback called for each item with dir_walk_parallel, invoked concurrently from multiple threads.
+ * @param path full path to current item, same as for dir_walk_callback.
+ * @param type item type, file or dir.
+ * @param worker_index index of the worker invoking the callback, in range [0, num_threads), use to
+ *        keep per-worker state without locking. a worker is only ever running on one thread at a time.
+ * @param userdata passed to dir_walk_parallel.
+ *
+ * @return one of enum dir_walk_result, DIR_WALK_CONTINUE (zero) to keep iterating.
+ *         with DIR_WALK_ABORT no new directories are read, but callbacks already running on other workers are completed.
+ */
+typedef int ( *dir_walk_parallel_callback )( const char* path, unsigned int path_len, enum dir_item_type type, unsigned int worker_index, void* userdata );
+
+/**
+ * Same as dir_walkex but the directories are read by multiple threads, where sub-directories are
+ * distributed among workers by work-stealing.
+ *
+ * @param num_threads number of workers, including the calling thread, 0 (zero) to use one per hardware thread.
+ *
+ * @note flags and glob patterns have the same meaning as for dir_walkex.
+ *
+ * @note there is no ordering guarantee between items in different directories, but:
+ *       - without DIR_WALK_DEPTH_FIRST the callback for a directory is invoked before the callback for any item in it.
+ *       - with DIR_WALK_DEPTH_FIRST the callback for a directory is invoked after the callbacks for all items
+ *         in its sub-tree (post-order per sub-tree), i.e. it is safe to, for example, remove the directory in the callback.
+ *
+ * @note requires linking with pthreads on POSIX, define DIRUTIL_NO_THREADS to exclude all multi-threaded functionality.
+ */
+DIRUTIL_API enum dir_error dir_walk_parallel( const char* path, unsigned int flags,
+   const char* optional_glob_directories, const char* optional_glob_files,
+   unsigned int num_threads, dir_walk_parallel_callback callback, void* userdata );
+
+/* disk usage of a directory and everything in it, as summed up by dir_du and dir_du_top */
+struct dir_du_totals
+{
+   dir_uint64 size;      /* apparent size in bytes, as 'st_size', of the directory itself and all items in it */
+   dir_uint64 allocated; /* bytes allocated on disk, as 'st_blocks' * 512, on Windows the same as 'size' */
+   dir_uint64 num_files; /* items that are not directories, symlinks included */
+   dir_uint64 num_dirs;  /* sub-directories, at any depth, not counting the directory itself */
+};
+
+/**
+ * Callback called with the totals of a directory with dir_du and dir_du_top.
+ * @param path full path to the directory, same as for dir_walk_callback. with DIR_WALK_ROOT_RELATIVE_PATHS
+ *             the input/root-directory is passed as an empty path.
+ * @param depth of the directory, 0 for the input/root-directory.
+ * @param worker_index same as for dir_walk_parallel_callback.
+ *
+ * @return DIR_WALK_CONTINUE (zero) to keep going, anything else stops and DIR_ERROR_ABORTED is returned.
+ */
+typedef int ( *dir_du_callback )( const char* path, unsigned int path_len, unsigned int depth, const struct dir_du_totals* totals, unsigned int worker_index, void* userdata );
+
+/* order of the directories reported by dir_du_top */
+enum dir_du_order
+{
+   DIR_DU_BY_ALLOCATED,
+   DIR_DU_BY_SIZE,
+   DIR_DU_BY_FILES,
+
+   DIR_DU_ORDER_FORCEINT = 65536 /* force the enum to be signed integer */
+};
+
+/**
+ * Sum up the disk usage of path and each directory in it, on multiple threads as dir_walk_parallel.
+ *
+ * Every item is counted in its directory and all directories above it. Files with more than one hard link are only
+ * counted the first time they are found, wherever that is in the tree. Items that can not be read are not counted.
+ * Each worker sums the items of the directories it reads and the totals of a directory are added to its parent when
+ * the directory and all its sub-directories are completed.
+ *
+ * @param flags only DIR_WALK_IGNORE_DOT_DIRECTORIES, DIR_WALK_IGNORE_DOT_FILES, DIR_WALK_ROOT_RELATIVE_PATHS,
+ *              DIR_WALK_SAME_FILESYSTEM, DIR_WALK_FOLLOW_SYMLINKS, DIR_WALK_MAX_DEPTH and the path separator flags are used,
+ *              items ignored by them are not counted. directories the walk is stopped at only count themselves.
+ * @param max_depth callback is only invoked for directories at this depth or above, 0 to only report the
+ *                  input/root-directory. the totals always include everything walked.
+ * @param callback _optional_, invoked concurrently from multiple threads for each directory when its totals are
+ *                 complete, i.e. after all directories below it.
+ * @param totals _optional_, set to the totals of the input/root-directory.
+ *
+ * @note hard-linked files are not detected on Windows.
+ */
+DIRUTIL_API enum dir_error dir_du( const char* path, unsigned int flags, unsigned int max_depth,
+   unsigned int num_threads, dir_du_callback callback, void* userdata, struct dir_du_totals* totals );
+
+/**
+ * Same as dir_du but the callback is only invoked for the num_top directories, at any depth, with the largest totals
+ * in the given order, largest first and from the calling thread after the tree is summed up. Each worker keeps its own
+ * num_top largest directories while walking, so memory use does not grow with the size of the tree.
+ *
+ * @note the directories overlap, i.e. the input/root-directory is always the largest.
+ */
+DIRUTIL_API enum dir_error dir_du_top( const char* path, unsigned int flags, enum dir_du_order order, unsigned int num_top,
+   unsigned int num_threads, dir_du_callback callback, void* userdata, struct dir_du_totals* totals );
+
+/**
+ * Callback called for each hashed item with dir_walk_hash, invoked concurrently from multiple threads.
+ * @param hash of the content of the file, or for a directory of the names and hashes of the items in it.
+ * @param info information about a file, all fields that could be fetched are valid. for directories nothing is valid.
+ * @see dir_walk_parallel_callback.
+ */
+typedef int ( *dir_hash_callback )( const char* path, unsigned int path_len, enum dir_item_type type, dir_uint64 hash,
+   const struct dir_item_info* info, unsigned int worker_index, void* userdata );
+
+/**
+ * Callback asked for a previously computed hash of a file before it is read with dir_walk_hash, invoked concurrently.
+ * @param info information about the file, compare with the information stored with the hash to decide if it is still valid.
+ * @param hash set to the stored hash of the file.
+ * @return non-zero if hash was set and the file should not be read.
+ */
+typedef int ( *dir_hash_cached_callback )( const char* path, unsigned int path_len, const struct dir_item_info* info, dir_uint64* hash, void* userdata );
+
+/**
+ * Walk path as dir_walk_parallel and hash the content of each file, files are read by the workers that find them.
+ * Files up to DIRUTIL_HASH_BUFFER_SIZE bytes are read into a buffer per worker, larger files are mapped into memory.
+ *
+ * The hash of a file is the 64-bit XXH64 hash, seed 0, of its content, of a symlink the hash of the path it refers to
+ * (on Windows the hash of the file it refers to).
+ * The hash of a directory is computed from the names and hashes of the files and sub-directories in it in a way that
+ * does not depend on the order they are read in, so the same content gives the same hash wherever it is found.
+ * Other special files are not hashed.
+ *
+ * @param flags and glob patterns have the same meaning as for dir_walkex and decide the files and directories that are
+ *              hashed, directories only walked to reach matching directories are hashed from the directories below
+ *              them. DIR_WALK_ONLY_FILES and DIR_WALK_ONLY_DIRECTORIES only decide what the callback is invoked for.
+ *              with DIR_WALK_SINGLE_DIRECTORY no sub-directories are hashed, directories that DIR_WALK_MAX_DEPTH,
+ *              DIR_WALK_SAME_FILESYSTEM or DIR_WALK_FOLLOW_SYMLINKS stop the walk at are hashed as empty directories.
+ * @param cached _optional_, see dir_hash_cached_callback.
+ * @param callback _optional_, invoked for each file when it is hashed and for each directory after all items in it.
+ * @param userdata passed to cached and callback.
+ * @param root_hash _optional_, set to the hash of the input/root-directory.
+ *
+ * @return DIR_ERROR_FAILED if a file or directory could not be read, everything else is still hashed but root_hash
+ *         does not include it.
+ *
+ * @note as with any file mapped into memory, a file that is truncated by someone else while it is hashed raises SIGBUS.
+ *       define DIRUTIL_HASH_BUFFER_SIZE larger than the files to hash to always read them.
+ */
+DIRUTIL_API enum dir_error dir_walk_hash( const char* path, unsigned int flags,
+   const char* optional_glob_directories, const char* optional_glob_files, unsigned int num_threads,
+   dir_hash_cached_callback cached, dir_hash_callback callback, void* userdata, dir_uint64* root_hash );
+#endif
+
 /**
  * Tidy up the path inplace. Convert all slashes to slash specified by input, remove
  * running slashes (i.e. '//' -> '/'), unquote the path (i.e. '"local/folder"' -> 'local/folder'),
@@ -253,12 +782,98 @@ enum dir_glob_result
    DIR_GLOB_MATCH,
    DIR_GLOB_NO_MATCH,
    DIR_GLOB_INVALID_PATTERN,
+   DIR_GLOB_PARTIAL_MATCH, /* only returned by dir_glob_match_partial */
 
    DIR_GLOB_FORCEINT = 65536 /* force the enum to be signed integer */
 };
 
 DIRUTIL_API enum dir_glob_result dir_glob_match( const char* glob_pattern, const char* path );
 
+/**
+ * Glob-pattern pre-parsed by dir_glob_compile, for when the same pattern is matched against many paths.
+ * Matches exactly as dir_glob_match but without re-interpreting the pattern-string for each path.
+ */
+struct dir_glob;
+
+/**
+ * Compile glob-pattern, see dir_glob_match for rules.
+ * @param glob_pattern to compile.
+ * @return compiled pattern to be freed with dir_glob_free, or null if out of memory.
+ *
+ * @note an invalid pattern still compiles, matching it returns DIR_GLOB_INVALID_PATTERN just as dir_glob_match would.
+ */
+DIRUTIL_API struct dir_glob* dir_glob_compile( const char* glob_pattern );
+
+/**
+ * Match compiled glob-pattern vs path.
+ * @return DIR_GLOB_MATCH on match, DIR_GLOB_NO_MATCH on mismatch, otherwise error-code.
+ */
+DIRUTIL_API enum dir_glob_result dir_glob_match_compiled( const struct dir_glob* glob, const char* path );
+
+/**
+ * Match compiled glob-pattern vs path to a directory, and if it does not match, check if a path below it might match.
+ * Used to only walk the directories that could lead to a match, i.e. "src/{a,b}/core" could match below "src" and "src/a" but not below "lib".
+ *
+ * The check is conservative, DIR_GLOB_PARTIAL_MATCH means that a path below might match, not that one does.
+ *
+ * @return DIR_GLOB_MATCH if path match, DIR_GLOB_PARTIAL_MATCH if path does not match but path followed by a separator
+ *         and more path-segments might, DIR_GLOB_NO_MATCH if no path below path can match, otherwise error-code.
+ */
+DIRUTIL_API enum dir_glob_result dir_glob_match_partial( const struct dir_glob* glob, const char* path );
+
+/**
+ * Free glob-pattern returned by dir_glob_compile.
+ */
+DIRUTIL_API void dir_glob_free( struct dir_glob* glob );
+
+/**
+ * Set of glob-patterns used as one filter, with first-match-wins include/exclude semantics.
+ * Patterns that starts with '!' are exclude-patterns (the '!' is not part of the pattern), all others are include-patterns.
+ *
+ * A path is included by the set if the first pattern, in the order given, that matches the path is an include-pattern.
+ * If no pattern match the path it is included only if the set has no include-patterns at all.
+ *
+ * example:
+ *    { "!build", "*" }      - everything except 'build'
+ *    { "!*.tmp" }            - everything except paths ending with '.tmp'
+ *    { "*.c", "*.h" }        - only paths ending with '.c' or '.h'
+ *
+ * The set is not a combined automaton. It is a pre-filter: a table indexed by the last char of the path gives the
+ * patterns that could match a path ending with it, and only those are then matched one by one, in order, as with
+ * dir_glob_match_compiled. Sets of patterns that end with different chars, i.e. "*.c", "*.h", "*.txt", only try
+ * one or a few of them per path, patterns that can end with any char, i.e. "**" or ones ending with '*', are tried for
+ * every path.
+ */
+struct dir_glob_set;
+
+/**
+ * Compile set of glob-patterns.
+ * @return set to be freed with dir_glob_set_free, or null if out of memory.
+ */
+DIRUTIL_API struct dir_glob_set* dir_glob_set_compile( const char* const* glob_patterns, unsigned int num_patterns );
+
+/**
+ * @return index of first pattern that matches path, or -1 if no pattern match.
+ */
+DIRUTIL_API int dir_glob_set_match_first( const struct dir_glob_set* set, const char* path );
+
+/**
+ * Match all patterns vs path.
+ * @param match_bits receives one bit per pattern, set if pattern matches path, must hold at least (num_patterns + 31) / 32 items.
+ * @return number of patterns that matched.
+ */
+DIRUTIL_API unsigned int dir_glob_set_match_all( const struct dir_glob_set* set, const char* path, unsigned int* match_bits );
+
+/**
+ * @return 1 if path is included by the set (see above), otherwise 0.
+ */
+DIRUTIL_API int dir_glob_set_includes( const struct dir_glob_set* set, const char* path );
+
+/**
+ * Free set returned by dir_glob_set_compile.
+ */
+DIRUTIL_API void dir_glob_set_free( struct dir_glob_set* set );
+
 #ifdef __cplusplus
    }
 #endif
@@ -268,6 +883,7 @@ DIRUTIL_API enum dir_glob_result dir_glob_match( const char* glob_pattern, const
 #if defined(DIRUTIL_IMPLEMENTATION)
 
 #include <string.h>
+#include <time.h>
 
 #define dir_strlen32(s) (unsigned int)strlen( (s) )
 
@@ -293,19 +909,126 @@ DIRUTIL_API enum dir_glob_result dir_glob_match( const char* glob_pattern, const
    #endif
 #else
    #include <sys/stat.h>
+   #include <sys/mman.h>
+   #include <stdio.h> /* rename */
    #include <errno.h>
+   #include <fcntl.h>
    #include <unistd.h>
 
    #include <dirent.h>
    #ifndef _DIRENT_HAVE_D_TYPE
       #error "_DIRENT_HAVE_D_TYPE undefined is unhandled (probably missing _DEFAULT_SOURCE or _BSD_SOURCE define)"
    #endif
+
+   /*
+      opt-in, linux only, backend that reads directory entries in large batches with 'getdents64'
+      directly into a buffer of DIRUTIL_GETDENTS64_BUFFER_SIZE bytes instead of going through 'readdir'.
+      define DIRUTIL_USE_GETDENTS64 before including the implementation to enable it.
+   */
+   #if defined( DIRUTIL_USE_GETDENTS64 )
+      #if !defined( __linux__ )
+         #error "DIRUTIL_USE_GETDENTS64 is only supported on linux"
+      #endif
+      #include <stdint.h>
+      #include <sys/syscall.h>
+      #ifndef DIRUTIL_GETDENTS64_BUFFER_SIZE
+         #define DIRUTIL_GETDENTS64_BUFFER_SIZE ( 64 * 1024 )
+      #endif
+   #endif
+
+   /*
+      opt-in, linux only, fetch item information for 'dir_walkex_info' with 'statx' asking the kernel only for the
+      requested fields instead of 'fstatat' that always fetches all of them (matters on network filesystems).
+      falls back to 'fstatat' if the kernel do not support 'statx'.
+   */
+   #if defined( DIRUTIL_USE_STATX )
+      #if !defined( __linux__ )
+         #error "DIRUTIL_USE_STATX is only supported on linux"
+      #endif
+      #include <stdint.h>
+      #include <sys/syscall.h>
+   #endif
+
+   /*
+      opt-in, linux only, 'dir_walkex_info' reads entries in chunks of DIRUTIL_IO_URING_BATCH_SIZE and fetches the
+      information of a whole chunk with one batch of 'statx' submitted to io_uring, so that the kernel can fetch cold
+      inodes concurrently instead of one synchronous call at a time. if io_uring is not available at runtime the
+      synchronous path is used.
+
+      only the chunk being walked is in flight, the walk waits for all of its requests to complete before reporting
+      its first entry and does not read ahead into the next directories. the concurrency is bounded by the chunk, so
+      trees with few entries per directory gain little.
+   */
+   #if defined( DIRUTIL_USE_IO_URING )
+      #if !defined( __linux__ )
+         #error "DIRUTIL_USE_IO_URING is only supported on linux"
+      #endif
+      #include <stdint.h>
+      #include <sys/syscall.h>
+      #ifndef DIRUTIL_IO_URING_BATCH_SIZE
+         #define DIRUTIL_IO_URING_BATCH_SIZE 128
+      #endif
+   #endif
+
+   /* dir_copytree, files are cloned with 'FICLONE' or copied in the kernel with 'copy_file_range' when possible */
+   #if defined( __linux__ )
+      #include <sys/ioctl.h>
+      #include <sys/syscall.h>
+   #endif
+   #ifndef DIRUTIL_COPY_BUFFER_SIZE
+      #define DIRUTIL_COPY_BUFFER_SIZE ( 1024 * 1024 )
+   #endif
+
+   /* dir_watch_open/dir_watch_poll, changes are collected until none has arrived for DIRUTIL_WATCH_COALESCE_MS */
+   #if defined( __linux__ )
+      #include <sys/inotify.h>
+      #include <poll.h>
+      #ifndef DIRUTIL_WATCH_COALESCE_MS
+         #define DIRUTIL_WATCH_COALESCE_MS 50
+      #endif
+   #endif
+#endif
+
+/*
+   dir_path_tidy and the glob-matchers scan paths 16 bytes at a time with SSE2 on x86, and 32 bytes at a time with
+   AVX2 when the cpu supports it (gcc/clang only, checked at runtime). define DIRUTIL_NO_SIMD to always use the
+   scalar versions.
+*/
+#if !defined( DIRUTIL_NO_SIMD ) && ( defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 ) )
+   #define DIR_SIMD_SSE2
+   #include <emmintrin.h>
+   #if ( defined( __x86_64__ ) || defined( __i386__ ) ) && ( defined( __clang__ ) || ( defined( __GNUC__ ) && __GNUC__ >= 5 ) )
+      #define DIR_SIMD_AVX2
+      #include <immintrin.h>
+   #endif
+#endif
+
+/* the simd scans that read past the null-terminator within an aligned block are not checked by address sanitizer */
+#if defined( __SANITIZE_ADDRESS__ )
+   #define DIR_NO_SANITIZE_ADDRESS __attribute__(( no_sanitize_address ))
+#elif defined( __has_feature )
+   #if __has_feature( address_sanitizer )
+      #define DIR_NO_SANITIZE_ADDRESS __attribute__(( no_sanitize_address ))
+   #endif
+#endif
+#if !defined( DIR_NO_SANITIZE_ADDRESS )
+   #define DIR_NO_SANITIZE_ADDRESS
+#endif
+
+#if !defined( DIRUTIL_MALLOC )
+   #include <stdlib.h>
+   #define DIRUTIL_MALLOC( size ) malloc( size )
+   #define DIRUTIL_FREE( ptr ) free( ptr )
 #endif
 
 /* forward declare glob-match implementation */
 static enum dir_glob_result dir_glob_match_impl( const char* glob_pattern, const char* glob_end, const char* path );
+static enum dir_glob_result dir_glob_match_compiled_impl( const struct dir_glob* glob, const char* path, unsigned int path_len );
+static enum dir_glob_result dir_glob_match_partial_impl( const struct dir_glob* glob, const char* path, unsigned int path_len );
+static int dir_glob_set_includes_impl( const struct dir_glob_set* set, const char* path, unsigned int path_len );
 
 #define DIR_IS_SEP(c) ((c) == '\\' || (c) == '/')
+#define DIR_GLOB_IS_SPECIAL(c) ((c) == '*' || (c) == '?' || (c) == '[' || (c) == '{' || (c) == '/')
 
 static char dir_walk_slash_by_flags( unsigned int flags )
 {
@@ -318,64 +1041,246 @@ static char dir_walk_slash_by_flags( unsigned int flags )
    }
 }
 
-static unsigned dir_walk_trim_convert_slashes_inplace( char* dest, char slash_substitute )
+/* the item was neither reported as file or directory by the reader and type has to be resolved by 'stat' */
+#define DIR_WALK_READER_TYPE_UNKNOWN -1
+
+/* reads the entries of one open directory, one reader per level in the walk */
+struct dir_walk_reader
 {
-   char c;
-   char *runner = dest, *odest = dest;
+#if defined ( _WIN32 )
+   HANDLE ffh;
+   WIN32_FIND_DATAA ffd;
+   int has_entry;
+#elif defined( DIRUTIL_USE_GETDENTS64 )
+   int fd;
+   char* buffer;
+   long buffer_len;
+   long buffer_pos;
+   unsigned char d_type; /* of last entry */
+   dir_uint64 d_ino;
+#else
+   DIR* dir;
+   unsigned char d_type; /* of last entry */
+   dir_uint64 d_ino;
+#endif
+#if defined( DIRUTIL_USE_IO_URING )
+   struct dir_walk_batch* batch; /* optional, entries read ahead with their information */
+#endif
+   const struct dir_snapshot* snapshot; /* set if the directory is read from a snapshot instead of the file system */
+   unsigned int snapshot_dir;
+   unsigned int snapshot_entry;         /* next entry to read from the snapshot */
+   unsigned int snapshot_end;
+   struct dir_walk_sorted* sorted;      /* set if all entries have been read and are handed out sorted, DIR_WALK_SORTED */
+   int error;                           /* set if reading the directory failed, not all entries were read */
+};
+
+#if defined( DIRUTIL_USE_GETDENTS64 )
+/* layout of the records returned by 'getdents64', glibc do not expose this struct before 2.30 */
+struct dir_linux_dirent64
+{
+   uint64_t d_ino;
+   int64_t d_off;
+   unsigned short d_reclen;
+   unsigned char d_type;
+   char d_name[1];
+};
+#endif
+
+/*
+   layout of the files written by dir_snapshot_save, in native byte-order and mapped as is by dir_snapshot_open:
+   header, 'num_dirs' struct dir_snapshot_dir, 'num_entries' struct dir_snapshot_entry, 'num_entries' struct dir_item_info
+   if 'info_fields' is not 0 and last 'strings_size' bytes of null-terminated names. all sections are 8-byte aligned as
+   the sizes of the structs are multiples of 8. the entries of a directory are stored in the order they were read.
+*/
+#define DIR_SNAPSHOT_MAGIC   "DIRSNAP"
+#define DIR_SNAPSHOT_VERSION 2
+#define DIR_SNAPSHOT_NONE    0xffffffffu
+
+struct dir_snapshot_header
+{
+   char magic[8];             /* DIR_SNAPSHOT_MAGIC */
+   unsigned int version;      /* DIR_SNAPSHOT_VERSION, does not match if written with another byte-order */
+   unsigned int header_size;  /* sizes of the structs in the file, do not match if written with another layout */
+   unsigned int dir_size;
+   unsigned int entry_size;
+   unsigned int info_size;
+   unsigned int info_fields;  /* enum dir_item_info_fields stored for each entry */
+   unsigned int num_dirs;
+   unsigned int num_entries;
+   unsigned int strings_size;
+   unsigned int root_path;    /* offset in strings of the path the snapshot was saved from */
+   dir_uint64 file_size;
+};
+
+struct dir_snapshot_dir
+{
+   unsigned int parent;       /* index of parent directory, DIR_SNAPSHOT_NONE for the root */
+   unsigned int entry;        /* index of the entry in parent that leads here, DIR_SNAPSHOT_NONE for the root */
+   unsigned int first_entry;
+   unsigned int num_entries;
+   dir_int64 mtime;           /* of the directory itself, changes when entries are added, removed or renamed */
+   dir_int64 ctime;           /* changes as well if mtime is set back, as archivers and copy tools do. 0 on windows */
+   unsigned int mtime_nsec;
+   unsigned int ctime_nsec;
+   dir_uint64 inode;
+   dir_uint64 device;
+   unsigned int reusable;     /* 1 if the stored entries are still valid as long as mtime, ctime, inode and device match */
+   unsigned int unused;
+};
+
+#define DIR_SNAPSHOT_SYMLINK_KNOWN 1u
+#define DIR_SNAPSHOT_SYMLINK       2u
+
+struct dir_snapshot_entry
+{
+   unsigned int name;         /* offset in strings */
+   unsigned int dir;          /* index of the directory for entries of type DIR_ITEM_DIR that could be read, otherwise DIR_SNAPSHOT_NONE */
+   unsigned int type;         /* enum dir_item_type */
+   unsigned int flags;        /* DIR_SNAPSHOT_SYMLINK_KNOWN and DIR_SNAPSHOT_SYMLINK, independent of 'info_fields' */
+};
+
+struct dir_snapshot
+{
+   const struct dir_snapshot_header* header;
+   const struct dir_snapshot_dir* dirs;
+   const struct dir_snapshot_entry* entries;
+   const struct dir_item_info* infos; /* 0x0 if no information is stored */
+   const char* strings;
+   void* data;
+   size_t size;
 #if defined( _WIN32 )
-   /* handle UNC paths */
-   if ( runner[0] == DIR_SEP_PLATFORM && runner[1] == DIR_SEP_PLATFORM )
-   {
-      *dest++ = *runner++;
-      *dest++ = *runner++;
-      while ( DIR_IS_SEP( *runner ) )
-         ++runner;
-   }
+   HANDLE mapping;
+#endif
+};
+
+/* start reading directory 'dir' of snapshot */
+static enum dir_error dir_snapshot_reader_open( struct dir_walk_reader* reader, const struct dir_snapshot* snapshot, unsigned int dir )
+{
+   if ( dir == DIR_SNAPSHOT_NONE )
+      return DIR_ERROR_PATH_DO_NOT_EXIST;
+
+   reader->snapshot = snapshot;
+   reader->snapshot_dir = dir;
+   reader->snapshot_entry = snapshot->dirs[dir].first_entry;
+   reader->snapshot_end = reader->snapshot_entry + snapshot->dirs[dir].num_entries;
+   reader->sorted = 0x0;
+   reader->error = 0;
+#if defined( DIRUTIL_USE_IO_URING )
+   reader->batch = 0x0;
 #endif
-   while ( ( c = *runner++ ) )
+   return DIR_ERROR_OK;
+}
+
+/* open the sub-directory item_name of the snapshot directory read by parent */
+static enum dir_error dir_snapshot_reader_open_child( struct dir_walk_reader* reader, const struct dir_walk_reader* parent, const char* item_name )
+{
+   const struct dir_snapshot* snapshot = parent->snapshot;
+   unsigned int entry = parent->snapshot_entry - 1;
+
+   /* the walks open a sub-directory right after reading its entry, search the directory if not */
+   if ( parent->snapshot_entry == snapshot->dirs[parent->snapshot_dir].first_entry || strcmp( snapshot->strings + snapshot->entries[entry].name, item_name ) != 0 )
    {
-      switch ( c ) {
-      case '/':
-      case '\\': {
-         c = slash_substitute;
-         /* next is slash ? */
-         if ( DIR_IS_SEP( *runner ) )
+      for ( entry = snapshot->dirs[parent->snapshot_dir].first_entry; entry < parent->snapshot_end; ++entry )
+         if ( strcmp( snapshot->strings + snapshot->entries[entry].name, item_name ) == 0 )
             break;
-      }
-      /* FALLTHRU */
-      default:
-         *dest++ = c;
-      }
+      if ( entry == parent->snapshot_end )
+         return DIR_ERROR_PATH_DO_NOT_EXIST;
    }
+   return dir_snapshot_reader_open( reader, snapshot, snapshot->entries[entry].dir );
+}
 
-   *dest = '\0';
-   return (unsigned)(dest - odest);
+static int dir_snapshot_reader_read( struct dir_walk_reader* reader, const char** item_name, int* is_dir )
+{
+   const struct dir_snapshot_entry* entry;
+   if ( reader->snapshot_entry == reader->snapshot_end )
+      return 0;
+
+   entry = &reader->snapshot->entries[reader->snapshot_entry++];
+   *item_name = reader->snapshot->strings + entry->name;
+   *is_dir = entry->type == DIR_ITEM_DIR;
+   return 1;
 }
 
-static enum dir_error dir_walk_impl( char* path_buffer, unsigned int path_len, unsigned path_buffer_size, unsigned root_path_len,
-   const char* optional_glob_directories, const char* optional_glob_directories_end,
-   const char* optional_glob_files, const char* optional_glob_files_end,
-   unsigned int flags, dir_walk_callback callback, void* userdata )
+/* information of a stored entry, 'stored_info' is 0x0 if no information was stored */
+static void dir_snapshot_entry_info( const struct dir_snapshot_entry* entry, const struct dir_item_info* stored_info, unsigned int fields, struct dir_item_info* info )
 {
-#if defined ( _WIN32 )
-   HANDLE ffh;
-   WIN32_FIND_DATAA ffd;
+   if ( stored_info )
+   {
+      *info = *stored_info;
+      info->valid &= fields;
+   }
+   else
+      info->valid = 0;
+
+   if ( ( fields & DIR_ITEM_INFO_SYMLINK ) && ( entry->flags & DIR_SNAPSHOT_SYMLINK_KNOWN ) )
+   {
+      info->is_symlink = ( entry->flags & DIR_SNAPSHOT_SYMLINK ) != 0;
+      info->valid |= DIR_ITEM_INFO_SYMLINK;
+   }
+}
+
+static void dir_snapshot_reader_item_info( const struct dir_walk_reader* reader, unsigned int fields, struct dir_item_info* info )
+{
+   const struct dir_snapshot* snapshot = reader->snapshot;
+   unsigned int entry = reader->snapshot_entry - 1;
+   dir_snapshot_entry_info( &snapshot->entries[entry], snapshot->infos ? &snapshot->infos[entry] : 0x0, fields, info );
+}
+
+#if !defined( _WIN32 )
+static int dir_walk_reader_fd( const struct dir_walk_reader* reader )
+{
+#if defined( DIRUTIL_USE_GETDENTS64 )
+   return reader->fd;
 #else
-   struct dirent* ent;
-   DIR* dir;
+   return dirfd( reader->dir );
 #endif
-   enum dir_error result = DIR_ERROR_OK;
+}
 
-   char slash = dir_walk_slash_by_flags( flags );
+/* resolve if item is a directory when the reader could not tell, without following symlinks just as d_type */
+static int dir_walk_reader_stat_is_dir( const struct dir_walk_reader* reader, const char* item_name, int* is_dir )
+{
+   struct stat s;
+   if ( fstatat( dir_walk_reader_fd( reader ), item_name, &s, AT_SYMLINK_NOFOLLOW ) != 0 )
+      return 0;
+   *is_dir = S_ISDIR( s.st_mode );
+   return 1;
+}
 
-   int should_walk_directories = ( flags & DIR_WALK_SINGLE_DIRECTORY ) == 0;
-   int should_ignore_dot_directories = flags & DIR_WALK_IGNORE_DOT_DIRECTORIES;
-   int should_ignore_dot_files = flags & DIR_WALK_IGNORE_DOT_FILES;
-   int should_call_callback_directories = ( flags & DIR_WALK_ONLY_FILES ) == 0;
-   int should_call_callback_files = ( flags & DIR_WALK_ONLY_DIRECTORIES ) == 0;
-   unsigned int callback_path_offset = ( flags & DIR_WALK_ROOT_RELATIVE_PATHS ) ? ( root_path_len + 1 ) : 0;
+/* DIR_WALK_FOLLOW_SYMLINKS, returns 1 if the last entry read, that is not a directory itself, is a symlink to a directory */
+static int dir_walk_reader_is_dir_symlink( const struct dir_walk_reader* reader, const char* item_name )
+{
+   struct stat s;
+   if ( reader->snapshot || ( reader->d_type != DT_LNK && reader->d_type != DT_UNKNOWN ) )
+      return 0;
+   return fstatat( dir_walk_reader_fd( reader ), item_name, &s, 0 ) == 0 && S_ISDIR( s.st_mode );
+}
+#endif
+
+/**
+ * open directory for reading.
+ * @param parent reader of the directory containing the directory to open, or null if this is the root of the walk.
+ * @param path_buffer full path to the directory, only used to open the root of the walk (or on platforms without *at-functions).
+ * @param item_name name of the directory relative to parent, only used if parent is not null.
+ * @param follow_symlink open item_name even if it is a symlink, DIR_WALK_FOLLOW_SYMLINKS.
+ *
+ * @note on POSIX the directory is opened relative to the parent directory so that the kernel do not have
+ *       to resolve the full path once again for each directory in the walk.
+ */
+static enum dir_error dir_walk_reader_open( struct dir_walk_reader* reader, const struct dir_walk_reader* parent, const char* item_name,
+   char* path_buffer, unsigned int path_len, unsigned int path_buffer_size, char slash, int follow_symlink )
+{
+#if !defined ( _WIN32 )
+   int fd;
+#endif
+
+   if ( parent && parent->snapshot )
+      return dir_snapshot_reader_open_child( reader, parent, item_name );
+   reader->snapshot = 0x0;
+   reader->sorted = 0x0;
+   reader->error = 0;
 
 #if defined ( _WIN32 )
+   (void)follow_symlink;
    if ( path_buffer_size < 3 )
       return DIR_ERROR_PATH_TOO_DEEP;
 
@@ -383,505 +1288,7685 @@ static enum dir_error dir_walk_impl( char* path_buffer, unsigned int path_len, u
    path_buffer[path_len + 1] = '*';
    path_buffer[path_len + 2] = '\0';
 
-   ffh = FindFirstFileA( path_buffer, &ffd );
-   if ( ffh == INVALID_HANDLE_VALUE )
+   reader->ffh = FindFirstFileA( path_buffer, &reader->ffd );
+   path_buffer[path_len] = '\0';
+   if ( reader->ffh == INVALID_HANDLE_VALUE )
       return DIR_ERROR_PATH_DO_NOT_EXIST;
+   reader->has_entry = 1;
 #else
-   dir = opendir( path_buffer );
-   if ( dir == 0x0 )
+   (void)path_len; (void)path_buffer_size; (void)slash;
+   if ( parent )
+      fd = openat( dir_walk_reader_fd( parent ), item_name, O_RDONLY | O_DIRECTORY | ( follow_symlink ? 0 : O_NOFOLLOW ) | O_CLOEXEC );
+   else
+      fd = open( path_buffer, O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+   if ( fd < 0 )
       return DIR_ERROR_PATH_DO_NOT_EXIST;
-#endif
-
-#if defined ( _WIN32 )
-   do
-#else
-   while ( ( ent = readdir( dir ) ) != 0x0 )
-#endif
-   {
-      unsigned int item_len, current_path_len;
-      #if defined ( _WIN32 )
-         const char* item_name = ffd.cFileName;
-         int is_dir = ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY;
-      #else
-         const char* item_name = ent->d_name;
-         int is_dir = ent->d_type == DT_DIR;
-         if ( ent->d_type == DT_UNKNOWN )
-         {
-            struct stat s;
-            if ( stat( path_buffer, &s ) != 0 )
-               return DIR_ERROR_FAILED;
-            is_dir = S_ISDIR( s.st_mode );
-         }
-      #endif
 
-      if ( strcmp( item_name, "." ) == 0 || strcmp( item_name, ".." ) == 0 )
-         continue;
+   #if defined( DIRUTIL_USE_IO_URING )
+      reader->batch = 0x0;
+   #endif
 
-      if ( is_dir && should_ignore_dot_directories && *item_name == '.' )
-         continue;
+   #if defined( DIRUTIL_USE_GETDENTS64 )
+      reader->fd = fd;
+      reader->buffer = (char*)DIRUTIL_MALLOC( DIRUTIL_GETDENTS64_BUFFER_SIZE );
+      if ( reader->buffer == 0x0 )
+      {
+         close( fd );
+         return DIR_ERROR_FAILED;
+      }
+      reader->buffer_len = 0;
+      reader->buffer_pos = 0;
+   #else
+      reader->dir = fdopendir( fd );
+      if ( reader->dir == 0x0 )
+      {
+         close( fd );
+         return DIR_ERROR_FAILED;
+      }
+   #endif
+#endif
+   return DIR_ERROR_OK;
+}
 
-      if ( !is_dir && should_ignore_dot_files && *item_name == '.' )
-         continue;
+/* read next entry from the directory, see dir_walk_reader_next */
+static int dir_walk_reader_read( struct dir_walk_reader* reader, const char** item_name, int* is_dir )
+{
+#if defined ( _WIN32 )
+   /* the find-data of the previous entry is handed out to the caller, so advance lazily */
+   if ( reader->has_entry < 0 )
+      reader->has_entry = FindNextFileA( reader->ffh, &reader->ffd ) != 0;
 
-      item_len = dir_strlen32( item_name );
+   if ( !reader->has_entry )
+   {
+      reader->error = GetLastError() != ERROR_NO_MORE_FILES;
+      return 0;
+   }
 
-      if ( path_buffer_size < item_len + 2 ) /* 2 == '/' + null-terminator */
+   *item_name = reader->ffd.cFileName;
+   *is_dir = ( reader->ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) != 0;
+   reader->has_entry = -1;
+   return 1;
+#elif defined( DIRUTIL_USE_GETDENTS64 )
+   struct dir_linux_dirent64* ent;
+   if ( reader->buffer_pos >= reader->buffer_len )
+   {
+      long nread;
+      do
+         nread = (long)syscall( SYS_getdents64, reader->fd, reader->buffer, DIRUTIL_GETDENTS64_BUFFER_SIZE );
+      while ( nread < 0 && errno == EINTR );
+      if ( nread <= 0 )
       {
-         result = DIR_ERROR_PATH_TOO_DEEP;
-         break;
+         reader->error = nread < 0;
+         return 0;
       }
+      reader->buffer_len = nread;
+      reader->buffer_pos = 0;
+   }
 
-      path_buffer[path_len] = slash;
-
-      memcpy( &path_buffer[path_len + 1], item_name, item_len + 1 );
+   ent = (struct dir_linux_dirent64*)( reader->buffer + reader->buffer_pos );
+   reader->buffer_pos += ent->d_reclen;
 
-      current_path_len = path_len + item_len + 1;
+   *item_name = ent->d_name;
+   *is_dir = ent->d_type == DT_UNKNOWN ? DIR_WALK_READER_TYPE_UNKNOWN : ent->d_type == DT_DIR;
+   reader->d_type = ent->d_type;
+   reader->d_ino = (dir_uint64)ent->d_ino;
+   return 1;
+#else
+   struct dirent* ent;
+   errno = 0; /* readdir only sets errno on failure */
+   ent = readdir( reader->dir );
+   if ( ent == 0x0 )
+   {
+      reader->error = errno != 0;
+      return 0;
+   }
 
-      if ( is_dir && ( should_walk_directories || should_call_callback_directories ) )
-      {
-         int matches_pattern = !optional_glob_directories || DIR_GLOB_MATCH == dir_glob_match_impl( optional_glob_directories, optional_glob_directories_end, &path_buffer[root_path_len + 1] );
+   *item_name = ent->d_name;
+   *is_dir = ent->d_type == DT_UNKNOWN ? DIR_WALK_READER_TYPE_UNKNOWN : ent->d_type == DT_DIR;
+   reader->d_type = ent->d_type;
+   reader->d_ino = (dir_uint64)ent->d_ino;
+   return 1;
+#endif
+}
 
-         if ( !matches_pattern )
-            continue;
+static void dir_walk_reader_close( struct dir_walk_reader* reader )
+{
+   if ( reader->snapshot )
+      return;
 
-         if ( flags & DIR_WALK_DEPTH_FIRST )
-         {
-            if ( should_walk_directories )
-               dir_walk_impl( path_buffer, path_len + item_len + 1, path_buffer_size - item_len - 1, root_path_len,
-               optional_glob_directories, optional_glob_directories_end, optional_glob_files, optional_glob_files_end, flags, callback, userdata );
+#if defined ( _WIN32 )
+   FindClose( reader->ffh );
+#else
+   #if defined( DIRUTIL_USE_IO_URING )
+      DIRUTIL_FREE( reader->batch );
+   #endif
+   #if defined( DIRUTIL_USE_GETDENTS64 )
+      DIRUTIL_FREE( reader->buffer );
+      close( reader->fd );
+   #else
+      closedir( reader->dir );
+   #endif
+#endif
+}
 
-            if ( should_call_callback_directories )
-               callback( path_buffer + callback_path_offset, current_path_len - callback_path_offset, DIR_ITEM_DIR, userdata );
-         }
-         else
-         {
-            if ( should_call_callback_directories )
-               callback( path_buffer + callback_path_offset, current_path_len - callback_path_offset, DIR_ITEM_DIR, userdata );
+#if defined( DIRUTIL_USE_STATX ) || defined( DIRUTIL_USE_IO_URING )
+/* layout of 'struct statx', glibc do not expose it before 2.28 */
+struct dir_statx_timestamp
+{
+   int64_t tv_sec;
+   uint32_t tv_nsec;
+   int32_t reserved;
+};
 
-            if ( should_walk_directories )
-               dir_walk_impl( path_buffer, path_len + item_len + 1, path_buffer_size - item_len - 1, root_path_len,
-               optional_glob_directories, optional_glob_directories_end, optional_glob_files, optional_glob_files_end, flags, callback, userdata );
-         }
-      }
-      else if ( !is_dir && should_call_callback_files ) {
-         int matches_pattern = !optional_glob_files || DIR_GLOB_MATCH == dir_glob_match_impl( optional_glob_files, optional_glob_files_end, item_name );
+struct dir_statx
+{
+   uint32_t stx_mask;
+   uint32_t stx_blksize;
+   uint64_t stx_attributes;
+   uint32_t stx_nlink;
+   uint32_t stx_uid;
+   uint32_t stx_gid;
+   uint16_t stx_mode;
+   uint16_t spare0;
+   uint64_t stx_ino;
+   uint64_t stx_size;
+   uint64_t stx_blocks;
+   uint64_t stx_attributes_mask;
+   struct dir_statx_timestamp stx_atime, stx_btime, stx_ctime, stx_mtime;
+   uint32_t stx_rdev_major, stx_rdev_minor;
+   uint32_t stx_dev_major, stx_dev_minor;
+   uint64_t spare2[14];
+};
 
-         if ( !matches_pattern )
-            continue;
+#define DIR_STATX_TYPE  0x001u
+#define DIR_STATX_MODE  0x002u
+#define DIR_STATX_MTIME 0x040u
+#define DIR_STATX_INO   0x100u
+#define DIR_STATX_SIZE  0x200u
 
-         callback( path_buffer + callback_path_offset, current_path_len - callback_path_offset, DIR_ITEM_FILE, userdata );
-      }
+static unsigned int dir_statx_mask( unsigned int fields )
+{
+   unsigned int mask = 0;
+   if ( fields & DIR_ITEM_INFO_SIZE )    mask |= DIR_STATX_SIZE;
+   if ( fields & DIR_ITEM_INFO_MTIME )   mask |= DIR_STATX_MTIME;
+   if ( fields & DIR_ITEM_INFO_INODE )   mask |= DIR_STATX_INO;
+   if ( fields & DIR_ITEM_INFO_MODE )    mask |= DIR_STATX_TYPE | DIR_STATX_MODE;
+   if ( fields & DIR_ITEM_INFO_SYMLINK ) mask |= DIR_STATX_TYPE;
+   return mask;
+}
 
+/* fill the requested fields of info that the kernel returned */
+static void dir_statx_to_item_info( const struct dir_statx* stx, unsigned int fields, struct dir_item_info* info )
+{
+   info->valid = 0;
+   if ( ( fields & DIR_ITEM_INFO_SIZE ) && ( stx->stx_mask & DIR_STATX_SIZE ) )
+   {
+      info->size = stx->stx_size;
+      info->valid |= DIR_ITEM_INFO_SIZE;
    }
-#if defined ( _WIN32 )
-   while ( FindNextFileA( ffh, &ffd ) != 0 );
+   if ( ( fields & DIR_ITEM_INFO_MTIME ) && ( stx->stx_mask & DIR_STATX_MTIME ) )
+   {
+      info->mtime = stx->stx_mtime.tv_sec;
+      info->mtime_nsec = stx->stx_mtime.tv_nsec;
+      info->valid |= DIR_ITEM_INFO_MTIME;
+   }
+   if ( ( fields & DIR_ITEM_INFO_INODE ) && ( stx->stx_mask & DIR_STATX_INO ) )
+   {
+      /* same encoding as glibc 'makedev' so that it compares equal to 'st_dev' */
+      uint64_t major = stx->stx_dev_major, minor = stx->stx_dev_minor;
+      info->inode = stx->stx_ino;
+      info->device = ( ( major & 0xfffff000u ) << 32 ) | ( ( major & 0xfffu ) << 8 ) | ( ( minor & 0xffffff00u ) << 12 ) | ( minor & 0xffu );
+      info->valid |= DIR_ITEM_INFO_INODE;
+   }
+   if ( ( fields & DIR_ITEM_INFO_MODE ) && ( stx->stx_mask & DIR_STATX_TYPE ) && ( stx->stx_mask & DIR_STATX_MODE ) )
+   {
+      info->mode = stx->stx_mode;
+      info->valid |= DIR_ITEM_INFO_MODE;
+   }
+   if ( ( fields & DIR_ITEM_INFO_SYMLINK ) && ( stx->stx_mask & DIR_STATX_TYPE ) )
+   {
+      info->is_symlink = S_ISLNK( stx->stx_mode );
+      info->valid |= DIR_ITEM_INFO_SYMLINK;
+   }
+}
 #endif
-   path_buffer[path_len] = '\0';
 
-#if defined ( _WIN32 )
-   FindClose( ffh );
-#else
-   closedir( dir );
+#if defined( DIRUTIL_USE_IO_URING )
+/* the parts of the io_uring ABI used here, to not depend on liburing or recent kernel headers */
+#if !defined( SYS_io_uring_setup )
+   #define SYS_io_uring_setup 425
+   #define SYS_io_uring_enter 426
 #endif
-   return result;
-}
+#define DIR_IORING_OP_STATX        21
+#define DIR_IORING_ENTER_GETEVENTS 1u
+#define DIR_IORING_FEAT_SINGLE_MMAP 1u
+#define DIR_IORING_OFF_SQ_RING     0
+#define DIR_IORING_OFF_CQ_RING     0x8000000
+#define DIR_IORING_OFF_SQES        0x10000000
+
+struct dir_io_uring_sqe
+{
+   uint8_t opcode;
+   uint8_t flags;
+   uint16_t ioprio;
+   int32_t fd;
+   uint64_t off;
+   uint64_t addr;
+   uint32_t len;
+   uint32_t op_flags;
+   uint64_t user_data;
+   uint16_t buf_index;
+   uint16_t personality;
+   int32_t splice_fd_in;
+   uint64_t addr3;
+   uint64_t pad;
+};
 
-static int dir_walk_iswhite( int c )
+struct dir_io_uring_cqe
 {
-   return   ( ' '  == c ) ||
-            ( '\t' == c ) ||
-            ( '\n' == c ) ||
-            ( '\v' == c ) ||
-            ( '\f' == c ) ||
-            ( '\r' == c );
-}
+   uint64_t user_data;
+   int32_t res;
+   uint32_t flags;
+};
 
-static unsigned int dir_walk_path_trimwhite_unquote( char* path_buffer, unsigned int path_len )
+struct dir_io_uring_params
 {
-   char* p = path_buffer;
-   while ( ( path_len && dir_walk_iswhite( path_buffer[path_len - 1] ) ) || ( path_buffer[path_len - 1] == '"' ) )
-      --path_len;
+   uint32_t sq_entries, cq_entries, flags, sq_thread_cpu, sq_thread_idle, features, wq_fd, resv[3];
+   struct { uint32_t head, tail, ring_mask, ring_entries, flags, dropped, array, resv1; uint64_t user_addr; } sq_off;
+   struct { uint32_t head, tail, ring_mask, ring_entries, overflow, cqes, flags, resv1; uint64_t user_addr; } cq_off;
+};
 
-   while ( ( path_len && dir_walk_iswhite( *p ) ) || *p == '"' )
-      --path_len, ++p;
+struct dir_io_uring
+{
+   int fd;
+   int broken;      /* statx could not be submitted, use the synchronous path from now on */
+   void* sq_ring;
+   void* cq_ring;   /* same as 'sq_ring' with DIR_IORING_FEAT_SINGLE_MMAP */
+   size_t sq_ring_size;
+   size_t cq_ring_size;
+   struct dir_io_uring_sqe* sqes;
+   size_t sqes_size;
+   uint32_t* sq_head;
+   uint32_t* sq_tail;
+   uint32_t* sq_array;
+   uint32_t sq_mask;
+   uint32_t sq_entries;
+   uint32_t* cq_head;
+   uint32_t* cq_tail;
+   uint32_t cq_mask;
+   struct dir_io_uring_cqe* cqes;
+};
 
-   if ( p != path_buffer )
-      memmove( path_buffer, p, path_len );
+static int dir_io_uring_init( struct dir_io_uring* ring, unsigned int entries )
+{
+   struct dir_io_uring_params params;
+   char* sq;
+   char* cq;
 
-   path_buffer[path_len] = '\0';
-   return path_len;
-}
+   memset( &params, 0, sizeof( params ) );
+   ring->fd = (int)syscall( SYS_io_uring_setup, entries, &params );
+   if ( ring->fd < 0 )
+      return 0;
 
-DIRUTIL_API unsigned int dir_path_tidy( char* path, char slash, unsigned int path_len )
-{
-   path_len = path_len ? path_len : dir_strlen32( path );
-   path_len = dir_walk_path_trimwhite_unquote( path, path_len );
-   path_len = dir_walk_trim_convert_slashes_inplace( path, slash );
+   ring->broken = 0;
+   ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof( uint32_t );
+   ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof( struct dir_io_uring_cqe );
+   if ( params.features & DIR_IORING_FEAT_SINGLE_MMAP )
+   {
+      if ( ring->cq_ring_size > ring->sq_ring_size )
+         ring->sq_ring_size = ring->cq_ring_size;
+      ring->cq_ring_size = ring->sq_ring_size;
+   }
 
-   if ( path_len && DIR_IS_SEP( path[path_len - 1] ) )
+   ring->sq_ring = mmap( 0x0, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, DIR_IORING_OFF_SQ_RING );
+   if ( ring->sq_ring == MAP_FAILED )
    {
-      --path_len;
-      path[path_len] = '\0';
+      close( ring->fd );
+      return 0;
    }
-   return path_len;
-}
 
-DIRUTIL_API const char* dir_path_filename( const char* path, unsigned int path_len, unsigned int* filename_len )
-{
-   unsigned full_path_len = path_len;
-   if ( !path_len || DIR_IS_SEP( path[path_len - 1] ) )
+   ring->cq_ring = ring->sq_ring;
+   if ( !( params.features & DIR_IORING_FEAT_SINGLE_MMAP ) )
    {
-      *filename_len = 0;
+      ring->cq_ring = mmap( 0x0, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, DIR_IORING_OFF_CQ_RING );
+      if ( ring->cq_ring == MAP_FAILED )
+      {
+         munmap( ring->sq_ring, ring->sq_ring_size );
+         close( ring->fd );
+         return 0;
+      }
+   }
+
+   ring->sqes_size = params.sq_entries * sizeof( struct dir_io_uring_sqe );
+   ring->sqes = (struct dir_io_uring_sqe*)mmap( 0x0, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, DIR_IORING_OFF_SQES );
+   if ( ring->sqes == MAP_FAILED )
+   {
+      if ( ring->cq_ring != ring->sq_ring )
+         munmap( ring->cq_ring, ring->cq_ring_size );
+      munmap( ring->sq_ring, ring->sq_ring_size );
+      close( ring->fd );
       return 0;
    }
 
-   while ( path_len && !DIR_IS_SEP( path[path_len - 1] ) )
-      --path_len;
+   sq = (char*)ring->sq_ring;
+   cq = (char*)ring->cq_ring;
+   ring->sq_head    = (uint32_t*)( sq + params.sq_off.head );
+   ring->sq_tail    = (uint32_t*)( sq + params.sq_off.tail );
+   ring->sq_array   = (uint32_t*)( sq + params.sq_off.array );
+   ring->sq_mask    = *(uint32_t*)( sq + params.sq_off.ring_mask );
+   ring->sq_entries = params.sq_entries;
+   ring->cq_head    = (uint32_t*)( cq + params.cq_off.head );
+   ring->cq_tail    = (uint32_t*)( cq + params.cq_off.tail );
+   ring->cq_mask    = *(uint32_t*)( cq + params.cq_off.ring_mask );
+   ring->cqes       = (struct dir_io_uring_cqe*)( cq + params.cq_off.cqes );
+   return 1;
+}
 
-   *filename_len = full_path_len - path_len;
-   return path + path_len;
+static void dir_io_uring_destroy( struct dir_io_uring* ring )
+{
+   munmap( ring->sqes, ring->sqes_size );
+   if ( ring->cq_ring != ring->sq_ring )
+      munmap( ring->cq_ring, ring->cq_ring_size );
+   munmap( ring->sq_ring, ring->sq_ring_size );
+   close( ring->fd );
 }
 
-DIRUTIL_API const char* dir_path_extension( const char* path, unsigned int path_len, unsigned int* extension_len )
+/* an entry read ahead by a batched reader */
+struct dir_walk_batch_item
 {
-   unsigned full_path_len = path_len;
+   unsigned int name_offset;
+   unsigned char d_type;
+   dir_uint64 d_ino;
+   int is_dir;
+   int status; /* DIR_WALK_BATCH_NOT_FETCHED, DIR_WALK_BATCH_WANTED, 0 if 'stx' is valid or negative errno */
+   struct dir_statx stx;
+};
 
-   if ( !path_len || DIR_IS_SEP( path[path_len - 1] ) || path[path_len - 1] == '.' )
-      goto no_extension;
+#define DIR_WALK_BATCH_NOT_FETCHED 1
+#define DIR_WALK_BATCH_WANTED      2
 
-   while ( path_len > 1 && path[path_len - 1] != '.' && !DIR_IS_SEP( path[path_len - 1] ) )
-      --path_len;
+/* decides if the information of an entry should be fetched, to not fetch it for entries that will never be reported */
+typedef int ( *dir_walk_batch_want_func )( const void* ctx, const char* item_name, int is_dir );
 
-   if ( path_len > 1 && !DIR_IS_SEP( path[path_len - 2] ) )
-   {
-      *extension_len = full_path_len - path_len;
-      return path + path_len;
-   }
+struct dir_walk_batch
+{
+   struct dir_io_uring* ring;
+   unsigned int statx_mask;
+   dir_walk_batch_want_func want;
+   const void* want_ctx;
+   unsigned int num_items;
+   unsigned int pos;
+   int eof;
+   struct dir_walk_batch_item* current; /* last item returned */
+   struct dir_walk_batch_item items[DIRUTIL_IO_URING_BATCH_SIZE];
+   char names[DIRUTIL_IO_URING_BATCH_SIZE * 256]; /* entry names are at most 255 chars on linux */
+};
 
-no_extension:
-   *extension_len = 0;
-   return 0;
+/* read ahead entries with their information from now on, on failure the reader is left as is. */
+static void dir_walk_reader_enable_batch( struct dir_walk_reader* reader, struct dir_io_uring* ring, unsigned int statx_mask,
+   dir_walk_batch_want_func want, const void* want_ctx )
+{
+   struct dir_walk_batch* batch;
+   if ( ring->broken )
+      return;
+
+   batch = (struct dir_walk_batch*)DIRUTIL_MALLOC( sizeof( struct dir_walk_batch ) );
+   if ( batch == 0x0 )
+      return;
+
+   batch->ring = ring;
+   batch->statx_mask = statx_mask;
+   batch->want = want;
+   batch->want_ctx = want_ctx;
+   batch->num_items = 0;
+   batch->pos = 0;
+   batch->eof = 0;
+   batch->current = 0x0;
+   reader->batch = batch;
 }
 
-DIRUTIL_API enum dir_error dir_walkex( const char* path, unsigned int flags, const char* optional_glob_directories, const char *optional_glob_files, dir_walk_callback callback, void* userdata )
+/*
+   fetch information of all wanted items in batch, keeping as many requests in flight as the ring allows.
+   all submitted requests are completed before returning as they write to the batch, items that could not be
+   submitted are left as DIR_WALK_BATCH_WANTED and fetched synchronously. the ring is only fed from this batch,
+   there is no read ahead into other directories and no entry is reported before the whole batch completes.
+*/
+static void dir_walk_batch_fetch( struct dir_walk_batch* batch, int dir_fd )
 {
-   char path_buffer[4096];
-   unsigned int path_len = dir_strlen32( path );
+   struct dir_io_uring* ring = batch->ring;
+   unsigned int next = 0, queued = 0, in_flight = 0;
 
-   if ( path_len >= sizeof( path_buffer ) - 1 )
-      return DIR_ERROR_FAILED;
+   for ( ;; )
+   {
+      uint32_t tail = *ring->sq_tail;
+      uint32_t cq_head, cq_tail;
+      int res;
 
-   memcpy( path_buffer, path, path_len + 1 );
+      while ( !ring->broken && next < batch->num_items && queued + in_flight < ring->sq_entries )
+      {
+         struct dir_walk_batch_item* item = &batch->items[next];
+         if ( item->status == DIR_WALK_BATCH_WANTED )
+         {
+            struct dir_io_uring_sqe* sqe = &ring->sqes[tail & ring->sq_mask];
+            memset( sqe, 0, sizeof( *sqe ) );
+            sqe->opcode = DIR_IORING_OP_STATX;
+            sqe->fd = dir_fd;
+            sqe->addr = (uint64_t)(uintptr_t)( batch->names + item->name_offset );
+            sqe->len = batch->statx_mask;
+            sqe->off = (uint64_t)(uintptr_t)&item->stx;
+            sqe->op_flags = AT_SYMLINK_NOFOLLOW;
+            sqe->user_data = next;
+            ring->sq_array[tail & ring->sq_mask] = tail & ring->sq_mask;
+            ++tail;
+            ++queued;
+         }
+         ++next;
+      }
+      __atomic_store_n( ring->sq_tail, tail, __ATOMIC_RELEASE );
 
-   path_len = dir_path_tidy( path_buffer, dir_walk_slash_by_flags( flags ), path_len );
+      if ( queued == 0 && in_flight == 0 )
+         break;
 
-   if ( !path_len )
-      return DIR_ERROR_FAILED;
+      res = (int)syscall( SYS_io_uring_enter, ring->fd, queued, 1, DIR_IORING_ENTER_GETEVENTS, 0x0, 0 );
+      if ( res >= 0 )
+      {
+         queued -= (unsigned int)res;
+         in_flight += (unsigned int)res;
+      }
+      else if ( errno != EINTR && errno != EAGAIN && errno != EBUSY )
+      {
+         /* take back what the kernel did not consume and stop using the ring */
+         __atomic_store_n( ring->sq_tail, tail - queued, __ATOMIC_RELEASE );
+         queued = 0;
+         ring->broken = 1;
+         if ( in_flight == 0 )
+            break;
+      }
 
-   return dir_walk_impl( path_buffer, path_len, sizeof( path_buffer ) - path_len, path_len,
-      optional_glob_directories, ( ( optional_glob_directories && *optional_glob_directories ) ? optional_glob_directories + strlen( optional_glob_directories ) : 0),
-      optional_glob_files, ( (optional_glob_files && *optional_glob_files ) ? optional_glob_files + strlen( optional_glob_files ) : 0),
-      flags, callback, userdata );
+      cq_head = *ring->cq_head;
+      cq_tail = __atomic_load_n( ring->cq_tail, __ATOMIC_ACQUIRE );
+      for ( ; cq_head != cq_tail; ++cq_head )
+      {
+         const struct dir_io_uring_cqe* cqe = &ring->cqes[cq_head & ring->cq_mask];
+         struct dir_walk_batch_item* item = &batch->items[cqe->user_data];
+         /* kernels before 5.6 do not know IORING_OP_STATX */
+         if ( cqe->res == -EINVAL )
+            ring->broken = 1;
+         else
+            item->status = cqe->res;
+         --in_flight;
+      }
+      __atomic_store_n( ring->cq_head, cq_head, __ATOMIC_RELEASE );
+   }
 }
 
-DIRUTIL_API enum dir_error dir_create( const char* path )
+static int dir_walk_batch_next( struct dir_walk_reader* reader, const char** item_name, int* is_dir )
 {
-#if defined( _WIN32 )
-   if ( CreateDirectoryA( path, 0x0 ) )
-      return DIR_ERROR_OK;
-   if ( GetLastError() == ERROR_ALREADY_EXISTS )
-      return DIR_ERROR_OK;
+   struct dir_walk_batch* batch = reader->batch;
+   struct dir_walk_batch_item* item;
+
+   if ( batch->pos == batch->num_items )
+   {
+      unsigned int names_size = 0;
+      const char* name;
+      int dir;
+
+      batch->num_items = 0;
+      batch->pos = 0;
+      batch->current = 0x0;
+      while ( !batch->eof && batch->num_items < DIRUTIL_IO_URING_BATCH_SIZE )
+      {
+         unsigned int len;
+         if ( !dir_walk_reader_read( reader, &name, &dir ) )
+         {
+            batch->eof = 1;
+            break;
+         }
+         len = dir_strlen32( name ) + 1;
+         item = &batch->items[batch->num_items++];
+         item->name_offset = names_size;
+         item->d_type = reader->d_type;
+         item->d_ino = reader->d_ino;
+         item->is_dir = dir;
+         item->status = batch->want( batch->want_ctx, name, dir ) ? DIR_WALK_BATCH_WANTED : DIR_WALK_BATCH_NOT_FETCHED;
+         memcpy( batch->names + names_size, name, len );
+         names_size += len;
+      }
+      if ( batch->num_items == 0 )
+         return 0;
+      dir_walk_batch_fetch( batch, dir_walk_reader_fd( reader ) );
+   }
+
+   item = &batch->items[batch->pos++];
+   batch->current = item;
+   reader->d_type = item->d_type;
+   reader->d_ino = item->d_ino;
+   *item_name = batch->names + item->name_offset;
+   *is_dir = item->is_dir;
+   return 1;
+}
+#endif
+
+/* grow array of 'count' elements to 'capacity' elements, returns 0 on failure and leaves array as is */
+static int dir_array_grow( void** array, unsigned int count, unsigned int capacity, unsigned int element_size )
+{
+   void* grown = DIRUTIL_MALLOC( (size_t)capacity * element_size );
+   if ( grown == 0x0 )
+      return 0;
+   if ( count )
+      memcpy( grown, *array, (size_t)count * element_size );
+   DIRUTIL_FREE( *array );
+   *array = grown;
+   return 1;
+}
+
+/* an entry read by dir_walk_reader_sort, with what the reader needs to hand it out as if it was just read */
+struct dir_walk_sorted_entry
+{
+   dir_uint64 key;      /* 8 bytes of the name from the current sort depth as a big-endian number, 0-padded */
+   unsigned int name;   /* offset in 'names' */
+   int is_dir;
+#if defined( _WIN32 )
+   DWORD attributes;
+   DWORD size_high;
+   DWORD size_low;
+   FILETIME mtime;
+   DWORD reparse_tag;
 #else
-   if ( mkdir( path, 0777 ) == 0 )
-      return DIR_ERROR_OK;
-   if ( errno == EEXIST )
-      return DIR_ERROR_OK;
+   dir_uint64 d_ino;
+   unsigned char d_type;
 #endif
-   return DIR_ERROR_FAILED;
+   unsigned int snapshot_entry;
+};
+
+/* all entries of one directory, DIR_WALK_SORTED. the walks keep one per directory level and reuse it for the next directory */
+struct dir_walk_sorted
+{
+   struct dir_walk_sorted_entry* entries;
+   struct dir_walk_sorted_entry* scratch; /* radix sort moves entries between 'entries' and 'scratch' */
+   unsigned int count;
+   unsigned int capacity;
+   unsigned int pos;                      /* next entry to hand out */
+   char* names;
+   unsigned int names_size;
+   unsigned int names_capacity;
+};
+
+static void dir_walk_sorted_free( struct dir_walk_sorted* sorted )
+{
+   DIRUTIL_FREE( sorted->entries );
+   DIRUTIL_FREE( sorted->scratch );
+   DIRUTIL_FREE( sorted->names );
 }
 
-static int dir_walk_rmitem( const char* path, unsigned int path_len, enum dir_item_type type, void* userdata )
+#define DIR_WALK_SORT_INSERTION_MAX 32
+
+static dir_uint64 dir_walk_sort_key( const char* name, unsigned int depth )
 {
-   (void)path_len;
-   switch ( type )
+   dir_uint64 key = 0;
+   unsigned int i;
+   for ( i = 0; i < depth; ++i )
+      if ( name[i] == '\0' )
+         return 0;
+   name += depth;
+   for ( i = 0; i < 8 && name[i] != '\0'; ++i )
+      key |= (dir_uint64)(unsigned char)name[i] << ( 56 - 8 * i );
+   return key;
+}
+
+/* entries with the same key only differ after depth + 8 chars, unless both names end within the key (can not happen in a directory) */
+static int dir_walk_sort_less( const struct dir_walk_sorted* sorted, const struct dir_walk_sorted_entry* a, const struct dir_walk_sorted_entry* b, unsigned int depth )
+{
+   if ( a->key != b->key )
+      return a->key < b->key;
+   return ( a->key & 0xff ) != 0 && strcmp( sorted->names + a->name + depth + 8, sorted->names + b->name + depth + 8 ) < 0;
+}
+
+/*
+   sort entries[0, count) that all have the same first 'depth' chars. small ranges are insertion-sorted, larger ones are
+   radix-sorted on the 8 bytes from depth, one byte per pass and skipping bytes that are the same in all entries, after
+   which each run of equal keys is sorted on the following 8 bytes.
+*/
+static void dir_walk_sort_range( struct dir_walk_sorted* sorted, struct dir_walk_sorted_entry* entries, struct dir_walk_sorted_entry* scratch, unsigned int count, unsigned int depth )
+{
+   struct dir_walk_sorted_entry* src = entries;
+   struct dir_walk_sorted_entry* dst = scratch;
+   unsigned int i, j, shift;
+
+   for ( i = 0; i < count; ++i )
+      entries[i].key = dir_walk_sort_key( sorted->names + entries[i].name, depth );
+
+   if ( count <= DIR_WALK_SORT_INSERTION_MAX )
    {
-   case DIR_ITEM_FILE:
+      for ( i = 1; i < count; ++i )
+      {
+         struct dir_walk_sorted_entry entry = entries[i];
+         for ( j = i; j > 0 && dir_walk_sort_less( sorted, &entry, &entries[j - 1], depth ); --j )
+            entries[j] = entries[j - 1];
+         entries[j] = entry;
+      }
+      return;
+   }
+
+   for ( shift = 0; shift < 64; shift += 8 )
+   {
+      unsigned int counts[256];
+      unsigned int offset = 0;
+      memset( counts, 0, sizeof( counts ) );
+      for ( i = 0; i < count; ++i )
+         ++counts[( src[i].key >> shift ) & 0xff];
+      if ( counts[( src[0].key >> shift ) & 0xff] == count )
+         continue;
+      for ( i = 0; i < 256; ++i )
+      {
+         unsigned int bucket = counts[i];
+         counts[i] = offset;
+         offset += bucket;
+      }
+      for ( i = 0; i < count; ++i )
+         dst[counts[( src[i].key >> shift ) & 0xff]++] = src[i];
+      src = dst;
+      dst = src == entries ? scratch : entries;
+   }
+   if ( src != entries )
+      memcpy( entries, src, count * sizeof( struct dir_walk_sorted_entry ) );
+
+   for ( i = 0; i < count; i = j )
+   {
+      for ( j = i + 1; j < count && entries[j].key == entries[i].key; ++j )
+         ;
+      if ( j - i > 1 && ( entries[i].key & 0xff ) != 0 )
+         dir_walk_sort_range( sorted, entries + i, scratch + i, j - i, depth + 8 );
+   }
+}
+
+static int dir_walk_sorted_next( struct dir_walk_reader* reader, const char** item_name, int* is_dir )
+{
+   struct dir_walk_sorted* sorted = reader->sorted;
+   const struct dir_walk_sorted_entry* entry;
+   if ( sorted->pos == sorted->count )
+      return 0;
+
+   /* restore the state of the reader as it was when the entry was read, the item information is fetched from it */
+   entry = &sorted->entries[sorted->pos++];
+   *item_name = sorted->names + entry->name;
+   *is_dir = entry->is_dir;
+   if ( reader->snapshot )
+      reader->snapshot_entry = entry->snapshot_entry;
 #if defined( _WIN32 )
-      if ( !DeleteFileA( path ) )
-         *((enum dir_error*)userdata) = DIR_ERROR_FAILED;
+   reader->ffd.dwFileAttributes = entry->attributes;
+   reader->ffd.nFileSizeHigh = entry->size_high;
+   reader->ffd.nFileSizeLow = entry->size_low;
+   reader->ffd.ftLastWriteTime = entry->mtime;
+   reader->ffd.dwReserved0 = entry->reparse_tag;
 #else
-      if ( unlink( path ) != 0 )
-         *((enum dir_error*)userdata) = DIR_ERROR_FAILED;
+   reader->d_ino = entry->d_ino;
+   reader->d_type = entry->d_type;
 #endif
-      break;
-   case DIR_ITEM_DIR:
-      #if defined ( _WIN32 )
-         #pragma warning( push )
-         #pragma warning( disable : 4996 ) /* 'rmdir': the POSIX name for this item is deprecated... */
-      #endif
-      if ( rmdir( path ) != 0 )
-         *((enum dir_error*)userdata) = DIR_ERROR_FAILED;
-      #if defined ( _WIN32 )
-         #pragma warning( pop )
-      #endif
-      break;
-   default:
-      break;
+   return 1;
+}
+
+/**
+ * fetch next entry in directory.
+ * @param item_name set to the null-terminated name of the entry, valid until next call.
+ * @param is_dir set to 1 if entry is a directory, 0 if not and DIR_WALK_READER_TYPE_UNKNOWN if the reader do not know.
+ * @return 1 if an entry was read, 0 when there is no more entries or reading failed, see reader->error.
+ */
+static int dir_walk_reader_next( struct dir_walk_reader* reader, const char** item_name, int* is_dir )
+{
+   if ( reader->sorted )
+      return dir_walk_sorted_next( reader, item_name, is_dir );
+   if ( reader->snapshot )
+      return dir_snapshot_reader_read( reader, item_name, is_dir );
+#if defined( DIRUTIL_USE_IO_URING )
+   if ( reader->batch )
+      return dir_walk_batch_next( reader, item_name, is_dir );
+#endif
+   return dir_walk_reader_read( reader, item_name, is_dir );
+}
+
+/* read all entries of the directory and sort them, dir_walk_reader_next then hands them out in order */
+static int dir_walk_reader_sort( struct dir_walk_reader* reader, struct dir_walk_sorted* sorted )
+{
+   const char* item_name;
+   int is_dir;
+
+   sorted->count = 0;
+   sorted->pos = 0;
+   sorted->names_size = 0;
+   while ( dir_walk_reader_next( reader, &item_name, &is_dir ) )
+   {
+      struct dir_walk_sorted_entry* entry;
+      unsigned int name_len = dir_strlen32( item_name ) + 1;
+
+      if ( sorted->count == sorted->capacity )
+      {
+         unsigned int capacity = sorted->capacity ? sorted->capacity * 2 : 64;
+         if ( !dir_array_grow( (void**)&sorted->entries, sorted->count, capacity, sizeof( struct dir_walk_sorted_entry ) ) ||
+              !dir_array_grow( (void**)&sorted->scratch, 0, capacity, sizeof( struct dir_walk_sorted_entry ) ) )
+            return 0;
+         sorted->capacity = capacity;
+      }
+      if ( sorted->names_size + name_len > sorted->names_capacity )
+      {
+         unsigned int capacity = sorted->names_capacity ? sorted->names_capacity * 2 : 4096;
+         while ( capacity < sorted->names_size + name_len )
+            capacity *= 2;
+         if ( !dir_array_grow( (void**)&sorted->names, sorted->names_size, capacity, 1 ) )
+            return 0;
+         sorted->names_capacity = capacity;
+      }
+
+      entry = &sorted->entries[sorted->count++];
+      entry->name = sorted->names_size;
+      entry->is_dir = is_dir;
+      entry->snapshot_entry = reader->snapshot ? reader->snapshot_entry : 0;
+#if defined( _WIN32 )
+      entry->attributes = reader->ffd.dwFileAttributes;
+      entry->size_high = reader->ffd.nFileSizeHigh;
+      entry->size_low = reader->ffd.nFileSizeLow;
+      entry->mtime = reader->ffd.ftLastWriteTime;
+      entry->reparse_tag = reader->ffd.dwReserved0;
+#else
+      entry->d_ino = reader->d_ino;
+      entry->d_type = reader->d_type;
+#endif
+      memcpy( sorted->names + sorted->names_size, item_name, name_len );
+      sorted->names_size += name_len;
    }
-   return *((enum dir_error*)userdata) == DIR_ERROR_OK ? 0 : 1;
+
+   if ( sorted->count > 1 )
+      dir_walk_sort_range( sorted, sorted->entries, sorted->scratch, sorted->count, 0 );
+   reader->sorted = sorted;
+   return 1;
 }
 
-DIRUTIL_API enum dir_error dir_rmtree( const char* path )
+#if defined( _WIN32 )
+static void dir_filetime_to_unix( const FILETIME* filetime, dir_int64* seconds, unsigned int* nanoseconds )
 {
-   enum dir_error res = DIR_ERROR_OK;
-   enum dir_error e = dir_walk( path, DIR_WALK_DEPTH_FIRST, dir_walk_rmitem, &res );
-   if ( e != DIR_ERROR_OK )
-      return e;
-   if ( res != DIR_ERROR_OK )
-      return res;
+   /* FILETIME is 100-nanosecond intervals since 1601-01-01 */
+   dir_int64 ft = (dir_int64)( ( (dir_uint64)filetime->dwHighDateTime << 32 ) | filetime->dwLowDateTime ) - 116444736000000000;
+   *seconds = ft / 10000000;
+   *nanoseconds = (unsigned int)( ft % 10000000 ) * 100;
+}
+#endif
+
+/**
+ * fetch information about the last entry read by reader.
+ * @param item_name name of the entry.
+ * @param fields mask of enum dir_item_info_fields to fetch.
+ */
+static void dir_walk_reader_item_info( const struct dir_walk_reader* reader, const char* item_name, unsigned int fields, struct dir_item_info* info )
+{
+#if defined ( _WIN32 )
+   const WIN32_FIND_DATAA* ffd = &reader->ffd;
+#else
+   struct stat s;
+#endif
+
+   if ( reader->snapshot )
+   {
+      dir_snapshot_reader_item_info( reader, fields, info );
+      return;
+   }
+
+#if defined ( _WIN32 )
+   (void)item_name;
+   info->valid = fields & ~(unsigned int)DIR_ITEM_INFO_INODE;
+   info->size = ( (dir_uint64)ffd->nFileSizeHigh << 32 ) | ffd->nFileSizeLow;
+   dir_filetime_to_unix( &ffd->ftLastWriteTime, &info->mtime, &info->mtime_nsec );
+   info->is_symlink = ( ffd->dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT ) && ffd->dwReserved0 == IO_REPARSE_TAG_SYMLINK;
+   /* same as the mode that 'stat' of the C runtime reports */
+   if ( info->is_symlink )
+      info->mode = 0120000 | 0777;
+   else if ( ffd->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY )
+      info->mode = 0040000 | 0555;
+   else
+      info->mode = 0100000 | 0444;
+   if ( !( ffd->dwFileAttributes & FILE_ATTRIBUTE_READONLY ) )
+      info->mode |= 0222;
+#else
+   info->valid = 0;
+   if ( fields == 0 )
+      return;
+
+   /* the type is already known from the directory entry */
+   if ( fields == DIR_ITEM_INFO_SYMLINK && reader->d_type != DT_UNKNOWN )
+   {
+      info->is_symlink = reader->d_type == DT_LNK;
+      info->valid = DIR_ITEM_INFO_SYMLINK;
+      return;
+   }
+
+   #if defined( DIRUTIL_USE_IO_URING )
+   if ( reader->batch && reader->batch->current )
+   {
+      const struct dir_walk_batch_item* item = reader->batch->current;
+      if ( item->status == 0 )
+      {
+         dir_statx_to_item_info( &item->stx, fields, info );
+         return;
+      }
+      if ( item->status < 0 )
+         return;
+   }
+   #endif
+
+   #if defined( DIRUTIL_USE_STATX )
+   {
+      struct dir_statx stx;
+      if ( syscall( SYS_statx, dir_walk_reader_fd( reader ), item_name, AT_SYMLINK_NOFOLLOW, dir_statx_mask( fields ), &stx ) == 0 )
+      {
+         dir_statx_to_item_info( &stx, fields, info );
+         return;
+      }
+      if ( errno != ENOSYS )
+         return;
+   }
+   #endif
+
+   if ( fstatat( dir_walk_reader_fd( reader ), item_name, &s, AT_SYMLINK_NOFOLLOW ) != 0 )
+      return;
+
+   info->valid = fields;
+   info->size = (dir_uint64)s.st_size;
+   info->mtime = (dir_int64)s.st_mtime;
+   #if defined( __APPLE__ )
+      info->mtime_nsec = (unsigned int)s.st_mtimespec.tv_nsec;
+   #else
+      info->mtime_nsec = (unsigned int)s.st_mtim.tv_nsec;
+   #endif
+   info->inode = (dir_uint64)s.st_ino;
+   info->device = (dir_uint64)s.st_dev;
+   info->mode = (unsigned int)s.st_mode;
+   info->is_symlink = S_ISLNK( s.st_mode );
+#endif
+}
+
+/* all values returned from callback except DIR_WALK_CONTINUE and DIR_WALK_SKIP_SUBTREE stops the walk */
+static int dir_walk_result_is_abort( int callback_result )
+{
+   return callback_result != DIR_WALK_CONTINUE && callback_result != DIR_WALK_SKIP_SUBTREE;
+}
+
+/* set of device/inode pairs, open addressing with linear probing */
+struct dir_inode_set
+{
+   dir_uint64* keys;      /* device/inode pairs, free slots are 0/0 */
+   unsigned int count;
+   unsigned int capacity; /* in pairs, power of 2 */
+};
+
+static unsigned int dir_inode_set_hash( dir_uint64 device, dir_uint64 inode )
+{
+   return (unsigned int)( inode ^ ( inode >> 32 ) ^ device ^ ( device >> 32 ) ) * 2654435761u;
+}
+
+static int dir_inode_set_grow( struct dir_inode_set* set )
+{
+   unsigned int i, capacity = set->capacity ? set->capacity * 2 : 64;
+   dir_uint64* keys = (dir_uint64*)DIRUTIL_MALLOC( capacity * 2 * sizeof( dir_uint64 ) );
+   if ( keys == 0x0 )
+      return 0;
+   memset( keys, 0, capacity * 2 * sizeof( dir_uint64 ) );
+
+   for ( i = 0; i < set->capacity; ++i )
+   {
+      unsigned int slot;
+      if ( set->keys[i * 2] == 0 && set->keys[i * 2 + 1] == 0 )
+         continue;
+      slot = dir_inode_set_hash( set->keys[i * 2], set->keys[i * 2 + 1] ) & ( capacity - 1 );
+      while ( keys[slot * 2] != 0 || keys[slot * 2 + 1] != 0 )
+         slot = ( slot + 1 ) & ( capacity - 1 );
+      keys[slot * 2] = set->keys[i * 2];
+      keys[slot * 2 + 1] = set->keys[i * 2 + 1];
+   }
+   DIRUTIL_FREE( set->keys );
+   set->keys = keys;
+   set->capacity = capacity;
+   return 1;
+}
+
+/* returns 1 if the pair was not in the set before, 0 if it was and -1 on out of memory */
+static int dir_inode_set_insert( struct dir_inode_set* set, unsigned int hash, dir_uint64 device, dir_uint64 inode )
+{
+   unsigned int slot;
+   if ( ( set->count + 1 ) * 2 > set->capacity && !dir_inode_set_grow( set ) )
+      return -1;
+
+   slot = hash & ( set->capacity - 1 );
+   while ( set->keys[slot * 2] != 0 || set->keys[slot * 2 + 1] != 0 )
+   {
+      if ( set->keys[slot * 2] == device && set->keys[slot * 2 + 1] == inode )
+         return 0;
+      slot = ( slot + 1 ) & ( set->capacity - 1 );
+   }
+   set->keys[slot * 2] = device;
+   set->keys[slot * 2 + 1] = inode;
+   ++set->count;
+   return 1;
+}
+
+/* settings deciding which items that are reported and walked (and what is reported), shared by all variants of the walk */
+struct dir_walk_filter
+{
+   unsigned int flags;
+   char slash;
+   unsigned int root_path_len;
+   struct dir_glob* glob_directories;
+   struct dir_glob* glob_files;
+   const struct dir_glob_set* set_directories; /* not owned by filter */
+   const struct dir_glob_set* set_files;
+   unsigned int info_fields; /* enum dir_item_info_fields fetched for each reported item */
+   unsigned int max_depth;   /* DIR_WALK_MAX_DEPTH, 0 for no limit */
+   dir_uint64 root_device;   /* of the input/root-directory, DIR_WALK_SAME_FILESYSTEM */
+#if defined( DIRUTIL_USE_IO_URING )
+   struct dir_io_uring* uring; /* optional, used to fetch 'info_fields' in batches */
+#endif
+};
+
+/* the glob patterns are compiled once for the entire walk, must be paired with dir_walk_filter_free */
+static enum dir_error dir_walk_filter_init( struct dir_walk_filter* filter, unsigned int flags, unsigned int root_path_len,
+   const char* optional_glob_directories, const char* optional_glob_files )
+{
+   filter->flags = flags;
+   filter->slash = dir_walk_slash_by_flags( flags );
+   filter->root_path_len = root_path_len;
+   filter->glob_directories = optional_glob_directories ? dir_glob_compile( optional_glob_directories ) : 0x0;
+   filter->glob_files = optional_glob_files ? dir_glob_compile( optional_glob_files ) : 0x0;
+   filter->set_directories = 0x0;
+   filter->set_files = 0x0;
+   filter->info_fields = 0;
+   filter->max_depth = ( flags & DIR_WALK_MAX_DEPTH_MASK ) >> 20;
+   filter->root_device = 0;
+#if defined( DIRUTIL_USE_IO_URING )
+   filter->uring = 0x0;
+#endif
+
+   if ( ( optional_glob_directories && !filter->glob_directories ) || ( optional_glob_files && !filter->glob_files ) )
+   {
+      dir_glob_free( filter->glob_directories );
+      dir_glob_free( filter->glob_files );
+      return DIR_ERROR_FAILED;
+   }
+   return DIR_ERROR_OK;
+}
+
+static void dir_walk_filter_free( struct dir_walk_filter* filter )
+{
+   dir_glob_free( filter->glob_directories );
+   dir_glob_free( filter->glob_files );
+}
+
+/* items that should not be considered at all ('.', '..' and dot-items if requested by flags) */
+static int dir_walk_filter_ignore( const struct dir_walk_filter* filter, const char* item_name, int is_dir )
+{
+   if ( item_name[0] == '.' )
+   {
+      if ( item_name[1] == '\0' || ( item_name[1] == '.' && item_name[2] == '\0' ) )
+         return 1;
+      if ( filter->flags & ( is_dir ? DIR_WALK_IGNORE_DOT_DIRECTORIES : DIR_WALK_IGNORE_DOT_FILES ) )
+         return 1;
+   }
+   return 0;
+}
+
+enum dir_walk_filter_result
+{
+   DIR_WALK_FILTER_SKIP,   /* directory is neither reported nor walked */
+   DIR_WALK_FILTER_MATCH,  /* directory is reported and walked */
+   DIR_WALK_FILTER_PARTIAL /* directory is walked, as directories below it might match, but it and its files are not reported */
+};
+
+/* @param path full path to directory, i.e. with root-directory as base. */
+static enum dir_walk_filter_result dir_walk_filter_match_directory( const struct dir_walk_filter* filter, const char* path, unsigned int path_len )
+{
+   unsigned int offset = filter->root_path_len + 1;
+   if ( filter->glob_directories )
+   {
+      enum dir_glob_result res = dir_glob_match_partial_impl( filter->glob_directories, path + offset, path_len - offset );
+      if ( res == DIR_GLOB_PARTIAL_MATCH )
+         return DIR_WALK_FILTER_PARTIAL;
+      if ( res != DIR_GLOB_MATCH )
+         return DIR_WALK_FILTER_SKIP;
+   }
+   if ( filter->set_directories && !dir_glob_set_includes_impl( filter->set_directories, path + offset, path_len - offset ) )
+      return DIR_WALK_FILTER_SKIP;
+   return DIR_WALK_FILTER_MATCH;
+}
+
+static int dir_walk_filter_match_file( const struct dir_walk_filter* filter, const char* item_name, unsigned int item_len )
+{
+   if ( filter->glob_files && DIR_GLOB_MATCH != dir_glob_match_compiled_impl( filter->glob_files, item_name, item_len ) )
+      return 0;
+   return !filter->set_files || dir_glob_set_includes_impl( filter->set_files, item_name, item_len );
+}
+
+/* device and inode of a walked directory, compared with the ones of the directories above it, DIR_WALK_FOLLOW_SYMLINKS */
+struct dir_walk_dir_id
+{
+   dir_uint64 device;
+   dir_uint64 inode;
+};
+
+static int dir_walk_dir_id_equal( const struct dir_walk_dir_id* a, const struct dir_walk_dir_id* b )
+{
+   return a->device == b->device && a->inode == b->inode;
+}
+
+/**
+ * decide if a directory should be walked with DIR_WALK_MAX_DEPTH and DIR_WALK_SAME_FILESYSTEM. sub-directories are
+ * checked before they are opened, so that nothing on another file system is touched, and the input/root-directory
+ * after it is opened.
+ *
+ * @param reader reader of the parent directory, or of the input/root-directory itself.
+ * @param item_name name of the directory relative to the parent, 0x0 for the input/root-directory.
+ * @param depth of the directory, 0 for the input/root-directory.
+ * @param id set to the device and inode of the directory with DIR_WALK_FOLLOW_SYMLINKS, for the caller to check that
+ *        it is not one of the directories above it.
+ * @return 1 if the directory should be walked.
+ */
+static int dir_walk_filter_enter( struct dir_walk_filter* filter, const struct dir_walk_reader* reader, const char* item_name, unsigned int depth,
+   struct dir_walk_dir_id* id )
+{
+#if !defined( _WIN32 )
+   struct stat s;
+   int res;
+#endif
+
+   id->device = 0;
+   id->inode = 0;
+   if ( filter->max_depth && depth >= filter->max_depth )
+      return 0;
+
+#if defined( _WIN32 )
+   (void)reader; (void)item_name;
+   return 1;
+#else
+   if ( !( filter->flags & ( DIR_WALK_SAME_FILESYSTEM | DIR_WALK_FOLLOW_SYMLINKS ) ) || reader->snapshot )
+      return 1;
+
+   if ( item_name )
+      res = fstatat( dir_walk_reader_fd( reader ), item_name, &s, ( filter->flags & DIR_WALK_FOLLOW_SYMLINKS ) ? 0 : AT_SYMLINK_NOFOLLOW );
+   else
+      res = fstat( dir_walk_reader_fd( reader ), &s );
+   if ( res != 0 )
+      return 0;
+
+   if ( depth == 0 )
+      filter->root_device = (dir_uint64)s.st_dev;
+   else if ( ( filter->flags & DIR_WALK_SAME_FILESYSTEM ) && (dir_uint64)s.st_dev != filter->root_device )
+      return 0;
+
+   id->device = (dir_uint64)s.st_dev;
+   id->inode = (dir_uint64)s.st_ino;
+   return 1;
+#endif
+}
+
+#if defined( DIRUTIL_USE_IO_URING )
+/* dir_walk_batch_want_func, information is only fetched ahead for items that might be reported */
+static int dir_walk_filter_wants_info( const void* ctx, const char* item_name, int is_dir )
+{
+   const struct dir_walk_filter* filter = (const struct dir_walk_filter*)ctx;
+   if ( is_dir == DIR_WALK_READER_TYPE_UNKNOWN )
+      return 1;
+   if ( dir_walk_filter_ignore( filter, item_name, is_dir ) )
+      return 0;
+   if ( is_dir )
+      return ( filter->flags & DIR_WALK_ONLY_FILES ) == 0;
+   return ( filter->flags & DIR_WALK_ONLY_DIRECTORIES ) == 0 && dir_walk_filter_match_file( filter, item_name, dir_strlen32( item_name ) );
+}
+#endif
+
+static int dir_walk_iswhite( int c )
+{
+   return   ( ' '  == c ) ||
+            ( '\t' == c ) ||
+            ( '\n' == c ) ||
+            ( '\v' == c ) ||
+            ( '\f' == c ) ||
+            ( '\r' == c );
+}
+
+/*
+   moves [src, end) to dest (dest <= src) with each run of separators replaced by one 'slash', stops early at a
+   null-terminator. returns the end of what was written.
+*/
+static char* dir_path_tidy_scalar( char* dest, const char* src, const char* end, char slash )
+{
+   char c;
+   while ( src < end && ( c = *src++ ) != '\0' )
+   {
+      if ( DIR_IS_SEP( c ) )
+      {
+         /* only the last separator of a run is kept */
+         if ( src < end && DIR_IS_SEP( *src ) )
+            continue;
+         c = slash;
+      }
+      *dest++ = c;
+   }
+   return dest;
+}
+
+#if defined( DIR_SIMD_SSE2 )
+/* removes the bytes in 'drop' from the converted block of 'size' bytes already stored at dest */
+static char* dir_path_tidy_compact( char* dest, unsigned int drop, unsigned int size )
+{
+   unsigned int i, kept = 0;
+   for ( i = 0; i < size; ++i )
+   {
+      dest[kept] = dest[i];
+      kept += ( ( drop >> i ) & 1 ) ^ 1;
+   }
+   return dest + kept;
+}
+
+static char* dir_path_tidy_sse2( char* dest, const char* src, const char* end, char slash )
+{
+   const __m128i fwd   = _mm_set1_epi8( '/' );
+   const __m128i back  = _mm_set1_epi8( '\\' );
+   const __m128i zero  = _mm_setzero_si128();
+   const __m128i subst = _mm_set1_epi8( slash );
+   while ( end - src >= 16 )
+   {
+      __m128i block  = _mm_loadu_si128( (const __m128i*)src );
+      __m128i is_sep = _mm_or_si128( _mm_cmpeq_epi8( block, fwd ), _mm_cmpeq_epi8( block, back ) );
+      unsigned int seps = (unsigned int)_mm_movemask_epi8( is_sep );
+      unsigned int drop;
+      if ( _mm_movemask_epi8( _mm_cmpeq_epi8( block, zero ) ) )
+         break;
+
+      /* a separator followed by another one is dropped, the byte after the block decides for the last one */
+      drop = seps & ( ( seps >> 1 ) | ( (unsigned int)( src + 16 < end && DIR_IS_SEP( src[16] ) ) << 15 ) );
+      /* dest <= src, so the store only overwrites bytes that are already loaded */
+      _mm_storeu_si128( (__m128i*)dest, _mm_or_si128( _mm_andnot_si128( is_sep, block ), _mm_and_si128( is_sep, subst ) ) );
+      dest = drop ? dir_path_tidy_compact( dest, drop, 16 ) : dest + 16;
+      src += 16;
+   }
+   return dir_path_tidy_scalar( dest, src, end, slash );
+}
+#endif
+
+#if defined( DIR_SIMD_AVX2 )
+__attribute__(( target( "avx2" ) ))
+static char* dir_path_tidy_avx2( char* dest, const char* src, const char* end, char slash )
+{
+   const __m256i fwd   = _mm256_set1_epi8( '/' );
+   const __m256i back  = _mm256_set1_epi8( '\\' );
+   const __m256i zero  = _mm256_setzero_si256();
+   const __m256i subst = _mm256_set1_epi8( slash );
+   while ( end - src >= 32 )
+   {
+      __m256i block  = _mm256_loadu_si256( (const __m256i*)src );
+      __m256i is_sep = _mm256_or_si256( _mm256_cmpeq_epi8( block, fwd ), _mm256_cmpeq_epi8( block, back ) );
+      unsigned int seps = (unsigned int)_mm256_movemask_epi8( is_sep );
+      unsigned int drop;
+      if ( _mm256_movemask_epi8( _mm256_cmpeq_epi8( block, zero ) ) )
+         break;
+
+      drop = seps & ( ( seps >> 1 ) | ( (unsigned int)( src + 32 < end && DIR_IS_SEP( src[32] ) ) << 31 ) );
+      _mm256_storeu_si256( (__m256i*)dest, _mm256_blendv_epi8( block, subst, is_sep ) );
+      dest = drop ? dir_path_tidy_compact( dest, drop, 32 ) : dest + 32;
+      src += 32;
+   }
+   /* avoid the penalty of running the legacy sse encoded tail with the upper halves of the registers in use */
+   _mm256_zeroupper();
+   return dir_path_tidy_sse2( dest, src, end, slash );
+}
+#endif
+
+static char* dir_path_tidy_separators( char* dest, const char* src, const char* end, char slash )
+{
+#if defined( DIR_SIMD_AVX2 )
+   if ( end - src >= 64 && __builtin_cpu_supports( "avx2" ) )
+      return dir_path_tidy_avx2( dest, src, end, slash );
+#endif
+#if defined( DIR_SIMD_SSE2 )
+   return dir_path_tidy_sse2( dest, src, end, slash );
+#else
+   return dir_path_tidy_scalar( dest, src, end, slash );
+#endif
+}
+
+typedef char* (*dir_path_tidy_separators_func)( char* dest, const char* src, const char* end, char slash );
+
+/* dir_path_tidy with the separator conversion done by 'separators', so that each version can be tested on its own */
+static unsigned int dir_path_tidy_with( char* path, char slash, unsigned int path_len, dir_path_tidy_separators_func separators )
+{
+   const char* src = path;
+   const char* end;
+   char* dest = path;
+   path_len = path_len ? path_len : dir_strlen32( path );
+   end = path + path_len;
+
+   /* trim whitespace and quotes from both ends, the path is then moved into place while the separators are converted */
+   while ( end > src && ( dir_walk_iswhite( end[-1] ) || end[-1] == '"' ) )
+      --end;
+   while ( src < end && ( dir_walk_iswhite( *src ) || *src == '"' ) )
+      ++src;
+
+#if defined( _WIN32 )
+   /* handle UNC paths */
+   if ( end - src >= 2 && src[0] == DIR_SEP_PLATFORM && src[1] == DIR_SEP_PLATFORM )
+   {
+      *dest++ = *src++;
+      *dest++ = *src++;
+      while ( src < end && DIR_IS_SEP( *src ) )
+         ++src;
+   }
+#endif
+
+   dest = separators( dest, src, end, slash );
+   if ( dest != path && DIR_IS_SEP( dest[-1] ) )
+      --dest;
+   *dest = '\0';
+   return (unsigned int)( dest - path );
+}
+
+DIRUTIL_API unsigned int dir_path_tidy( char* path, char slash, unsigned int path_len )
+{
+   return dir_path_tidy_with( path, slash, path_len, dir_path_tidy_separators );
+}
+
+DIRUTIL_API const char* dir_path_filename( const char* path, unsigned int path_len, unsigned int* filename_len )
+{
+   unsigned full_path_len = path_len;
+   if ( !path_len || DIR_IS_SEP( path[path_len - 1] ) )
+   {
+      *filename_len = 0;
+      return 0;
+   }
+
+   while ( path_len && !DIR_IS_SEP( path[path_len - 1] ) )
+      --path_len;
+
+   *filename_len = full_path_len - path_len;
+   return path + path_len;
+}
+
+DIRUTIL_API const char* dir_path_extension( const char* path, unsigned int path_len, unsigned int* extension_len )
+{
+   unsigned full_path_len = path_len;
+
+   if ( !path_len || DIR_IS_SEP( path[path_len - 1] ) || path[path_len - 1] == '.' )
+      goto no_extension;
+
+   while ( path_len > 1 && path[path_len - 1] != '.' && !DIR_IS_SEP( path[path_len - 1] ) )
+      --path_len;
+
+   if ( path_len > 1 && !DIR_IS_SEP( path[path_len - 2] ) )
+   {
+      *extension_len = full_path_len - path_len;
+      return path + path_len;
+   }
+
+no_extension:
+   *extension_len = 0;
+   return 0;
+}
+
+/*
+   buffer holding the full path of the current item in a walk. paths that fits DIRUTIL_PATH_BUFFER_INLINE_SIZE do
+   not allocate, longer paths moves the buffer to the heap where it grows geometrically. as 'data' might point into
+   the buffer itself it must not be copied after dir_path_buffer_init.
+*/
+#ifndef DIRUTIL_PATH_BUFFER_INLINE_SIZE
+   #define DIRUTIL_PATH_BUFFER_INLINE_SIZE 4096
+#endif
+
+struct dir_path_buffer
+{
+   char* data;
+   unsigned int size;
+   char inline_data[DIRUTIL_PATH_BUFFER_INLINE_SIZE];
+};
+
+static void dir_path_buffer_init( struct dir_path_buffer* buffer )
+{
+   buffer->data = buffer->inline_data;
+   buffer->size = sizeof( buffer->inline_data );
+}
+
+static void dir_path_buffer_free( struct dir_path_buffer* buffer )
+{
+   if ( buffer->data != buffer->inline_data )
+      DIRUTIL_FREE( buffer->data );
+}
+
+/* make room for at least 'size' chars, the content is kept but 'data' might move. returns 0 on failure */
+static int dir_path_buffer_reserve( struct dir_path_buffer* buffer, unsigned int size )
+{
+   unsigned int new_size = buffer->size;
+   char* data;
+   if ( size <= buffer->size )
+      return 1;
+
+   while ( new_size < size )
+   {
+      if ( new_size > 0x7fffffff )
+         return 0;
+      new_size *= 2;
+   }
+
+   data = (char*)DIRUTIL_MALLOC( new_size );
+   if ( data == 0x0 )
+      return 0;
+
+   memcpy( data, buffer->data, buffer->size );
+   dir_path_buffer_free( buffer );
+   buffer->data = data;
+   buffer->size = new_size;
+   return 1;
+}
+
+/* copy and tidy the root-path of a walk into buffer, returns length of path or 0 on failure */
+static unsigned int dir_walk_root_path( const char* path, char slash, struct dir_path_buffer* buffer )
+{
+   unsigned int path_len = dir_strlen32( path );
+
+   if ( !dir_path_buffer_reserve( buffer, path_len + 1 ) )
+      return 0;
+
+   memcpy( buffer->data, path, path_len + 1 );
+
+   return dir_path_tidy( buffer->data, slash, path_len );
+}
+
+/* the walk only invokes callbacks with item information, this forwards to callbacks without it */
+struct dir_walk_callback_adapter
+{
+   dir_walk_callback callback;
+   void* userdata;
+};
+
+static int dir_walk_callback_no_info( const char* path, unsigned int path_len, enum dir_item_type type, const struct dir_item_info* info, void* userdata )
+{
+   struct dir_walk_callback_adapter* adapter = (struct dir_walk_callback_adapter*)userdata;
+   (void)info;
+   return adapter->callback( path, path_len, type, adapter->userdata );
+}
+
+/*
+   ignore rules of one directory read from its '.gitignore' and '.ignore', DIR_WALK_GITIGNORE.
+
+   the rules have their own matcher, as in git a '*' matches any part of a name ("*.gz" matches "a.tar.gz") which the
+   glob-matcher do not backtrack to find, and '**' is only special as a whole path-segment. a rule without a '/' is matched
+   against the name of the item at any depth, the others against the path relative to the directory. the rules are parsed
+   once when the directory is entered and matched last rule first, as the last rule that match decides.
+*/
+#define DIR_IGNORE_NEGATED  1  /* starts with '!', re-includes what an earlier rule ignored */
+#define DIR_IGNORE_DIR_ONLY 2  /* ends with '/', only matches directories */
+#define DIR_IGNORE_BASENAME 4  /* no '/', matched against the name of the item */
+#define DIR_IGNORE_LITERAL  8  /* name-rule without wildcards, compared as is */
+#define DIR_IGNORE_SUFFIX   16 /* name-rule of a '*' followed by a literal, only the end of the name is compared */
+
+struct dir_ignore_rule
+{
+   const char* pattern; /* null-terminated, without '!', a leading '/' and a trailing '/' */
+   unsigned int len;
+   unsigned int flags;  /* DIR_IGNORE_* */
+};
+
+struct dir_ignore_rules
+{
+   unsigned int num_rules;
+   struct dir_ignore_rule* rules; /* in the order of the files */
+};
+
+static void dir_ignore_rules_free( struct dir_ignore_rules* rules )
+{
+   DIRUTIL_FREE( rules );
+}
+
+#define DIR_IGNORE_NO_MATCH        0
+#define DIR_IGNORE_MATCH           1
+#define DIR_IGNORE_ABORT_ALL       2 /* the path ended, no later start of an enclosing '*' can match either */
+#define DIR_IGNORE_ABORT_TO_STAR   3 /* a separator stopped a '*', only an enclosing '**' can match */
+
+/* both separators of the path are '/' to the rules */
+#define DIR_IGNORE_CHAR( c ) (unsigned char)( DIR_IS_SEP( c ) ? '/' : (c) )
+
+static const char* dir_ignore_find_sep( const char* text )
+{
+   while ( *text != '\0' && !DIR_IS_SEP( *text ) )
+      ++text;
+   return *text != '\0' ? text : 0x0;
+}
+
+/* match text against pattern with the rules of git's wildmatch, returns one of DIR_IGNORE_NO_MATCH, DIR_IGNORE_MATCH, DIR_IGNORE_ABORT_* */
+static int dir_ignore_wildmatch( const char* p, const char* text )
+{
+   const char* pattern = p;
+   for ( ; *p != '\0'; ++text, ++p )
+   {
+      unsigned char p_ch = (unsigned char)*p;
+      unsigned char t_ch = DIR_IGNORE_CHAR( *text );
+      unsigned char prev_ch;
+      int match_slash, matched, negated;
+
+      if ( t_ch == '\0' && p_ch != '*' )
+         return DIR_IGNORE_ABORT_ALL;
+
+      switch ( p_ch )
+      {
+      case '\\':
+         /* escaped char is matched literally */
+         if ( t_ch != (unsigned char)*++p )
+            return DIR_IGNORE_NO_MATCH;
+         break;
+
+      case '?':
+         if ( t_ch == '/' )
+            return DIR_IGNORE_NO_MATCH;
+         break;
+
+      case '*':
+         match_slash = 0;
+         if ( *++p == '*' )
+         {
+            const char* prev_p = p - 2;
+            while ( *++p == '*' )
+               ;
+            /* '**' as a whole path-segment matches across separators, "**" + "/" also matches no directory at all */
+            if ( ( prev_p < pattern || *prev_p == '/' ) && ( *p == '\0' || *p == '/' || ( p[0] == '\\' && p[1] == '/' ) ) )
+            {
+               if ( p[0] == '/' && dir_ignore_wildmatch( p + 1, text ) == DIR_IGNORE_MATCH )
+                  return DIR_IGNORE_MATCH;
+               match_slash = 1;
+            }
+         }
+
+         if ( *p == '\0' )
+         {
+            /* a trailing '*' matches the rest of the name, a trailing '**' the rest of the path */
+            if ( !match_slash && dir_ignore_find_sep( text ) )
+               return DIR_IGNORE_ABORT_TO_STAR;
+            return DIR_IGNORE_MATCH;
+         }
+         if ( !match_slash && *p == '/' )
+         {
+            /* the rest of the name is matched, continue after the separator */
+            text = dir_ignore_find_sep( text );
+            if ( text == 0x0 )
+               return DIR_IGNORE_NO_MATCH;
+            break;
+         }
+
+         /* try the rest of the pattern at each position, backtracking */
+         for ( ; t_ch != '\0'; ++text, t_ch = DIR_IGNORE_CHAR( *text ) )
+         {
+            matched = dir_ignore_wildmatch( p, text );
+            if ( matched != DIR_IGNORE_NO_MATCH )
+            {
+               if ( !match_slash || matched != DIR_IGNORE_ABORT_TO_STAR )
+                  return matched;
+            }
+            else if ( !match_slash && t_ch == '/' )
+               return DIR_IGNORE_ABORT_TO_STAR;
+         }
+         return DIR_IGNORE_ABORT_ALL;
+
+      case '[':
+         p_ch = (unsigned char)*++p;
+         if ( p_ch == '^' )
+            p_ch = '!';
+         negated = p_ch == '!';
+         if ( negated )
+            p_ch = (unsigned char)*++p;
+         prev_ch = 0;
+         matched = 0;
+         /* a ']' first in the class is part of it */
+         do
+         {
+            if ( p_ch == '\0' )
+               return DIR_IGNORE_ABORT_ALL;
+            if ( p_ch == '\\' )
+            {
+               p_ch = (unsigned char)*++p;
+               if ( p_ch == '\0' )
+                  return DIR_IGNORE_ABORT_ALL;
+               matched |= t_ch == p_ch;
+            }
+            else if ( p_ch == '-' && prev_ch && p[1] != '\0' && p[1] != ']' )
+            {
+               p_ch = (unsigned char)*++p;
+               if ( p_ch == '\\' )
+               {
+                  p_ch = (unsigned char)*++p;
+                  if ( p_ch == '\0' )
+                     return DIR_IGNORE_ABORT_ALL;
+               }
+               matched |= prev_ch <= t_ch && t_ch <= p_ch;
+               p_ch = 0; /* a range is not the start of another one */
+            }
+            else
+               matched |= t_ch == p_ch;
+            prev_ch = p_ch;
+            p_ch = (unsigned char)*++p;
+         }
+         while ( p_ch != ']' );
+
+         if ( matched == negated || t_ch == '/' )
+            return DIR_IGNORE_NO_MATCH;
+         break;
+
+      default:
+         if ( t_ch != p_ch )
+            return DIR_IGNORE_NO_MATCH;
+         break;
+      }
+   }
+   return *text != '\0' ? DIR_IGNORE_NO_MATCH : DIR_IGNORE_MATCH;
+}
+
+/**
+ * @param path of the item relative to the directory of the rules, null-terminated.
+ * @param name of the item, the last name_len chars of path.
+ * @return 1 if the item is ignored by rules, 0 if it is re-included by a negated rule and -1 if no rule match.
+ */
+static int dir_ignore_rules_match( const struct dir_ignore_rules* rules, const char* path, const char* name, unsigned int name_len, int is_dir )
+{
+   unsigned int i = rules->num_rules;
+   while ( i-- )
+   {
+      const struct dir_ignore_rule* rule = &rules->rules[i];
+      int matched;
+      if ( ( rule->flags & DIR_IGNORE_DIR_ONLY ) && !is_dir )
+         continue;
+
+      if ( rule->flags & DIR_IGNORE_LITERAL )
+         matched = rule->len == name_len && memcmp( rule->pattern, name, name_len ) == 0;
+      else if ( rule->flags & DIR_IGNORE_SUFFIX )
+         matched = rule->len - 1 <= name_len && memcmp( rule->pattern + 1, name + name_len - ( rule->len - 1 ), rule->len - 1 ) == 0;
+      else
+         matched = dir_ignore_wildmatch( rule->pattern, ( rule->flags & DIR_IGNORE_BASENAME ) ? name : path ) == DIR_IGNORE_MATCH;
+
+      if ( matched )
+         return ( rule->flags & DIR_IGNORE_NEGATED ) == 0;
+   }
+   return -1;
+}
+
+/* larger ignore files are not read */
+#define DIR_IGNORE_MAX_FILE_SIZE 0x1000000
+
+/* chars of a rule that are not matched literally */
+#define DIR_IGNORE_IS_WILDCARD(c) ((c) == '*' || (c) == '?' || (c) == '[' || (c) == '\\')
+
+/* parse one line of an ignore file into rule, the pattern is copied to out. returns 0 if the line has no rule */
+static int dir_ignore_parse( const char* line, const char* end, char* out, struct dir_ignore_rule* rule )
+{
+   const char* p;
+   unsigned int flags = DIR_IGNORE_BASENAME;
+   unsigned int len;
+
+   /* trailing spaces are ignored unless escaped */
+   while ( end != line && ( end[-1] == '\r' || ( end[-1] == ' ' && ( end - 1 == line || end[-2] != '\\' ) ) ) )
+      --end;
+   if ( line == end || *line == '#' )
+      return 0;
+
+   if ( *line == '!' )
+   {
+      flags |= DIR_IGNORE_NEGATED;
+      ++line;
+   }
+   if ( end != line && end[-1] == '/' )
+   {
+      flags |= DIR_IGNORE_DIR_ONLY;
+      --end;
+   }
+   for ( p = line; p != end; ++p )
+   {
+      if ( *p == '/' )
+      {
+         flags &= ~(unsigned int)DIR_IGNORE_BASENAME;
+         break;
+      }
+   }
+   /* a leading '/' anchors the rule to the directory, as any other '/' do */
+   if ( line != end && *line == '/' )
+      ++line;
+   if ( line == end )
+      return 0;
+
+   len = (unsigned int)( end - line );
+   memcpy( out, line, len );
+   out[len] = '\0';
+
+   if ( flags & DIR_IGNORE_BASENAME )
+   {
+      for ( p = line + 1; p != end && !DIR_IGNORE_IS_WILDCARD( *p ); ++p )
+         ;
+      if ( p == end )
+         flags |= DIR_IGNORE_IS_WILDCARD( *line ) ? ( *line == '*' ? DIR_IGNORE_SUFFIX : 0 ) : DIR_IGNORE_LITERAL;
+   }
+
+   rule->pattern = out;
+   rule->len = len;
+   rule->flags = flags;
+   return 1;
+}
+
+/* parse the rules in text, the content of the ignore files of one directory. rules is set to 0x0 if there are none, returns 0 on out of memory */
+static int dir_ignore_rules_compile( const char* text, unsigned int text_size, struct dir_ignore_rules** rules )
+{
+   const char* line = text;
+   const char* text_end = text + text_size;
+   struct dir_ignore_rules* result;
+   char* patterns;
+   unsigned int num_lines = 0, i;
+
+   *rules = 0x0;
+   if ( text_size == 0 )
+      return 1;
+   for ( i = 0; i < text_size; ++i )
+      num_lines += text[i] == '\n';
+   num_lines += text[text_size - 1] != '\n';
+
+   /* the rules followed by their patterns, that are never longer than the lines */
+   result = (struct dir_ignore_rules*)DIRUTIL_MALLOC( sizeof( struct dir_ignore_rules ) + num_lines * sizeof( struct dir_ignore_rule ) + text_size + num_lines );
+   if ( result == 0x0 )
+      return 0;
+   result->rules = (struct dir_ignore_rule*)( result + 1 );
+   result->num_rules = 0;
+   patterns = (char*)( result->rules + num_lines );
+
+   for ( i = 0; i < num_lines; ++i )
+   {
+      const char* line_end = (const char*)memchr( line, '\n', (size_t)( text_end - line ) );
+      struct dir_ignore_rule* rule = &result->rules[result->num_rules];
+      if ( line_end == 0x0 )
+         line_end = text_end;
+      if ( dir_ignore_parse( line, line_end, patterns, rule ) )
+      {
+         patterns += rule->len + 1;
+         ++result->num_rules;
+      }
+      line = line_end + ( line_end != text_end );
+   }
+
+   if ( result->num_rules == 0 )
+      DIRUTIL_FREE( result );
+   else
+      *rules = result;
+   return 1;
+}
+
+/* append the content of the ignore file name in the directory read by reader to text, a missing file is not an error. returns 0 on out of memory */
+#if defined( _WIN32 )
+static int dir_ignore_read_file( const struct dir_walk_reader* reader, char* path, unsigned int path_len, char slash,
+   const char* name, char** text, unsigned int* text_size )
+{
+   HANDLE file;
+   LARGE_INTEGER size;
+   DWORD n;
+   char* grown;
+   (void)reader;
+
+   /* path has room for the separator and the name */
+   path[path_len] = slash;
+   memcpy( path + path_len + 1, name, dir_strlen32( name ) + 1 );
+   file = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 0x0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0x0 );
+   path[path_len] = '\0';
+   if ( file == INVALID_HANDLE_VALUE )
+      return 1;
+   if ( !GetFileSizeEx( file, &size ) || size.QuadPart <= 0 || size.QuadPart > DIR_IGNORE_MAX_FILE_SIZE )
+   {
+      CloseHandle( file );
+      return 1;
+   }
+
+   grown = (char*)DIRUTIL_MALLOC( *text_size + (size_t)size.QuadPart + 1 );
+   if ( grown == 0x0 )
+   {
+      CloseHandle( file );
+      return 0;
+   }
+   if ( *text_size )
+      memcpy( grown, *text, *text_size );
+   DIRUTIL_FREE( *text );
+   *text = grown;
+
+   if ( ReadFile( file, grown + *text_size, (DWORD)size.QuadPart, &n, 0x0 ) && n > 0 )
+   {
+      *text_size += (unsigned int)n;
+      grown[( *text_size )++] = '\n';
+   }
+   CloseHandle( file );
+   return 1;
+}
+#else
+static int dir_ignore_read_file( const struct dir_walk_reader* reader, char* path, unsigned int path_len, char slash,
+   const char* name, char** text, unsigned int* text_size )
+{
+   struct stat s;
+   char* grown;
+   unsigned int size = 0;
+   int fd;
+   (void)path; (void)path_len; (void)slash;
+
+   fd = openat( dir_walk_reader_fd( reader ), name, O_RDONLY | O_NOFOLLOW | O_NONBLOCK | O_CLOEXEC );
+   if ( fd < 0 )
+      return 1;
+   if ( fstat( fd, &s ) != 0 || !S_ISREG( s.st_mode ) || s.st_size <= 0 || s.st_size > DIR_IGNORE_MAX_FILE_SIZE )
+   {
+      close( fd );
+      return 1;
+   }
+
+   grown = (char*)DIRUTIL_MALLOC( *text_size + (size_t)s.st_size + 1 );
+   if ( grown == 0x0 )
+   {
+      close( fd );
+      return 0;
+   }
+   if ( *text_size )
+      memcpy( grown, *text, *text_size );
+   DIRUTIL_FREE( *text );
+   *text = grown;
+
+   while ( size < (unsigned int)s.st_size )
+   {
+      ssize_t n = read( fd, grown + *text_size + size, (size_t)s.st_size - size );
+      if ( n < 0 && errno == EINTR )
+         continue;
+      if ( n <= 0 )
+         break;
+      size += (unsigned int)n;
+   }
+   close( fd );
+
+   if ( size )
+   {
+      *text_size += size;
+      grown[( *text_size )++] = '\n';
+   }
+   return 1;
+}
+#endif
+
+/**
+ * read and compile the ignore files of the directory read by reader, path[0, path_len) is the path to the directory and has
+ * room for a separator and the name of an ignore file after it. rules is set to 0x0 if there are none, returns 0 on out of memory.
+ */
+static int dir_ignore_rules_load( const struct dir_walk_reader* reader, char* path, unsigned int path_len, char slash, struct dir_ignore_rules** rules )
+{
+   char* text = 0x0;
+   unsigned int text_size = 0;
+   int ok;
+
+   *rules = 0x0;
+   if ( reader->snapshot )
+      return 1;
+
+   /* '.ignore' after '.gitignore' so that its rules take precedence */
+   ok = dir_ignore_read_file( reader, path, path_len, slash, ".gitignore", &text, &text_size ) &&
+        dir_ignore_read_file( reader, path, path_len, slash, ".ignore", &text, &text_size ) &&
+        dir_ignore_rules_compile( text, text_size, rules );
+   DIRUTIL_FREE( text );
+   return ok;
+}
+
+/* an open directory in the walk */
+struct dir_iter_frame
+{
+   struct dir_walk_reader reader;
+   unsigned int path_len; /* length of the path to the directory in the path buffer */
+   int partial;           /* directory is only walked to reach matching sub-directories, its files are not reported */
+   int report;            /* report the directory when everything in it has been reported, DIR_WALK_DEPTH_FIRST */
+   struct dir_walk_dir_id id;       /* DIR_WALK_FOLLOW_SYMLINKS */
+   struct dir_ignore_rules* ignore; /* DIR_WALK_GITIGNORE, null if the directory has no rules */
+   struct dir_walk_sorted sorted; /* kept when popped and reused by the next directory at the same depth */
+};
+
+#define DIR_ITER_INITIAL_STACK_SIZE 32
+
+struct dir_iter
+{
+   struct dir_walk_filter filter;
+   struct dir_iter_frame* stack;
+   unsigned int depth;
+   unsigned int stack_size;
+
+   /* directory returned by the last call to dir_iter_next, walked on the next call unless skipped */
+   int descend;
+   int descend_partial;
+   unsigned int descend_path_len;
+
+   enum dir_error error;
+   struct dir_path_buffer path;
+   const struct dir_snapshot* snapshot; /* replay the walk from snapshot instead of the file system */
+#if defined( DIRUTIL_USE_IO_URING )
+   struct dir_io_uring ring;
+#endif
+};
+
+static int dir_iter_grow( struct dir_iter* iter )
+{
+   unsigned int stack_size = iter->stack_size ? iter->stack_size * 2 : DIR_ITER_INITIAL_STACK_SIZE;
+   unsigned int i;
+   struct dir_iter_frame* stack = (struct dir_iter_frame*)DIRUTIL_MALLOC( stack_size * sizeof( struct dir_iter_frame ) );
+   if ( stack == 0x0 )
+      return 0;
+
+   /* all frames are moved, the ones above the top still own their sort buffers */
+   if ( iter->stack_size )
+      memcpy( stack, iter->stack, iter->stack_size * sizeof( struct dir_iter_frame ) );
+   /* a sorted reader points at the sort buffers in its own frame */
+   for ( i = 0; i < iter->depth; ++i )
+      if ( stack[i].reader.sorted )
+         stack[i].reader.sorted = &stack[i].sorted;
+   memset( stack + iter->stack_size, 0, ( stack_size - iter->stack_size ) * sizeof( struct dir_iter_frame ) );
+   DIRUTIL_FREE( iter->stack );
+   iter->stack = stack;
+   iter->stack_size = stack_size;
+   return 1;
+}
+
+/* open the directory in path[0, path_len) on top of the stack, relative to the current top */
+static enum dir_error dir_iter_push( struct dir_iter* iter, unsigned int path_len, int partial, int report )
+{
+   struct dir_iter_frame* frame;
+   const struct dir_walk_reader* parent = 0x0;
+   const char* name = 0x0;
+   struct dir_walk_dir_id id;
+   enum dir_error result;
+   unsigned int i;
+
+   if ( iter->depth == iter->stack_size && !dir_iter_grow( iter ) )
+      return DIR_ERROR_FAILED;
+
+   /* room for the separator and '*' appended by the reader on windows, or the name of an ignore file */
+   if ( !dir_path_buffer_reserve( &iter->path, path_len + 12 ) )
+      return DIR_ERROR_FAILED;
+
+   if ( iter->depth )
+   {
+      parent = &iter->stack[iter->depth - 1].reader;
+      name = &iter->path.data[iter->stack[iter->depth - 1].path_len + 1];
+   }
+
+   /* directories that should not be walked are handled as directories that could not be opened */
+   if ( parent && !dir_walk_filter_enter( &iter->filter, parent, name, iter->depth, &id ) )
+      return DIR_ERROR_FAILED;
+   for ( i = 0; parent && ( iter->filter.flags & DIR_WALK_FOLLOW_SYMLINKS ) && i < iter->depth; ++i )
+      if ( dir_walk_dir_id_equal( &iter->stack[i].id, &id ) )
+         return DIR_ERROR_FAILED;
+
+   frame = &iter->stack[iter->depth];
+   if ( iter->depth == 0 && iter->snapshot )
+      result = dir_snapshot_reader_open( &frame->reader, iter->snapshot, 0 );
+   else
+      result = dir_walk_reader_open( &frame->reader, parent, name, iter->path.data, path_len, iter->path.size - path_len, iter->filter.slash,
+                                     ( iter->filter.flags & DIR_WALK_FOLLOW_SYMLINKS ) != 0 );
+   if ( result != DIR_ERROR_OK )
+      return result;
+
+   if ( parent == 0x0 && !dir_walk_filter_enter( &iter->filter, &frame->reader, 0x0, 0, &id ) )
+   {
+      dir_walk_reader_close( &frame->reader );
+      return DIR_ERROR_FAILED;
+   }
+   frame->id = id;
+
+   #if defined( DIRUTIL_USE_IO_URING )
+      /* nothing but sub-directories are reported from partial directories, not worth reading ahead. the batches are read in order, so not when sorted */
+      if ( iter->filter.uring && !partial && !( iter->filter.flags & DIR_WALK_SORTED ) )
+         dir_walk_reader_enable_batch( &frame->reader, iter->filter.uring, dir_statx_mask( iter->filter.info_fields ), dir_walk_filter_wants_info, &iter->filter );
+   #endif
+
+   if ( ( iter->filter.flags & DIR_WALK_SORTED ) && !dir_walk_reader_sort( &frame->reader, &frame->sorted ) )
+   {
+      dir_walk_reader_close( &frame->reader );
+      return DIR_ERROR_FAILED;
+   }
+
+   frame->ignore = 0x0;
+   if ( ( iter->filter.flags & DIR_WALK_GITIGNORE ) && !dir_ignore_rules_load( &frame->reader, iter->path.data, path_len, iter->filter.slash, &frame->ignore ) )
+   {
+      dir_walk_reader_close( &frame->reader );
+      return DIR_ERROR_FAILED;
+   }
+
+   frame->path_len = path_len;
+   frame->partial = partial;
+   frame->report = report;
+   ++iter->depth;
+   return DIR_ERROR_OK;
+}
+
+/* DIR_WALK_GITIGNORE, returns 1 if the item in path[0, path_len), named by its last name_len chars, is ignored by the rules of the open directories */
+static int dir_iter_ignored( const struct dir_iter* iter, unsigned int path_len, unsigned int name_len, int is_dir )
+{
+   const char* name = iter->path.data + path_len - name_len;
+   unsigned int i = iter->depth;
+
+   /* as git, its own directory is never reported */
+   if ( name_len == 4 && memcmp( name, ".git", 4 ) == 0 )
+      return 1;
+
+   /* the innermost rules decide first */
+   while ( i-- )
+   {
+      const struct dir_iter_frame* frame = &iter->stack[i];
+      int ignored;
+      if ( frame->ignore == 0x0 )
+         continue;
+      ignored = dir_ignore_rules_match( frame->ignore, iter->path.data + frame->path_len + 1, name, name_len, is_dir );
+      if ( ignored >= 0 )
+         return ignored;
+   }
+   return 0;
+}
+
+/* the path to the item is in the path buffer and the item is the last entry read by reader */
+static void dir_iter_set_item( struct dir_iter* iter, struct dir_iter_item* item, const struct dir_walk_reader* reader,
+   unsigned int name_offset, unsigned int path_len, enum dir_item_type type )
+{
+   unsigned int path_offset = ( iter->filter.flags & DIR_WALK_ROOT_RELATIVE_PATHS ) ? ( iter->filter.root_path_len + 1 ) : 0;
+   item->path = iter->path.data + path_offset;
+   item->path_len = path_len - path_offset;
+   item->type = type;
+   dir_walk_reader_item_info( reader, &iter->path.data[name_offset], iter->filter.info_fields, &item->info );
+}
+
+/* close the directory on top of the stack, returns 1 if the directory was set to item */
+static int dir_iter_pop( struct dir_iter* iter, enum dir_error error, struct dir_iter_item* item )
+{
+   struct dir_iter_frame* frame = &iter->stack[--iter->depth];
+   struct dir_iter_frame* parent;
+
+   /* errors in sub-directories are ignored */
+   if ( iter->depth == 0 )
+      iter->error = error;
+
+   iter->path.data[frame->path_len] = '\0';
+   dir_walk_reader_close( &frame->reader );
+   dir_ignore_rules_free( frame->ignore );
+   if ( !frame->report )
+      return 0;
+
+   parent = &iter->stack[iter->depth - 1];
+   dir_iter_set_item( iter, item, &parent->reader, parent->path_len + 1, frame->path_len, DIR_ITEM_DIR );
+   return 1;
+}
+
+static void dir_iter_release( struct dir_iter* iter )
+{
+   unsigned int i;
+   while ( iter->depth )
+   {
+      dir_walk_reader_close( &iter->stack[--iter->depth].reader );
+      dir_ignore_rules_free( iter->stack[iter->depth].ignore );
+   }
+   for ( i = 0; i < iter->stack_size; ++i )
+      dir_walk_sorted_free( &iter->stack[i].sorted );
+   DIRUTIL_FREE( iter->stack );
+   dir_path_buffer_free( &iter->path );
+#if defined( DIRUTIL_USE_IO_URING )
+   if ( iter->filter.uring )
+      dir_io_uring_destroy( &iter->ring );
+#endif
+   dir_walk_filter_free( &iter->filter );
+}
+
+static enum dir_error dir_iter_init( struct dir_iter* iter, const char* path, unsigned int flags, unsigned int info_fields,
+   const char* optional_glob_directories, const char* optional_glob_files,
+   const struct dir_glob_set* optional_set_directories, const struct dir_glob_set* optional_set_files,
+   const struct dir_snapshot* snapshot )
+{
+   enum dir_error result;
+   unsigned int path_len;
+
+   dir_path_buffer_init( &iter->path );
+   path_len = dir_walk_root_path( path, dir_walk_slash_by_flags( flags ), &iter->path );
+   if ( !path_len || dir_walk_filter_init( &iter->filter, flags, path_len, optional_glob_directories, optional_glob_files ) != DIR_ERROR_OK )
+   {
+      dir_path_buffer_free( &iter->path );
+      return DIR_ERROR_FAILED;
+   }
+   iter->filter.set_directories = optional_set_directories;
+   iter->filter.set_files = optional_set_files;
+   iter->filter.info_fields = info_fields & DIR_ITEM_INFO_ALL;
+
+   iter->stack = 0x0;
+   iter->depth = 0;
+   iter->stack_size = 0;
+   iter->descend = 0;
+   iter->error = DIR_ERROR_OK;
+   iter->snapshot = snapshot;
+
+#if defined( DIRUTIL_USE_IO_URING )
+   /* the symlink-flag alone is known from the directory entries, if io_uring is not available the information is fetched synchronously */
+   if ( snapshot == 0x0 && ( iter->filter.info_fields & ~(unsigned int)DIR_ITEM_INFO_SYMLINK ) && dir_io_uring_init( &iter->ring, DIRUTIL_IO_URING_BATCH_SIZE ) )
+      iter->filter.uring = &iter->ring;
+#endif
+
+   result = dir_iter_grow( iter ) ? dir_iter_push( iter, path_len, 0, 0 ) : DIR_ERROR_FAILED;
+   if ( result != DIR_ERROR_OK )
+      dir_iter_release( iter );
+   return result;
+}
+
+DIRUTIL_API enum dir_error dir_iter_open( const char* path, unsigned int flags, unsigned int info_fields,
+   const char* optional_glob_directories, const char* optional_glob_files, struct dir_iter** iter )
+{
+   enum dir_error result;
+   struct dir_iter* it = (struct dir_iter*)DIRUTIL_MALLOC( sizeof( struct dir_iter ) );
+
+   *iter = 0x0;
+   if ( it == 0x0 )
+      return DIR_ERROR_FAILED;
+
+   result = dir_iter_init( it, path, flags, info_fields, optional_glob_directories, optional_glob_files, 0x0, 0x0, 0x0 );
+   if ( result != DIR_ERROR_OK )
+   {
+      DIRUTIL_FREE( it );
+      return result;
+   }
+   *iter = it;
+   return DIR_ERROR_OK;
+}
+
+DIRUTIL_API int dir_iter_next( struct dir_iter* iter, struct dir_iter_item* item )
+{
+   const struct dir_walk_filter* filter = &iter->filter;
+   unsigned int flags = filter->flags;
+
+   int should_walk_directories = ( flags & DIR_WALK_SINGLE_DIRECTORY ) == 0;
+   int should_call_callback_directories = ( flags & DIR_WALK_ONLY_FILES ) == 0;
+   int should_call_callback_files = ( flags & DIR_WALK_ONLY_DIRECTORIES ) == 0;
+
+   if ( iter->descend )
+   {
+      /* errors in sub-directories are ignored, the directory is just not walked */
+      iter->descend = 0;
+      dir_iter_push( iter, iter->descend_path_len, iter->descend_partial, 0 );
+   }
+
+   while ( iter->depth )
+   {
+      struct dir_iter_frame* frame = &iter->stack[iter->depth - 1];
+      unsigned int path_len = frame->path_len;
+      unsigned int item_len, current_path_len;
+      char* path_buffer;
+      const char* item_name;
+      int is_dir;
+
+      if ( !dir_walk_reader_next( &frame->reader, &item_name, &is_dir ) )
+      {
+         if ( dir_iter_pop( iter, frame->reader.error ? DIR_ERROR_FAILED : DIR_ERROR_OK, item ) )
+            return 1;
+         continue;
+      }
+
+      #if !defined ( _WIN32 )
+         if ( is_dir == DIR_WALK_READER_TYPE_UNKNOWN && !dir_walk_reader_stat_is_dir( &frame->reader, item_name, &is_dir ) )
+         {
+            if ( dir_iter_pop( iter, DIR_ERROR_FAILED, item ) )
+               return 1;
+            continue;
+         }
+         if ( !is_dir && ( flags & DIR_WALK_FOLLOW_SYMLINKS ) )
+            is_dir = dir_walk_reader_is_dir_symlink( &frame->reader, item_name );
+      #endif
+
+      if ( dir_walk_filter_ignore( filter, item_name, is_dir ) )
+         continue;
+
+      item_len = dir_strlen32( item_name );
+
+      if ( !dir_path_buffer_reserve( &iter->path, path_len + item_len + 2 ) ) /* 2 == '/' + null-terminator */
+      {
+         if ( dir_iter_pop( iter, DIR_ERROR_FAILED, item ) )
+            return 1;
+         continue;
+      }
+
+      path_buffer = iter->path.data;
+      path_buffer[path_len] = filter->slash;
+
+      memcpy( &path_buffer[path_len + 1], item_name, item_len + 1 );
+
+      current_path_len = path_len + item_len + 1;
+
+      if ( ( flags & DIR_WALK_GITIGNORE ) && dir_iter_ignored( iter, current_path_len, item_len, is_dir ) )
+         continue;
+
+      if ( is_dir && ( should_walk_directories || should_call_callback_directories ) )
+      {
+         int walk_directory = should_walk_directories;
+         int call_callback = should_call_callback_directories;
+         int walk_partial = 0;
+
+         switch ( dir_walk_filter_match_directory( filter, path_buffer, current_path_len ) )
+         {
+         case DIR_WALK_FILTER_SKIP:
+            continue;
+         case DIR_WALK_FILTER_PARTIAL:
+            if ( !walk_directory )
+               continue;
+            call_callback = 0;
+            walk_partial = 1;
+            break;
+         case DIR_WALK_FILTER_MATCH:
+            break;
+         }
+
+         if ( !call_callback )
+         {
+            if ( walk_directory )
+               dir_iter_push( iter, current_path_len, walk_partial, 0 );
+            continue;
+         }
+
+         if ( flags & DIR_WALK_DEPTH_FIRST )
+         {
+            /* reported when everything in it has been reported, or right away if it is not walked */
+            if ( walk_directory && dir_iter_push( iter, current_path_len, walk_partial, 1 ) == DIR_ERROR_OK )
+               continue;
+         }
+         else
+         {
+            iter->descend = walk_directory;
+            iter->descend_partial = walk_partial;
+            iter->descend_path_len = current_path_len;
+         }
+
+         dir_iter_set_item( iter, item, &frame->reader, path_len + 1, current_path_len, DIR_ITEM_DIR );
+         return 1;
+      }
+      else if ( !is_dir && should_call_callback_files && !frame->partial )
+      {
+         if ( !dir_walk_filter_match_file( filter, item_name, item_len ) )
+            continue;
+
+         dir_iter_set_item( iter, item, &frame->reader, path_len + 1, current_path_len, DIR_ITEM_FILE );
+         return 1;
+      }
+   }
+   return 0;
+}
+
+DIRUTIL_API void dir_iter_skip_subtree( struct dir_iter* iter )
+{
+   iter->descend = 0;
+}
+
+DIRUTIL_API enum dir_error dir_iter_close( struct dir_iter* iter )
+{
+   enum dir_error result;
+   if ( iter == 0x0 )
+      return DIR_ERROR_OK;
+
+   result = iter->error;
+   dir_iter_release( iter );
+   DIRUTIL_FREE( iter );
+   return result;
+}
+
+/* drive an initialized iterator with callbacks, iter is released when done */
+static enum dir_error dir_iter_walk( struct dir_iter* iter, dir_walk_info_callback callback, void* userdata )
+{
+   struct dir_iter_item item;
+   enum dir_error result;
+
+   while ( dir_iter_next( iter, &item ) )
+   {
+      int callback_result = callback( item.path, item.path_len, item.type, &item.info, userdata );
+      if ( callback_result == DIR_WALK_SKIP_SUBTREE )
+         dir_iter_skip_subtree( iter );
+      else if ( dir_walk_result_is_abort( callback_result ) )
+      {
+         dir_iter_release( iter );
+         return DIR_ERROR_ABORTED;
+      }
+   }
+
+   result = iter->error;
+   dir_iter_release( iter );
+   return result;
+}
+
+DIRUTIL_API enum dir_error dir_walkex_info( const char* path, unsigned int flags, unsigned int info_fields,
+   const char* optional_glob_directories, const char* optional_glob_files,
+   dir_walk_info_callback callback, void* userdata )
+{
+   struct dir_iter iter;
+   enum dir_error result = dir_iter_init( &iter, path, flags, info_fields, optional_glob_directories, optional_glob_files, 0x0, 0x0, 0x0 );
+   if ( result != DIR_ERROR_OK )
+      return result;
+   return dir_iter_walk( &iter, callback, userdata );
+}
+
+DIRUTIL_API enum dir_error dir_walkex( const char* path, unsigned int flags, const char* optional_glob_directories, const char *optional_glob_files, dir_walk_callback callback, void* userdata )
+{
+   struct dir_walk_callback_adapter adapter;
+   adapter.callback = callback;
+   adapter.userdata = userdata;
+   return dir_walkex_info( path, flags, 0, optional_glob_directories, optional_glob_files, dir_walk_callback_no_info, &adapter );
+}
+
+DIRUTIL_API enum dir_error dir_walkex_globset( const char* path, unsigned int flags,
+   const struct dir_glob_set* optional_directories, const struct dir_glob_set* optional_files,
+   dir_walk_callback callback, void* userdata )
+{
+   struct dir_iter iter;
+   struct dir_walk_callback_adapter adapter;
+   enum dir_error result = dir_iter_init( &iter, path, flags, 0, 0x0, 0x0, optional_directories, optional_files, 0x0 );
+   if ( result != DIR_ERROR_OK )
+      return result;
+
+   adapter.callback = callback;
+   adapter.userdata = userdata;
+   return dir_iter_walk( &iter, dir_walk_callback_no_info, &adapter );
+}
+
+/* a directory in dir_walkex_batch, its arrays are kept when popped and reused by the next directory at the same depth */
+struct dir_batch_frame
+{
+   struct dir_walk_reader reader;
+   unsigned int path_len;
+   int partial;
+   struct dir_walk_dir_id id; /* DIR_WALK_FOLLOW_SYMLINKS */
+
+   unsigned int count; /* reported items */
+   unsigned int capacity;
+   unsigned int* name_offsets;
+   unsigned int* name_lens;
+   unsigned char* types;
+   dir_uint64* inodes;
+   struct dir_item_info* infos;
+
+   char* names; /* names of reported items and of sub-directories to walk */
+   unsigned int names_size;
+   unsigned int names_capacity;
+
+   unsigned int* subdirs; /* offset in 'names' of sub-directories to walk, the lowest bit set for partial ones */
+   unsigned int num_subdirs;
+   unsigned int subdirs_capacity;
+   unsigned int next_subdir;
+
+   struct dir_ignore_rules* ignore; /* DIR_WALK_GITIGNORE, null if the directory has no rules */
+   struct dir_walk_sorted sorted;   /* DIR_WALK_SORTED */
+};
+
+struct dir_batch_walk
+{
+   struct dir_walk_filter filter;
+   struct dir_batch_frame* stack;
+   unsigned int depth;
+   unsigned int stack_size;
+   struct dir_path_buffer path;
+#if defined( DIRUTIL_USE_IO_URING )
+   struct dir_io_uring ring;
+#endif
+};
+
+static int dir_batch_frame_add_name( struct dir_batch_frame* frame, const char* name, unsigned int name_len )
+{
+   if ( frame->names_size + name_len + 1 > frame->names_capacity )
+   {
+      unsigned int capacity = frame->names_capacity ? frame->names_capacity * 2 : 4096;
+      while ( capacity < frame->names_size + name_len + 1 )
+         capacity *= 2;
+      if ( !dir_array_grow( (void**)&frame->names, frame->names_size, capacity, 1 ) )
+         return 0;
+      frame->names_capacity = capacity;
+   }
+   memcpy( frame->names + frame->names_size, name, name_len + 1 );
+   frame->names_size += name_len + 1;
+   return 1;
+}
+
+static int dir_batch_frame_add_item( struct dir_batch_frame* frame, unsigned int info_fields )
+{
+   if ( frame->count == frame->capacity )
+   {
+      unsigned int capacity = frame->capacity ? frame->capacity * 2 : 64;
+      if ( !dir_array_grow( (void**)&frame->name_offsets, frame->count, capacity, sizeof( unsigned int ) ) ||
+           !dir_array_grow( (void**)&frame->name_lens, frame->count, capacity, sizeof( unsigned int ) ) ||
+           !dir_array_grow( (void**)&frame->types, frame->count, capacity, sizeof( unsigned char ) ) ||
+           !dir_array_grow( (void**)&frame->inodes, frame->count, capacity, sizeof( dir_uint64 ) ) ||
+           ( info_fields && !dir_array_grow( (void**)&frame->infos, frame->count, capacity, sizeof( struct dir_item_info ) ) ) )
+         return 0;
+      frame->capacity = capacity;
+   }
+   ++frame->count;
+   return 1;
+}
+
+static void dir_batch_frame_free( struct dir_batch_frame* frame )
+{
+   DIRUTIL_FREE( frame->name_offsets );
+   DIRUTIL_FREE( frame->name_lens );
+   DIRUTIL_FREE( frame->types );
+   DIRUTIL_FREE( frame->inodes );
+   DIRUTIL_FREE( frame->infos );
+   DIRUTIL_FREE( frame->names );
+   DIRUTIL_FREE( frame->subdirs );
+   dir_walk_sorted_free( &frame->sorted );
+}
+
+/* open the directory in path[0, path_len) on top of the stack, relative to the current top */
+static enum dir_error dir_batch_push( struct dir_batch_walk* walk, unsigned int path_len, int partial, const char* name )
+{
+   struct dir_batch_frame* frame;
+   const struct dir_walk_reader* parent;
+   struct dir_walk_dir_id id;
+   enum dir_error result;
+   unsigned int i;
+
+   if ( walk->depth == walk->stack_size )
+   {
+      unsigned int stack_size = walk->stack_size ? walk->stack_size * 2 : DIR_ITER_INITIAL_STACK_SIZE;
+      if ( !dir_array_grow( (void**)&walk->stack, walk->stack_size, stack_size, sizeof( struct dir_batch_frame ) ) )
+         return DIR_ERROR_FAILED;
+      memset( walk->stack + walk->stack_size, 0, ( stack_size - walk->stack_size ) * sizeof( struct dir_batch_frame ) );
+      /* a sorted reader points at the sort buffers in its own frame */
+      for ( i = 0; i < walk->depth; ++i )
+         if ( walk->stack[i].reader.sorted )
+            walk->stack[i].reader.sorted = &walk->stack[i].sorted;
+      walk->stack_size = stack_size;
+   }
+
+   /* room for the separator and '*' appended by the reader on windows, or the name of an ignore file */
+   if ( !dir_path_buffer_reserve( &walk->path, path_len + 12 ) )
+      return DIR_ERROR_FAILED;
+
+   /* directories that should not be walked are handled as directories that could not be opened */
+   parent = walk->depth ? &walk->stack[walk->depth - 1].reader : 0x0;
+   if ( parent && !dir_walk_filter_enter( &walk->filter, parent, name, walk->depth, &id ) )
+      return DIR_ERROR_FAILED;
+   for ( i = 0; parent && ( walk->filter.flags & DIR_WALK_FOLLOW_SYMLINKS ) && i < walk->depth; ++i )
+      if ( dir_walk_dir_id_equal( &walk->stack[i].id, &id ) )
+         return DIR_ERROR_FAILED;
+
+   frame = &walk->stack[walk->depth];
+   result = dir_walk_reader_open( &frame->reader, parent, name, walk->path.data, path_len, walk->path.size - path_len, walk->filter.slash,
+                                  ( walk->filter.flags & DIR_WALK_FOLLOW_SYMLINKS ) != 0 );
+   if ( result != DIR_ERROR_OK )
+      return result;
+
+   if ( parent == 0x0 && !dir_walk_filter_enter( &walk->filter, &frame->reader, 0x0, 0, &id ) )
+   {
+      dir_walk_reader_close( &frame->reader );
+      return DIR_ERROR_FAILED;
+   }
+   frame->id = id;
+
+   #if defined( DIRUTIL_USE_IO_URING )
+      if ( walk->filter.uring && !partial && !( walk->filter.flags & DIR_WALK_SORTED ) )
+         dir_walk_reader_enable_batch( &frame->reader, walk->filter.uring, dir_statx_mask( walk->filter.info_fields ), dir_walk_filter_wants_info, &walk->filter );
+   #endif
+
+   if ( ( walk->filter.flags & DIR_WALK_SORTED ) && !dir_walk_reader_sort( &frame->reader, &frame->sorted ) )
+   {
+      dir_walk_reader_close( &frame->reader );
+      return DIR_ERROR_FAILED;
+   }
+
+   frame->ignore = 0x0;
+   if ( ( walk->filter.flags & DIR_WALK_GITIGNORE ) && !dir_ignore_rules_load( &frame->reader, walk->path.data, path_len, walk->filter.slash, &frame->ignore ) )
+   {
+      dir_walk_reader_close( &frame->reader );
+      return DIR_ERROR_FAILED;
+   }
+
+   frame->path_len = path_len;
+   frame->partial = partial;
+   frame->count = 0;
+   frame->names_size = 0;
+   frame->num_subdirs = 0;
+   frame->next_subdir = 0;
+   ++walk->depth;
+   return DIR_ERROR_OK;
+}
+
+/* DIR_WALK_GITIGNORE, same as dir_iter_ignored */
+static int dir_batch_ignored( const struct dir_batch_walk* walk, unsigned int path_len, unsigned int name_len, int is_dir )
+{
+   const char* name = walk->path.data + path_len - name_len;
+   unsigned int i = walk->depth;
+
+   if ( name_len == 4 && memcmp( name, ".git", 4 ) == 0 )
+      return 1;
+
+   while ( i-- )
+   {
+      const struct dir_batch_frame* frame = &walk->stack[i];
+      int ignored;
+      if ( frame->ignore == 0x0 )
+         continue;
+      ignored = dir_ignore_rules_match( frame->ignore, walk->path.data + frame->path_len + 1, name, name_len, is_dir );
+      if ( ignored >= 0 )
+         return ignored;
+   }
+   return 0;
+}
+
+/* read all entries of the directory on top of the stack */
+static enum dir_error dir_batch_read( struct dir_batch_walk* walk, struct dir_batch_frame* frame )
+{
+   const struct dir_walk_filter* filter = &walk->filter;
+   unsigned int flags = filter->flags;
+   unsigned int path_len = frame->path_len;
+   const char* item_name;
+   int is_dir;
+
+   int should_walk_directories = ( flags & DIR_WALK_SINGLE_DIRECTORY ) == 0;
+   int should_call_callback_directories = ( flags & DIR_WALK_ONLY_FILES ) == 0;
+   int should_call_callback_files = ( flags & DIR_WALK_ONLY_DIRECTORIES ) == 0 && !frame->partial;
+
+   while ( dir_walk_reader_next( &frame->reader, &item_name, &is_dir ) )
+   {
+      unsigned int item_len, name_offset;
+      int report = 0, walk_directory = 0, walk_partial = 0;
+
+      #if !defined ( _WIN32 )
+         if ( is_dir == DIR_WALK_READER_TYPE_UNKNOWN && !dir_walk_reader_stat_is_dir( &frame->reader, item_name, &is_dir ) )
+            return DIR_ERROR_FAILED;
+         if ( !is_dir && ( flags & DIR_WALK_FOLLOW_SYMLINKS ) )
+            is_dir = dir_walk_reader_is_dir_symlink( &frame->reader, item_name );
+      #endif
+
+      if ( dir_walk_filter_ignore( filter, item_name, is_dir ) )
+         continue;
+
+      item_len = dir_strlen32( item_name );
+
+      if ( ( is_dir && ( should_walk_directories || should_call_callback_directories ) ) || ( flags & DIR_WALK_GITIGNORE ) )
+      {
+         if ( !dir_path_buffer_reserve( &walk->path, path_len + item_len + 2 ) ) /* 2 == '/' + null-terminator */
+            return DIR_ERROR_FAILED;
+         walk->path.data[path_len] = filter->slash;
+         memcpy( &walk->path.data[path_len + 1], item_name, item_len + 1 );
+
+         if ( ( flags & DIR_WALK_GITIGNORE ) && dir_batch_ignored( walk, path_len + item_len + 1, item_len, is_dir ) )
+            continue;
+      }
+
+      if ( is_dir && ( should_walk_directories || should_call_callback_directories ) )
+      {
+         switch ( dir_walk_filter_match_directory( filter, walk->path.data, path_len + item_len + 1 ) )
+         {
+         case DIR_WALK_FILTER_SKIP:
+            break;
+         case DIR_WALK_FILTER_PARTIAL:
+            walk_directory = should_walk_directories;
+            walk_partial = 1;
+            break;
+         case DIR_WALK_FILTER_MATCH:
+            walk_directory = should_walk_directories;
+            report = should_call_callback_directories;
+            break;
+         }
+      }
+      else if ( !is_dir && should_call_callback_files )
+         report = dir_walk_filter_match_file( filter, item_name, item_len );
+
+      if ( !report && !walk_directory )
+         continue;
+
+      name_offset = frame->names_size;
+      if ( !dir_batch_frame_add_name( frame, item_name, item_len ) )
+         return DIR_ERROR_FAILED;
+
+      if ( walk_directory )
+      {
+         if ( frame->num_subdirs == frame->subdirs_capacity )
+         {
+            unsigned int capacity = frame->subdirs_capacity ? frame->subdirs_capacity * 2 : 16;
+            if ( !dir_array_grow( (void**)&frame->subdirs, frame->num_subdirs, capacity, sizeof( unsigned int ) ) )
+               return DIR_ERROR_FAILED;
+            frame->subdirs_capacity = capacity;
+         }
+         /* offsets are used as is for names and shifted for the partial-flag, so the names-blob is limited to 2GB */
+         frame->subdirs[frame->num_subdirs++] = ( name_offset << 1 ) | (unsigned int)walk_partial;
+      }
+
+      if ( report )
+      {
+         unsigned int i = frame->count;
+         if ( !dir_batch_frame_add_item( frame, filter->info_fields ) )
+            return DIR_ERROR_FAILED;
+         frame->name_offsets[i] = name_offset;
+         frame->name_lens[i] = item_len;
+         frame->types[i] = (unsigned char)( is_dir ? DIR_ITEM_DIR : DIR_ITEM_FILE );
+         #if defined ( _WIN32 )
+            frame->inodes[i] = 0;
+         #else
+            frame->inodes[i] = frame->reader.d_ino;
+         #endif
+         if ( filter->info_fields )
+            dir_walk_reader_item_info( &frame->reader, frame->names + name_offset, filter->info_fields, &frame->infos[i] );
+      }
+   }
+   return frame->reader.error ? DIR_ERROR_FAILED : DIR_ERROR_OK;
+}
+
+static int dir_batch_deliver( struct dir_batch_walk* walk, struct dir_batch_frame* frame, dir_walk_batch_callback callback, void* userdata )
+{
+   struct dir_item_batch batch;
+   unsigned int path_offset = ( walk->filter.flags & DIR_WALK_ROOT_RELATIVE_PATHS ) ? ( walk->filter.root_path_len + 1 ) : 0;
+
+   walk->path.data[frame->path_len] = '\0';
+   if ( path_offset > frame->path_len )
+      path_offset = frame->path_len; /* the input/root-directory itself, "" */
+
+   batch.dir_path = walk->path.data + path_offset;
+   batch.dir_path_len = frame->path_len - path_offset;
+   batch.count = frame->count;
+   batch.names = frame->names;
+   batch.name_offsets = frame->name_offsets;
+   batch.name_lens = frame->name_lens;
+   batch.types = frame->types;
+   #if defined ( _WIN32 )
+      batch.inodes = 0x0;
+   #else
+      batch.inodes = frame->inodes;
+   #endif
+   batch.infos = walk->filter.info_fields ? frame->infos : 0x0;
+   return callback( &batch, userdata );
+}
+
+DIRUTIL_API enum dir_error dir_walkex_batch( const char* path, unsigned int flags, unsigned int info_fields,
+   const char* optional_glob_directories, const char* optional_glob_files,
+   dir_walk_batch_callback callback, void* userdata )
+{
+   struct dir_batch_walk walk;
+   enum dir_error result;
+   unsigned int path_len;
+   int depth_first = ( flags & DIR_WALK_DEPTH_FIRST ) != 0;
+
+   dir_path_buffer_init( &walk.path );
+   path_len = dir_walk_root_path( path, dir_walk_slash_by_flags( flags ), &walk.path );
+   if ( !path_len || dir_walk_filter_init( &walk.filter, flags, path_len, optional_glob_directories, optional_glob_files ) != DIR_ERROR_OK )
+   {
+      dir_path_buffer_free( &walk.path );
+      return DIR_ERROR_FAILED;
+   }
+   walk.filter.info_fields = info_fields & DIR_ITEM_INFO_ALL;
+   walk.stack = 0x0;
+   walk.depth = 0;
+   walk.stack_size = 0;
+
+#if defined( DIRUTIL_USE_IO_URING )
+   if ( ( walk.filter.info_fields & ~(unsigned int)DIR_ITEM_INFO_SYMLINK ) && dir_io_uring_init( &walk.ring, DIRUTIL_IO_URING_BATCH_SIZE ) )
+      walk.filter.uring = &walk.ring;
+#endif
+
+   result = dir_batch_push( &walk, path_len, 0, 0x0 );
+   if ( result == DIR_ERROR_OK )
+   {
+      /* errors in sub-directories only stops reading that directory, what was read is still reported */
+      enum dir_error root_error = dir_batch_read( &walk, &walk.stack[0] );
+
+      while ( walk.depth )
+      {
+         struct dir_batch_frame* frame = &walk.stack[walk.depth - 1];
+         int callback_result = DIR_WALK_CONTINUE;
+
+         if ( frame->next_subdir == 0 && !depth_first && frame->count )
+         {
+            callback_result = dir_batch_deliver( &walk, frame, callback, userdata );
+            if ( callback_result == DIR_WALK_SKIP_SUBTREE )
+               frame->num_subdirs = 0;
+            /* only deliver once */
+            frame->count = 0;
+         }
+
+         if ( !dir_walk_result_is_abort( callback_result ) && frame->next_subdir < frame->num_subdirs )
+         {
+            unsigned int subdir = frame->subdirs[frame->next_subdir++];
+            const char* name = frame->names + ( subdir >> 1 );
+            unsigned int name_len = dir_strlen32( name );
+            unsigned int subdir_path_len = frame->path_len + name_len + 1;
+
+            if ( !dir_path_buffer_reserve( &walk.path, subdir_path_len + 1 ) )
+               continue;
+            walk.path.data[frame->path_len] = walk.filter.slash;
+            memcpy( &walk.path.data[frame->path_len + 1], name, name_len + 1 );
+
+            if ( dir_batch_push( &walk, subdir_path_len, (int)( subdir & 1 ), name ) == DIR_ERROR_OK )
+               dir_batch_read( &walk, &walk.stack[walk.depth - 1] );
+            continue;
+         }
+
+         if ( !dir_walk_result_is_abort( callback_result ) && depth_first && frame->count )
+            callback_result = dir_batch_deliver( &walk, frame, callback, userdata );
+
+         if ( dir_walk_result_is_abort( callback_result ) )
+         {
+            result = DIR_ERROR_ABORTED;
+            break;
+         }
+
+         dir_walk_reader_close( &frame->reader );
+         dir_ignore_rules_free( frame->ignore );
+         --walk.depth;
+      }
+
+      if ( result == DIR_ERROR_OK )
+         result = root_error;
+   }
+
+   while ( walk.depth )
+   {
+      dir_walk_reader_close( &walk.stack[--walk.depth].reader );
+      dir_ignore_rules_free( walk.stack[walk.depth].ignore );
+   }
+   while ( walk.stack_size )
+      dir_batch_frame_free( &walk.stack[--walk.stack_size] );
+   DIRUTIL_FREE( walk.stack );
+   dir_path_buffer_free( &walk.path );
+#if defined( DIRUTIL_USE_IO_URING )
+   if ( walk.filter.uring )
+      dir_io_uring_destroy( &walk.ring );
+#endif
+   dir_walk_filter_free( &walk.filter );
+   return result;
+}
+
+/* walk of the tree in dir_snapshot_save and dir_walk_incremental, all entries of a directory are read before its sub-directories are walked */
+struct dir_snapshot_build_frame
+{
+   struct dir_walk_reader reader;
+   unsigned int dir;
+   unsigned int next_entry; /* next entry to check for a sub-directory to walk */
+   unsigned int end_entry;
+   unsigned int path_len;
+   int reused;              /* the entries are the ones of the snapshot compared with, not copied as no snapshot is saved */
+};
+
+/* a removed directory in the snapshot compared with, see dir_snapshot_builder_report_removed */
+struct dir_snapshot_removed_frame
+{
+   unsigned int dir;
+   unsigned int next_entry;
+   unsigned int path_len;
+};
+
+/* directories modified this close to the start of a walk are not reused, later modifications might not change their mtime */
+#define DIR_SNAPSHOT_RACY_SECONDS 2
+
+struct dir_snapshot_builder
+{
+   unsigned int info_fields;
+
+   struct dir_snapshot_dir* dirs;
+   unsigned int num_dirs;
+   unsigned int dirs_capacity;
+
+   struct dir_snapshot_entry* entries;
+   struct dir_item_info* infos;
+   unsigned int* previous_entries; /* matching entry in 'previous' of each entry, or DIR_SNAPSHOT_NONE */
+   unsigned int num_entries;
+   unsigned int entries_capacity;
+
+   char* strings;
+   unsigned int strings_size;
+   unsigned int strings_capacity;
+
+   struct dir_snapshot_build_frame* stack;
+   unsigned int depth;
+   unsigned int stack_size;
+   struct dir_path_buffer path;
+   char slash;
+   dir_int64 racy_time;
+
+   /* dir_walk_incremental, the snapshot compared with and the state to compare a directory with it */
+   const struct dir_snapshot* previous;
+   int save;                       /* build a complete snapshot, otherwise only what is needed to compare with 'previous' */
+   dir_walk_change_callback callback;
+   void* userdata;
+   unsigned int flags;
+   unsigned int root_path_len;
+   int aborted;
+
+   unsigned int* lookup; /* open addressing hash-table of previous entries by name */
+   unsigned int lookup_capacity;
+   unsigned char* matched;
+   unsigned int matched_capacity;
+   struct dir_snapshot_removed_frame* removed_stack;
+   unsigned int removed_stack_size;
+};
+
+/* add 'size' bytes of null-terminated strings to the name pool, returns the offset of the first or DIR_SNAPSHOT_NONE on failure */
+static unsigned int dir_snapshot_builder_add_strings( struct dir_snapshot_builder* builder, const char* strings, unsigned int size )
+{
+   unsigned int offset = builder->strings_size;
+   if ( size > 0x7fffffff - offset )
+      return DIR_SNAPSHOT_NONE;
+
+   if ( offset + size > builder->strings_capacity )
+   {
+      unsigned int capacity = builder->strings_capacity ? builder->strings_capacity : 64 * 1024;
+      while ( capacity < offset + size )
+         capacity *= 2;
+      if ( !dir_array_grow( (void**)&builder->strings, offset, capacity, 1 ) )
+         return DIR_SNAPSHOT_NONE;
+      builder->strings_capacity = capacity;
+   }
+   memcpy( builder->strings + offset, strings, size );
+   builder->strings_size += size;
+   return offset;
+}
+
+#define dir_snapshot_builder_add_string( builder, string, len ) dir_snapshot_builder_add_strings( ( builder ), ( string ), ( len ) + 1 )
+
+/* make room for 'count' more entries, returns 0 on failure */
+static int dir_snapshot_builder_reserve_entries( struct dir_snapshot_builder* builder, unsigned int count )
+{
+   unsigned int capacity = builder->entries_capacity ? builder->entries_capacity : 1024;
+   if ( count <= builder->entries_capacity - builder->num_entries )
+      return 1;
+
+   while ( capacity - builder->num_entries < count )
+   {
+      if ( capacity > 0x7fffffff )
+         return 0;
+      capacity *= 2;
+   }
+
+   if ( !dir_array_grow( (void**)&builder->entries, builder->num_entries, capacity, sizeof( struct dir_snapshot_entry ) ) ||
+        ( builder->info_fields && !dir_array_grow( (void**)&builder->infos, builder->num_entries, capacity, sizeof( struct dir_item_info ) ) ) ||
+        ( builder->previous && !dir_array_grow( (void**)&builder->previous_entries, builder->num_entries, capacity, sizeof( unsigned int ) ) ) )
+      return 0;
+   builder->entries_capacity = capacity;
+   return 1;
+}
+
+/* read all entries of the directory on top of the stack, returns 0 on failure */
+static int dir_snapshot_builder_read( struct dir_snapshot_builder* builder, struct dir_snapshot_build_frame* frame )
+{
+   const char* item_name;
+   int is_dir;
+
+   while ( dir_walk_reader_next( &frame->reader, &item_name, &is_dir ) )
+   {
+      struct dir_snapshot_entry* entry;
+      struct dir_item_info info;
+      unsigned int name;
+
+      if ( item_name[0] == '.' && ( item_name[1] == '\0' || ( item_name[1] == '.' && item_name[2] == '\0' ) ) )
+         continue;
+
+      #if !defined ( _WIN32 )
+         /* the walk stops reading the directory here, so does the snapshot */
+         if ( is_dir == DIR_WALK_READER_TYPE_UNKNOWN && !dir_walk_reader_stat_is_dir( &frame->reader, item_name, &is_dir ) )
+            break;
+      #endif
+
+      if ( !dir_snapshot_builder_reserve_entries( builder, 1 ) )
+         return 0;
+
+      name = dir_snapshot_builder_add_string( builder, item_name, dir_strlen32( item_name ) );
+      if ( name == DIR_SNAPSHOT_NONE )
+         return 0;
+
+      /* cleared so that the file does not depend on padding and fields that are not set */
+      memset( &info, 0, sizeof( info ) );
+      dir_walk_reader_item_info( &frame->reader, item_name, builder->info_fields | DIR_ITEM_INFO_SYMLINK, &info );
+
+      entry = &builder->entries[builder->num_entries];
+      entry->name = name;
+      entry->dir = DIR_SNAPSHOT_NONE;
+      entry->type = is_dir ? DIR_ITEM_DIR : DIR_ITEM_FILE;
+      entry->flags = 0;
+      if ( info.valid & DIR_ITEM_INFO_SYMLINK )
+         entry->flags = DIR_SNAPSHOT_SYMLINK_KNOWN | ( info.is_symlink ? DIR_SNAPSHOT_SYMLINK : 0 );
+
+      if ( builder->info_fields )
+      {
+         info.valid &= builder->info_fields;
+         if ( !( info.valid & DIR_ITEM_INFO_SYMLINK ) )
+            info.is_symlink = 0;
+         builder->infos[builder->num_entries] = info;
+      }
+      ++builder->num_entries;
+   }
+
+   builder->dirs[frame->dir].num_entries = builder->num_entries - builder->dirs[frame->dir].first_entry;
+
+   /* as in the walk, a directory below the root that fails to read keeps the entries read so far */
+   return !frame->reader.error || frame != builder->stack;
+}
+
+/* reuse the entries of directory 'previous_dir' in the snapshot compared with, returns 0 on failure */
+static int dir_snapshot_builder_copy( struct dir_snapshot_builder* builder, unsigned int dir, unsigned int previous_dir )
+{
+   const struct dir_snapshot* previous = builder->previous;
+   unsigned int first_entry = previous->dirs[previous_dir].first_entry;
+   unsigned int count = previous->dirs[previous_dir].num_entries;
+   unsigned int names_begin = DIR_SNAPSHOT_NONE, names_end = 0, names, i;
+
+   builder->dirs[dir].num_entries = count;
+   if ( count == 0 )
+      return 1;
+
+   /* the names of a directory are next to each other in the pool and copied in one go */
+   for ( i = first_entry; i < first_entry + count; ++i )
+   {
+      if ( previous->entries[i].name < names_begin )
+         names_begin = previous->entries[i].name;
+      if ( previous->entries[i].name >= names_end )
+         names_end = previous->entries[i].name + 1;
+   }
+   names_end += dir_strlen32( previous->strings + names_end - 1 );
+
+   if ( !dir_snapshot_builder_reserve_entries( builder, count ) )
+      return 0;
+   names = dir_snapshot_builder_add_strings( builder, previous->strings + names_begin, names_end - names_begin );
+   if ( names == DIR_SNAPSHOT_NONE )
+      return 0;
+
+   memcpy( &builder->entries[builder->num_entries], &previous->entries[first_entry], count * sizeof( struct dir_snapshot_entry ) );
+   if ( builder->info_fields )
+      memcpy( &builder->infos[builder->num_entries], &previous->infos[first_entry], count * sizeof( struct dir_item_info ) );
+   for ( i = 0; i < count; ++i )
+   {
+      struct dir_snapshot_entry* entry = &builder->entries[builder->num_entries];
+      entry->name = entry->name - names_begin + names;
+      entry->dir = DIR_SNAPSHOT_NONE;
+      builder->previous_entries[builder->num_entries++] = first_entry + i;
+   }
+   return 1;
+}
+
+/* fetch modification times and identity of directory item_name in parent, or at path for the root and on windows */
+static int dir_snapshot_stat_dir( const struct dir_walk_reader* parent, const char* item_name, const char* path, struct dir_snapshot_dir* dir )
+{
+#if defined( _WIN32 )
+   WIN32_FILE_ATTRIBUTE_DATA data;
+   (void)parent; (void)item_name;
+   if ( !GetFileAttributesExA( path, GetFileExInfoStandard, &data ) )
+      return 0;
+   dir_filetime_to_unix( &data.ftLastWriteTime, &dir->mtime, &dir->mtime_nsec );
+#else
+   struct stat s;
+   /* the root of a walk may be a symlink, just as it is opened */
+   if ( fstatat( parent ? dir_walk_reader_fd( parent ) : AT_FDCWD, parent ? item_name : path, &s, parent ? AT_SYMLINK_NOFOLLOW : 0 ) != 0 )
+      return 0;
+   dir->mtime = (dir_int64)s.st_mtime;
+   dir->ctime = (dir_int64)s.st_ctime;
+   #if defined( __APPLE__ )
+      dir->mtime_nsec = (unsigned int)s.st_mtimespec.tv_nsec;
+      dir->ctime_nsec = (unsigned int)s.st_ctimespec.tv_nsec;
+   #else
+      dir->mtime_nsec = (unsigned int)s.st_mtim.tv_nsec;
+      dir->ctime_nsec = (unsigned int)s.st_ctim.tv_nsec;
+   #endif
+   dir->inode = (dir_uint64)s.st_ino;
+   dir->device = (dir_uint64)s.st_dev;
+#endif
+   return 1;
+}
+
+static int dir_snapshot_dir_unchanged( const struct dir_snapshot_dir* dir, const struct dir_snapshot_dir* previous )
+{
+   return previous->reusable && dir->mtime == previous->mtime && dir->mtime_nsec == previous->mtime_nsec &&
+          dir->ctime == previous->ctime && dir->ctime_nsec == previous->ctime_nsec &&
+          dir->inode == previous->inode && dir->device == previous->device;
+}
+
+/* append '/name' to the path in path[0, path_len), returns the new length or 0 on failure */
+static unsigned int dir_snapshot_builder_append( struct dir_snapshot_builder* builder, unsigned int path_len, const char* name )
+{
+   unsigned int name_len = dir_strlen32( name );
+   if ( !dir_path_buffer_reserve( &builder->path, path_len + name_len + 2 ) ) /* 2 == '/' + null-terminator */
+      return 0;
+   builder->path.data[path_len] = builder->slash;
+   memcpy( &builder->path.data[path_len + 1], name, name_len + 1 );
+   return path_len + name_len + 1;
+}
+
+/* report a change of the item in path[0, path_len), returns 0 if the walk should stop */
+static int dir_snapshot_builder_report( struct dir_snapshot_builder* builder, unsigned int path_len, unsigned int type, enum dir_change change,
+   const struct dir_snapshot_entry* entry, const struct dir_item_info* stored_info )
+{
+   unsigned int path_offset = ( builder->flags & DIR_WALK_ROOT_RELATIVE_PATHS ) ? ( builder->root_path_len + 1 ) : 0;
+   struct dir_item_info info;
+   int callback_result;
+
+   if ( builder->flags & ( type == DIR_ITEM_DIR ? DIR_WALK_ONLY_FILES : DIR_WALK_ONLY_DIRECTORIES ) )
+      return 1;
+
+   builder->path.data[path_len] = '\0';
+   dir_snapshot_entry_info( entry, stored_info, builder->info_fields | DIR_ITEM_INFO_SYMLINK, &info );
+   callback_result = builder->callback( builder->path.data + path_offset, path_len - path_offset, (enum dir_item_type)type, change, &info, builder->userdata );
+   if ( dir_walk_result_is_abort( callback_result ) )
+   {
+      builder->aborted = 1;
+      return 0;
+   }
+   return 1;
+}
+
+/* report 'previous_entry' in the snapshot compared with as removed, for directories everything in them is reported first */
+static int dir_snapshot_builder_report_removed( struct dir_snapshot_builder* builder, unsigned int previous_entry, unsigned int path_len )
+{
+   const struct dir_snapshot* previous = builder->previous;
+   const struct dir_snapshot_entry* entry = &previous->entries[previous_entry];
+   unsigned int entry_path_len = dir_snapshot_builder_append( builder, path_len, previous->strings + entry->name );
+   unsigned int depth = 0;
+
+   if ( entry_path_len == 0 )
+      return 0;
+   if ( entry->dir == DIR_SNAPSHOT_NONE )
+      return dir_snapshot_builder_report( builder, entry_path_len, entry->type, DIR_CHANGE_REMOVED, entry, previous->infos ? &previous->infos[previous_entry] : 0x0 );
+
+   for ( ;; )
+   {
+      struct dir_snapshot_removed_frame* frame;
+      const struct dir_snapshot_dir* dir;
+
+      if ( entry )
+      {
+         if ( depth == builder->removed_stack_size )
+         {
+            unsigned int stack_size = depth ? depth * 2 : DIR_ITER_INITIAL_STACK_SIZE;
+            if ( !dir_array_grow( (void**)&builder->removed_stack, depth, stack_size, sizeof( struct dir_snapshot_removed_frame ) ) )
+               return 0;
+            builder->removed_stack_size = stack_size;
+         }
+         frame = &builder->removed_stack[depth++];
+         frame->dir = entry->dir;
+         frame->next_entry = previous->dirs[entry->dir].first_entry;
+         frame->path_len = entry_path_len;
+         entry = 0x0;
+      }
+
+      frame = &builder->removed_stack[depth - 1];
+      dir = &previous->dirs[frame->dir];
+      if ( frame->next_entry < dir->first_entry + dir->num_entries )
+      {
+         previous_entry = frame->next_entry++;
+         entry_path_len = dir_snapshot_builder_append( builder, frame->path_len, previous->strings + previous->entries[previous_entry].name );
+         if ( entry_path_len == 0 )
+            return 0;
+         if ( previous->entries[previous_entry].dir != DIR_SNAPSHOT_NONE )
+            entry = &previous->entries[previous_entry];
+         else if ( !dir_snapshot_builder_report( builder, entry_path_len, previous->entries[previous_entry].type, DIR_CHANGE_REMOVED,
+                                                 &previous->entries[previous_entry], previous->infos ? &previous->infos[previous_entry] : 0x0 ) )
+            return 0;
+         continue;
+      }
+
+      /* everything in the directory is reported, the directory itself is next */
+      previous_entry = dir->entry;
+      if ( !dir_snapshot_builder_report( builder, frame->path_len, DIR_ITEM_DIR, DIR_CHANGE_REMOVED,
+                                         &previous->entries[previous_entry], previous->infos ? &previous->infos[previous_entry] : 0x0 ) )
+         return 0;
+      if ( --depth == 0 )
+         return 1;
+   }
+}
+
+static unsigned int dir_snapshot_hash( const char* name )
+{
+   unsigned int hash = 2166136261u;
+   while ( *name )
+      hash = ( hash ^ (unsigned char)*name++ ) * 16777619u;
+   return hash;
+}
+
+static int dir_item_info_differs( const struct dir_item_info* a, const struct dir_item_info* b )
+{
+   unsigned int fields = a->valid & b->valid;
+   if ( a->valid != b->valid )
+      return 1;
+   return ( ( fields & DIR_ITEM_INFO_SIZE ) && a->size != b->size ) ||
+          ( ( fields & DIR_ITEM_INFO_MTIME ) && ( a->mtime != b->mtime || a->mtime_nsec != b->mtime_nsec ) ) ||
+          ( ( fields & DIR_ITEM_INFO_INODE ) && ( a->inode != b->inode || a->device != b->device ) ) ||
+          ( ( fields & DIR_ITEM_INFO_MODE ) && a->mode != b->mode ) ||
+          ( ( fields & DIR_ITEM_INFO_SYMLINK ) && a->is_symlink != b->is_symlink );
+}
+
+/**
+ * match the entries of directory 'dir', just read, with the entries of 'previous_dir' in the snapshot compared with by name
+ * and report what was removed, added and modified. returns 0 if the walk should stop.
+ */
+static int dir_snapshot_builder_compare( struct dir_snapshot_builder* builder, unsigned int dir, unsigned int previous_dir, unsigned int path_len )
+{
+   const struct dir_snapshot* previous = builder->previous;
+   unsigned int first_entry = builder->dirs[dir].first_entry;
+   unsigned int end = first_entry + builder->dirs[dir].num_entries;
+   unsigned int previous_first = 0, previous_count = 0, mask = 0, i;
+
+   if ( previous_dir != DIR_SNAPSHOT_NONE )
+   {
+      previous_first = previous->dirs[previous_dir].first_entry;
+      previous_count = previous->dirs[previous_dir].num_entries;
+   }
+
+   if ( previous_count )
+   {
+      unsigned int capacity = 16;
+      while ( capacity < previous_count * 2 )
+         capacity *= 2;
+      if ( capacity > builder->lookup_capacity )
+      {
+         if ( !dir_array_grow( (void**)&builder->lookup, 0, capacity, sizeof( unsigned int ) ) )
+            return 0;
+         builder->lookup_capacity = capacity;
+      }
+      if ( previous_count > builder->matched_capacity )
+      {
+         if ( !dir_array_grow( (void**)&builder->matched, 0, previous_count, 1 ) )
+            return 0;
+         builder->matched_capacity = previous_count;
+      }
+      mask = capacity - 1;
+      memset( builder->lookup, 0xff, capacity * sizeof( unsigned int ) );
+      memset( builder->matched, 0, previous_count );
+      for ( i = previous_first; i < previous_first + previous_count; ++i )
+      {
+         unsigned int slot = dir_snapshot_hash( previous->strings + previous->entries[i].name ) & mask;
+         while ( builder->lookup[slot] != DIR_SNAPSHOT_NONE )
+            slot = ( slot + 1 ) & mask;
+         builder->lookup[slot] = i;
+      }
+   }
+
+   for ( i = first_entry; i < end; ++i )
+   {
+      const char* name = builder->strings + builder->entries[i].name;
+      builder->previous_entries[i] = DIR_SNAPSHOT_NONE;
+      if ( previous_count )
+      {
+         unsigned int slot = dir_snapshot_hash( name ) & mask;
+         for ( ; builder->lookup[slot] != DIR_SNAPSHOT_NONE; slot = ( slot + 1 ) & mask )
+         {
+            unsigned int match = builder->lookup[slot];
+            if ( strcmp( previous->strings + previous->entries[match].name, name ) != 0 )
+               continue;
+            /* an item replaced by one of another type is removed and added */
+            if ( previous->entries[match].type == builder->entries[i].type )
+            {
+               builder->previous_entries[i] = match;
+               builder->matched[match - previous_first] = 1;
+            }
+            break;
+         }
+      }
+   }
+
+   for ( i = 0; i < previous_count; ++i )
+      if ( !builder->matched[i] && !dir_snapshot_builder_report_removed( builder, previous_first + i, path_len ) )
+         return 0;
+
+   for ( i = first_entry; i < end; ++i )
+   {
+      const struct dir_snapshot_entry* entry = &builder->entries[i];
+      unsigned int match = builder->previous_entries[i];
+      const struct dir_item_info* info = builder->info_fields ? &builder->infos[i] : 0x0;
+      enum dir_change change = DIR_CHANGE_ADDED;
+      unsigned int entry_path_len;
+
+      /* directories are not modified themselves, what changed in them is reported when they are walked */
+      if ( match != DIR_SNAPSHOT_NONE )
+      {
+         const struct dir_snapshot_entry* previous_entry = &previous->entries[match];
+         if ( entry->type == DIR_ITEM_DIR ||
+              ( ( entry->flags == previous_entry->flags || !( entry->flags & previous_entry->flags & DIR_SNAPSHOT_SYMLINK_KNOWN ) ) &&
+                ( info == 0x0 || !dir_item_info_differs( info, &previous->infos[match] ) ) ) )
+            continue;
+         change = DIR_CHANGE_MODIFIED;
+      }
+
+      entry_path_len = dir_snapshot_builder_append( builder, path_len, builder->strings + entry->name );
+      if ( entry_path_len == 0 || !dir_snapshot_builder_report( builder, entry_path_len, entry->type, change, entry, info ) )
+         return 0;
+   }
+   return 1;
+}
+
+/**
+ * add the directory in path[0, path_len) and its entries, read from the file system or reused from the snapshot compared with.
+ * @param name name of the directory in the directory on top of the stack, ignored for the root.
+ * @param entry the entry of the directory on top of the stack that leads to the directory, DIR_SNAPSHOT_NONE if the
+ *              entries on top of the stack are not stored.
+ * @param previous_dir the same directory in the snapshot compared with, DIR_SNAPSHOT_NONE if it is not in it.
+ */
+static enum dir_error dir_snapshot_builder_push( struct dir_snapshot_builder* builder, unsigned int path_len, const char* name,
+   unsigned int entry, unsigned int previous_dir )
+{
+   const struct dir_snapshot* previous = builder->previous;
+   const struct dir_walk_reader* parent;
+   struct dir_snapshot_build_frame* frame;
+   struct dir_snapshot_dir current;
+   enum dir_error result;
+   int reuse = 0, open_reader = 1, ok = 1;
+
+   if ( builder->depth == builder->stack_size )
+   {
+      unsigned int stack_size = builder->stack_size ? builder->stack_size * 2 : DIR_ITER_INITIAL_STACK_SIZE;
+      if ( !dir_array_grow( (void**)&builder->stack, builder->depth, stack_size, sizeof( struct dir_snapshot_build_frame ) ) )
+         return DIR_ERROR_FAILED;
+      builder->stack_size = stack_size;
+   }
+
+   if ( builder->num_dirs == builder->dirs_capacity )
+   {
+      unsigned int capacity = builder->dirs_capacity ? builder->dirs_capacity * 2 : 256;
+      if ( capacity <= builder->dirs_capacity || !dir_array_grow( (void**)&builder->dirs, builder->num_dirs, capacity, sizeof( struct dir_snapshot_dir ) ) )
+         return DIR_ERROR_FAILED;
+      builder->dirs_capacity = capacity;
+   }
+
+   /* room for the separator and '*' appended by the reader on windows */
+   if ( !dir_path_buffer_reserve( &builder->path, path_len + 3 ) )
+      return DIR_ERROR_FAILED;
+
+   parent = builder->depth ? &builder->stack[builder->depth - 1].reader : 0x0;
+
+   /* fetched before the entries are read, a modification while reading makes the next walk read them again */
+   memset( &current, 0, sizeof( current ) );
+   if ( dir_snapshot_stat_dir( parent, name, builder->path.data, &current ) )
+   {
+      current.reusable = current.mtime < builder->racy_time && current.ctime < builder->racy_time;
+      reuse = previous_dir != DIR_SNAPSHOT_NONE && dir_snapshot_dir_unchanged( &current, &previous->dirs[previous_dir] );
+   }
+
+   /* an unchanged directory is only opened to check its sub-directories */
+   if ( reuse )
+   {
+      unsigned int i = previous->dirs[previous_dir].first_entry;
+      unsigned int end = i + previous->dirs[previous_dir].num_entries;
+      while ( i < end && previous->entries[i].type != DIR_ITEM_DIR )
+         ++i;
+      open_reader = i < end;
+   }
+
+   frame = &builder->stack[builder->depth];
+   if ( open_reader )
+   {
+      result = dir_walk_reader_open( &frame->reader, parent, name, builder->path.data, path_len, builder->path.size - path_len, builder->slash, 0 );
+      if ( result != DIR_ERROR_OK )
+         return result;
+      ++builder->depth;
+   }
+
+   current.parent = parent ? frame[-1].dir : DIR_SNAPSHOT_NONE;
+   current.entry = parent ? entry : DIR_SNAPSHOT_NONE;
+   current.first_entry = builder->num_entries;
+   builder->dirs[builder->num_dirs] = current;
+   if ( entry != DIR_SNAPSHOT_NONE )
+      builder->entries[entry].dir = builder->num_dirs;
+
+   frame->dir = builder->num_dirs++;
+   frame->path_len = path_len;
+   frame->reused = reuse && !builder->save;
+
+   if ( frame->reused )
+   {
+      frame->next_entry = previous->dirs[previous_dir].first_entry;
+      frame->end_entry = frame->next_entry + previous->dirs[previous_dir].num_entries;
+      return DIR_ERROR_OK;
+   }
+
+   if ( reuse )
+      ok = dir_snapshot_builder_copy( builder, frame->dir, previous_dir );
+   else
+      ok = dir_snapshot_builder_read( builder, frame ) && ( previous == 0x0 || dir_snapshot_builder_compare( builder, frame->dir, previous_dir, path_len ) );
+
+   frame->next_entry = builder->dirs[frame->dir].first_entry;
+   frame->end_entry = frame->next_entry + builder->dirs[frame->dir].num_entries;
+   if ( ok )
+      return DIR_ERROR_OK;
+   return builder->aborted ? DIR_ERROR_ABORTED : DIR_ERROR_FAILED;
+}
+
+static enum dir_error dir_snapshot_builder_walk( struct dir_snapshot_builder* builder, unsigned int path_len )
+{
+   const struct dir_snapshot* previous = builder->previous;
+   enum dir_error result = dir_snapshot_builder_push( builder, path_len, 0x0, DIR_SNAPSHOT_NONE, previous ? 0 : DIR_SNAPSHOT_NONE );
+
+   while ( result == DIR_ERROR_OK && builder->depth )
+   {
+      struct dir_snapshot_build_frame* frame = &builder->stack[builder->depth - 1];
+      const struct dir_snapshot_entry* entries = frame->reused ? previous->entries : builder->entries;
+      unsigned int entry, subdir_path_len, previous_dir = DIR_SNAPSHOT_NONE;
+      const char* name;
+
+      while ( frame->next_entry < frame->end_entry && entries[frame->next_entry].type != DIR_ITEM_DIR )
+         ++frame->next_entry;
+
+      if ( frame->next_entry == frame->end_entry )
+      {
+         dir_walk_reader_close( &frame->reader );
+         --builder->depth;
+         continue;
+      }
+
+      entry = frame->next_entry++;
+      if ( frame->reused )
+      {
+         name = previous->strings + entries[entry].name;
+         previous_dir = entries[entry].dir;
+         entry = DIR_SNAPSHOT_NONE;
+      }
+      else
+      {
+         name = builder->strings + entries[entry].name;
+         if ( previous && builder->previous_entries[entry] != DIR_SNAPSHOT_NONE )
+            previous_dir = previous->entries[builder->previous_entries[entry]].dir;
+      }
+
+      subdir_path_len = dir_snapshot_builder_append( builder, frame->path_len, name );
+      if ( subdir_path_len == 0 )
+      {
+         result = DIR_ERROR_FAILED;
+         break;
+      }
+
+      /* directories that can not be opened are stored as entries that can not be walked, just as a walk ignores them */
+      result = dir_snapshot_builder_push( builder, subdir_path_len, name, entry, previous_dir );
+      if ( result == DIR_ERROR_PATH_DO_NOT_EXIST )
+      {
+         result = DIR_ERROR_OK;
+         /* what was in it is gone from the new snapshot */
+         if ( previous_dir != DIR_SNAPSHOT_NONE )
+         {
+            const struct dir_snapshot_dir* gone = &previous->dirs[previous_dir];
+            unsigned int i;
+            for ( i = gone->first_entry; i < gone->first_entry + gone->num_entries && result == DIR_ERROR_OK; ++i )
+               if ( !dir_snapshot_builder_report_removed( builder, i, subdir_path_len ) )
+                  result = builder->aborted ? DIR_ERROR_ABORTED : DIR_ERROR_FAILED;
+         }
+      }
+   }
+
+   while ( builder->depth )
+      dir_walk_reader_close( &builder->stack[--builder->depth].reader );
+   return result;
+}
+
+/* write the snapshot to a new file that replaces 'snapshot_file' when complete */
+static enum dir_error dir_snapshot_builder_write( const struct dir_snapshot_builder* builder, unsigned int root_path, const char* snapshot_file )
+{
+   struct dir_snapshot_header header;
+   const void* sections[5];
+   size_t section_sizes[5];
+   unsigned int i, file_len = dir_strlen32( snapshot_file );
+   int ok = 1;
+   char* temp_file = (char*)DIRUTIL_MALLOC( file_len + 5 );
+#if defined( _WIN32 )
+   HANDLE file;
+#else
+   int fd;
+#endif
+
+   if ( temp_file == 0x0 )
+      return DIR_ERROR_FAILED;
+   memcpy( temp_file, snapshot_file, file_len );
+   memcpy( temp_file + file_len, ".tmp", 5 );
+
+   memset( &header, 0, sizeof( header ) );
+   memcpy( header.magic, DIR_SNAPSHOT_MAGIC, sizeof( DIR_SNAPSHOT_MAGIC ) );
+   header.version = DIR_SNAPSHOT_VERSION;
+   header.header_size = sizeof( struct dir_snapshot_header );
+   header.dir_size = sizeof( struct dir_snapshot_dir );
+   header.entry_size = sizeof( struct dir_snapshot_entry );
+   header.info_size = sizeof( struct dir_item_info );
+   header.info_fields = builder->info_fields;
+   header.num_dirs = builder->num_dirs;
+   header.num_entries = builder->num_entries;
+   header.strings_size = builder->strings_size;
+   header.root_path = root_path;
+
+   sections[0] = &header;
+   section_sizes[0] = sizeof( header );
+   sections[1] = builder->dirs;
+   section_sizes[1] = (size_t)builder->num_dirs * sizeof( struct dir_snapshot_dir );
+   sections[2] = builder->entries;
+   section_sizes[2] = (size_t)builder->num_entries * sizeof( struct dir_snapshot_entry );
+   sections[3] = builder->infos;
+   section_sizes[3] = builder->info_fields ? (size_t)builder->num_entries * sizeof( struct dir_item_info ) : 0;
+   sections[4] = builder->strings;
+   section_sizes[4] = builder->strings_size;
+   for ( i = 0; i < 5; ++i )
+      header.file_size += section_sizes[i];
+
+#if defined( _WIN32 )
+   file = CreateFileA( temp_file, GENERIC_WRITE, 0, 0x0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0x0 );
+   if ( file == INVALID_HANDLE_VALUE )
+   {
+      DIRUTIL_FREE( temp_file );
+      return DIR_ERROR_FAILED;
+   }
+   for ( i = 0; ok && i < 5; ++i )
+   {
+      const char* data = (const char*)sections[i];
+      size_t left = section_sizes[i];
+      while ( ok && left )
+      {
+         DWORD written = 0;
+         ok = WriteFile( file, data, left > 0x40000000 ? 0x40000000 : (DWORD)left, &written, 0x0 ) != 0;
+         data += written;
+         left -= written;
+      }
+   }
+   ok = CloseHandle( file ) && ok;
+   ok = ok && MoveFileExA( temp_file, snapshot_file, MOVEFILE_REPLACE_EXISTING );
+   if ( !ok )
+      DeleteFileA( temp_file );
+#else
+   fd = open( temp_file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666 );
+   if ( fd < 0 )
+   {
+      DIRUTIL_FREE( temp_file );
+      return DIR_ERROR_FAILED;
+   }
+   for ( i = 0; ok && i < 5; ++i )
+   {
+      const char* data = (const char*)sections[i];
+      size_t left = section_sizes[i];
+      while ( ok && left )
+      {
+         ssize_t written = write( fd, data, left > 0x40000000 ? 0x40000000 : left );
+         if ( written < 0 )
+         {
+            ok = errno == EINTR;
+            continue;
+         }
+         data += written;
+         left -= (size_t)written;
+      }
+   }
+   ok = close( fd ) == 0 && ok;
+   ok = ok && rename( temp_file, snapshot_file ) == 0;
+   if ( !ok )
+      unlink( temp_file );
+#endif
+   DIRUTIL_FREE( temp_file );
+   return ok ? DIR_ERROR_OK : DIR_ERROR_FAILED;
+}
+
+/* walk path into builder and write the result to snapshot_file if not 0x0 */
+static enum dir_error dir_snapshot_builder_run( struct dir_snapshot_builder* builder, const char* path, const char* snapshot_file )
+{
+   enum dir_error result = DIR_ERROR_FAILED;
+   unsigned int path_len, root_path;
+
+   builder->racy_time = (dir_int64)time( 0x0 ) - DIR_SNAPSHOT_RACY_SECONDS;
+   dir_path_buffer_init( &builder->path );
+
+   path_len = dir_walk_root_path( path, builder->slash, &builder->path );
+   root_path = dir_snapshot_builder_add_string( builder, path, dir_strlen32( path ) );
+   if ( path_len && root_path != DIR_SNAPSHOT_NONE )
+   {
+      builder->root_path_len = path_len;
+      result = dir_snapshot_builder_walk( builder, path_len );
+      if ( result == DIR_ERROR_OK && snapshot_file )
+         result = dir_snapshot_builder_write( builder, root_path, snapshot_file );
+   }
+
+   DIRUTIL_FREE( builder->dirs );
+   DIRUTIL_FREE( builder->entries );
+   DIRUTIL_FREE( builder->infos );
+   DIRUTIL_FREE( builder->previous_entries );
+   DIRUTIL_FREE( builder->strings );
+   DIRUTIL_FREE( builder->stack );
+   DIRUTIL_FREE( builder->lookup );
+   DIRUTIL_FREE( builder->matched );
+   DIRUTIL_FREE( builder->removed_stack );
+   dir_path_buffer_free( &builder->path );
+   return result;
+}
+
+DIRUTIL_API enum dir_error dir_snapshot_save( const char* path, unsigned int info_fields, const char* snapshot_file )
+{
+   struct dir_snapshot_builder builder;
+   memset( &builder, 0, sizeof( builder ) );
+   builder.info_fields = info_fields & DIR_ITEM_INFO_ALL;
+   builder.slash = dir_walk_slash_by_flags( DIR_WALK_NO_FLAGS );
+   builder.save = 1;
+   return dir_snapshot_builder_run( &builder, path, snapshot_file );
+}
+
+DIRUTIL_API enum dir_error dir_walk_incremental( const char* path, const struct dir_snapshot* previous_snapshot, unsigned int flags,
+   dir_walk_change_callback callback, void* userdata, const char* optional_snapshot_file )
+{
+   struct dir_snapshot_builder builder;
+   memset( &builder, 0, sizeof( builder ) );
+   builder.info_fields = previous_snapshot->header->info_fields;
+   builder.slash = dir_walk_slash_by_flags( flags );
+   builder.previous = previous_snapshot;
+   builder.save = optional_snapshot_file != 0x0;
+   builder.callback = callback;
+   builder.userdata = userdata;
+   builder.flags = flags;
+   return dir_snapshot_builder_run( &builder, path, optional_snapshot_file );
+}
+
+/* check that everything in the snapshot is in bounds and that the directories form a tree, so that walks of it terminate */
+static int dir_snapshot_validate( struct dir_snapshot* snapshot )
+{
+   const struct dir_snapshot_header* header = (const struct dir_snapshot_header*)snapshot->data;
+   dir_uint64 offset = sizeof( struct dir_snapshot_header );
+   unsigned int i;
+
+   if ( snapshot->size < sizeof( struct dir_snapshot_header ) ||
+        memcmp( header->magic, DIR_SNAPSHOT_MAGIC, sizeof( DIR_SNAPSHOT_MAGIC ) ) != 0 ||
+        header->version != DIR_SNAPSHOT_VERSION ||
+        header->header_size != sizeof( struct dir_snapshot_header ) ||
+        header->dir_size != sizeof( struct dir_snapshot_dir ) ||
+        header->entry_size != sizeof( struct dir_snapshot_entry ) ||
+        header->info_size != sizeof( struct dir_item_info ) ||
+        header->file_size != snapshot->size ||
+        header->num_dirs == 0 || header->strings_size == 0 )
+      return 0;
+
+   snapshot->header = header;
+   snapshot->dirs = (const struct dir_snapshot_dir*)( (const char*)snapshot->data + offset );
+   offset += (dir_uint64)header->num_dirs * sizeof( struct dir_snapshot_dir );
+   snapshot->entries = (const struct dir_snapshot_entry*)( (const char*)snapshot->data + offset );
+   offset += (dir_uint64)header->num_entries * sizeof( struct dir_snapshot_entry );
+   snapshot->infos = header->info_fields ? (const struct dir_item_info*)( (const char*)snapshot->data + offset ) : 0x0;
+   if ( header->info_fields )
+      offset += (dir_uint64)header->num_entries * sizeof( struct dir_item_info );
+   snapshot->strings = (const char*)snapshot->data + offset;
+   offset += header->strings_size;
+
+   /* a null-terminator last makes every offset in the pool a valid string */
+   if ( offset != header->file_size || snapshot->strings[header->strings_size - 1] != '\0' ||
+        header->root_path >= header->strings_size || snapshot->strings[header->root_path] == '\0' )
+      return 0;
+
+   /* the entries of the directories follow each other in the order of the directories, so each entry has one directory */
+   for ( i = 0; i < header->num_dirs; ++i )
+   {
+      const struct dir_snapshot_dir* dir = &snapshot->dirs[i];
+      unsigned int first_entry = i ? snapshot->dirs[i - 1].first_entry + snapshot->dirs[i - 1].num_entries : 0;
+      if ( dir->first_entry != first_entry || dir->num_entries > header->num_entries - first_entry )
+         return 0;
+      if ( i == 0 )
+         continue;
+      /* parents are stored before their sub-directories */
+      if ( dir->parent >= i || dir->entry < snapshot->dirs[dir->parent].first_entry ||
+           dir->entry - snapshot->dirs[dir->parent].first_entry >= snapshot->dirs[dir->parent].num_entries ||
+           snapshot->entries[dir->entry].dir != i )
+         return 0;
+   }
+
+   for ( i = 0; i < header->num_entries; ++i )
+   {
+      const struct dir_snapshot_entry* entry = &snapshot->entries[i];
+      if ( entry->name >= header->strings_size || ( entry->type != DIR_ITEM_FILE && entry->type != DIR_ITEM_DIR ) )
+         return 0;
+      if ( entry->dir != DIR_SNAPSHOT_NONE && ( entry->dir == 0 || entry->dir >= header->num_dirs || snapshot->dirs[entry->dir].entry != i ) )
+         return 0;
+   }
+   return 1;
+}
+
+DIRUTIL_API enum dir_error dir_snapshot_open( const char* snapshot_file, struct dir_snapshot** snapshot )
+{
+   struct dir_snapshot* snap = (struct dir_snapshot*)DIRUTIL_MALLOC( sizeof( struct dir_snapshot ) );
+#if defined( _WIN32 )
+   HANDLE file;
+   LARGE_INTEGER size;
+#else
+   int fd;
+   struct stat s;
+#endif
+
+   *snapshot = 0x0;
+   if ( snap == 0x0 )
+      return DIR_ERROR_FAILED;
+
+#if defined( _WIN32 )
+   file = CreateFileA( snapshot_file, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, 0x0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0x0 );
+   if ( file == INVALID_HANDLE_VALUE )
+   {
+      DIRUTIL_FREE( snap );
+      return DIR_ERROR_PATH_DO_NOT_EXIST;
+   }
+   snap->data = 0x0;
+   snap->mapping = 0x0;
+   if ( GetFileSizeEx( file, &size ) && size.QuadPart > 0 && (dir_uint64)size.QuadPart <= (size_t)-1 )
+   {
+      snap->size = (size_t)size.QuadPart;
+      snap->mapping = CreateFileMappingA( file, 0x0, PAGE_READONLY, 0, 0, 0x0 );
+      if ( snap->mapping )
+         snap->data = MapViewOfFile( snap->mapping, FILE_MAP_READ, 0, 0, 0 );
+   }
+   /* the mapping keeps the file open */
+   CloseHandle( file );
+   if ( snap->data == 0x0 )
+   {
+      if ( snap->mapping )
+         CloseHandle( snap->mapping );
+      DIRUTIL_FREE( snap );
+      return DIR_ERROR_FAILED;
+   }
+#else
+   fd = open( snapshot_file, O_RDONLY | O_CLOEXEC );
+   if ( fd < 0 )
+   {
+      DIRUTIL_FREE( snap );
+      return DIR_ERROR_PATH_DO_NOT_EXIST;
+   }
+   snap->data = MAP_FAILED;
+   if ( fstat( fd, &s ) == 0 && s.st_size > 0 && (dir_uint64)s.st_size <= (size_t)-1 )
+   {
+      snap->size = (size_t)s.st_size;
+      snap->data = mmap( 0x0, snap->size, PROT_READ, MAP_PRIVATE, fd, 0 );
+   }
+   /* the mapping keeps the file open */
+   close( fd );
+   if ( snap->data == MAP_FAILED )
+   {
+      DIRUTIL_FREE( snap );
+      return DIR_ERROR_FAILED;
+   }
+#endif
+
+   if ( !dir_snapshot_validate( snap ) )
+   {
+      dir_snapshot_close( snap );
+      return DIR_ERROR_FAILED;
+   }
+   *snapshot = snap;
+   return DIR_ERROR_OK;
+}
+
+DIRUTIL_API void dir_snapshot_close( struct dir_snapshot* snapshot )
+{
+   if ( snapshot == 0x0 )
+      return;
+#if defined( _WIN32 )
+   UnmapViewOfFile( snapshot->data );
+   CloseHandle( snapshot->mapping );
+#else
+   munmap( snapshot->data, snapshot->size );
+#endif
+   DIRUTIL_FREE( snapshot );
+}
+
+DIRUTIL_API enum dir_error dir_snapshot_walkex( const struct dir_snapshot* snapshot, unsigned int flags, unsigned int info_fields,
+   const char* optional_glob_directories, const char* optional_glob_files,
+   dir_walk_info_callback callback, void* userdata )
+{
+   struct dir_iter iter;
+   enum dir_error result = dir_iter_init( &iter, snapshot->strings + snapshot->header->root_path, flags, info_fields,
+                                          optional_glob_directories, optional_glob_files, 0x0, 0x0, snapshot );
+   if ( result != DIR_ERROR_OK )
+      return result;
+   return dir_iter_walk( &iter, callback, userdata );
+}
+
+#if defined( __linux__ )
+
+#define DIR_WATCH_NONE 0xffffffffu
+
+/* change of an item that was added and then removed again in the same batch */
+#define DIR_WATCH_CHANGE_NONE 0xff
+
+#define DIR_WATCH_EVENTS ( IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | \
+                           IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_EXCL_UNLINK )
+
+/* max number of DIRUTIL_WATCH_COALESCE_MS periods that one batch collects changes for */
+#define DIR_WATCH_MAX_ROUNDS 10
+
+/* an item in the view of the tree, the items of a directory are linked in a list below it */
+struct dir_watch_node
+{
+   char* name;                /* the root path for the root, 0x0 if the node is unused */
+   unsigned int name_len;
+   unsigned int parent;
+   unsigned int first_child;
+   unsigned int next_sibling;
+   unsigned int prev_sibling;
+   unsigned int hash_next;    /* next node in the same bucket of 'children', or the next unused node */
+   unsigned int wd_next;      /* next node in the same bucket of 'wds' */
+   int wd;                    /* watch descriptor of a walked directory, -1 if it is not watched */
+   unsigned int mark;         /* last read of the parent directory that found the item */
+   unsigned char type;        /* enum dir_item_type */
+   unsigned char walked;      /* directory whose items are in the view */
+   unsigned char partial;     /* walked only as directories below it might match, its files are not in the view */
+   unsigned char reported;    /* changes to the item are reported */
+   unsigned char queued;      /* directory is waiting in 'queue' to be read */
+   unsigned char deferred;    /* directory is in the view at another path too, see dir_watch_read */
+   unsigned char read;        /* 'mtime' and 'ctime' are from the last time the directory was read */
+   struct timespec mtime;
+   struct timespec ctime;
+   ino_t inode;               /* of the directory when it was first read, the watch belongs to it */
+   dev_t device;
+};
+
+/* a change waiting to be reported, there is one per path and type in a batch */
+struct dir_watch_change
+{
+   char* path;
+   unsigned int path_len;
+   unsigned int hash_next;
+   unsigned char type;   /* enum dir_item_type */
+   unsigned char change; /* enum dir_change or DIR_WATCH_CHANGE_NONE */
+};
+
+struct dir_watch
+{
+   int fd;
+   struct dir_walk_filter filter;
+   struct dir_path_buffer path;
+
+   struct dir_watch_node* nodes; /* node 0 is the root */
+   unsigned int num_nodes;       /* used and unused */
+   unsigned int max_nodes;
+   unsigned int num_used;
+   unsigned int free_nodes;      /* list of unused nodes linked through 'hash_next' */
+   unsigned int* children;       /* buckets of the nodes by parent and name */
+   unsigned int* wds;            /* buckets of the watched directories by watch descriptor */
+   unsigned int num_buckets;     /* power of two, shared by 'children' and 'wds' */
+
+   unsigned int* queue;          /* stack of directories to read */
+   unsigned int queue_len;
+   unsigned int max_queue;
+   unsigned int mark;
+   unsigned int num_deferred;
+   int resync;                   /* directories read also queue the walked directories in them */
+
+   struct dir_watch_change* changes;
+   unsigned int num_changes;
+   unsigned int max_changes;
+   unsigned int* change_buckets;
+   unsigned int num_change_buckets;
+
+   /* while dir_watch_open walks the tree, items are reported right away as there is nothing to merge */
+   int seeding;
+   dir_walk_change_callback seed_callback;
+   void* seed_userdata;
+
+   int aborted;
+   int watch_failed;
+   int root_removed;
+   int overflow;
+
+   union
+   {
+      dir_uint64 align; /* of struct inotify_event */
+      char data[64 * 1024];
+   } events;
+};
+
+static unsigned int dir_watch_child_bucket( const struct dir_watch* watch, unsigned int parent, const char* name )
+{
+   return ( dir_snapshot_hash( name ) ^ ( parent * 2654435761u ) ) & ( watch->num_buckets - 1 );
+}
+
+static unsigned int dir_watch_wd_bucket( const struct dir_watch* watch, int wd )
+{
+   return ( (unsigned int)wd * 2654435761u ) & ( watch->num_buckets - 1 );
+}
+
+static unsigned int dir_watch_find_child( const struct dir_watch* watch, unsigned int parent, const char* name )
+{
+   unsigned int node = watch->children[dir_watch_child_bucket( watch, parent, name )];
+   while ( node != DIR_WATCH_NONE && ( watch->nodes[node].parent != parent || strcmp( watch->nodes[node].name, name ) != 0 ) )
+      node = watch->nodes[node].hash_next;
+   return node;
+}
+
+static unsigned int dir_watch_find_wd( const struct dir_watch* watch, int wd )
+{
+   unsigned int node = watch->wds[dir_watch_wd_bucket( watch, wd )];
+   while ( node != DIR_WATCH_NONE && watch->nodes[node].wd != wd )
+      node = watch->nodes[node].wd_next;
+   return node;
+}
+
+/* replace the buckets with 'num_buckets' new ones and insert all used nodes again, returns 0 if out of memory */
+static int dir_watch_rehash( struct dir_watch* watch, unsigned int num_buckets )
+{
+   unsigned int* buckets = (unsigned int*)DIRUTIL_MALLOC( 2 * num_buckets * sizeof( unsigned int ) );
+   unsigned int i, bucket;
+   if ( buckets == 0x0 )
+      return 0;
+
+   DIRUTIL_FREE( watch->children );
+   memset( buckets, 0xff, 2 * num_buckets * sizeof( unsigned int ) );
+   watch->children = buckets;
+   watch->wds = buckets + num_buckets;
+   watch->num_buckets = num_buckets;
+
+   for ( i = 0; i < watch->num_nodes; ++i )
+   {
+      struct dir_watch_node* node = &watch->nodes[i];
+      if ( node->name == 0x0 )
+         continue;
+      if ( node->parent != DIR_WATCH_NONE )
+      {
+         bucket = dir_watch_child_bucket( watch, node->parent, node->name );
+         node->hash_next = watch->children[bucket];
+         watch->children[bucket] = i;
+      }
+      if ( node->wd >= 0 )
+      {
+         bucket = dir_watch_wd_bucket( watch, node->wd );
+         node->wd_next = watch->wds[bucket];
+         watch->wds[bucket] = i;
+      }
+   }
+   return 1;
+}
+
+/* add item 'name' to directory 'parent' in the view, DIR_WATCH_NONE for the root. returns the new node or DIR_WATCH_NONE if out of memory */
+static unsigned int dir_watch_add_node( struct dir_watch* watch, unsigned int parent, const char* name, unsigned int name_len, unsigned int type )
+{
+   struct dir_watch_node* node;
+   unsigned int index;
+   char* node_name;
+
+   if ( watch->num_used >= watch->num_buckets && !dir_watch_rehash( watch, watch->num_buckets * 2 ) )
+      return DIR_WATCH_NONE;
+
+   if ( watch->free_nodes == DIR_WATCH_NONE && watch->num_nodes == watch->max_nodes )
+   {
+      unsigned int max_nodes = watch->max_nodes ? watch->max_nodes * 2 : 256;
+      struct dir_watch_node* nodes = (struct dir_watch_node*)DIRUTIL_MALLOC( max_nodes * sizeof( struct dir_watch_node ) );
+      if ( nodes == 0x0 )
+         return DIR_WATCH_NONE;
+      if ( watch->num_nodes )
+         memcpy( nodes, watch->nodes, watch->num_nodes * sizeof( struct dir_watch_node ) );
+      DIRUTIL_FREE( watch->nodes );
+      watch->nodes = nodes;
+      watch->max_nodes = max_nodes;
+   }
+
+   node_name = (char*)DIRUTIL_MALLOC( name_len + 1 );
+   if ( node_name == 0x0 )
+      return DIR_WATCH_NONE;
+   memcpy( node_name, name, name_len );
+   node_name[name_len] = '\0';
+
+   if ( watch->free_nodes != DIR_WATCH_NONE )
+   {
+      index = watch->free_nodes;
+      watch->free_nodes = watch->nodes[index].hash_next;
+   }
+   else
+      index = watch->num_nodes++;
+   ++watch->num_used;
+
+   node = &watch->nodes[index];
+   memset( node, 0, sizeof( struct dir_watch_node ) );
+   node->name = node_name;
+   node->name_len = name_len;
+   node->parent = parent;
+   node->first_child = DIR_WATCH_NONE;
+   node->next_sibling = DIR_WATCH_NONE;
+   node->prev_sibling = DIR_WATCH_NONE;
+   node->hash_next = DIR_WATCH_NONE;
+   node->wd_next = DIR_WATCH_NONE;
+   node->wd = -1;
+   node->mark = watch->mark;
+   node->type = (unsigned char)type;
+
+   if ( parent != DIR_WATCH_NONE )
+   {
+      unsigned int bucket = dir_watch_child_bucket( watch, parent, node_name );
+      node->hash_next = watch->children[bucket];
+      watch->children[bucket] = index;
+      node->next_sibling = watch->nodes[parent].first_child;
+      if ( node->next_sibling != DIR_WATCH_NONE )
+         watch->nodes[node->next_sibling].prev_sibling = index;
+      watch->nodes[parent].first_child = index;
+   }
+   return index;
+}
+
+static void dir_watch_unlink_wd( struct dir_watch* watch, unsigned int index )
+{
+   unsigned int* link = &watch->wds[dir_watch_wd_bucket( watch, watch->nodes[index].wd )];
+   while ( *link != index )
+      link = &watch->nodes[*link].wd_next;
+   *link = watch->nodes[index].wd_next;
+   watch->nodes[index].wd = -1;
+}
+
+static void dir_watch_set_wd( struct dir_watch* watch, unsigned int index, int wd )
+{
+   unsigned int bucket = dir_watch_wd_bucket( watch, wd );
+   watch->nodes[index].wd = wd;
+   watch->nodes[index].wd_next = watch->wds[bucket];
+   watch->wds[bucket] = index;
+}
+
+static void dir_watch_free_node( struct dir_watch* watch, unsigned int index )
+{
+   struct dir_watch_node* node = &watch->nodes[index];
+
+   if ( node->wd >= 0 )
+   {
+      /* fails if the directory was deleted, the kernel removed the watch already */
+      inotify_rm_watch( watch->fd, node->wd );
+      dir_watch_unlink_wd( watch, index );
+   }
+
+   if ( node->parent != DIR_WATCH_NONE )
+   {
+      unsigned int* link = &watch->children[dir_watch_child_bucket( watch, node->parent, node->name )];
+      while ( *link != index )
+         link = &watch->nodes[*link].hash_next;
+      *link = node->hash_next;
+
+      if ( node->prev_sibling != DIR_WATCH_NONE )
+         watch->nodes[node->prev_sibling].next_sibling = node->next_sibling;
+      else
+         watch->nodes[node->parent].first_child = node->next_sibling;
+      if ( node->next_sibling != DIR_WATCH_NONE )
+         watch->nodes[node->next_sibling].prev_sibling = node->prev_sibling;
+   }
+
+   watch->num_deferred -= node->deferred;
+   DIRUTIL_FREE( node->name );
+   node->name = 0x0;
+   node->queued = 0;
+   node->hash_next = watch->free_nodes;
+   watch->free_nodes = index;
+   --watch->num_used;
+}
+
+/* write the full path of node 'index' to watch->path, returns its length or 0 if out of memory */
+static unsigned int dir_watch_path( struct dir_watch* watch, unsigned int index )
+{
+   unsigned int size = 0, pos, node;
+   char* path;
+
+   for ( node = index; node != DIR_WATCH_NONE; node = watch->nodes[node].parent )
+      size += watch->nodes[node].name_len + 1; /* 1 == separator or null-terminator */
+   if ( !dir_path_buffer_reserve( &watch->path, size ) )
+      return 0;
+
+   path = watch->path.data;
+   pos = size - 1;
+   path[pos] = '\0';
+   for ( node = index; node != DIR_WATCH_NONE; node = watch->nodes[node].parent )
+   {
+      pos -= watch->nodes[node].name_len;
+      memcpy( path + pos, watch->nodes[node].name, watch->nodes[node].name_len );
+      if ( pos )
+         path[--pos] = watch->filter.slash;
+   }
+   return size - 1;
+}
+
+/* merge a change of node 'index' with the earlier changes of the same item in the batch, returns 0 if out of memory or aborted by callback */
+static int dir_watch_record( struct dir_watch* watch, unsigned int index, enum dir_change change )
+{
+   unsigned int type = watch->nodes[index].type;
+   struct dir_watch_change* record;
+   unsigned int path_len, bucket, i;
+
+   if ( !watch->nodes[index].reported || ( watch->seeding && watch->seed_callback == 0x0 ) )
+      return 1;
+
+   path_len = dir_watch_path( watch, index );
+   if ( !path_len )
+      return 0;
+
+   if ( watch->seeding )
+   {
+      unsigned int path_offset = ( watch->filter.flags & DIR_WALK_ROOT_RELATIVE_PATHS ) ? ( watch->filter.root_path_len + 1 ) : 0;
+      struct dir_item_info info;
+      memset( &info, 0, sizeof( info ) );
+      if ( dir_walk_result_is_abort( watch->seed_callback( watch->path.data + path_offset, path_len - path_offset, (enum dir_item_type)type,
+                                                           change, &info, watch->seed_userdata ) ) )
+         watch->aborted = 1;
+      return !watch->aborted;
+   }
+
+   if ( watch->num_changes >= watch->num_change_buckets )
+   {
+      unsigned int num_buckets = watch->num_change_buckets ? watch->num_change_buckets * 2 : 64;
+      unsigned int* buckets = (unsigned int*)DIRUTIL_MALLOC( num_buckets * sizeof( unsigned int ) );
+      if ( buckets == 0x0 )
+         return 0;
+      memset( buckets, 0xff, num_buckets * sizeof( unsigned int ) );
+      for ( i = 0; i < watch->num_changes; ++i )
+      {
+         bucket = ( dir_snapshot_hash( watch->changes[i].path ) ^ watch->changes[i].type ) & ( num_buckets - 1 );
+         watch->changes[i].hash_next = buckets[bucket];
+         buckets[bucket] = i;
+      }
+      DIRUTIL_FREE( watch->change_buckets );
+      watch->change_buckets = buckets;
+      watch->num_change_buckets = num_buckets;
+   }
+
+   bucket = ( dir_snapshot_hash( watch->path.data ) ^ type ) & ( watch->num_change_buckets - 1 );
+   for ( i = watch->change_buckets[bucket]; i != DIR_WATCH_NONE; i = watch->changes[i].hash_next )
+   {
+      record = &watch->changes[i];
+      if ( record->type != type || record->path_len != path_len || memcmp( record->path, watch->path.data, path_len ) != 0 )
+         continue;
+
+      switch ( record->change )
+      {
+      case DIR_CHANGE_ADDED:
+         if ( change == DIR_CHANGE_REMOVED )
+            record->change = DIR_WATCH_CHANGE_NONE;
+         break;
+      case DIR_CHANGE_REMOVED:
+         /* what is in a directory that came back is reported by itself */
+         if ( change == DIR_CHANGE_ADDED )
+            record->change = type == DIR_ITEM_DIR ? DIR_WATCH_CHANGE_NONE : DIR_CHANGE_MODIFIED;
+         break;
+      case DIR_CHANGE_MODIFIED:
+         if ( change == DIR_CHANGE_REMOVED )
+            record->change = DIR_CHANGE_REMOVED;
+         break;
+      default:
+         record->change = (unsigned char)change;
+         break;
+      }
+      return 1;
+   }
+
+   if ( watch->num_changes == watch->max_changes )
+   {
+      unsigned int max_changes = watch->max_changes ? watch->max_changes * 2 : 64;
+      struct dir_watch_change* changes = (struct dir_watch_change*)DIRUTIL_MALLOC( max_changes * sizeof( struct dir_watch_change ) );
+      if ( changes == 0x0 )
+         return 0;
+      if ( watch->num_changes )
+         memcpy( changes, watch->changes, watch->num_changes * sizeof( struct dir_watch_change ) );
+      DIRUTIL_FREE( watch->changes );
+      watch->changes = changes;
+      watch->max_changes = max_changes;
+   }
+
+   record = &watch->changes[watch->num_changes];
+   record->path = (char*)DIRUTIL_MALLOC( path_len + 1 );
+   if ( record->path == 0x0 )
+      return 0;
+   memcpy( record->path, watch->path.data, path_len + 1 );
+   record->path_len = path_len;
+   record->type = (unsigned char)type;
+   record->change = (unsigned char)change;
+   record->hash_next = watch->change_buckets[bucket];
+   watch->change_buckets[bucket] = watch->num_changes++;
+   return 1;
+}
+
+/* report the changes of the batch in the order they were first recorded and start a new batch, returns 0 if aborted by callback */
+static int dir_watch_report( struct dir_watch* watch, dir_walk_change_callback callback, void* userdata )
+{
+   unsigned int path_offset = ( watch->filter.flags & DIR_WALK_ROOT_RELATIVE_PATHS ) ? ( watch->filter.root_path_len + 1 ) : 0;
+   struct dir_item_info info;
+   unsigned int i;
+
+   memset( &info, 0, sizeof( info ) );
+   for ( i = 0; i < watch->num_changes; ++i )
+   {
+      struct dir_watch_change* record = &watch->changes[i];
+      if ( !watch->aborted && record->change != DIR_WATCH_CHANGE_NONE &&
+           dir_walk_result_is_abort( callback( record->path + path_offset, record->path_len - path_offset, (enum dir_item_type)record->type,
+                                               (enum dir_change)record->change, &info, userdata ) ) )
+         watch->aborted = 1;
+      DIRUTIL_FREE( record->path );
+   }
+
+   watch->num_changes = 0;
+   if ( watch->change_buckets )
+      memset( watch->change_buckets, 0xff, watch->num_change_buckets * sizeof( unsigned int ) );
+   return !watch->aborted;
+}
+
+/* remove node 'index' and everything below it from the view, the items in a directory are removed before the directory */
+static int dir_watch_remove( struct dir_watch* watch, unsigned int index )
+{
+   unsigned int node = index;
+   for ( ;; )
+   {
+      unsigned int parent;
+      while ( watch->nodes[node].first_child != DIR_WATCH_NONE )
+         node = watch->nodes[node].first_child;
+
+      parent = watch->nodes[node].parent;
+      if ( !dir_watch_record( watch, node, DIR_CHANGE_REMOVED ) )
+         return 0;
+      dir_watch_free_node( watch, node );
+      if ( node == index )
+         return 1;
+      node = parent;
+   }
+}
+
+/* the watched directory itself was removed or moved, everything in it is reported removed and the watch ends */
+static int dir_watch_remove_root( struct dir_watch* watch )
+{
+   if ( watch->nodes[0].wd >= 0 )
+   {
+      inotify_rm_watch( watch->fd, watch->nodes[0].wd );
+      dir_watch_unlink_wd( watch, 0 );
+   }
+   watch->root_removed = 1;
+   while ( watch->nodes[0].first_child != DIR_WATCH_NONE )
+      if ( !dir_watch_remove( watch, watch->nodes[0].first_child ) )
+         return 0;
+   return 1;
+}
+
+static int dir_watch_queue( struct dir_watch* watch, unsigned int index )
+{
+   if ( watch->nodes[index].queued )
+      return 1;
+
+   if ( watch->queue_len == watch->max_queue )
+   {
+      unsigned int max_queue = watch->max_queue ? watch->max_queue * 2 : 64;
+      unsigned int* queue = (unsigned int*)DIRUTIL_MALLOC( max_queue * sizeof( unsigned int ) );
+      if ( queue == 0x0 )
+         return 0;
+      if ( watch->queue_len )
+         memcpy( queue, watch->queue, watch->queue_len * sizeof( unsigned int ) );
+      DIRUTIL_FREE( watch->queue );
+      watch->queue = queue;
+      watch->max_queue = max_queue;
+   }
+   watch->queue[watch->queue_len++] = index;
+   watch->nodes[index].queued = 1;
+   return 1;
+}
+
+/* while resyncing, queue the walked directories in directory 'index' so that the whole view is compared top-down */
+static int dir_watch_queue_walked( struct dir_watch* watch, unsigned int index )
+{
+   unsigned int child;
+   if ( !watch->resync )
+      return 1;
+   for ( child = watch->nodes[index].first_child; child != DIR_WATCH_NONE; child = watch->nodes[child].next_sibling )
+      if ( watch->nodes[child].walked && !dir_watch_queue( watch, child ) )
+         return 0;
+   return 1;
+}
+
+/**
+ * add item 'name' in directory 'parent' to the view if a walk with the same flags and glob patterns would report or walk it,
+ * directories to walk are queued to be read. returns 0 if out of memory.
+ */
+static int dir_watch_add_item( struct dir_watch* watch, unsigned int parent, const char* name, int is_dir )
+{
+   const struct dir_walk_filter* filter = &watch->filter;
+   unsigned int name_len, path_len, index;
+   int walked = 0, partial = 0, reported;
+
+   if ( dir_walk_filter_ignore( filter, name, is_dir ) || ( !is_dir && watch->nodes[parent].partial ) )
+      return 1;
+
+   name_len = dir_strlen32( name );
+   if ( is_dir )
+   {
+      path_len = dir_watch_path( watch, parent );
+      if ( !path_len || !dir_path_buffer_reserve( &watch->path, path_len + name_len + 2 ) ) /* 2 == '/' + null-terminator */
+         return 0;
+      watch->path.data[path_len] = filter->slash;
+      memcpy( &watch->path.data[path_len + 1], name, name_len + 1 );
+
+      switch ( dir_walk_filter_match_directory( filter, watch->path.data, path_len + name_len + 1 ) )
+      {
+      case DIR_WALK_FILTER_SKIP:
+         return 1;
+      case DIR_WALK_FILTER_PARTIAL:
+         walked = partial = 1;
+         reported = 0;
+         break;
+      default:
+         walked = 1;
+         reported = ( filter->flags & DIR_WALK_ONLY_FILES ) == 0;
+         break;
+      }
+      if ( filter->flags & DIR_WALK_SINGLE_DIRECTORY )
+         walked = partial = 0;
+      if ( !walked && !reported )
+         return 1;
+   }
+   else
+   {
+      reported = ( filter->flags & DIR_WALK_ONLY_DIRECTORIES ) == 0 && dir_walk_filter_match_file( filter, name, name_len );
+      if ( !reported )
+         return 1;
+   }
+
+   index = dir_watch_add_node( watch, parent, name, name_len, is_dir ? DIR_ITEM_DIR : DIR_ITEM_FILE );
+   if ( index == DIR_WATCH_NONE )
+      return 0;
+   watch->nodes[index].walked = (unsigned char)walked;
+   watch->nodes[index].partial = (unsigned char)partial;
+   watch->nodes[index].reported = (unsigned char)reported;
+
+   if ( !dir_watch_record( watch, index, DIR_CHANGE_ADDED ) )
+      return 0;
+   return !walked || dir_watch_queue( watch, index );
+}
+
+/* replace node 'index' in the view with the item now at its path */
+static int dir_watch_replace( struct dir_watch* watch, unsigned int index )
+{
+   unsigned int parent = watch->nodes[index].parent;
+   unsigned int name_len = watch->nodes[index].name_len;
+   char* name;
+   int ok;
+
+   if ( index == 0 )
+      return dir_watch_remove_root( watch );
+
+   /* the name is freed with the node */
+   name = (char*)DIRUTIL_MALLOC( name_len + 1 );
+   if ( name == 0x0 )
+      return 0;
+   memcpy( name, watch->nodes[index].name, name_len + 1 );
+   ok = dir_watch_remove( watch, index ) && dir_watch_add_item( watch, parent, name, 1 );
+   DIRUTIL_FREE( name );
+   return ok;
+}
+
+/**
+ * read walked directory 'index' and bring its items in the view up to date, directories that were read before are
+ * skipped if their mtime and ctime are the same. the directory is watched before it is read, so that anything added
+ * after it was read is reported by the watch. returns 0 if out of memory or aborted by callback.
+ *
+ * the view can be behind the tree by the events not yet handled, so the path of the directory might lead to another
+ * directory that is already watched at its own path in the view. one of the paths is then removed by the events to come
+ * and the directory is left unread until that has happened, see dir_watch_read_deferred.
+ */
+static int dir_watch_read( struct dir_watch* watch, unsigned int index )
+{
+   struct dir_walk_reader reader;
+   struct stat s;
+   unsigned int path_len = dir_watch_path( watch, index );
+   unsigned int mark, child, next;
+   const char* item_name;
+   int is_dir, first_read, ok = 1;
+
+   if ( !path_len )
+      return 0;
+
+   if ( watch->nodes[index].wd < 0 )
+   {
+      int wd = inotify_add_watch( watch->fd, watch->path.data, DIR_WATCH_EVENTS | ( index ? IN_DONT_FOLLOW : 0 ) );
+      if ( wd < 0 )
+      {
+         /* a directory that is already gone is reported removed when the event of its parent is read */
+         if ( errno != ENOENT && errno != ENOTDIR )
+            watch->watch_failed = 1;
+         return 1;
+      }
+      if ( dir_watch_find_wd( watch, wd ) != DIR_WATCH_NONE )
+      {
+         watch->num_deferred += !watch->nodes[index].deferred;
+         watch->nodes[index].deferred = 1;
+         return 1;
+      }
+      watch->num_deferred -= watch->nodes[index].deferred;
+      watch->nodes[index].deferred = 0;
+      dir_watch_set_wd( watch, index, wd );
+   }
+
+   /* the events of the root being removed are lost when the queue overflows */
+   if ( dir_walk_reader_open( &reader, 0x0, 0x0, watch->path.data, path_len, watch->path.size, watch->filter.slash, 0 ) != DIR_ERROR_OK )
+      return index != 0 || dir_watch_remove_root( watch );
+
+   if ( fstat( dir_walk_reader_fd( &reader ), &s ) == 0 )
+   {
+      struct dir_watch_node* node = &watch->nodes[index];
+      if ( node->inode == 0 )
+      {
+         node->inode = s.st_ino;
+         node->device = s.st_dev;
+      }
+      else if ( node->inode != s.st_ino || node->device != s.st_dev )
+      {
+         /* the directory was moved away and another took its place while the events telling so were lost */
+         dir_walk_reader_close( &reader );
+         return dir_watch_replace( watch, index );
+      }
+      if ( node->read && node->mtime.tv_sec == s.st_mtim.tv_sec && node->mtime.tv_nsec == s.st_mtim.tv_nsec &&
+           node->ctime.tv_sec == s.st_ctim.tv_sec && node->ctime.tv_nsec == s.st_ctim.tv_nsec )
+      {
+         dir_walk_reader_close( &reader );
+         return dir_watch_queue_walked( watch, index );
+      }
+      node->mtime = s.st_mtim;
+      node->ctime = s.st_ctim;
+      /* a directory changed in the same timestamp tick as it is read keeps its times, so it is always read again */
+      node->read = s.st_mtim.tv_sec < time( 0x0 ) - DIR_SNAPSHOT_RACY_SECONDS && s.st_ctim.tv_sec < time( 0x0 ) - DIR_SNAPSHOT_RACY_SECONDS;
+   }
+
+   /* nothing to compare with when the directory is read the first time */
+   first_read = watch->nodes[index].first_child == DIR_WATCH_NONE;
+   mark = ++watch->mark;
+   while ( ok && dir_walk_reader_next( &reader, &item_name, &is_dir ) )
+   {
+      if ( is_dir == DIR_WALK_READER_TYPE_UNKNOWN && !dir_walk_reader_stat_is_dir( &reader, item_name, &is_dir ) )
+         continue;
+
+      child = first_read ? DIR_WATCH_NONE : dir_watch_find_child( watch, index, item_name );
+      if ( child != DIR_WATCH_NONE && watch->nodes[child].type != ( is_dir ? DIR_ITEM_DIR : DIR_ITEM_FILE ) )
+      {
+         ok = dir_watch_remove( watch, child );
+         child = DIR_WATCH_NONE;
+      }
+      if ( child != DIR_WATCH_NONE )
+         watch->nodes[child].mark = mark;
+      else if ( ok )
+         ok = dir_watch_add_item( watch, index, item_name, is_dir );
+   }
+   dir_walk_reader_close( &reader );
+
+   /* the entries that were not read would be taken as removed, read the directory again on the next poll */
+   if ( ok && reader.error )
+   {
+      watch->nodes[index].read = 0;
+      return dir_watch_queue_walked( watch, index );
+   }
+   if ( !ok )
+      return 0;
+
+   for ( child = watch->nodes[index].first_child; child != DIR_WATCH_NONE; child = next )
+   {
+      next = watch->nodes[child].next_sibling;
+      if ( watch->nodes[child].mark != mark && !dir_watch_remove( watch, child ) )
+         return 0;
+   }
+   return dir_watch_queue_walked( watch, index );
+}
+
+/* read the queued directories and the ones found in them, returns 0 if out of memory or aborted by callback */
+static int dir_watch_read_queued( struct dir_watch* watch )
+{
+   while ( watch->queue_len )
+   {
+      unsigned int index = watch->queue[--watch->queue_len];
+
+      /* removed while queued, or queued again when added after that */
+      if ( !watch->nodes[index].queued )
+         continue;
+      watch->nodes[index].queued = 0;
+
+      if ( !dir_watch_read( watch, index ) )
+         return 0;
+   }
+   return 1;
+}
+
+/* update the view by one event from the kernel, returns 0 if out of memory */
+static int dir_watch_handle( struct dir_watch* watch, const struct inotify_event* event )
+{
+   int is_dir = ( event->mask & IN_ISDIR ) != 0;
+   unsigned int dir, child;
+
+   if ( event->mask & IN_Q_OVERFLOW )
+   {
+      watch->overflow = 1;
+      return 1;
+   }
+
+   /* events queued before the directory was removed from the view */
+   dir = dir_watch_find_wd( watch, event->wd );
+   if ( dir == DIR_WATCH_NONE )
+      return 1;
+
+   if ( event->mask & IN_IGNORED )
+   {
+      dir_watch_unlink_wd( watch, dir );
+      return 1;
+   }
+
+   /* other directories are removed when the event of their parent is read */
+   if ( event->mask & ( IN_DELETE_SELF | IN_MOVE_SELF ) )
+      return dir != 0 || dir_watch_remove_root( watch );
+
+   /* the rest are about items in the directory */
+   if ( event->len == 0 )
+      return 1;
+
+   child = dir_watch_find_child( watch, dir, event->name );
+   if ( event->mask & ( IN_DELETE | IN_MOVED_FROM ) )
+      return child == DIR_WATCH_NONE || dir_watch_remove( watch, child );
+
+   if ( event->mask & ( IN_CREATE | IN_MOVED_TO ) )
+   {
+      if ( child != DIR_WATCH_NONE )
+      {
+         /* created items can already have been found by a read of the directory, files moved over others replace them */
+         if ( watch->nodes[child].type == DIR_ITEM_FILE && !is_dir )
+            return ( event->mask & IN_CREATE ) || dir_watch_record( watch, child, DIR_CHANGE_MODIFIED );
+         if ( watch->nodes[child].type == DIR_ITEM_DIR && is_dir && ( event->mask & IN_CREATE ) )
+            return watch->nodes[child].wd >= 0 || !watch->nodes[child].walked || ( dir_watch_queue( watch, child ) && dir_watch_read_queued( watch ) );
+         if ( !dir_watch_remove( watch, child ) )
+            return 0;
+      }
+      return dir_watch_add_item( watch, dir, event->name, is_dir ) && dir_watch_read_queued( watch );
+   }
+
+   /* IN_MODIFY, IN_ATTRIB and IN_CLOSE_WRITE */
+   if ( child != DIR_WATCH_NONE && watch->nodes[child].type == DIR_ITEM_FILE )
+      return dir_watch_record( watch, child, DIR_CHANGE_MODIFIED );
+   return 1;
+}
+
+/* handle all events that can be read without blocking, returns 0 if out of memory */
+static int dir_watch_handle_events( struct dir_watch* watch )
+{
+   for ( ;; )
+   {
+      ssize_t size = read( watch->fd, watch->events.data, sizeof( watch->events.data ) );
+      ssize_t offset = 0;
+      if ( size <= 0 )
+         return 1;
+
+      while ( offset < size )
+      {
+         const struct inotify_event* event = (const struct inotify_event*)( watch->events.data + offset );
+         if ( !dir_watch_handle( watch, event ) )
+            return 0;
+         offset += (ssize_t)( sizeof( struct inotify_event ) + event->len );
+      }
+   }
+}
+
+/* events were lost, read the watched directories that changed since they were read and compare them with the view */
+static int dir_watch_resync( struct dir_watch* watch )
+{
+   int ok;
+   watch->overflow = 0;
+   watch->resync = 1;
+   ok = dir_watch_queue( watch, 0 ) && dir_watch_read_queued( watch );
+   watch->resync = 0;
+   return ok;
+}
+
+/* read the directories left unread by dir_watch_read as they were in the view at another path, if that path is gone by now */
+static int dir_watch_read_deferred( struct dir_watch* watch )
+{
+   unsigned int i;
+   for ( i = 0; i < watch->num_nodes; ++i )
+      if ( watch->nodes[i].name && watch->nodes[i].deferred && !dir_watch_queue( watch, i ) )
+         return 0;
+   return dir_watch_read_queued( watch );
+}
+
+DIRUTIL_API void dir_watch_close( struct dir_watch* watch )
+{
+   unsigned int i;
+   if ( watch == 0x0 )
+      return;
+
+   for ( i = 0; i < watch->num_nodes; ++i )
+      DIRUTIL_FREE( watch->nodes[i].name );
+   for ( i = 0; i < watch->num_changes; ++i )
+      DIRUTIL_FREE( watch->changes[i].path );
+   DIRUTIL_FREE( watch->nodes );
+   DIRUTIL_FREE( watch->children );
+   DIRUTIL_FREE( watch->queue );
+   DIRUTIL_FREE( watch->changes );
+   DIRUTIL_FREE( watch->change_buckets );
+   dir_path_buffer_free( &watch->path );
+   dir_walk_filter_free( &watch->filter );
+   /* closing the inotify instance removes all watches */
+   close( watch->fd );
+   DIRUTIL_FREE( watch );
+}
+
+DIRUTIL_API enum dir_error dir_watch_open( const char* path, unsigned int flags, const char* optional_glob_directories, const char* optional_glob_files,
+   dir_walk_change_callback callback, void* userdata, struct dir_watch** watch )
+{
+   struct dir_watch* w = (struct dir_watch*)DIRUTIL_MALLOC( sizeof( struct dir_watch ) );
+   enum dir_error result = DIR_ERROR_OK;
+   unsigned int path_len;
+   int wd;
+
+   *watch = 0x0;
+   if ( w == 0x0 )
+      return DIR_ERROR_FAILED;
+
+   memset( w, 0, sizeof( struct dir_watch ) );
+   dir_path_buffer_init( &w->path );
+   w->free_nodes = DIR_WATCH_NONE;
+   path_len = dir_walk_root_path( path, dir_walk_slash_by_flags( flags ), &w->path );
+   if ( !path_len || dir_walk_filter_init( &w->filter, flags, path_len, optional_glob_directories, optional_glob_files ) != DIR_ERROR_OK )
+   {
+      dir_path_buffer_free( &w->path );
+      DIRUTIL_FREE( w );
+      return DIR_ERROR_FAILED;
+   }
+
+   w->fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+   if ( w->fd < 0 || !dir_watch_rehash( w, 256 ) ||
+        dir_watch_add_node( w, DIR_WATCH_NONE, w->path.data, path_len, DIR_ITEM_DIR ) == DIR_WATCH_NONE )
+   {
+      dir_watch_close( w );
+      return DIR_ERROR_FAILED;
+   }
+   w->nodes[0].walked = 1;
+
+   /* the root is watched here to tell a path that can not be read from one that can not be watched */
+   wd = inotify_add_watch( w->fd, w->path.data, DIR_WATCH_EVENTS );
+   if ( wd < 0 )
+   {
+      result = errno == ENOENT || errno == ENOTDIR ? DIR_ERROR_PATH_DO_NOT_EXIST : DIR_ERROR_FAILED;
+      dir_watch_close( w );
+      return result;
+   }
+   dir_watch_set_wd( w, 0, wd );
+
+   w->seeding = 1;
+   w->seed_callback = callback;
+   w->seed_userdata = userdata;
+   if ( !dir_watch_queue( w, 0 ) || !dir_watch_read_queued( w ) )
+      result = w->aborted ? DIR_ERROR_ABORTED : DIR_ERROR_FAILED;
+   else if ( w->watch_failed )
+      result = DIR_ERROR_FAILED;
+   w->seeding = 0;
+
+   if ( result != DIR_ERROR_OK )
+   {
+      dir_watch_close( w );
+      return result;
+   }
+   *watch = w;
+   return DIR_ERROR_OK;
+}
+
+DIRUTIL_API int dir_watch_fd( const struct dir_watch* watch )
+{
+   return watch->fd;
+}
+
+DIRUTIL_API enum dir_error dir_watch_poll( struct dir_watch* watch, int timeout_ms, dir_walk_change_callback callback, void* userdata )
+{
+   struct pollfd pfd;
+   unsigned int round;
+   int ok = 1;
+
+   if ( watch->root_removed )
+      return DIR_ERROR_PATH_DO_NOT_EXIST;
+
+   pfd.fd = watch->fd;
+   pfd.events = POLLIN;
+   if ( poll( &pfd, 1, timeout_ms ) <= 0 )
+      return DIR_ERROR_OK;
+
+   /* storms of events, e.g. a file written in many small chunks, end up as one change */
+   for ( round = 0; round < DIR_WATCH_MAX_ROUNDS; ++round )
+   {
+      ok = dir_watch_handle_events( watch );
+      if ( !ok || watch->root_removed || poll( &pfd, 1, DIRUTIL_WATCH_COALESCE_MS ) <= 0 )
+         break;
+   }
+
+   if ( ok && watch->overflow && !watch->root_removed )
+      ok = dir_watch_resync( watch );
+   if ( ok && watch->num_deferred )
+      ok = dir_watch_read_deferred( watch );
+
+   watch->aborted = 0;
+   if ( !dir_watch_report( watch, callback, userdata ) )
+      return DIR_ERROR_ABORTED;
+   if ( !ok )
+      return DIR_ERROR_FAILED;
+   if ( watch->root_removed )
+      return DIR_ERROR_PATH_DO_NOT_EXIST;
+   if ( watch->watch_failed )
+   {
+      watch->watch_failed = 0;
+      return DIR_ERROR_FAILED;
+   }
+   return DIR_ERROR_OK;
+}
+
+#endif
+
+#if !defined( DIRUTIL_NO_THREADS )
+
+#if defined( _WIN32 )
+   typedef CRITICAL_SECTION dir_mutex;
+   typedef CONDITION_VARIABLE dir_cond;
+   typedef HANDLE dir_thread;
+   #define DIR_THREAD_ENTRY( name, arg ) static DWORD WINAPI name( LPVOID arg )
+   #define DIR_THREAD_RETURN return 0
+
+   static void dir_mutex_init( dir_mutex* m )             { InitializeCriticalSection( m ); }
+   static void dir_mutex_destroy( dir_mutex* m )          { DeleteCriticalSection( m ); }
+   static void dir_mutex_lock( dir_mutex* m )             { EnterCriticalSection( m ); }
+   static void dir_mutex_unlock( dir_mutex* m )           { LeaveCriticalSection( m ); }
+   static void dir_cond_init( dir_cond* c )               { InitializeConditionVariable( c ); }
+   static void dir_cond_destroy( dir_cond* c )            { (void)c; }
+   static void dir_cond_wait( dir_cond* c, dir_mutex* m ) { SleepConditionVariableCS( c, m, INFINITE ); }
+   static void dir_cond_signal( dir_cond* c )             { WakeConditionVariable( c ); }
+   static void dir_cond_broadcast( dir_cond* c )          { WakeAllConditionVariable( c ); }
+
+   static int dir_thread_create( dir_thread* t, LPTHREAD_START_ROUTINE entry, void* arg )
+   {
+      *t = CreateThread( 0x0, 0, entry, arg, 0, 0x0 );
+      return *t != 0x0;
+   }
+
+   static void dir_thread_join( dir_thread t )
+   {
+      WaitForSingleObject( t, INFINITE );
+      CloseHandle( t );
+   }
+
+   static unsigned int dir_thread_hardware_concurrency( void )
+   {
+      SYSTEM_INFO si;
+      GetSystemInfo( &si );
+      return (unsigned int)si.dwNumberOfProcessors;
+   }
+
+   /* returns the new value */
+   static long dir_atomic_add( volatile long* value, long add ) { return InterlockedExchangeAdd( value, add ) + add; }
+   static long dir_atomic_load( volatile long* value )          { return *value; /* aligned volatile reads are atomic with msvc */ }
+   static void dir_atomic_store( volatile long* value, long v ) { InterlockedExchange( value, v ); }
+   static dir_uint64 dir_atomic_add64( volatile dir_uint64* value, dir_uint64 add ) { return (dir_uint64)InterlockedExchangeAdd64( (volatile LONG64*)value, (LONG64)add ) + add; }
+#else
+   #include <pthread.h>
+
+   typedef pthread_mutex_t dir_mutex;
+   typedef pthread_cond_t dir_cond;
+   typedef pthread_t dir_thread;
+   #define DIR_THREAD_ENTRY( name, arg ) static void* name( void* arg )
+   #define DIR_THREAD_RETURN return 0x0
+
+   static void dir_mutex_init( dir_mutex* m )             { pthread_mutex_init( m, 0x0 ); }
+   static void dir_mutex_destroy( dir_mutex* m )          { pthread_mutex_destroy( m ); }
+   static void dir_mutex_lock( dir_mutex* m )             { pthread_mutex_lock( m ); }
+   static void dir_mutex_unlock( dir_mutex* m )           { pthread_mutex_unlock( m ); }
+   static void dir_cond_init( dir_cond* c )               { pthread_cond_init( c, 0x0 ); }
+   static void dir_cond_destroy( dir_cond* c )            { pthread_cond_destroy( c ); }
+   static void dir_cond_wait( dir_cond* c, dir_mutex* m ) { pthread_cond_wait( c, m ); }
+   static void dir_cond_signal( dir_cond* c )             { pthread_cond_signal( c ); }
+   static void dir_cond_broadcast( dir_cond* c )          { pthread_cond_broadcast( c ); }
+
+   static int dir_thread_create( dir_thread* t, void* ( *entry )( void* ), void* arg )
+   {
+      return pthread_create( t, 0x0, entry, arg ) == 0;
+   }
+
+   static void dir_thread_join( dir_thread t )
+   {
+      pthread_join( t, 0x0 );
+   }
+
+   static unsigned int dir_thread_hardware_concurrency( void )
+   {
+      long n = sysconf( _SC_NPROCESSORS_ONLN );
+      return n > 0 ? (unsigned int)n : 1;
+   }
+
+   /* returns the new value */
+   static long dir_atomic_add( volatile long* value, long add ) { return __sync_add_and_fetch( value, add ); }
+   static dir_uint64 dir_atomic_add64( volatile dir_uint64* value, dir_uint64 add ) { return __sync_add_and_fetch( value, add ); }
+   #if defined( __ATOMIC_RELAXED )
+      static long dir_atomic_load( volatile long* value )          { return __atomic_load_n( value, __ATOMIC_RELAXED ); }
+      static void dir_atomic_store( volatile long* value, long v ) { __atomic_store_n( value, v, __ATOMIC_RELEASE ); }
+   #else
+      static long dir_atomic_load( volatile long* value )          { return __sync_fetch_and_add( value, 0 ); }
+      static void dir_atomic_store( volatile long* value, long v ) { __sync_lock_test_and_set( value, v ); }
+   #endif
+#endif
+
+/*
+   parallel walk engine.
+
+   every directory in the walk is a node that is pushed to the deque of the worker that found it, workers
+   pop nodes from the back of their own deque and steal from the front of the other workers deques when
+   they run out of work.
+
+   a node keeps its directory open until it is completed, that is until it has been read and all of
+   its sub-directories are completed, so that sub-directories can be opened relative to it. 'pending'
+   counts the read of the directory itself plus all not yet completed sub-directories.
+
+   the actual work done for each item and directory is decided by the 'visit' and 'complete' hooks.
+*/
+struct dir_pwalk;
+struct dir_pwalk_worker;
+
+struct dir_pwalk_node
+{
+   struct dir_pwalk_node* parent;
+   volatile long pending;
+   struct dir_walk_reader reader;
+   int is_open;
+   int not_walked;           /* stopped by DIR_WALK_MAX_DEPTH, DIR_WALK_SAME_FILESYSTEM or DIR_WALK_FOLLOW_SYMLINKS, completed without being opened */
+   int visit_result;         /* value returned by 'visit' for the directory, 0 for the root-directory */
+   unsigned int depth;       /* 0 for the root-directory */
+   struct dir_walk_dir_id id; /* DIR_WALK_FOLLOW_SYMLINKS */
+   void* extra;              /* 'node_extra_size' bytes of zero-initialized data for the hooks */
+   unsigned int path_len;    /* full path to directory, with the root-directory as base */
+   unsigned int name_offset; /* offset of the directory name in 'path' */
+   char path[1];
+};
+
+/**
+ * invoked for each item in a directory.
+ * @param dir the directory being read.
+ * @param item_name name of the item.
+ * @param path_len length of the full path to the item, stored in 'worker->path'.
+ * @return non-zero if the item is a directory that should be walked, stored in 'visit_result' of the directory node.
+ */
+typedef int ( *dir_pwalk_visit_func )( struct dir_pwalk_worker* worker, struct dir_pwalk_node* dir, const char* item_name, unsigned int path_len, int is_dir );
+
+/* invoked when directory and all its sub-directories is completed, the directory itself is closed but its parent is still open. */
+typedef void ( *dir_pwalk_complete_func )( struct dir_pwalk_worker* worker, struct dir_pwalk_node* dir );
+
+struct dir_pwalk_worker
+{
+   struct dir_pwalk* walk;
+   unsigned int index;
+   int started;
+   dir_thread thread;
+
+   dir_mutex lock;
+   struct dir_pwalk_node** nodes; /* valid nodes in range [top, bottom) */
+   unsigned int top;
+   unsigned int bottom;
+   unsigned int capacity;
+
+   struct dir_path_buffer path; /* full path of the current item */
+};
+
+struct dir_pwalk
+{
+   struct dir_walk_filter filter;
+   dir_pwalk_visit_func visit;
+   dir_pwalk_complete_func complete;
+   void* userdata;
+   unsigned int node_extra_size;
+
+   struct dir_pwalk_worker* workers;
+   unsigned int num_workers;
+
+   dir_mutex lock;
+   dir_cond wakeup;
+   unsigned int sleepers;
+   volatile long queued;
+   volatile long aborted;
+   int done;
+   enum dir_error result;
+};
+
+static struct dir_pwalk_node* dir_pwalk_node_alloc( struct dir_pwalk* walk, struct dir_pwalk_node* parent, const char* path, unsigned int path_len, unsigned int name_offset )
+{
+   /* extra-data is placed after the path, aligned for any type */
+   unsigned int extra_offset = ( (unsigned int)sizeof( struct dir_pwalk_node ) + path_len + 15 ) & ~15u;
+   struct dir_pwalk_node* node = (struct dir_pwalk_node*)DIRUTIL_MALLOC( extra_offset + walk->node_extra_size );
+   if ( node == 0x0 )
+      return 0x0;
+
+   node->parent = parent;
+   node->pending = 1;
+   node->is_open = 0;
+   node->not_walked = 0;
+   node->visit_result = 0;
+   node->depth = parent ? parent->depth + 1 : 0;
+   node->extra = (char*)node + extra_offset;
+   node->path_len = path_len;
+   node->name_offset = name_offset;
+   memcpy( node->path, path, path_len );
+   node->path[path_len] = '\0';
+   memset( node->extra, 0, walk->node_extra_size );
+   return node;
+}
+
+static int dir_pwalk_push( struct dir_pwalk_worker* worker, struct dir_pwalk_node* node )
+{
+   struct dir_pwalk* walk = worker->walk;
+
+   dir_mutex_lock( &worker->lock );
+   if ( worker->bottom == worker->capacity )
+   {
+      unsigned int count = worker->bottom - worker->top;
+      if ( worker->top > worker->capacity / 2 )
+         memmove( worker->nodes, worker->nodes + worker->top, count * sizeof( struct dir_pwalk_node* ) );
+      else
+      {
+         unsigned int capacity = worker->capacity ? worker->capacity * 2 : 64;
+         struct dir_pwalk_node** nodes = (struct dir_pwalk_node**)DIRUTIL_MALLOC( capacity * sizeof( struct dir_pwalk_node* ) );
+         if ( nodes == 0x0 )
+         {
+            dir_mutex_unlock( &worker->lock );
+            return 0;
+         }
+         if ( count )
+            memcpy( nodes, worker->nodes + worker->top, count * sizeof( struct dir_pwalk_node* ) );
+         DIRUTIL_FREE( worker->nodes );
+         worker->nodes = nodes;
+         worker->capacity = capacity;
+      }
+      worker->top = 0;
+      worker->bottom = count;
+   }
+   worker->nodes[worker->bottom++] = node;
+   dir_mutex_unlock( &worker->lock );
+
+   dir_atomic_add( &walk->queued, 1 );
+
+   /* taking the lock here pairs with the check of 'queued' before sleeping so that no wakeup is lost */
+   if ( walk->num_workers > 1 )
+   {
+      dir_mutex_lock( &walk->lock );
+      if ( walk->sleepers )
+         dir_cond_signal( &walk->wakeup );
+      dir_mutex_unlock( &walk->lock );
+   }
+   return 1;
+}
+
+/* pop from the back of own deque, or steal from the front of the others */
+static struct dir_pwalk_node* dir_pwalk_pop( struct dir_pwalk_worker* worker )
+{
+   struct dir_pwalk* walk = worker->walk;
+   struct dir_pwalk_node* node = 0x0;
+   unsigned int i;
+
+   dir_mutex_lock( &worker->lock );
+   if ( worker->bottom != worker->top )
+      node = worker->nodes[--worker->bottom];
+   dir_mutex_unlock( &worker->lock );
+
+   for ( i = 1; node == 0x0 && i < walk->num_workers; ++i )
+   {
+      struct dir_pwalk_worker* victim = &walk->workers[( worker->index + i ) % walk->num_workers];
+      dir_mutex_lock( &victim->lock );
+      if ( victim->bottom != victim->top )
+         node = victim->nodes[victim->top++];
+      dir_mutex_unlock( &victim->lock );
+   }
+
+   if ( node )
+      dir_atomic_add( &walk->queued, -1 );
+   return node;
+}
+
+/* record error as result of the walk, unless an error is already recorded, and optionally stop the walk */
+static void dir_pwalk_fail( struct dir_pwalk* walk, enum dir_error error, int abort )
+{
+   dir_mutex_lock( &walk->lock );
+   if ( walk->result == DIR_ERROR_OK )
+      walk->result = error;
+   if ( abort )
+      dir_atomic_store( &walk->aborted, 1 );
+   dir_mutex_unlock( &walk->lock );
+}
+
+/* drop one reference to node and complete all directories, bottom-up, that has no more pending work */
+static void dir_pwalk_release( struct dir_pwalk_worker* worker, struct dir_pwalk_node* node )
+{
+   struct dir_pwalk* walk = worker->walk;
+   while ( node && dir_atomic_add( &node->pending, -1 ) == 0 )
+   {
+      struct dir_pwalk_node* parent = node->parent;
+
+      if ( node->is_open )
+         dir_walk_reader_close( &node->reader );
+
+      if ( walk->complete )
+         walk->complete( worker, node );
+
+      DIRUTIL_FREE( node );
+
+      if ( parent == 0x0 )
+      {
+         dir_mutex_lock( &walk->lock );
+         walk->done = 1;
+         dir_cond_broadcast( &walk->wakeup );
+         dir_mutex_unlock( &walk->lock );
+      }
+      node = parent;
+   }
+}
+
+/* DIR_WALK_MAX_DEPTH, DIR_WALK_SAME_FILESYSTEM and DIR_WALK_FOLLOW_SYMLINKS for a sub-directory, as dir_walk_filter_enter with the directories above it in its parents */
+static int dir_pwalk_enter( struct dir_pwalk* walk, struct dir_pwalk_node* node )
+{
+   const struct dir_walk_filter* filter = &walk->filter;
+#if !defined( _WIN32 )
+   const struct dir_pwalk_node* parent;
+   struct stat s;
+#endif
+
+   if ( filter->max_depth && node->depth >= filter->max_depth )
+      return 0;
+
+#if defined( _WIN32 )
+   return 1;
+#else
+   if ( !( filter->flags & ( DIR_WALK_SAME_FILESYSTEM | DIR_WALK_FOLLOW_SYMLINKS ) ) )
+      return 1;
+
+   /* the parent is open until all its sub-directories are completed */
+   if ( fstatat( dir_walk_reader_fd( &node->parent->reader ), node->path + node->name_offset, &s, ( filter->flags & DIR_WALK_FOLLOW_SYMLINKS ) ? 0 : AT_SYMLINK_NOFOLLOW ) != 0 )
+      return 0;
+   if ( ( filter->flags & DIR_WALK_SAME_FILESYSTEM ) && (dir_uint64)s.st_dev != filter->root_device )
+      return 0;
+   if ( !( filter->flags & DIR_WALK_FOLLOW_SYMLINKS ) )
+      return 1;
+
+   /* the parents are alive until all their sub-directories are completed */
+   node->id.device = (dir_uint64)s.st_dev;
+   node->id.inode = (dir_uint64)s.st_ino;
+   for ( parent = node->parent; parent; parent = parent->parent )
+      if ( dir_walk_dir_id_equal( &parent->id, &node->id ) )
+         return 0;
+   return 1;
+#endif
+}
+
+static void dir_pwalk_process( struct dir_pwalk_worker* worker, struct dir_pwalk_node* node )
+{
+   struct dir_pwalk* walk = worker->walk;
+   char* path_buffer;
+   unsigned int path_len = node->path_len;
+   char slash = walk->filter.slash;
+   const char* item_name;
+   int is_dir;
+   enum dir_error err;
+
+   if ( dir_atomic_load( &walk->aborted ) )
+   {
+      dir_pwalk_release( worker, node );
+      return;
+   }
+
+   /* room for the separator and '*' appended by the reader on windows */
+   if ( !dir_path_buffer_reserve( &worker->path, path_len + 3 ) )
+   {
+      dir_pwalk_fail( walk, DIR_ERROR_FAILED, 1 );
+      dir_pwalk_release( worker, node );
+      return;
+   }
+   path_buffer = worker->path.data;
+   memcpy( path_buffer, node->path, path_len + 1 );
+
+   /* the directory is still reported, as a directory that could not be opened */
+   if ( node->parent && !dir_pwalk_enter( walk, node ) )
+   {
+      node->not_walked = 1;
+      dir_pwalk_release( worker, node );
+      return;
+   }
+
+   err = dir_walk_reader_open( &node->reader, node->parent ? &node->parent->reader : 0x0, node->path + node->name_offset, path_buffer, path_len, worker->path.size - path_len, slash,
+                               ( walk->filter.flags & DIR_WALK_FOLLOW_SYMLINKS ) != 0 );
+   if ( err != DIR_ERROR_OK )
+   {
+      /* just as in the single threaded walk, only failing to open the root-directory is an error */
+      if ( node->parent == 0x0 )
+         dir_pwalk_fail( walk, err, 1 );
+      dir_pwalk_release( worker, node );
+      return;
+   }
+   node->is_open = 1;
+
+   /* the device and inode of the input/root-directory, nothing else is running yet */
+   if ( node->parent == 0x0 && !dir_walk_filter_enter( &walk->filter, &node->reader, 0x0, 0, &node->id ) )
+   {
+      dir_pwalk_fail( walk, DIR_ERROR_FAILED, 1 );
+      dir_pwalk_release( worker, node );
+      return;
+   }
+
+   while ( !dir_atomic_load( &walk->aborted ) && dir_walk_reader_next( &node->reader, &item_name, &is_dir ) )
+   {
+      unsigned int item_len;
+      int visit_result;
+      #if !defined ( _WIN32 )
+         if ( is_dir == DIR_WALK_READER_TYPE_UNKNOWN && !dir_walk_reader_stat_is_dir( &node->reader, item_name, &is_dir ) )
+         {
+            err = DIR_ERROR_FAILED;
+            break;
+         }
+         if ( !is_dir && ( walk->filter.flags & DIR_WALK_FOLLOW_SYMLINKS ) )
+            is_dir = dir_walk_reader_is_dir_symlink( &node->reader, item_name );
+      #endif
+
+      if ( dir_walk_filter_ignore( &walk->filter, item_name, is_dir ) )
+         continue;
+
+      item_len = dir_strlen32( item_name );
+      if ( !dir_path_buffer_reserve( &worker->path, path_len + item_len + 2 ) ) /* 2 == '/' + null-terminator */
+      {
+         err = DIR_ERROR_FAILED;
+         break;
+      }
+
+      path_buffer = worker->path.data;
+      path_buffer[path_len] = slash;
+      memcpy( &path_buffer[path_len + 1], item_name, item_len + 1 );
+
+      visit_result = walk->visit( worker, node, &path_buffer[path_len + 1], path_len + item_len + 1, is_dir );
+      if ( visit_result && is_dir )
+      {
+         struct dir_pwalk_node* child = dir_pwalk_node_alloc( walk, node, path_buffer, path_len + item_len + 1, path_len + 1 );
+         if ( child )
+            child->visit_result = visit_result;
+         dir_atomic_add( &node->pending, 1 );
+         if ( child == 0x0 || !dir_pwalk_push( worker, child ) )
+         {
+            DIRUTIL_FREE( child );
+            dir_atomic_add( &node->pending, -1 );
+            dir_pwalk_fail( walk, DIR_ERROR_FAILED, 1 );
+         }
+      }
+   }
+   worker->path.data[path_len] = '\0';
+   if ( err == DIR_ERROR_OK && node->reader.error )
+      err = DIR_ERROR_FAILED;
+
+   /* as in the single threaded walk, errors in sub-directories only stops reading that directory */
+   if ( err != DIR_ERROR_OK && node->parent == 0x0 )
+      dir_pwalk_fail( walk, err, 0 );
+
+   dir_pwalk_release( worker, node );
+}
+
+static void dir_pwalk_worker_run( struct dir_pwalk_worker* worker )
+{
+   struct dir_pwalk* walk = worker->walk;
+   for ( ;; )
+   {
+      int done;
+      struct dir_pwalk_node* node = dir_pwalk_pop( worker );
+      if ( node )
+      {
+         dir_pwalk_process( worker, node );
+         continue;
+      }
+
+      dir_mutex_lock( &walk->lock );
+      while ( dir_atomic_load( &walk->queued ) == 0 && !walk->done )
+      {
+         ++walk->sleepers;
+         dir_cond_wait( &walk->wakeup, &walk->lock );
+         --walk->sleepers;
+      }
+      done = walk->done;
+      dir_mutex_unlock( &walk->lock );
+
+      if ( done )
+         break;
+   }
+}
+
+DIR_THREAD_ENTRY( dir_pwalk_thread_entry, arg )
+{
+   dir_pwalk_worker_run( (struct dir_pwalk_worker*)arg );
+   DIR_THREAD_RETURN;
+}
+
+/**
+ * run parallel walk, 'visit', 'complete', 'userdata' and 'node_extra_size' of walk should be set by caller.
+ * @param num_threads number of workers, including the calling thread, 0 to use one per hardware thread.
+ */
+static enum dir_error dir_pwalk_run( struct dir_pwalk* walk, const char* path, unsigned int flags,
+   const char* optional_glob_directories, const char* optional_glob_files, unsigned int num_threads )
+{
+   struct dir_pwalk_node* root;
+   unsigned int i, path_len;
+
+   walk->workers = 0x0;
+   walk->sleepers = 0;
+   walk->queued = 0;
+   walk->done = 0;
+   walk->aborted = 0;
+   walk->result = DIR_ERROR_OK;
+   walk->num_workers = num_threads ? num_threads : dir_thread_hardware_concurrency();
+
+   walk->workers = (struct dir_pwalk_worker*)DIRUTIL_MALLOC( walk->num_workers * sizeof( struct dir_pwalk_worker ) );
+   if ( walk->workers == 0x0 )
+      return DIR_ERROR_FAILED;
+
+   dir_path_buffer_init( &walk->workers[0].path );
+   path_len = dir_walk_root_path( path, dir_walk_slash_by_flags( flags ), &walk->workers[0].path );
+   if ( !path_len || dir_walk_filter_init( &walk->filter, flags, path_len, optional_glob_directories, optional_glob_files ) != DIR_ERROR_OK )
+   {
+      dir_path_buffer_free( &walk->workers[0].path );
+      DIRUTIL_FREE( walk->workers );
+      return DIR_ERROR_FAILED;
+   }
+
+   root = dir_pwalk_node_alloc( walk, 0x0, walk->workers[0].path.data, path_len, 0 );
+   if ( root == 0x0 )
+   {
+      dir_walk_filter_free( &walk->filter );
+      dir_path_buffer_free( &walk->workers[0].path );
+      DIRUTIL_FREE( walk->workers );
+      return DIR_ERROR_FAILED;
+   }
+
+   dir_mutex_init( &walk->lock );
+   dir_cond_init( &walk->wakeup );
+   for ( i = 0; i < walk->num_workers; ++i )
+   {
+      struct dir_pwalk_worker* worker = &walk->workers[i];
+      worker->walk = walk;
+      worker->index = i;
+      worker->started = 0;
+      worker->nodes = 0x0;
+      worker->top = worker->bottom = worker->capacity = 0;
+      if ( i > 0 )
+         dir_path_buffer_init( &worker->path );
+      dir_mutex_init( &worker->lock );
+   }
+
+   if ( !dir_pwalk_push( &walk->workers[0], root ) )
+   {
+      DIRUTIL_FREE( root );
+      walk->result = DIR_ERROR_FAILED;
+   }
+   else
+   {
+      /* if a thread could not be started the walk is still completed by the workers that did start */
+      for ( i = 1; i < walk->num_workers; ++i )
+         walk->workers[i].started = dir_thread_create( &walk->workers[i].thread, dir_pwalk_thread_entry, &walk->workers[i] );
+
+      dir_pwalk_worker_run( &walk->workers[0] );
+
+      for ( i = 1; i < walk->num_workers; ++i )
+         if ( walk->workers[i].started )
+            dir_thread_join( walk->workers[i].thread );
+   }
+
+   for ( i = 0; i < walk->num_workers; ++i )
+   {
+      DIRUTIL_FREE( walk->workers[i].nodes );
+      dir_path_buffer_free( &walk->workers[i].path );
+      dir_mutex_destroy( &walk->workers[i].lock );
+   }
+   dir_cond_destroy( &walk->wakeup );
+   dir_mutex_destroy( &walk->lock );
+   dir_walk_filter_free( &walk->filter );
+   DIRUTIL_FREE( walk->workers );
+   walk->workers = 0x0;
+   return walk->result;
+}
+
+/* state for the public 'dir_walk_parallel' */
+struct dir_walk_parallel_ctx
+{
+   dir_walk_parallel_callback callback;
+   void* userdata;
+};
+
+static int dir_walk_parallel_visit( struct dir_pwalk_worker* worker, struct dir_pwalk_node* dir, const char* item_name, unsigned int path_len, int is_dir )
+{
+   struct dir_pwalk* walk = worker->walk;
+   struct dir_walk_parallel_ctx* ctx = (struct dir_walk_parallel_ctx*)walk->userdata;
+   unsigned int flags = walk->filter.flags;
+   unsigned int callback_path_offset = ( flags & DIR_WALK_ROOT_RELATIVE_PATHS ) ? ( walk->filter.root_path_len + 1 ) : 0;
+   int should_walk_directories = ( flags & DIR_WALK_SINGLE_DIRECTORY ) == 0;
+   int should_call_callback_directories = ( flags & DIR_WALK_ONLY_FILES ) == 0;
+
+   if ( is_dir )
+   {
+      enum dir_walk_filter_result filter_result;
+      if ( !( should_walk_directories || should_call_callback_directories ) )
+         return DIR_WALK_FILTER_SKIP;
+
+      filter_result = dir_walk_filter_match_directory( &walk->filter, worker->path.data, path_len );
+      if ( filter_result != DIR_WALK_FILTER_MATCH )
+         return should_walk_directories ? filter_result : DIR_WALK_FILTER_SKIP;
+
+      /* with depth-first the callback is invoked on completion of the directory if it is walked */
+      if ( should_call_callback_directories && ( !( flags & DIR_WALK_DEPTH_FIRST ) || !should_walk_directories ) )
+      {
+         int callback_result = ctx->callback( worker->path.data + callback_path_offset, path_len - callback_path_offset, DIR_ITEM_DIR, worker->index, ctx->userdata );
+         if ( callback_result == DIR_WALK_SKIP_SUBTREE && !( flags & DIR_WALK_DEPTH_FIRST ) )
+            return DIR_WALK_FILTER_SKIP;
+         if ( dir_walk_result_is_abort( callback_result ) )
+         {
+            dir_pwalk_fail( walk, DIR_ERROR_ABORTED, 1 );
+            return DIR_WALK_FILTER_SKIP;
+         }
+      }
+
+      return should_walk_directories ? DIR_WALK_FILTER_MATCH : DIR_WALK_FILTER_SKIP;
+   }
+
+   /* files in directories only walked to reach matching sub-directories are not reported */
+   if ( dir->visit_result == DIR_WALK_FILTER_PARTIAL )
+      return DIR_WALK_FILTER_SKIP;
+
+   if ( ( flags & DIR_WALK_ONLY_DIRECTORIES ) == 0 && dir_walk_filter_match_file( &walk->filter, item_name, path_len - (unsigned int)( item_name - worker->path.data ) ) )
+   {
+      if ( dir_walk_result_is_abort( ctx->callback( worker->path.data + callback_path_offset, path_len - callback_path_offset, DIR_ITEM_FILE, worker->index, ctx->userdata ) ) )
+         dir_pwalk_fail( walk, DIR_ERROR_ABORTED, 1 );
+   }
+
+   return DIR_WALK_FILTER_SKIP;
+}
+
+static void dir_walk_parallel_complete( struct dir_pwalk_worker* worker, struct dir_pwalk_node* dir )
+{
+   struct dir_pwalk* walk = worker->walk;
+   struct dir_walk_parallel_ctx* ctx = (struct dir_walk_parallel_ctx*)walk->userdata;
+   unsigned int flags = walk->filter.flags;
+   unsigned int callback_path_offset = ( flags & DIR_WALK_ROOT_RELATIVE_PATHS ) ? ( walk->filter.root_path_len + 1 ) : 0;
+
+   if ( dir->parent == 0x0 || dir->visit_result == DIR_WALK_FILTER_PARTIAL || dir_atomic_load( &walk->aborted ) )
+      return;
+
+   if ( ( flags & DIR_WALK_DEPTH_FIRST ) && ( flags & DIR_WALK_ONLY_FILES ) == 0 )
+   {
+      if ( dir_walk_result_is_abort( ctx->callback( dir->path + callback_path_offset, dir->path_len - callback_path_offset, DIR_ITEM_DIR, worker->index, ctx->userdata ) ) )
+         dir_pwalk_fail( walk, DIR_ERROR_ABORTED, 1 );
+   }
+}
+
+DIRUTIL_API enum dir_error dir_walk_parallel( const char* path, unsigned int flags,
+   const char* optional_glob_directories, const char* optional_glob_files,
+   unsigned int num_threads, dir_walk_parallel_callback callback, void* userdata )
+{
+   struct dir_pwalk walk;
+   struct dir_walk_parallel_ctx ctx;
+
+   ctx.callback = callback;
+   ctx.userdata = userdata;
+
+   walk.visit = dir_walk_parallel_visit;
+   walk.complete = dir_walk_parallel_complete;
+   walk.userdata = &ctx;
+   walk.node_extra_size = 0;
+
+   return dir_pwalk_run( &walk, path, flags, optional_glob_directories, optional_glob_files, num_threads );
+}
+
+/* state for 'dir_rmtree_parallel' */
+struct dir_rmtree_parallel_ctx
+{
+   char* failed_path;
+   unsigned int failed_path_size;
+};
+
+/* stop the walk with DIR_ERROR_FAILED, unless an error is already recorded, and store path in _optional_ failed_path */
+static void dir_pwalk_fail_path( struct dir_pwalk* walk, const char* path, char* failed_path, unsigned int failed_path_size )
+{
+   dir_mutex_lock( &walk->lock );
+   if ( walk->result == DIR_ERROR_OK )
+   {
+      walk->result = DIR_ERROR_FAILED;
+      if ( failed_path && failed_path_size )
+      {
+         unsigned int len = dir_strlen32( path );
+         if ( len >= failed_path_size )
+            len = failed_path_size - 1;
+         memcpy( failed_path, path, len );
+         failed_path[len] = '\0';
+      }
+   }
+   dir_atomic_store( &walk->aborted, 1 );
+   dir_mutex_unlock( &walk->lock );
+}
+
+static void dir_rmtree_parallel_fail( struct dir_pwalk* walk, const char* path )
+{
+   struct dir_rmtree_parallel_ctx* ctx = (struct dir_rmtree_parallel_ctx*)walk->userdata;
+   dir_pwalk_fail_path( walk, path, ctx->failed_path, ctx->failed_path_size );
+}
+
+static int dir_rmtree_parallel_visit( struct dir_pwalk_worker* worker, struct dir_pwalk_node* dir, const char* item_name, unsigned int path_len, int is_dir )
+{
+   (void)path_len;
+   if ( is_dir )
+      return 1;
+
+#if defined( _WIN32 )
+   (void)dir; (void)item_name;
+   if ( !DeleteFileA( worker->path.data ) )
+#else
+   if ( unlinkat( dir_walk_reader_fd( &dir->reader ), item_name, 0 ) != 0 )
+#endif
+      dir_rmtree_parallel_fail( worker->walk, worker->path.data );
+   return 0;
+}
+
+static void dir_rmtree_parallel_complete( struct dir_pwalk_worker* worker, struct dir_pwalk_node* dir )
+{
+   int removed;
+   if ( dir_atomic_load( &worker->walk->aborted ) )
+      return;
+
+#if defined( _WIN32 )
+   removed = RemoveDirectoryA( dir->path ) != 0;
+#else
+   if ( dir->parent )
+      removed = unlinkat( dir_walk_reader_fd( &dir->parent->reader ), dir->path + dir->name_offset, AT_REMOVEDIR ) == 0;
+   else
+      removed = rmdir( dir->path ) == 0;
+#endif
+   if ( !removed )
+      dir_rmtree_parallel_fail( worker->walk, dir->path );
+}
+
+DIRUTIL_API enum dir_error dir_rmtree_parallel( const char* path, unsigned int num_threads, char* failed_path, unsigned int failed_path_size )
+{
+   struct dir_pwalk walk;
+   struct dir_rmtree_parallel_ctx ctx;
+
+   ctx.failed_path = failed_path;
+   ctx.failed_path_size = failed_path_size;
+   if ( failed_path && failed_path_size )
+      failed_path[0] = '\0';
+
+   walk.visit = dir_rmtree_parallel_visit;
+   walk.complete = dir_rmtree_parallel_complete;
+   walk.userdata = &ctx;
+   walk.node_extra_size = 0;
+
+   return dir_pwalk_run( &walk, path, DIR_WALK_NO_FLAGS, 0x0, 0x0, num_threads );
+}
+
+/*
+   copy of a tree, on top of the parallel walk engine.
+
+   each walked directory is created in the destination when its parent is read, and opened there, relative to the
+   destination of its parent, when the first item in it is copied. the destination stays open until the directory
+   is completed, as the source, and the attributes of the directory are copied on completion as copying the items
+   in it changes its modification time.
+*/
+struct dir_copytree_ctx
+{
+   char* failed_path;
+   unsigned int failed_path_size;
+   unsigned int flags;
+#if defined( _WIN32 )
+   struct dir_path_buffer* dst_paths; /* one per worker, full destination path of the current item */
+   unsigned int dst_root_len;
+#else
+   int dst_fd;
+   dir_uint64 dst_device; /* to skip the destination if it is inside the source */
+   dir_uint64 dst_inode;
+   char** buffers;        /* one per worker, allocated the first time data is copied through it */
+   volatile long no_clone;      /* set when the file system do not support 'FICLONE' */
+   volatile long no_copy_range; /* set when the kernel do not support 'copy_file_range' */
+#endif
+};
+
+/* smaller files are copied with read/write, that is faster than 'copy_file_range' for them */
+#define DIR_COPYTREE_MIN_COPY_RANGE ( 64 * 1024 )
+
+#if defined( _WIN32 )
+
+/* build the path in dst of the current item of worker */
+static const char* dir_copytree_dst_path( struct dir_pwalk_worker* worker, unsigned int path_len )
+{
+   struct dir_copytree_ctx* ctx = (struct dir_copytree_ctx*)worker->walk->userdata;
+   struct dir_path_buffer* dst = &ctx->dst_paths[worker->index];
+   unsigned int root_len = worker->walk->filter.root_path_len;
+
+   if ( !dir_path_buffer_reserve( dst, ctx->dst_root_len + path_len - root_len + 1 ) )
+      return 0x0;
+   memcpy( dst->data + ctx->dst_root_len, worker->path.data + root_len, path_len - root_len + 1 );
+   return dst->data;
+}
+
+static int dir_copytree_visit( struct dir_pwalk_worker* worker, struct dir_pwalk_node* dir, const char* item_name, unsigned int path_len, int is_dir )
+{
+   struct dir_pwalk* walk = worker->walk;
+   struct dir_copytree_ctx* ctx = (struct dir_copytree_ctx*)walk->userdata;
+   const char* dst_path;
+   enum dir_walk_filter_result filter_result = DIR_WALK_FILTER_SKIP;
+
+   if ( is_dir )
+   {
+      filter_result = dir_walk_filter_match_directory( &walk->filter, worker->path.data, path_len );
+      if ( filter_result == DIR_WALK_FILTER_SKIP || ( filter_result == DIR_WALK_FILTER_PARTIAL && ( ctx->flags & DIR_WALK_SINGLE_DIRECTORY ) ) )
+         return DIR_WALK_FILTER_SKIP;
+   }
+   else if ( dir->visit_result == DIR_WALK_FILTER_PARTIAL || ( ctx->flags & DIR_WALK_ONLY_DIRECTORIES ) ||
+             !dir_walk_filter_match_file( &walk->filter, item_name, path_len - (unsigned int)( item_name - worker->path.data ) ) )
+      return DIR_WALK_FILTER_SKIP;
+
+   dst_path = dir_copytree_dst_path( worker, path_len );
+   if ( dst_path == 0x0 || ( is_dir ? dir_create( dst_path ) != DIR_ERROR_OK : !CopyFileA( worker->path.data, dst_path, FALSE ) ) )
+   {
+      dir_pwalk_fail_path( walk, worker->path.data, ctx->failed_path, ctx->failed_path_size );
+      return DIR_WALK_FILTER_SKIP;
+   }
+   return ( ctx->flags & DIR_WALK_SINGLE_DIRECTORY ) ? DIR_WALK_FILTER_SKIP : filter_result;
+}
+
+static void dir_copytree_complete( struct dir_pwalk_worker* worker, struct dir_pwalk_node* dir )
+{
+   /* CopyFileA copies the attributes of files, and directories have nothing worth preserving */
+   (void)worker; (void)dir;
+}
+
+#else
+
+#if defined( __APPLE__ )
+   #define DIR_STAT_ATIME( s ) ( s ).st_atimespec
+   #define DIR_STAT_MTIME( s ) ( s ).st_mtimespec
+#else
+   #define DIR_STAT_ATIME( s ) ( s ).st_atim
+   #define DIR_STAT_MTIME( s ) ( s ).st_mtim
+#endif
+
+/* destination of directory, -1 if it could not be opened. that fails the copy once, the first time it is needed */
+static int dir_copytree_dst_fd( struct dir_pwalk* walk, struct dir_pwalk_node* dir )
+{
+   struct dir_copytree_ctx* ctx = (struct dir_copytree_ctx*)walk->userdata;
+   int* dst_fd = (int*)dir->extra; /* dst_fd + 1, zero until opened and -1 if it could not be opened */
+   int parent_fd, fd;
+
+   if ( dir->parent == 0x0 )
+      return ctx->dst_fd;
+   if ( *dst_fd )
+      return *dst_fd > 0 ? *dst_fd - 1 : -1;
+
+   /* the destination of the parent was opened when this directory was created in it */
+   parent_fd = dir_copytree_dst_fd( walk, dir->parent );
+   fd = openat( parent_fd, dir->path + dir->name_offset, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC );
+   *dst_fd = fd < 0 ? -1 : fd + 1;
+   if ( fd < 0 )
+      dir_pwalk_fail_path( walk, dir->path, ctx->failed_path, ctx->failed_path_size );
+   return fd;
+}
+
+static char* dir_copytree_buffer( struct dir_copytree_ctx* ctx, unsigned int worker_index )
+{
+   if ( ctx->buffers[worker_index] == 0x0 )
+      ctx->buffers[worker_index] = (char*)DIRUTIL_MALLOC( DIRUTIL_COPY_BUFFER_SIZE );
+   return ctx->buffers[worker_index];
+}
+
+/* copy data from src to dst, by sharing the blocks or in the kernel if possible. returns 0 on failure with errno set */
+static int dir_copytree_data( struct dir_copytree_ctx* ctx, unsigned int worker_index, int src, int dst, dir_uint64 size )
+{
+   char* buffer;
+
+#if defined( __linux__ )
+   if ( !( ctx->flags & DIR_COPY_NO_REFLINK ) && !dir_atomic_load( &ctx->no_clone ) )
+   {
+      if ( ioctl( dst, _IOW( 0x94, 9, int ) /* FICLONE */, src ) == 0 )
+         return 1;
+      /* not supported by the file system, do not try again for every file */
+      if ( errno == EOPNOTSUPP || errno == ENOTTY || errno == ENOSYS )
+         dir_atomic_store( &ctx->no_clone, 1 );
+   }
+
+   #if defined( SYS_copy_file_range )
+   /* file offsets are updated, so the read/write loop continues where this stops if it is not supported for the files */
+   while ( size >= DIR_COPYTREE_MIN_COPY_RANGE && !dir_atomic_load( &ctx->no_copy_range ) )
+   {
+      long n = syscall( SYS_copy_file_range, src, 0x0, dst, 0x0, (size_t)0x40000000, 0u );
+      if ( n == 0 )
+         return 1;
+      if ( n > 0 || errno == EINTR )
+         continue;
+      if ( errno == ENOSYS )
+         dir_atomic_store( &ctx->no_copy_range, 1 );
+      else if ( errno != EXDEV && errno != EINVAL && errno != EOPNOTSUPP && errno != EPERM && errno != ETXTBSY )
+         return 0;
+      break;
+   }
+   #endif
+#else
+   (void)size;
+#endif
+
+   buffer = dir_copytree_buffer( ctx, worker_index );
+   if ( buffer == 0x0 )
+      return 0;
+
+   for ( ;; )
+   {
+      ssize_t written = 0;
+      ssize_t n = read( src, buffer, DIRUTIL_COPY_BUFFER_SIZE );
+      if ( n == 0 )
+         return 1;
+      if ( n < 0 )
+      {
+         if ( errno == EINTR )
+            continue;
+         return 0;
+      }
+      while ( written < n )
+      {
+         ssize_t w = write( dst, buffer + written, (size_t)( n - written ) );
+         if ( w < 0 && errno != EINTR )
+            return 0;
+         if ( w > 0 )
+            written += w;
+      }
+   }
+}
+
+static int dir_copytree_symlink( struct dir_copytree_ctx* ctx, unsigned int worker_index, int src_dir_fd, int dst_dir_fd, const char* name )
+{
+   struct stat s;
+   ssize_t len;
+   char* target = dir_copytree_buffer( ctx, worker_index );
+   if ( target == 0x0 )
+      return 0;
+
+   len = readlinkat( src_dir_fd, name, target, DIRUTIL_COPY_BUFFER_SIZE - 1 );
+   if ( len < 0 )
+      return 0;
+   target[len] = '\0';
+
+   if ( symlinkat( target, dst_dir_fd, name ) != 0 )
+   {
+      if ( errno != EEXIST || unlinkat( dst_dir_fd, name, 0 ) != 0 || symlinkat( target, dst_dir_fd, name ) != 0 )
+         return 0;
+   }
+
+   if ( ctx->flags & DIR_COPY_PRESERVE )
+   {
+      struct timespec times[2];
+      if ( fstatat( src_dir_fd, name, &s, AT_SYMLINK_NOFOLLOW ) != 0 )
+         return 0;
+      times[0] = DIR_STAT_ATIME( s );
+      times[1] = DIR_STAT_MTIME( s );
+      if ( utimensat( dst_dir_fd, name, times, AT_SYMLINK_NOFOLLOW ) != 0 )
+         return 0;
+   }
+   return 1;
+}
+
+static int dir_copytree_file( struct dir_copytree_ctx* ctx, unsigned int worker_index, const struct dir_walk_reader* reader, int dst_dir_fd, const char* name )
+{
+   struct stat s;
+   int src_dir_fd = dir_walk_reader_fd( reader );
+   int src, dst, ok;
+
+   if ( reader->d_type == DT_LNK )
+      return dir_copytree_symlink( ctx, worker_index, src_dir_fd, dst_dir_fd, name );
+   if ( reader->d_type != DT_REG && reader->d_type != DT_UNKNOWN )
+      return 1;
+
+   /* non-blocking so that a fifo that replaced the file is not waited for */
+   src = openat( src_dir_fd, name, O_RDONLY | O_NOFOLLOW | O_NONBLOCK | O_CLOEXEC );
+   if ( src < 0 )
+      return errno == ELOOP ? dir_copytree_symlink( ctx, worker_index, src_dir_fd, dst_dir_fd, name ) : 0;
+   if ( fstat( src, &s ) != 0 )
+   {
+      close( src );
+      return 0;
+   }
+   if ( !S_ISREG( s.st_mode ) )
+   {
+      close( src );
+      return 1;
+   }
+
+   dst = openat( dst_dir_fd, name, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, s.st_mode & 0777 );
+   if ( dst < 0 )
+   {
+      close( src );
+      return 0;
+   }
+
+   ok = dir_copytree_data( ctx, worker_index, src, dst, (dir_uint64)s.st_size );
+   if ( ok && ( ctx->flags & DIR_COPY_PRESERVE ) )
+   {
+      struct timespec times[2];
+      times[0] = DIR_STAT_ATIME( s );
+      times[1] = DIR_STAT_MTIME( s );
+      ok = fchmod( dst, s.st_mode & 07777 ) == 0 && futimens( dst, times ) == 0;
+   }
+   close( src );
+   return close( dst ) == 0 && ok;
+}
+
+static int dir_copytree_visit( struct dir_pwalk_worker* worker, struct dir_pwalk_node* dir, const char* item_name, unsigned int path_len, int is_dir )
+{
+   struct dir_pwalk* walk = worker->walk;
+   struct dir_copytree_ctx* ctx = (struct dir_copytree_ctx*)walk->userdata;
+   enum dir_walk_filter_result filter_result = DIR_WALK_FILTER_SKIP;
+   int dst_dir_fd;
+
+   if ( is_dir )
+   {
+      filter_result = dir_walk_filter_match_directory( &walk->filter, worker->path.data, path_len );
+      if ( filter_result == DIR_WALK_FILTER_SKIP || ( filter_result == DIR_WALK_FILTER_PARTIAL && ( ctx->flags & DIR_WALK_SINGLE_DIRECTORY ) ) )
+         return DIR_WALK_FILTER_SKIP;
+
+      /* do not copy the destination into itself */
+      if ( dir->reader.d_ino == ctx->dst_inode )
+      {
+         struct stat s;
+         if ( fstatat( dir_walk_reader_fd( &dir->reader ), item_name, &s, AT_SYMLINK_NOFOLLOW ) == 0 &&
+              (dir_uint64)s.st_dev == ctx->dst_device && (dir_uint64)s.st_ino == ctx->dst_inode )
+            return DIR_WALK_FILTER_SKIP;
+      }
+   }
+   else if ( dir->visit_result == DIR_WALK_FILTER_PARTIAL || ( ctx->flags & DIR_WALK_ONLY_DIRECTORIES ) ||
+             !dir_walk_filter_match_file( &walk->filter, item_name, path_len - (unsigned int)( item_name - worker->path.data ) ) )
+      return DIR_WALK_FILTER_SKIP;
+
+   dst_dir_fd = dir_copytree_dst_fd( walk, dir );
+   if ( dst_dir_fd < 0 )
+      return DIR_WALK_FILTER_SKIP;
+   if ( is_dir ? mkdirat( dst_dir_fd, item_name, 0777 ) != 0 && errno != EEXIST
+               : !dir_copytree_file( ctx, worker->index, &dir->reader, dst_dir_fd, item_name ) )
+   {
+      dir_pwalk_fail_path( walk, worker->path.data, ctx->failed_path, ctx->failed_path_size );
+      return DIR_WALK_FILTER_SKIP;
+   }
+   return ( ctx->flags & DIR_WALK_SINGLE_DIRECTORY ) ? DIR_WALK_FILTER_SKIP : filter_result;
+}
+
+static void dir_copytree_complete( struct dir_pwalk_worker* worker, struct dir_pwalk_node* dir )
+{
+   struct dir_pwalk* walk = worker->walk;
+   struct dir_copytree_ctx* ctx = (struct dir_copytree_ctx*)walk->userdata;
+   int* dst_fd = (int*)dir->extra;
+   struct stat s;
+   struct timespec times[2];
+   int ok;
+
+   if ( *dst_fd > 0 )
+      close( *dst_fd - 1 );
+
+   if ( !( ctx->flags & DIR_COPY_PRESERVE ) || dir_atomic_load( &walk->aborted ) )
+      return;
+
+   if ( dir->parent )
+   {
+      int parent_fd = dir_copytree_dst_fd( walk, dir->parent );
+      const char* name = dir->path + dir->name_offset;
+      ok = fstatat( dir_walk_reader_fd( &dir->parent->reader ), name, &s, AT_SYMLINK_NOFOLLOW ) == 0;
+      times[0] = DIR_STAT_ATIME( s );
+      times[1] = DIR_STAT_MTIME( s );
+      ok = ok && fchmodat( parent_fd, name, s.st_mode & 07777, 0 ) == 0 && utimensat( parent_fd, name, times, AT_SYMLINK_NOFOLLOW ) == 0;
+   }
+   else
+   {
+      ok = stat( dir->path, &s ) == 0;
+      times[0] = DIR_STAT_ATIME( s );
+      times[1] = DIR_STAT_MTIME( s );
+      ok = ok && fchmod( ctx->dst_fd, s.st_mode & 07777 ) == 0 && futimens( ctx->dst_fd, times ) == 0;
+   }
+   if ( !ok )
+      dir_pwalk_fail_path( walk, dir->path, ctx->failed_path, ctx->failed_path_size );
+}
+
+#endif
+
+DIRUTIL_API enum dir_error dir_copytree( const char* src, const char* dst, unsigned int flags,
+   const char* optional_glob_directories, const char* optional_glob_files,
+   unsigned int num_threads, char* failed_path, unsigned int failed_path_size )
+{
+   struct dir_pwalk walk;
+   struct dir_copytree_ctx ctx;
+   enum dir_error result;
+   unsigned int i, num_workers = num_threads ? num_threads : dir_thread_hardware_concurrency();
+#if defined( _WIN32 )
+   DWORD attributes;
+#else
+   struct stat s;
+#endif
+
+   ctx.failed_path = failed_path;
+   ctx.failed_path_size = failed_path_size;
+   ctx.flags = flags;
+   if ( failed_path && failed_path_size )
+      failed_path[0] = '\0';
+
+#if defined( _WIN32 )
+   attributes = GetFileAttributesA( src );
+   if ( attributes == INVALID_FILE_ATTRIBUTES || !( attributes & FILE_ATTRIBUTE_DIRECTORY ) )
+      return DIR_ERROR_PATH_DO_NOT_EXIST;
+#else
+   if ( stat( src, &s ) != 0 || !S_ISDIR( s.st_mode ) )
+      return DIR_ERROR_PATH_DO_NOT_EXIST;
+#endif
+
+   result = dir_mktree( dst );
+   if ( result != DIR_ERROR_OK )
+      return result;
+
+#if defined( _WIN32 )
+   ctx.dst_paths = (struct dir_path_buffer*)DIRUTIL_MALLOC( num_workers * sizeof( struct dir_path_buffer ) );
+   if ( ctx.dst_paths == 0x0 )
+      return DIR_ERROR_FAILED;
+   for ( i = 0; i < num_workers; ++i )
+      dir_path_buffer_init( &ctx.dst_paths[i] );
+   ctx.dst_root_len = dir_walk_root_path( dst, '\\', &ctx.dst_paths[0] );
+   for ( i = 1; ctx.dst_root_len && i < num_workers; ++i )
+   {
+      if ( dir_path_buffer_reserve( &ctx.dst_paths[i], ctx.dst_root_len + 1 ) )
+         memcpy( ctx.dst_paths[i].data, ctx.dst_paths[0].data, ctx.dst_root_len + 1 );
+      else
+         ctx.dst_root_len = 0;
+   }
+   result = DIR_ERROR_FAILED;
+   if ( ctx.dst_root_len )
+   {
+#else
+   ctx.dst_fd = open( dst, O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+   if ( ctx.dst_fd < 0 )
+      return DIR_ERROR_FAILED;
+   ctx.buffers = (char**)DIRUTIL_MALLOC( num_workers * sizeof( char* ) );
+   result = DIR_ERROR_FAILED;
+   if ( ctx.buffers && fstat( ctx.dst_fd, &s ) == 0 )
+   {
+      ctx.no_clone = 0;
+      ctx.no_copy_range = 0;
+      ctx.dst_device = (dir_uint64)s.st_dev;
+      ctx.dst_inode = (dir_uint64)s.st_ino;
+      memset( ctx.buffers, 0, num_workers * sizeof( char* ) );
+#endif
+
+      walk.visit = dir_copytree_visit;
+      walk.complete = dir_copytree_complete;
+      walk.userdata = &ctx;
+      walk.node_extra_size = sizeof( int );
+
+      flags &= DIR_WALK_SINGLE_DIRECTORY | DIR_WALK_ONLY_DIRECTORIES | DIR_WALK_IGNORE_DOT_DIRECTORIES | DIR_WALK_IGNORE_DOT_FILES |
+               DIR_WALK_SAME_FILESYSTEM | DIR_WALK_FOLLOW_SYMLINKS | DIR_WALK_MAX_DEPTH_MASK;
+      result = dir_pwalk_run( &walk, src, flags, optional_glob_directories, optional_glob_files, num_workers );
+   }
+
+#if defined( _WIN32 )
+   for ( i = 0; i < num_workers; ++i )
+      dir_path_buffer_free( &ctx.dst_paths[i] );
+   DIRUTIL_FREE( ctx.dst_paths );
+#else
+   for ( i = 0; ctx.buffers && i < num_workers; ++i )
+      DIRUTIL_FREE( ctx.buffers[i] );
+   DIRUTIL_FREE( ctx.buffers );
+   close( ctx.dst_fd );
+#endif
+   return result;
+}
+
+/*
+   disk usage, on top of the parallel walk engine.
+
+   the items in a directory are summed into 'own' of its node by the one worker reading it. when a directory is
+   completed 'own', the directory itself and 'sub', the totals of its sub-directories, are added to 'sub' of its
+   parent. that is done with atomic adds as other sub-directories of the parent might complete on other workers.
+*/
+struct dir_du_node
+{
+   struct dir_du_totals own;
+   struct dir_du_totals sub;
+};
+
+/* set of device/inode of the files with more than one hard link found so far, split in stripes with one lock each */
+#define DIR_DU_LINK_STRIPES 64
+
+struct dir_du_link_stripe
+{
+   dir_mutex lock;
+   struct dir_inode_set set;
+};
+
+/* directory kept by dir_du_top */
+struct dir_du_entry
+{
+   dir_uint64 key;
+   char* path;
+   unsigned int path_len;
+   unsigned int depth;
+   struct dir_du_totals totals;
+};
+
+/* the 'num_top' largest directories completed by one worker, a min-heap on 'key' */
+struct dir_du_top
+{
+   struct dir_du_entry* entries;
+   unsigned int count;
+};
+
+/* state for 'dir_du' and 'dir_du_top' */
+struct dir_du_ctx
+{
+   dir_du_callback callback;
+   void* userdata;
+   unsigned int max_depth;
+   struct dir_du_totals* totals;
+   struct dir_du_link_stripe links[DIR_DU_LINK_STRIPES];
+
+   struct dir_du_top* top; /* one per worker, only set by dir_du_top */
+   unsigned int num_top;
+   enum dir_du_order order;
+};
+
+/* returns 1 if the file was not found before, 0 if it was and -1 on out of memory */
+static int dir_du_link_insert( struct dir_du_ctx* ctx, dir_uint64 device, dir_uint64 inode )
+{
+   unsigned int hash = dir_inode_set_hash( device, inode );
+   struct dir_du_link_stripe* stripe = &ctx->links[hash >> 26]; /* top bits for the stripe, the rest for the slot */
+   int result;
+
+   dir_mutex_lock( &stripe->lock );
+   result = dir_inode_set_insert( &stripe->set, hash, device, inode );
+   dir_mutex_unlock( &stripe->lock );
+   return result;
+}
+
+static dir_uint64 dir_du_key( enum dir_du_order order, const struct dir_du_totals* totals )
+{
+   switch ( order )
+   {
+   case DIR_DU_BY_SIZE:  return totals->size;
+   case DIR_DU_BY_FILES: return totals->num_files;
+   default:              return totals->allocated;
+   }
+}
+
+static void dir_du_heap_sift_down( struct dir_du_entry* heap, unsigned int count, unsigned int i )
+{
+   for ( ;; )
+   {
+      struct dir_du_entry tmp;
+      unsigned int smallest = i, left = i * 2 + 1, right = i * 2 + 2;
+      if ( left < count && heap[left].key < heap[smallest].key )
+         smallest = left;
+      if ( right < count && heap[right].key < heap[smallest].key )
+         smallest = right;
+      if ( smallest == i )
+         return;
+      tmp = heap[i];
+      heap[i] = heap[smallest];
+      heap[smallest] = tmp;
+      i = smallest;
+   }
+}
+
+static int dir_du_top_accepts( const struct dir_du_top* top, unsigned int num_top, dir_uint64 key )
+{
+   return top->count < num_top || ( num_top > 0 && key > top->entries[0].key );
+}
+
+/* add entry, that should be accepted by dir_du_top_accepts, taking ownership of its path */
+static void dir_du_top_insert( struct dir_du_top* top, unsigned int num_top, const struct dir_du_entry* entry )
+{
+   unsigned int i;
+   if ( top->count == num_top )
+   {
+      DIRUTIL_FREE( top->entries[0].path );
+      top->entries[0] = *entry;
+      dir_du_heap_sift_down( top->entries, top->count, 0 );
+      return;
+   }
+
+   i = top->count++;
+   while ( i > 0 && entry->key < top->entries[( i - 1 ) / 2].key )
+   {
+      top->entries[i] = top->entries[( i - 1 ) / 2];
+      i = ( i - 1 ) / 2;
+   }
+   top->entries[i] = *entry;
+}
+
+static int dir_du_visit( struct dir_pwalk_worker* worker, struct dir_pwalk_node* dir, const char* item_name, unsigned int path_len, int is_dir )
+{
+   struct dir_du_node* node = (struct dir_du_node*)dir->extra;
+#if defined( _WIN32 )
+   const WIN32_FIND_DATAA* ffd = &dir->reader.ffd;
+   dir_uint64 size;
+#else
+   struct stat s;
+#endif
+   (void)path_len;
+
+   /* directories count themselves on completion */
+   if ( is_dir )
+      return 1;
+
+#if defined( _WIN32 )
+   (void)worker; (void)item_name;
+   size = ( (dir_uint64)ffd->nFileSizeHigh << 32 ) | ffd->nFileSizeLow;
+   node->own.size += size;
+   node->own.allocated += size;
+#else
+   if ( fstatat( dir_walk_reader_fd( &dir->reader ), item_name, &s, AT_SYMLINK_NOFOLLOW ) != 0 )
+      return 0;
+
+   if ( s.st_nlink > 1 )
+   {
+      int inserted = dir_du_link_insert( (struct dir_du_ctx*)worker->walk->userdata, (dir_uint64)s.st_dev, (dir_uint64)s.st_ino );
+      if ( inserted < 0 )
+         dir_pwalk_fail( worker->walk, DIR_ERROR_FAILED, 1 );
+      if ( inserted <= 0 )
+         return 0;
+   }
+
+   node->own.size += (dir_uint64)s.st_size;
+   node->own.allocated += (dir_uint64)s.st_blocks * 512;
+#endif
+   ++node->own.num_files;
+   return 0;
+}
+
+static void dir_du_complete( struct dir_pwalk_worker* worker, struct dir_pwalk_node* dir )
+{
+   struct dir_pwalk* walk = worker->walk;
+   struct dir_du_ctx* ctx = (struct dir_du_ctx*)walk->userdata;
+   struct dir_du_node* node = (struct dir_du_node*)dir->extra;
+   struct dir_du_totals totals;
+   struct dir_pwalk_node* parent;
+   unsigned int depth = 0;
+   unsigned int callback_path_offset = ( walk->filter.flags & DIR_WALK_ROOT_RELATIVE_PATHS ) ? ( walk->filter.root_path_len + 1 ) : 0;
+#if !defined( _WIN32 )
+   struct stat s;
+   int stat_result;
+#endif
+
+   if ( dir_atomic_load( &walk->aborted ) )
+      return;
+
+   for ( parent = dir->parent; parent; parent = parent->parent )
+      ++depth;
+   if ( callback_path_offset > dir->path_len )
+      callback_path_offset = dir->path_len;
+
+   totals.size = node->own.size + node->sub.size;
+   totals.allocated = node->own.allocated + node->sub.allocated;
+   totals.num_files = node->own.num_files + node->sub.num_files;
+   totals.num_dirs = node->sub.num_dirs;
+
+   /* the size of the directory itself, windows do not report any */
+#if !defined( _WIN32 )
+   if ( dir->parent )
+      stat_result = fstatat( dir_walk_reader_fd( &dir->parent->reader ), dir->path + dir->name_offset, &s, AT_SYMLINK_NOFOLLOW );
+   else
+      stat_result = stat( dir->path, &s );
+   if ( stat_result == 0 )
+   {
+      totals.size += (dir_uint64)s.st_size;
+      totals.allocated += (dir_uint64)s.st_blocks * 512;
+   }
+#endif
+
+   if ( dir->parent )
+   {
+      struct dir_du_totals* sub = &( (struct dir_du_node*)dir->parent->extra )->sub;
+      dir_atomic_add64( &sub->size, totals.size );
+      dir_atomic_add64( &sub->allocated, totals.allocated );
+      dir_atomic_add64( &sub->num_files, totals.num_files );
+      dir_atomic_add64( &sub->num_dirs, totals.num_dirs + 1 );
+   }
+   else if ( ctx->totals )
+      *ctx->totals = totals;
+
+   if ( ctx->top )
+   {
+      struct dir_du_top* top = &ctx->top[worker->index];
+      struct dir_du_entry entry;
+      entry.key = dir_du_key( ctx->order, &totals );
+      if ( !dir_du_top_accepts( top, ctx->num_top, entry.key ) )
+         return;
+
+      entry.path_len = dir->path_len - callback_path_offset;
+      entry.path = (char*)DIRUTIL_MALLOC( entry.path_len + 1 );
+      if ( entry.path == 0x0 )
+      {
+         dir_pwalk_fail( walk, DIR_ERROR_FAILED, 1 );
+         return;
+      }
+      memcpy( entry.path, dir->path + callback_path_offset, entry.path_len + 1 );
+      entry.depth = depth;
+      entry.totals = totals;
+      dir_du_top_insert( top, ctx->num_top, &entry );
+   }
+   else if ( ctx->callback && depth <= ctx->max_depth )
+   {
+      if ( dir_walk_result_is_abort( ctx->callback( dir->path + callback_path_offset, dir->path_len - callback_path_offset, depth, &totals, worker->index, ctx->userdata ) ) )
+         dir_pwalk_fail( walk, DIR_ERROR_ABORTED, 1 );
+   }
+}
+
+static enum dir_error dir_du_run( struct dir_du_ctx* ctx, const char* path, unsigned int flags, unsigned int num_threads )
+{
+   struct dir_pwalk walk;
+   enum dir_error result;
+   unsigned int i;
+
+   for ( i = 0; i < DIR_DU_LINK_STRIPES; ++i )
+   {
+      dir_mutex_init( &ctx->links[i].lock );
+      ctx->links[i].set.keys = 0x0;
+      ctx->links[i].set.count = 0;
+      ctx->links[i].set.capacity = 0;
+   }
+
+   walk.visit = dir_du_visit;
+   walk.complete = dir_du_complete;
+   walk.userdata = ctx;
+   walk.node_extra_size = sizeof( struct dir_du_node );
+
+   flags &= DIR_WALK_IGNORE_DOT_DIRECTORIES | DIR_WALK_IGNORE_DOT_FILES | DIR_WALK_ROOT_RELATIVE_PATHS | DIR_WALK_PATHS_SLASH_MASK |
+            DIR_WALK_SAME_FILESYSTEM | DIR_WALK_FOLLOW_SYMLINKS | DIR_WALK_MAX_DEPTH_MASK;
+   result = dir_pwalk_run( &walk, path, flags, 0x0, 0x0, num_threads );
+
+   for ( i = 0; i < DIR_DU_LINK_STRIPES; ++i )
+   {
+      DIRUTIL_FREE( ctx->links[i].set.keys );
+      dir_mutex_destroy( &ctx->links[i].lock );
+   }
+   return result;
+}
+
+DIRUTIL_API enum dir_error dir_du( const char* path, unsigned int flags, unsigned int max_depth,
+   unsigned int num_threads, dir_du_callback callback, void* userdata, struct dir_du_totals* totals )
+{
+   struct dir_du_ctx ctx;
+
+   ctx.callback = callback;
+   ctx.userdata = userdata;
+   ctx.max_depth = max_depth;
+   ctx.totals = totals;
+   ctx.top = 0x0;
+   ctx.num_top = 0;
+   ctx.order = DIR_DU_BY_ALLOCATED;
+
+   return dir_du_run( &ctx, path, flags, num_threads );
+}
+
+DIRUTIL_API enum dir_error dir_du_top( const char* path, unsigned int flags, enum dir_du_order order, unsigned int num_top,
+   unsigned int num_threads, dir_du_callback callback, void* userdata, struct dir_du_totals* totals )
+{
+   struct dir_du_ctx ctx;
+   struct dir_du_top* top;
+   enum dir_error result;
+   unsigned int i, j, num_workers = num_threads ? num_threads : dir_thread_hardware_concurrency();
+
+   ctx.callback = callback;
+   ctx.userdata = userdata;
+   ctx.max_depth = 0;
+   ctx.totals = totals;
+   ctx.num_top = num_top;
+   ctx.order = order;
+
+   /* the heaps of all workers in one allocation */
+   ctx.top = (struct dir_du_top*)DIRUTIL_MALLOC( num_workers * ( sizeof( struct dir_du_top ) + num_top * sizeof( struct dir_du_entry ) ) );
+   if ( ctx.top == 0x0 )
+      return DIR_ERROR_FAILED;
+   for ( i = 0; i < num_workers; ++i )
+   {
+      ctx.top[i].entries = (struct dir_du_entry*)( ctx.top + num_workers ) + i * num_top;
+      ctx.top[i].count = 0;
+   }
+
+   result = dir_du_run( &ctx, path, flags, num_workers );
+
+   /* merge into the heap of the first worker and sort it, largest first, by moving the smallest to the back */
+   top = &ctx.top[0];
+   for ( i = 1; i < num_workers; ++i )
+   {
+      for ( j = 0; j < ctx.top[i].count; ++j )
+      {
+         if ( dir_du_top_accepts( top, num_top, ctx.top[i].entries[j].key ) )
+            dir_du_top_insert( top, num_top, &ctx.top[i].entries[j] );
+         else
+            DIRUTIL_FREE( ctx.top[i].entries[j].path );
+      }
+   }
+   for ( i = top->count; i > 1; --i )
+   {
+      struct dir_du_entry tmp = top->entries[0];
+      top->entries[0] = top->entries[i - 1];
+      top->entries[i - 1] = tmp;
+      dir_du_heap_sift_down( top->entries, i - 1, 0 );
+   }
+
+   for ( i = 0; i < top->count; ++i )
+   {
+      const struct dir_du_entry* entry = &top->entries[i];
+      if ( result == DIR_ERROR_OK && callback && dir_walk_result_is_abort( callback( entry->path, entry->path_len, entry->depth, &entry->totals, 0, userdata ) ) )
+         result = DIR_ERROR_ABORTED;
+      DIRUTIL_FREE( entry->path );
+   }
+   DIRUTIL_FREE( ctx.top );
+   return result;
+}
+
+/*
+   64-bit hash of file contents, the XXH64 algorithm by Yann Collet, fed in pieces so that files can be read in chunks.
+   input is read as little-endian on all platforms so that the hashes are the same everywhere.
+*/
+#define DIR_U64( hi, lo ) ( ( (dir_uint64)( hi ) << 32 ) | (dir_uint64)( lo ) )
+#define DIR_HASH_PRIME1 DIR_U64( 0x9e3779b1u, 0x85ebca87u )
+#define DIR_HASH_PRIME2 DIR_U64( 0xc2b2ae3du, 0x27d4eb4fu )
+#define DIR_HASH_PRIME3 DIR_U64( 0x165667b1u, 0x9e3779f9u )
+#define DIR_HASH_PRIME4 DIR_U64( 0x85ebca77u, 0xc2b2ae63u )
+#define DIR_HASH_PRIME5 DIR_U64( 0x27d4eb2fu, 0x165667c5u )
+
+struct dir_hash_state
+{
+   dir_uint64 v[4];
+   dir_uint64 total_len;
+   dir_uint64 seed;
+   unsigned char buffer[32];
+   unsigned int buffer_len;
+};
+
+static dir_uint64 dir_hash_rotl( dir_uint64 x, unsigned int r )
+{
+   return ( x << r ) | ( x >> ( 64 - r ) );
+}
+
+static dir_uint64 dir_hash_read64( const unsigned char* p )
+{
+   return (dir_uint64)p[0]         | (dir_uint64)p[1] << 8  | (dir_uint64)p[2] << 16 | (dir_uint64)p[3] << 24 |
+          (dir_uint64)p[4] << 32   | (dir_uint64)p[5] << 40 | (dir_uint64)p[6] << 48 | (dir_uint64)p[7] << 56;
+}
+
+static dir_uint64 dir_hash_read32( const unsigned char* p )
+{
+   return (dir_uint64)p[0] | (dir_uint64)p[1] << 8 | (dir_uint64)p[2] << 16 | (dir_uint64)p[3] << 24;
+}
+
+static dir_uint64 dir_hash_round( dir_uint64 acc, dir_uint64 input )
+{
+   acc += input * DIR_HASH_PRIME2;
+   return dir_hash_rotl( acc, 31 ) * DIR_HASH_PRIME1;
+}
+
+static dir_uint64 dir_hash_merge_round( dir_uint64 acc, dir_uint64 v )
+{
+   acc ^= dir_hash_round( 0, v );
+   return acc * DIR_HASH_PRIME1 + DIR_HASH_PRIME4;
+}
+
+static void dir_hash_init( struct dir_hash_state* state, dir_uint64 seed )
+{
+   state->v[0] = seed + DIR_HASH_PRIME1 + DIR_HASH_PRIME2;
+   state->v[1] = seed + DIR_HASH_PRIME2;
+   state->v[2] = seed;
+   state->v[3] = seed - DIR_HASH_PRIME1;
+   state->total_len = 0;
+   state->seed = seed;
+   state->buffer_len = 0;
+}
+
+static void dir_hash_update( struct dir_hash_state* state, const void* data, dir_uint64 size )
+{
+   const unsigned char* p = (const unsigned char*)data;
+   const unsigned char* end = p + size;
+   state->total_len += size;
+
+   if ( state->buffer_len + size < 32 )
+   {
+      memcpy( state->buffer + state->buffer_len, p, (size_t)size );
+      state->buffer_len += (unsigned int)size;
+      return;
+   }
+
+   if ( state->buffer_len )
+   {
+      unsigned int fill = 32 - state->buffer_len;
+      memcpy( state->buffer + state->buffer_len, p, fill );
+      p += fill;
+      state->v[0] = dir_hash_round( state->v[0], dir_hash_read64( state->buffer ) );
+      state->v[1] = dir_hash_round( state->v[1], dir_hash_read64( state->buffer + 8 ) );
+      state->v[2] = dir_hash_round( state->v[2], dir_hash_read64( state->buffer + 16 ) );
+      state->v[3] = dir_hash_round( state->v[3], dir_hash_read64( state->buffer + 24 ) );
+      state->buffer_len = 0;
+   }
+
+   if ( end - p >= 32 )
+   {
+      dir_uint64 v0 = state->v[0], v1 = state->v[1], v2 = state->v[2], v3 = state->v[3];
+      do
+      {
+         v0 = dir_hash_round( v0, dir_hash_read64( p ) );
+         v1 = dir_hash_round( v1, dir_hash_read64( p + 8 ) );
+         v2 = dir_hash_round( v2, dir_hash_read64( p + 16 ) );
+         v3 = dir_hash_round( v3, dir_hash_read64( p + 24 ) );
+         p += 32;
+      } while ( end - p >= 32 );
+      state->v[0] = v0; state->v[1] = v1; state->v[2] = v2; state->v[3] = v3;
+   }
+
+   memcpy( state->buffer, p, (size_t)( end - p ) );
+   state->buffer_len = (unsigned int)( end - p );
+}
+
+static dir_uint64 dir_hash_digest( const struct dir_hash_state* state )
+{
+   const unsigned char* p = state->buffer;
+   const unsigned char* end = p + state->buffer_len;
+   dir_uint64 h;
+
+   if ( state->total_len >= 32 )
+   {
+      h = dir_hash_rotl( state->v[0], 1 ) + dir_hash_rotl( state->v[1], 7 ) + dir_hash_rotl( state->v[2], 12 ) + dir_hash_rotl( state->v[3], 18 );
+      h = dir_hash_merge_round( h, state->v[0] );
+      h = dir_hash_merge_round( h, state->v[1] );
+      h = dir_hash_merge_round( h, state->v[2] );
+      h = dir_hash_merge_round( h, state->v[3] );
+   }
+   else
+      h = state->seed + DIR_HASH_PRIME5;
+   h += state->total_len;
+
+   for ( ; end - p >= 8; p += 8 )
+      h = dir_hash_rotl( h ^ dir_hash_round( 0, dir_hash_read64( p ) ), 27 ) * DIR_HASH_PRIME1 + DIR_HASH_PRIME4;
+   if ( end - p >= 4 )
+   {
+      h = dir_hash_rotl( h ^ dir_hash_read32( p ) * DIR_HASH_PRIME1, 23 ) * DIR_HASH_PRIME2 + DIR_HASH_PRIME3;
+      p += 4;
+   }
+   for ( ; p < end; ++p )
+      h = dir_hash_rotl( h ^ *p * DIR_HASH_PRIME5, 11 ) * DIR_HASH_PRIME1;
+
+   h ^= h >> 33;
+   h *= DIR_HASH_PRIME2;
+   h ^= h >> 29;
+   h *= DIR_HASH_PRIME3;
+   h ^= h >> 32;
+   return h;
+}
+
+static dir_uint64 dir_hash64( const void* data, dir_uint64 size, dir_uint64 seed )
+{
+   struct dir_hash_state state;
+   dir_hash_init( &state, seed );
+   dir_hash_update( &state, data, size );
+   return dir_hash_digest( &state );
+}
+
+#if !defined( DIRUTIL_HASH_BUFFER_SIZE )
+   #define DIRUTIL_HASH_BUFFER_SIZE ( 1024 * 1024 )
+#endif
+
+/*
+   hashing walk, on top of the parallel walk engine.
+
+   each item in a directory adds the hash of its name, seeded by the hash of its content, to the sum of its
+   directory. files are added to 'own' by the one worker reading the directory and sub-directories atomically to
+   'sub' on completion. the hash of a directory is the hash of the total sum and number of items when it completes,
+   independent of the order the items were read and completed in.
+*/
+struct dir_hash_node
+{
+   dir_uint64 own_sum;
+   dir_uint64 own_count;
+   dir_uint64 sub_sum;
+   dir_uint64 sub_count;
+};
+
+/* state for 'dir_walk_hash' */
+struct dir_walk_hash_ctx
+{
+   dir_hash_cached_callback cached;
+   dir_hash_callback callback;
+   void* userdata;
+   dir_uint64* root_hash;
+   char** buffers; /* one per worker, allocated the first time a file is read through it */
+};
+
+/* seeds of the hash of the name of an item, so that a file and a directory with the same name and hash differs */
+#define DIR_HASH_SEED_FILE 1
+#define DIR_HASH_SEED_DIR  2
+
+static dir_uint64 dir_walk_hash_item( const char* name, unsigned int name_len, dir_uint64 hash, int is_dir )
+{
+   return dir_hash64( name, name_len, hash * DIR_HASH_PRIME1 + ( is_dir ? DIR_HASH_SEED_DIR : DIR_HASH_SEED_FILE ) );
+}
+
+#if defined( _WIN32 )
+
+static int dir_walk_hash_file( struct dir_walk_hash_ctx* ctx, unsigned int worker_index, const struct dir_walk_reader* reader,
+   const char* item_name, const char* path, const struct dir_item_info* info, dir_uint64* hash )
+{
+   struct dir_hash_state state;
+   HANDLE file;
+   DWORD n;
+   char* buffer;
+   int ok = 1;
+   (void)reader; (void)item_name;
+
+   (void)info; /* symlinks are followed, reading the path they refer to needs a reparse point ioctl */
+
+   buffer = ctx->buffers[worker_index];
+   if ( buffer == 0x0 )
+      buffer = ctx->buffers[worker_index] = (char*)DIRUTIL_MALLOC( DIRUTIL_HASH_BUFFER_SIZE );
+   if ( buffer == 0x0 )
+      return 0;
+
+   file = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 0x0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0x0 );
+   if ( file == INVALID_HANDLE_VALUE )
+      return 0;
+   dir_hash_init( &state, 0 );
+   while ( ( ok = ReadFile( file, buffer, DIRUTIL_HASH_BUFFER_SIZE, &n, 0x0 ) != 0 ) && n > 0 )
+      dir_hash_update( &state, buffer, n );
+   CloseHandle( file );
+   *hash = dir_hash_digest( &state );
+   return ok;
+}
+
+#else
+
+static int dir_walk_hash_file( struct dir_walk_hash_ctx* ctx, unsigned int worker_index, const struct dir_walk_reader* reader,
+   const char* item_name, const char* path, const struct dir_item_info* info, dir_uint64* hash )
+{
+   struct dir_hash_state state;
+   struct stat s;
+   char* buffer;
+   int fd;
+   (void)path;
+
+   if ( info->is_symlink )
+   {
+      char target[4096];
+      ssize_t len = readlinkat( dir_walk_reader_fd( reader ), item_name, target, sizeof( target ) );
+      if ( len < 0 )
+         return 0;
+      *hash = dir_hash64( target, (dir_uint64)len, 0 );
+      return 1;
+   }
+
+   /* non-blocking so that a fifo that replaced the file is not waited for */
+   fd = openat( dir_walk_reader_fd( reader ), item_name, O_RDONLY | O_NOFOLLOW | O_NONBLOCK | O_CLOEXEC );
+   if ( fd < 0 )
+      return 0;
+   if ( fstat( fd, &s ) != 0 || !S_ISREG( s.st_mode ) )
+   {
+      close( fd );
+      return 0;
+   }
+
+   dir_hash_init( &state, 0 );
+   if ( (dir_uint64)s.st_size > DIRUTIL_HASH_BUFFER_SIZE && (dir_uint64)(size_t)s.st_size == (dir_uint64)s.st_size )
+   {
+      void* data = mmap( 0x0, (size_t)s.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+      if ( data != MAP_FAILED )
+      {
+         #if defined( POSIX_MADV_SEQUENTIAL )
+            posix_madvise( data, (size_t)s.st_size, POSIX_MADV_SEQUENTIAL );
+         #endif
+         dir_hash_update( &state, data, (dir_uint64)s.st_size );
+         munmap( data, (size_t)s.st_size );
+         close( fd );
+         *hash = dir_hash_digest( &state );
+         return 1;
+      }
+   }
+
+   buffer = ctx->buffers[worker_index];
+   if ( buffer == 0x0 )
+      buffer = ctx->buffers[worker_index] = (char*)DIRUTIL_MALLOC( DIRUTIL_HASH_BUFFER_SIZE );
+   if ( buffer == 0x0 )
+   {
+      close( fd );
+      return 0;
+   }
+
+   for ( ;; )
+   {
+      ssize_t n = read( fd, buffer, DIRUTIL_HASH_BUFFER_SIZE );
+      if ( n == 0 )
+         break;
+      if ( n < 0 )
+      {
+         if ( errno == EINTR )
+            continue;
+         close( fd );
+         return 0;
+      }
+      dir_hash_update( &state, buffer, (dir_uint64)n );
+   }
+   close( fd );
+   *hash = dir_hash_digest( &state );
+   return 1;
+}
+
+#endif
+
+static int dir_walk_hash_visit( struct dir_pwalk_worker* worker, struct dir_pwalk_node* dir, const char* item_name, unsigned int path_len, int is_dir )
+{
+   struct dir_pwalk* walk = worker->walk;
+   struct dir_walk_hash_ctx* ctx = (struct dir_walk_hash_ctx*)walk->userdata;
+   struct dir_hash_node* node = (struct dir_hash_node*)dir->extra;
+   unsigned int flags = walk->filter.flags;
+   unsigned int callback_path_offset = ( flags & DIR_WALK_ROOT_RELATIVE_PATHS ) ? ( walk->filter.root_path_len + 1 ) : 0;
+   unsigned int item_len = path_len - (unsigned int)( item_name - worker->path.data );
+   struct dir_item_info info;
+   dir_uint64 hash;
+
+   if ( is_dir )
+      return ( flags & DIR_WALK_SINGLE_DIRECTORY ) ? DIR_WALK_FILTER_SKIP : dir_walk_filter_match_directory( &walk->filter, worker->path.data, path_len );
+
+   /* files in directories only walked to reach matching sub-directories are not hashed */
+   if ( dir->visit_result == DIR_WALK_FILTER_PARTIAL || !dir_walk_filter_match_file( &walk->filter, item_name, item_len ) )
+      return DIR_WALK_FILTER_SKIP;
+
+   dir_walk_reader_item_info( &dir->reader, item_name, DIR_ITEM_INFO_ALL, &info );
+   #if !defined( _WIN32 )
+      if ( !( info.valid & DIR_ITEM_INFO_MODE ) )
+      {
+         dir_pwalk_fail( walk, DIR_ERROR_FAILED, 0 );
+         return DIR_WALK_FILTER_SKIP;
+      }
+      /* other special files are not hashed */
+      if ( !info.is_symlink && !S_ISREG( info.mode ) )
+         return DIR_WALK_FILTER_SKIP;
+   #endif
+
+   if ( !( ctx->cached && ctx->cached( worker->path.data + callback_path_offset, path_len - callback_path_offset, &info, &hash, ctx->userdata ) ) &&
+        !dir_walk_hash_file( ctx, worker->index, &dir->reader, item_name, worker->path.data, &info, &hash ) )
+   {
+      dir_pwalk_fail( walk, DIR_ERROR_FAILED, 0 );
+      return DIR_WALK_FILTER_SKIP;
+   }
+
+   node->own_sum += dir_walk_hash_item( item_name, item_len, hash, 0 );
+   ++node->own_count;
+
+   if ( ctx->callback && ( flags & DIR_WALK_ONLY_DIRECTORIES ) == 0 )
+   {
+      if ( dir_walk_result_is_abort( ctx->callback( worker->path.data + callback_path_offset, path_len - callback_path_offset, DIR_ITEM_FILE, hash, &info, worker->index, ctx->userdata ) ) )
+         dir_pwalk_fail( walk, DIR_ERROR_ABORTED, 1 );
+   }
+   return DIR_WALK_FILTER_SKIP;
+}
+
+static void dir_walk_hash_complete( struct dir_pwalk_worker* worker, struct dir_pwalk_node* dir )
+{
+   struct dir_pwalk* walk = worker->walk;
+   struct dir_walk_hash_ctx* ctx = (struct dir_walk_hash_ctx*)walk->userdata;
+   struct dir_hash_node* node = (struct dir_hash_node*)dir->extra;
+   unsigned int flags = walk->filter.flags;
+   unsigned int callback_path_offset = ( flags & DIR_WALK_ROOT_RELATIVE_PATHS ) ? ( walk->filter.root_path_len + 1 ) : 0;
+   unsigned char totals[16];
+   dir_uint64 sum, count, hash;
+   unsigned int i;
+
+   if ( dir_atomic_load( &walk->aborted ) )
+      return;
+   if ( !dir->is_open && !dir->not_walked )
+      dir_pwalk_fail( walk, DIR_ERROR_FAILED, 0 );
+
+   sum = node->own_sum + node->sub_sum;
+   count = node->own_count + node->sub_count;
+   for ( i = 0; i < 8; ++i )
+   {
+      totals[i] = (unsigned char)( sum >> ( i * 8 ) );
+      totals[8 + i] = (unsigned char)( count >> ( i * 8 ) );
+   }
+   hash = dir_hash64( totals, sizeof( totals ), DIR_HASH_SEED_DIR );
+
+   if ( dir->parent == 0x0 )
+   {
+      if ( ctx->root_hash )
+         *ctx->root_hash = hash;
+      return;
+   }
+
+   {
+      struct dir_hash_node* parent = (struct dir_hash_node*)dir->parent->extra;
+      dir_atomic_add64( &parent->sub_sum, dir_walk_hash_item( dir->path + dir->name_offset, dir->path_len - dir->name_offset, hash, 1 ) );
+      dir_atomic_add64( &parent->sub_count, 1 );
+   }
+
+   if ( ctx->callback && dir->visit_result == DIR_WALK_FILTER_MATCH && ( flags & DIR_WALK_ONLY_FILES ) == 0 )
+   {
+      struct dir_item_info info;
+      info.valid = 0;
+      if ( dir_walk_result_is_abort( ctx->callback( dir->path + callback_path_offset, dir->path_len - callback_path_offset, DIR_ITEM_DIR, hash, &info, worker->index, ctx->userdata ) ) )
+         dir_pwalk_fail( walk, DIR_ERROR_ABORTED, 1 );
+   }
+}
+
+DIRUTIL_API enum dir_error dir_walk_hash( const char* path, unsigned int flags,
+   const char* optional_glob_directories, const char* optional_glob_files, unsigned int num_threads,
+   dir_hash_cached_callback cached, dir_hash_callback callback, void* userdata, dir_uint64* root_hash )
+{
+   struct dir_pwalk walk;
+   struct dir_walk_hash_ctx ctx;
+   enum dir_error result;
+   unsigned int i, num_workers = num_threads ? num_threads : dir_thread_hardware_concurrency();
+
+   ctx.cached = cached;
+   ctx.callback = callback;
+   ctx.userdata = userdata;
+   ctx.root_hash = root_hash;
+   ctx.buffers = (char**)DIRUTIL_MALLOC( num_workers * sizeof( char* ) );
+   if ( ctx.buffers == 0x0 )
+      return DIR_ERROR_FAILED;
+   memset( ctx.buffers, 0, num_workers * sizeof( char* ) );
+
+   walk.visit = dir_walk_hash_visit;
+   walk.complete = dir_walk_hash_complete;
+   walk.userdata = &ctx;
+   walk.node_extra_size = sizeof( struct dir_hash_node );
+
+   result = dir_pwalk_run( &walk, path, flags, optional_glob_directories, optional_glob_files, num_workers );
+
+   for ( i = 0; i < num_workers; ++i )
+      DIRUTIL_FREE( ctx.buffers[i] );
+   DIRUTIL_FREE( ctx.buffers );
+   return result;
+}
+
+#endif /* !defined( DIRUTIL_NO_THREADS ) */
+
+DIRUTIL_API enum dir_error dir_create( const char* path )
+{
+#if defined( _WIN32 )
+   if ( CreateDirectoryA( path, 0x0 ) )
+      return DIR_ERROR_OK;
+   if ( GetLastError() == ERROR_ALREADY_EXISTS )
+      return DIR_ERROR_OK;
+#else
+   if ( mkdir( path, 0777 ) == 0 )
+      return DIR_ERROR_OK;
+   if ( errno == EEXIST )
+      return DIR_ERROR_OK;
+#endif
+   return DIR_ERROR_FAILED;
+}
+
+#if defined( _WIN32 )
+static int dir_walk_rmitem( const char* path, unsigned int path_len, enum dir_item_type type, void* userdata )
+{
+   (void)path_len;
+   switch ( type )
+   {
+   case DIR_ITEM_FILE:
+      if ( !DeleteFileA( path ) )
+         *((enum dir_error*)userdata) = DIR_ERROR_FAILED;
+      break;
+   case DIR_ITEM_DIR:
+      #pragma warning( push )
+      #pragma warning( disable : 4996 ) /* 'rmdir': the POSIX name for this item is deprecated... */
+      if ( rmdir( path ) != 0 )
+         *((enum dir_error*)userdata) = DIR_ERROR_FAILED;
+      #pragma warning( pop )
+      break;
+   default:
+      break;
+   }
+   return *((enum dir_error*)userdata) == DIR_ERROR_OK ? DIR_WALK_CONTINUE : DIR_WALK_ABORT;
+}
+#else
+/* remove everything in path, each item relative to the open directory it is in so that paths longer than PATH_MAX can be removed */
+static enum dir_error dir_rmtree_items( const char* path )
+{
+   struct dir_iter iter;
+   struct dir_iter_item item;
+   enum dir_error result = dir_iter_init( &iter, path, DIR_WALK_DEPTH_FIRST, 0, 0x0, 0x0, 0x0, 0x0, 0x0 );
+   if ( result != DIR_ERROR_OK )
+      return result;
+
+   /* depth first, so the directory on top of the stack is the one the item is in, also when a directory is reported */
+   while ( dir_iter_next( &iter, &item ) )
+   {
+      const char* name = item.path + item.path_len;
+      while ( name != item.path && !DIR_IS_SEP( name[-1] ) )
+         --name;
+
+      if ( unlinkat( dir_walk_reader_fd( &iter.stack[iter.depth - 1].reader ), name, item.type == DIR_ITEM_DIR ? AT_REMOVEDIR : 0 ) != 0 )
+      {
+         dir_iter_release( &iter );
+         return DIR_ERROR_FAILED;
+      }
+   }
+
+   result = iter.error;
+   dir_iter_release( &iter );
+   return result;
+}
+#endif
+
+DIRUTIL_API enum dir_error dir_rmtree( const char* path )
+{
+#if defined( _WIN32 )
+   enum dir_error res = DIR_ERROR_OK;
+   enum dir_error e = dir_walk( path, DIR_WALK_DEPTH_FIRST, dir_walk_rmitem, &res );
+   if ( res != DIR_ERROR_OK )
+      return res;
+#else
+   enum dir_error e = dir_rmtree_items( path );
+#endif
+   if ( e != DIR_ERROR_OK )
+      return e;
+
+   #if defined ( _WIN32 )
+      #pragma warning( push )
+      #pragma warning( disable : 4996 ) /* 'rmdir': the POSIX name for this item is deprecated... */
+   #endif
+   return rmdir( path ) == 0 ? DIR_ERROR_OK : DIR_ERROR_FAILED;
+   #if defined ( _WIN32 )
+      #pragma warning( pop )
+   #endif
+}
+
+DIRUTIL_API enum dir_error dir_mktree( const char* path )
+{
+   struct dir_path_buffer buffer;
+   enum dir_error err;
+   char* path_buffer;
+   char* beg;
+#if !defined( _WIN32 )
+   int dir_fd;
+#endif
+
+   dir_path_buffer_init( &buffer );
+   if ( !dir_walk_root_path( path, DIR_SEP_PLATFORM, &buffer ) )
+   {
+      dir_path_buffer_free( &buffer );
+      return DIR_ERROR_FAILED;
+   }
+   path_buffer = beg = buffer.data;
+
+   /* if path is absolute, we need to start trying to create directories from the second '/',
+    * otherwise we would try to create the dir "" */
+   if ( *beg == DIR_SEP_PLATFORM )
+      ++beg;
+
+#if defined( _WIN32 )
+   for ( ;; )
+   {
+      char* sep = strchr( beg, DIR_SEP_PLATFORM );
+      if ( sep == 0 )
+      {
+         err = dir_create( path_buffer );
+         break;
+      }
+
+      *sep = '\0';
+      err = dir_create( path_buffer );
+      if ( err != DIR_ERROR_OK )
+         break;
+
+      *sep = DIR_SEP_PLATFORM;
+      beg = sep + 1;
+   }
+#else
+   /* each directory is created relative to an open parent, as the walk opens directories, so that paths longer than PATH_MAX can be created */
+   dir_fd = open( beg != path_buffer ? "/" : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+   err = dir_fd < 0 ? DIR_ERROR_FAILED : DIR_ERROR_OK;
+   while ( err == DIR_ERROR_OK )
+   {
+      char* sep = strchr( beg, DIR_SEP_PLATFORM );
+      if ( sep )
+         *sep = '\0';
+
+      if ( *beg != '\0' && mkdirat( dir_fd, beg, 0777 ) != 0 && errno != EEXIST )
+         err = DIR_ERROR_FAILED;
+      else if ( sep == 0 )
+         break;
+      else
+      {
+         int parent_fd = dir_fd;
+         dir_fd = openat( parent_fd, beg, O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+         close( parent_fd );
+         if ( dir_fd < 0 )
+            err = DIR_ERROR_FAILED;
+         beg = sep + 1;
+      }
+   }
+   if ( dir_fd >= 0 )
+      close( dir_fd );
+#endif
+
+   dir_path_buffer_free( &buffer );
+   return err;
+}
+
+static int dir_glob_match_range( const char* range_start, const char* range_end, char match_char )
+{
+   int match_return = 1;
+   if ( *range_start == '!' )
+   {
+      match_return = 0;
+      ++range_start;
+   }
+
+   while ( range_start <= range_end )
+   {
+      if ( range_start + 2 <= range_end && range_start[1] == '-' )
+      {
+         if ( range_start[0] <= match_char && match_char <= range_start[2] )
+            return match_return;
+         range_start += 3;
+      }
+      else
+      {
+         if ( *range_start == match_char )
+            return match_return;
+         ++range_start;
+      }
+   }
+
+   return !match_return;
+}
+
+/* find index of lowest set bit */
+static unsigned int dir_bit_index( unsigned int bits )
+{
+#if defined( __GNUC__ )
+   return (unsigned int)__builtin_ctz( bits );
+#else
+   unsigned int index = 0;
+   while ( ( bits & 1 ) == 0 )
+   {
+      bits >>= 1;
+      ++index;
+   }
+   return index;
+#endif
+}
+
+/* first char in [s, end) that is 'c' or a path-separator, end if there is none */
+static const char* dir_glob_find_sep_or_scalar( const char* s, const char* end, char c )
+{
+   while ( s != end && *s != c && !DIR_IS_SEP( *s ) )
+      ++s;
+   return s;
+}
+
+#if defined( DIR_SIMD_SSE2 )
+static const char* dir_glob_find_sep_or_sse2( const char* s, const char* end, char c )
+{
+   const __m128i fwd  = _mm_set1_epi8( '/' );
+   const __m128i back = _mm_set1_epi8( '\\' );
+   const __m128i find = _mm_set1_epi8( c );
+   for ( ; end - s >= 16; s += 16 )
+   {
+      __m128i block = _mm_loadu_si128( (const __m128i*)s );
+      __m128i hit   = _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8( block, fwd ), _mm_cmpeq_epi8( block, back ) ), _mm_cmpeq_epi8( block, find ) );
+      unsigned int hits = (unsigned int)_mm_movemask_epi8( hit );
+      if ( hits )
+         return s + dir_bit_index( hits );
+   }
+   return dir_glob_find_sep_or_scalar( s, end, c );
+}
+#endif
+
+#if defined( DIR_SIMD_AVX2 )
+__attribute__(( target( "avx2" ) ))
+static const char* dir_glob_find_sep_or_avx2( const char* s, const char* end, char c )
+{
+   const __m256i fwd  = _mm256_set1_epi8( '/' );
+   const __m256i back = _mm256_set1_epi8( '\\' );
+   const __m256i find = _mm256_set1_epi8( c );
+   for ( ; end - s >= 32; s += 32 )
+   {
+      __m256i block = _mm256_loadu_si256( (const __m256i*)s );
+      __m256i hit   = _mm256_or_si256( _mm256_or_si256( _mm256_cmpeq_epi8( block, fwd ), _mm256_cmpeq_epi8( block, back ) ), _mm256_cmpeq_epi8( block, find ) );
+      unsigned int hits = (unsigned int)_mm256_movemask_epi8( hit );
+      if ( hits )
+      {
+         _mm256_zeroupper();
+         return s + dir_bit_index( hits );
+      }
+   }
+   _mm256_zeroupper(); /* see dir_path_tidy_avx2 */
+   return dir_glob_find_sep_or_sse2( s, end, c );
+}
+#endif
+
+/* used by both the interpreted and the compiled glob-patterns to skip over a path-segment for '*' and '**' */
+static const char* dir_glob_find_sep_or( const char* s, const char* end, char c )
+{
+#if defined( DIR_SIMD_AVX2 )
+   if ( end - s >= 64 && __builtin_cpu_supports( "avx2" ) )
+      return dir_glob_find_sep_or_avx2( s, end, c );
+#endif
+#if defined( DIR_SIMD_SSE2 )
+   return dir_glob_find_sep_or_sse2( s, end, c );
+#else
+   return dir_glob_find_sep_or_scalar( s, end, c );
+#endif
+}
+
+#define dir_glob_find_sep( s, end ) dir_glob_find_sep_or( ( s ), ( end ), '/' )
+
+/*
+   same as 'dir_glob_find_sep_or' but vs a null-terminated string, returns the null-terminator if there is no 'c' or
+   path-separator. aligned loads can not cross into the next page, so reading past the null-terminator is safe.
+*/
+#if defined( DIR_SIMD_SSE2 )
+DIR_NO_SANITIZE_ADDRESS
+static const char* dir_glob_find_sep_or_nul( const char* s, char c )
+{
+   const __m128i fwd  = _mm_set1_epi8( '/' );
+   const __m128i back = _mm_set1_epi8( '\\' );
+   const __m128i find = _mm_set1_epi8( c );
+   const __m128i zero = _mm_setzero_si128();
+   const char* block_start = s - ( (size_t)s & 15 );
+   unsigned int hits = 0xFFFFu << ( s - block_start ); /* ignore the bytes before s */
+   for ( ;; )
+   {
+      __m128i block = _mm_load_si128( (const __m128i*)block_start );
+      __m128i hit   = _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8( block, fwd ), _mm_cmpeq_epi8( block, back ) ),
+                                    _mm_or_si128( _mm_cmpeq_epi8( block, find ), _mm_cmpeq_epi8( block, zero ) ) );
+      hits &= (unsigned int)_mm_movemask_epi8( hit );
+      if ( hits )
+         return block_start + dir_bit_index( hits );
+      block_start += 16;
+      hits = 0xFFFF;
+   }
+}
+#else
+static const char* dir_glob_find_sep_or_nul( const char* s, char c )
+{
+   while ( *s && *s != c && !DIR_IS_SEP( *s ) )
+      ++s;
+   return s;
+}
+#endif
+
+/* same as 'dir_glob_match_literal' vs a null-terminated path that might be shorter than len */
+static int dir_glob_match_literal_cstr( const char* pattern, const char* path, unsigned int len )
+{
+   unsigned int i;
+   for ( i = 0; i < len; ++i )
+   {
+      if ( pattern[i] == '/' ? !DIR_IS_SEP( path[i] ) : pattern[i] != path[i] )
+         return 0;
+   }
+   return 1;
+}
+
+/* compare len chars of pattern vs path, where '/' in pattern matches both path separators. path has at least len chars */
+static int dir_glob_match_literal( const char* pattern, const char* path, unsigned int len )
+{
+   unsigned int i = 0;
+#if defined( DIR_SIMD_SSE2 )
+   const __m128i fwd  = _mm_set1_epi8( '/' );
+   const __m128i back = _mm_set1_epi8( '\\' );
+   for ( ; len - i >= 16; i += 16 )
+   {
+      __m128i pat = _mm_loadu_si128( (const __m128i*)( pattern + i ) );
+      __m128i str = _mm_loadu_si128( (const __m128i*)( path + i ) );
+      __m128i sep = _mm_and_si128( _mm_cmpeq_epi8( pat, fwd ), _mm_cmpeq_epi8( str, back ) );
+      if ( _mm_movemask_epi8( _mm_or_si128( _mm_cmpeq_epi8( pat, str ), sep ) ) != 0xFFFF )
+         return 0;
+   }
+#endif
+   for ( ; i < len; ++i )
+   {
+      if ( pattern[i] == '/' ? !DIR_IS_SEP( path[i] ) : pattern[i] != path[i] )
+         return 0;
+   }
+   return 1;
+}
+
+static int dir_glob_match_groups( const char* group_start, const char* group_end, const char* match_this )
+{
+   /* ... comma separated ... */
+   const char* item_start = group_start;
+
+   for ( ;; )
+   {
+      unsigned int item_len;
+      const char* item_end = item_start;
+      while ( item_end <= group_end && *item_end != ',' )
+         ++item_end;
+
+      item_len = (unsigned int)( item_end - item_start );
+      if ( dir_glob_match_literal_cstr( item_start, match_this, item_len ) )
+         return (int)item_len;
+
+      if ( item_end > group_end )
+         break;
+      item_start = item_end + 1;
+   }
+   return -1;
+}
+
+static enum dir_glob_result dir_glob_match_impl( const char* glob_pattern, const char* glob_end, const char* path )
+{
+   const char* unverified = path;
+
+   while ( glob_pattern != glob_end )
+   {
+      switch ( *glob_pattern )
+      {
+      case '\0':
+         return DIR_GLOB_NO_MATCH;
+      case '*':
+      {
+         switch ( glob_pattern[1] )
+         {
+         case '\0':
+         {
+            /* try to find a path-separator in unverified since a pattern without a path-separator should only match files. */
+            if ( *dir_glob_find_sep_or_nul( unverified, '/' ) != '\0' )
+               return DIR_GLOB_NO_MATCH; /* should match directories */
+            return DIR_GLOB_MATCH;
+         }
+
+         case '*':
+         {
+            const char* sub_search;
+            if ( glob_pattern[2] != '/' )
+               return glob_pattern[2] == '\0' ? DIR_GLOB_MATCH : DIR_GLOB_INVALID_PATTERN; /* a pattern that that ends with a '**' matches the rest */
+
+            for ( sub_search = unverified;; )
+            {
+               enum dir_glob_result res = dir_glob_match_impl( glob_pattern + 3, glob_end, sub_search );
+               if ( res != DIR_GLOB_NO_MATCH || *sub_search == '\0' )
+                  return res;
+
+               /* start of the next path-segment, after the run of separators */
+               sub_search = dir_glob_find_sep_or_nul( sub_search + 1, '/' );
+               if ( *sub_search == '\0' )
+                  return DIR_GLOB_NO_MATCH;
+               while ( DIR_IS_SEP( *sub_search ) )
+                  ++sub_search;
+            }
+         }
+
+         default:
+         {
+            /* search in unverified for char */
+            const char* next = dir_glob_find_sep_or_nul( unverified, glob_pattern[1] );
+
+            switch ( *next )
+            {
+            case '\0':
+               return DIR_GLOB_NO_MATCH; /* failed, could not find char after * */
+            case '\\':
+            case '/':
+               if ( glob_pattern[1] == '/' )
+               {
+                  unverified = next + 1;
+                  while ( DIR_IS_SEP( *unverified ) )
+                     ++unverified; /* skip running slashes */
+                  glob_pattern += 2;
+               }
+               else
+                  return DIR_GLOB_NO_MATCH;
+               break;
+            default:
+               unverified = next;
+               ++glob_pattern;
+               break;
+            }
+         }
+         break;
+
+         }
+      }
+      break;
+      case '?':
+      {
+         if ( DIR_IS_SEP( *unverified ) || *unverified == '\0' )
+            return DIR_GLOB_NO_MATCH;
+         ++unverified;
+         ++glob_pattern;
+      }
+      break;
+
+      case '[':
+      {
+         const char* range_start = glob_pattern + 1;
+         const char* range_end = strchr( range_start, ']' );
+         if ( range_end == 0x0 )
+            return DIR_GLOB_INVALID_PATTERN;
+
+         if ( *unverified == '\0' || !dir_glob_match_range( range_start, range_end - 1, *unverified ) )
+            return DIR_GLOB_NO_MATCH;
+
+         glob_pattern = range_end + 1;
+         ++unverified;
+      }
+      break;
+
+      case '{':
+      {
+         int match_len;
+         const char* group_start = glob_pattern + 1;
+         const char* group_end = group_start;
+         while ( group_end != glob_end && *group_end != '}' )
+            ++group_end;
+
+         if ( group_end == glob_end )
+            return DIR_GLOB_INVALID_PATTERN;
+
+         match_len = dir_glob_match_groups( group_start, group_end - 1, unverified );
+         if ( match_len < 0 )
+            return DIR_GLOB_NO_MATCH;
+
+         glob_pattern = group_end + 1;
+         unverified += match_len;
+      }
+      break;
+
+      case '/':
+      {
+         if ( !DIR_IS_SEP( *unverified ) )
+            return DIR_GLOB_NO_MATCH;
+         while ( DIR_IS_SEP( *unverified ) )
+            ++unverified; /* skip running slashes */
+         ++glob_pattern;
+      }
+      break;
+
+      default:
+      {
+         /* the whole run of literal chars, without going through the switch for each */
+         do
+         {
+            if ( *unverified != *glob_pattern )
+               return DIR_GLOB_NO_MATCH;
+            ++unverified;
+            ++glob_pattern;
+         }
+         while ( glob_pattern != glob_end && *glob_pattern != '\0' && !DIR_GLOB_IS_SPECIAL( *glob_pattern ) );
+      }
+      break;
+      }
+   }
+
+   return *unverified == '\0' ? DIR_GLOB_MATCH : DIR_GLOB_NO_MATCH;
+}
+
+DIRUTIL_API enum dir_glob_result dir_glob_match( const char* glob_pattern, const char* path )
+{
+   return dir_glob_match_impl( glob_pattern, glob_pattern + dir_strlen32( glob_pattern ), path );
+}
+
+/*
+   compiled glob-pattern, the pattern is turned into a list of ops where each op corresponds to
+   one of the cases in 'dir_glob_match_impl' so that both have exactly the same semantics.
+*/
+enum dir_glob_op_type
+{
+   DIR_GLOB_OP_LITERAL,      /* run of 'len' literal chars at 'offset' in 'strings' */
+   DIR_GLOB_OP_SEP,          /* '/', matches a run of path separators */
+   DIR_GLOB_OP_ANY,          /* '?' */
+   DIR_GLOB_OP_CLASS,        /* '[]', bitmap at 'offset' in 'classes' */
+   DIR_GLOB_OP_GROUP,        /* '{}', 'len' alternatives starting at 'offset' in 'alternatives' */
+   DIR_GLOB_OP_STAR,         /* '*' followed by char 'c', skip to first 'c' within path-segment */
+   DIR_GLOB_OP_STAR_SEP,     /* '*' followed by '/', skip rest of path-segment and the separators after it */
+   DIR_GLOB_OP_STAR_END,     /* '*' ending the pattern, matches if rest of path has no separators */
+   DIR_GLOB_OP_GLOBSTAR,     /* '**' followed by '/', try rest of pattern at the start of each path-segment */
+   DIR_GLOB_OP_GLOBSTAR_END, /* '**' ending the pattern, matches rest of path */
+   DIR_GLOB_OP_INVALID       /* invalid pattern from here on */
+};
+
+struct dir_glob_op
+{
+   unsigned char type;
+   char c;
+   unsigned int offset;
+   unsigned int len;
+};
+
+struct dir_glob_alternative
+{
+   unsigned int offset;
+   unsigned int len;
+};
+
+struct dir_glob
+{
+   struct dir_glob_op* ops;
+   unsigned int num_ops;
+   struct dir_glob_alternative* alternatives;
+   unsigned char ( *classes )[32];
+   char* strings; /* copy of the pattern, literals and alternatives point into this */
+
+   /*
+      checked before the ops are executed to reject most paths up front, a literal prefix/suffix
+      is the first/last op that is then not executed.
+   */
+   unsigned int min_len;    /* shortest path that can match */
+   unsigned int prefix_len; /* length of literal first op, 0 if none */
+   unsigned int suffix_len; /* length of literal last op, 0 if none */
+   int exec_suffix;         /* last op still has to be executed, see dir_glob_match_compiled_impl */
+   int has_last_chars;      /* 'last_chars' is valid, i.e. the last char of a matching path can be determined */
+   unsigned char last_chars[32];
+};
+
+/*
+   set bits in 'last_chars' for each char that a path matching glob can end with.
+   returns 0 if that can not be determined from the last op of the glob, i.e. any char is possible.
+*/
+static int dir_glob_last_chars( const struct dir_glob* glob, unsigned char last_chars[32] )
+{
+   const struct dir_glob_op* op;
+   unsigned int i;
+
+   if ( glob->num_ops == 0 )
+      return 0;
+
+   op = &glob->ops[glob->num_ops - 1];
+   memset( last_chars, 0, 32 );
+   switch ( op->type )
+   {
+   case DIR_GLOB_OP_LITERAL:
+   {
+      unsigned char c = (unsigned char)glob->strings[op->offset + op->len - 1];
+      last_chars[c >> 3] |= (unsigned char)( 1 << ( c & 7 ) );
+      return 1;
+   }
+   case DIR_GLOB_OP_SEP:
+   case DIR_GLOB_OP_STAR_SEP:
+      last_chars['/' >> 3] |= (unsigned char)( 1 << ( '/' & 7 ) );
+      last_chars['\\' >> 3] |= (unsigned char)( 1 << ( '\\' & 7 ) );
+      return 1;
+   case DIR_GLOB_OP_CLASS:
+      memcpy( last_chars, glob->classes[op->offset], 32 );
+      return 1;
+   case DIR_GLOB_OP_GROUP:
+      for ( i = 0; i < op->len; ++i )
+      {
+         const struct dir_glob_alternative* alt = &glob->alternatives[op->offset + i];
+         unsigned char c;
+         if ( alt->len == 0 )
+            return 0; /* last char is decided by the op before the group */
+         c = (unsigned char)glob->strings[alt->offset + alt->len - 1];
+         if ( c == '/' )
+            last_chars['\\' >> 3] |= (unsigned char)( 1 << ( '\\' & 7 ) );
+         last_chars[c >> 3] |= (unsigned char)( 1 << ( c & 7 ) );
+      }
+      return 1;
+   default:
+      return 0;
+   }
+}
+
+DIRUTIL_API struct dir_glob* dir_glob_compile( const char* glob_pattern )
+{
+   struct dir_glob* glob;
+   const char *p, *end;
+   unsigned int num_classes = 0, num_alternatives = 0, num_ops = 0, c;
+   unsigned int len = dir_strlen32( glob_pattern );
+   unsigned int num_ops_max = len + 1;
+
+   /* upper bounds of the tables so that everything fits in one allocation */
+   for ( p = glob_pattern; *p; ++p )
+   {
+      num_classes += *p == '[';
+      num_alternatives += *p == '{' || *p == ',';
+   }
+
+   glob = (struct dir_glob*)DIRUTIL_MALLOC( sizeof( struct dir_glob ) +
+      num_ops_max * sizeof( struct dir_glob_op ) +
+      num_alternatives * sizeof( struct dir_glob_alternative ) +
+      num_classes * 32 + len + 1 );
+   if ( glob == 0x0 )
+      return 0x0;
+
+   glob->ops = (struct dir_glob_op*)( glob + 1 );
+   glob->alternatives = (struct dir_glob_alternative*)( glob->ops + num_ops_max );
+   glob->classes = (unsigned char (*)[32])( glob->alternatives + num_alternatives );
+   glob->strings = (char*)( glob->classes + num_classes );
+   memcpy( glob->strings, glob_pattern, len + 1 );
+
+   num_classes = 0;
+   num_alternatives = 0;
+   p = glob->strings;
+   end = p + len;
+   while ( p != end )
+   {
+      struct dir_glob_op* op = &glob->ops[num_ops++];
+      op->c = 0;
+      op->offset = 0;
+      op->len = 0;
+
+      switch ( *p )
+      {
+      case '*':
+         if ( p + 1 == end )
+         {
+            op->type = DIR_GLOB_OP_STAR_END;
+            p = end;
+         }
+         else if ( p[1] == '*' )
+         {
+            if ( p + 2 == end )
+               op->type = DIR_GLOB_OP_GLOBSTAR_END;
+            else if ( p[2] == '/' )
+            {
+               op->type = DIR_GLOB_OP_GLOBSTAR;
+               p += 3;
+               break;
+            }
+            else
+               op->type = DIR_GLOB_OP_INVALID;
+            p = end; /* nothing after these ops is ever reached */
+         }
+         else if ( p[1] == '/' )
+         {
+            op->type = DIR_GLOB_OP_STAR_SEP;
+            p += 2;
+         }
+         else
+         {
+            /* only the '*' is consumed, the char searched for is matched by the next op */
+            op->type = DIR_GLOB_OP_STAR;
+            op->c = p[1];
+            ++p;
+         }
+         break;
+
+      case '?':
+         op->type = DIR_GLOB_OP_ANY;
+         ++p;
+         break;
+
+      case '/':
+         op->type = DIR_GLOB_OP_SEP;
+         ++p;
+         break;
+
+      case '[':
+      {
+         const char* range_end = p + 1;
+         while ( range_end != end && *range_end != ']' )
+            ++range_end;
+
+         if ( range_end == end )
+         {
+            op->type = DIR_GLOB_OP_INVALID;
+            p = end;
+            break;
+         }
+
+         op->type = DIR_GLOB_OP_CLASS;
+         op->offset = num_classes++;
+         memset( glob->classes[op->offset], 0, 32 );
+         for ( c = 1; c < 256; ++c ) /* '\0' never matches */
+            if ( dir_glob_match_range( p + 1, range_end - 1, (char)c ) )
+               glob->classes[op->offset][c >> 3] |= (unsigned char)( 1 << ( c & 7 ) );
+         p = range_end + 1;
+      }
+      break;
+
+      case '{':
+      {
+         const char* item_start = p + 1;
+         const char* group_end = item_start;
+         while ( group_end != end && *group_end != '}' )
+            ++group_end;
+
+         if ( group_end == end )
+         {
+            op->type = DIR_GLOB_OP_INVALID;
+            p = end;
+            break;
+         }
+
+         op->type = DIR_GLOB_OP_GROUP;
+         op->offset = num_alternatives;
+         for ( ;; )
+         {
+            const char* item_end = item_start;
+            while ( item_end != group_end && *item_end != ',' )
+               ++item_end;
+
+            glob->alternatives[num_alternatives].offset = (unsigned int)( item_start - glob->strings );
+            glob->alternatives[num_alternatives].len = (unsigned int)( item_end - item_start );
+            ++num_alternatives;
+
+            if ( item_end == group_end )
+               break;
+            item_start = item_end + 1;
+         }
+         op->len = num_alternatives - op->offset;
+         p = group_end + 1;
+      }
+      break;
+
+      default:
+      {
+         const char* run_end = p + 1;
+         while ( run_end != end && !DIR_GLOB_IS_SPECIAL( *run_end ) )
+            ++run_end;
+
+         op->type = DIR_GLOB_OP_LITERAL;
+         op->offset = (unsigned int)( p - glob->strings );
+         op->len = (unsigned int)( run_end - p );
+         p = run_end;
+      }
+      break;
+      }
+   }
+
+   glob->num_ops = num_ops;
+   glob->min_len = 0;
+   glob->prefix_len = 0;
+   glob->suffix_len = 0;
+   glob->exec_suffix = 0;
+
+   for ( c = 0; c < num_ops; ++c )
+   {
+      const struct dir_glob_op* op = &glob->ops[c];
+      if ( op->type == DIR_GLOB_OP_INVALID )
+         break; /* ops before an invalid op must match for it to be reached, nothing after it is counted */
+
+      switch ( op->type )
+      {
+      case DIR_GLOB_OP_LITERAL:
+         glob->min_len += op->len;
+         break;
+      case DIR_GLOB_OP_SEP:
+      case DIR_GLOB_OP_ANY:
+      case DIR_GLOB_OP_CLASS:
+      case DIR_GLOB_OP_STAR_SEP:
+         glob->min_len += 1;
+         break;
+      case DIR_GLOB_OP_GROUP:
+      {
+         unsigned int i, min_alt = glob->alternatives[op->offset].len;
+         glob->exec_suffix = 1;
+         for ( i = 1; i < op->len; ++i )
+            if ( glob->alternatives[op->offset + i].len < min_alt )
+               min_alt = glob->alternatives[op->offset + i].len;
+         glob->min_len += min_alt;
+      }
+      break;
+      default:
+         break;
+      }
+   }
+
+   glob->has_last_chars = dir_glob_last_chars( glob, glob->last_chars );
+   if ( num_ops > 0 && glob->ops[0].type == DIR_GLOB_OP_LITERAL )
+      glob->prefix_len = glob->ops[0].len;
+   if ( num_ops > 1 && glob->ops[num_ops - 1].type == DIR_GLOB_OP_LITERAL )
+   {
+      const struct dir_glob_op* op = &glob->ops[num_ops - 1];
+      glob->suffix_len = op->len;
+      for ( c = 0; c < op->len; ++c )
+         glob->exec_suffix |= glob->strings[op->offset + c] == '\\';
+   }
+
+   return glob;
+}
 
-   #if defined ( _WIN32 )
-      #pragma warning( push )
-      #pragma warning( disable : 4996 ) /* 'rmdir': the POSIX name for this item is deprecated... */
-   #endif
-   return rmdir( path ) == 0 ? DIR_ERROR_OK : DIR_ERROR_FAILED;
-   #if defined ( _WIN32 )
-      #pragma warning( pop )
-   #endif
+DIRUTIL_API void dir_glob_free( struct dir_glob* glob )
+{
+   DIRUTIL_FREE( glob );
 }
 
-DIRUTIL_API enum dir_error dir_mktree( const char* path )
+static enum dir_glob_result dir_glob_exec( const struct dir_glob* glob, const struct dir_glob_op* op, const struct dir_glob_op* ops_end, const char* path, const char* path_end )
 {
-   char path_buffer[4096];
-   char* beg = path_buffer;
-   unsigned int path_len = dir_strlen32( path );
-   if ( path_len >= sizeof( path_buffer ) - 1 )
-      return DIR_ERROR_FAILED;
+   for ( ; op != ops_end; ++op )
+   {
+      switch ( op->type )
+      {
+      case DIR_GLOB_OP_LITERAL:
+         if ( (unsigned int)( path_end - path ) < op->len || memcmp( path, glob->strings + op->offset, op->len ) != 0 )
+            return DIR_GLOB_NO_MATCH;
+         path += op->len;
+         break;
 
-   memcpy( path_buffer, path, path_len + 1 );
+      case DIR_GLOB_OP_SEP:
+         if ( path == path_end || !DIR_IS_SEP( *path ) )
+            return DIR_GLOB_NO_MATCH;
+         while ( path != path_end && DIR_IS_SEP( *path ) )
+            ++path; /* skip running slashes */
+         break;
 
-   path_len = dir_path_tidy( path_buffer, DIR_SEP_PLATFORM, path_len );
+      case DIR_GLOB_OP_ANY:
+         if ( path == path_end || DIR_IS_SEP( *path ) )
+            return DIR_GLOB_NO_MATCH;
+         ++path;
+         break;
 
-   /* if path is absolute, we need to start trying to create directories from the second '/',
-    * otherwise we would try to create the dir "" */
-   if ( *beg == DIR_SEP_PLATFORM )
-      ++beg;
+      case DIR_GLOB_OP_CLASS:
+      {
+         unsigned char c;
+         if ( path == path_end )
+            return DIR_GLOB_NO_MATCH;
+         c = (unsigned char)*path;
+         if ( !( glob->classes[op->offset][c >> 3] & ( 1 << ( c & 7 ) ) ) )
+            return DIR_GLOB_NO_MATCH;
+         ++path;
+      }
+      break;
 
-   for ( ;; )
-   {
-      enum dir_error err;
-      char* sep = strchr( beg, DIR_SEP_PLATFORM );
-      if ( sep == 0 )
-         return dir_create( path_buffer );
+      case DIR_GLOB_OP_GROUP:
+      {
+         /* first alternative that matches wins, no backtracking, same as 'dir_glob_match_groups' */
+         const struct dir_glob_alternative* alt = glob->alternatives + op->offset;
+         const struct dir_glob_alternative* alt_end = alt + op->len;
+         for ( ; alt != alt_end; ++alt )
+            if ( (unsigned int)( path_end - path ) >= alt->len && dir_glob_match_literal( glob->strings + alt->offset, path, alt->len ) )
+               break;
+         if ( alt == alt_end )
+            return DIR_GLOB_NO_MATCH;
+         path += alt->len;
+      }
+      break;
 
-      *sep = '\0';
-      err = dir_create( path_buffer );
-      if ( err != DIR_ERROR_OK )
-         return err;
+      case DIR_GLOB_OP_STAR:
+         if ( op + 1 == ops_end )
+         {
+            /*
+               only happens when the literal suffix, starting with 'c', is cut from the path and the ops.
+               the first 'c' has to be where the suffix starts.
+            */
+            return dir_glob_find_sep_or( path, path_end, op->c ) == path_end ? DIR_GLOB_MATCH : DIR_GLOB_NO_MATCH;
+         }
+         path = dir_glob_find_sep_or( path, path_end, op->c );
+         if ( path == path_end || DIR_IS_SEP( *path ) )
+            return DIR_GLOB_NO_MATCH;
+         break;
 
-      *sep = DIR_SEP_PLATFORM;
-      beg = sep + 1;
-   }
-}
+      case DIR_GLOB_OP_STAR_SEP:
+         path = dir_glob_find_sep( path, path_end );
+         if ( path == path_end )
+            return DIR_GLOB_NO_MATCH;
+         while ( path != path_end && DIR_IS_SEP( *path ) )
+            ++path; /* skip running slashes */
+         break;
 
-static int dir_glob_match_range( const char* range_start, const char* range_end, char match_char )
-{
-   int match_return = 1;
-   if ( *range_start == '!' )
-   {
-      match_return = 0;
-      ++range_start;
-   }
+      case DIR_GLOB_OP_STAR_END:
+         return dir_glob_find_sep( path, path_end ) == path_end ? DIR_GLOB_MATCH : DIR_GLOB_NO_MATCH;
 
-   while ( range_start != range_end + 1 )
-   {
-      if ( range_start[1] == '-' )
+      case DIR_GLOB_OP_GLOBSTAR:
       {
-         if ( range_start[0] <= match_char && match_char <= range_start[2] )
-            return match_return;
-         range_start += 3;
+         const char* sub_search = path;
+         for ( ;; )
+         {
+            enum dir_glob_result res = dir_glob_exec( glob, op + 1, ops_end, sub_search, path_end );
+            if ( res != DIR_GLOB_NO_MATCH || sub_search == path_end )
+               return res;
+
+            /* next path-segment, searching from the char after the current start */
+            sub_search = dir_glob_find_sep( sub_search + 1, path_end );
+            if ( sub_search == path_end )
+               return DIR_GLOB_NO_MATCH;
+            while ( sub_search != path_end && DIR_IS_SEP( *sub_search ) )
+               ++sub_search;
+         }
       }
-      else
-      {
-         if ( *range_start == match_char )
-            return match_return;
-         ++range_start;
+
+      case DIR_GLOB_OP_GLOBSTAR_END:
+         return DIR_GLOB_MATCH;
+
+      default:
+         return DIR_GLOB_INVALID_PATTERN;
       }
    }
 
-   return !match_return;
+   return path == path_end ? DIR_GLOB_MATCH : DIR_GLOB_NO_MATCH;
 }
 
-static int dir_glob_match_groups( const char* group_start, const char* group_end, const char* match_this )
+static enum dir_glob_result dir_glob_match_compiled_impl( const struct dir_glob* glob, const char* path, unsigned int path_len )
 {
-   /* ... comma separated ... */
-   const char* item_start = group_start;
-
-   while ( item_start < group_end )
-   {
-      unsigned int item_len;
-      const char* item_end = item_start;
-      while ( *item_end != ',' && item_end != group_end + 1 )
-         ++item_end;
+   const struct dir_glob_op* ops = glob->ops;
+   const struct dir_glob_op* ops_end = ops + glob->num_ops;
+   const char* path_end = path + path_len;
 
-      item_len = (unsigned int)( item_end - item_start );
-      if ( strncmp( match_this, item_start, item_len ) == 0 )
-         return (int)item_len;
+   if ( path_len < glob->min_len )
+      return DIR_GLOB_NO_MATCH;
 
-      item_start = item_end + 1;
+   if ( glob->has_last_chars )
+   {
+      unsigned char c = (unsigned char)path[path_len - 1]; /* min_len is at least 1 if there are last chars */
+      if ( !( glob->last_chars[c >> 3] & ( 1 << ( c & 7 ) ) ) )
+         return DIR_GLOB_NO_MATCH;
    }
-   return -1;
-}
 
-/* find either 'a' or 'b' on 's' and returns the last occurrence of either 'a' or 'b' if found */
-static const char *dir_strchr2( const char *s, int a, int b )
-{
-   while ( *s )
+   /*
+      a literal last op must end exactly at the end of the path. if the suffix has no separators ('\' is a
+      literal in the pattern) the ops before it see the same path if it is cut before the suffix, except for
+      '*', see DIR_GLOB_OP_STAR, and '{}' that might try alternatives past the cut.
+   */
+   if ( glob->prefix_len )
+   {
+      if ( memcmp( path, glob->strings + ops->offset, glob->prefix_len ) != 0 )
+         return DIR_GLOB_NO_MATCH;
+      path += glob->prefix_len;
+      ++ops;
+   }
+   if ( glob->suffix_len )
    {
-      if ( *s == a || *s == b )
+      if ( memcmp( path_end - glob->suffix_len, glob->strings + ops_end[-1].offset, glob->suffix_len ) != 0 )
+         return DIR_GLOB_NO_MATCH;
+      if ( !glob->exec_suffix )
       {
-         while ( s[1] == a || s[1] == b )
-            ++s;
-         return s;
+         path_end -= glob->suffix_len;
+         --ops_end;
       }
-      ++s;
    }
-   return 0;
+
+   /* literal only pattern */
+   if ( ops == ops_end )
+      return path == path_end ? DIR_GLOB_MATCH : DIR_GLOB_NO_MATCH;
+
+   return dir_glob_exec( glob, ops, ops_end, path, path_end );
 }
 
-static enum dir_glob_result dir_glob_match_impl( const char* glob_pattern, const char* glob_end, const char* path )
+DIRUTIL_API enum dir_glob_result dir_glob_match_compiled( const struct dir_glob* glob, const char* path )
 {
-   const char* unverified = path;
+   return dir_glob_match_compiled_impl( glob, path, dir_strlen32( path ) );
+}
 
-   while ( glob_pattern != glob_end )
+/*
+   same as 'dir_glob_exec' but vs path followed by a separator and any number of unknown chars. as soon as
+   the result depends on the unknown chars DIR_GLOB_PARTIAL_MATCH is returned, so it is a conservative check.
+*/
+static enum dir_glob_result dir_glob_exec_partial( const struct dir_glob* glob, const struct dir_glob_op* op, const char* path, const char* path_end )
+{
+   const struct dir_glob_op* ops_end = glob->ops + glob->num_ops;
+
+   for ( ; op != ops_end; ++op )
    {
-      switch ( *glob_pattern )
+      switch ( op->type )
       {
-      case '\0':
-         return DIR_GLOB_NO_MATCH;
-      case '*':
+      case DIR_GLOB_OP_LITERAL:
       {
-         switch ( glob_pattern[1] )
+         unsigned int path_left = (unsigned int)( path_end - path );
+         if ( op->len <= path_left )
          {
-         case '\0':
-         {
-            /* try to find a path-separator in unverified since a pattern without a path-separator should only match files. */
-            if ( dir_strchr2( unverified, '/', '\\' ) )
-               return DIR_GLOB_NO_MATCH; /* should match directories */
-            return DIR_GLOB_MATCH;
+            if ( memcmp( path, glob->strings + op->offset, op->len ) != 0 )
+               return DIR_GLOB_NO_MATCH;
+            path += op->len;
+            break;
          }
-
-         case '*':
-         {
-            const char* sub_search;
-            if ( glob_pattern[2] != '/' )
-               return glob_pattern[2] == '\0' ? DIR_GLOB_MATCH : DIR_GLOB_INVALID_PATTERN; /* a pattern that that ends with a '**' matches the rest */
-
-            for (sub_search = unverified - 1;
-               sub_search;
-               sub_search = dir_strchr2( sub_search + 1, '/', '\\' ) )
-            {
-               enum dir_glob_result res;
-               ++sub_search;
-               res = dir_glob_match_impl( glob_pattern + 3, glob_end, sub_search );
-               if ( res != DIR_GLOB_NO_MATCH )
-                  return res;
-            }
+         /* literal continues past the separator, that only a literal '\' can match */
+         if ( memcmp( path, glob->strings + op->offset, path_left ) != 0 || glob->strings[op->offset + path_left] != '\\' )
             return DIR_GLOB_NO_MATCH;
-         }
+         return DIR_GLOB_PARTIAL_MATCH;
+      }
 
-         default:
-         {
-            /* search in unverified for char */
-            const char* next = unverified;
-            while ( *next && ( *next != glob_pattern[1] ) && !DIR_IS_SEP( *next ) )
-               ++next;
+      case DIR_GLOB_OP_SEP:
+         if ( path != path_end && !DIR_IS_SEP( *path ) )
+            return DIR_GLOB_NO_MATCH;
+         while ( path != path_end && DIR_IS_SEP( *path ) )
+            ++path;
+         if ( path == path_end )
+            return DIR_GLOB_PARTIAL_MATCH; /* separator after path and possibly more is skipped */
+         break;
 
-            switch ( *next )
-            {
-            case '\0':
-               return DIR_GLOB_NO_MATCH; /* failed, could not find char after * */
-            case '\\':
-            case '/':
-               if ( glob_pattern[1] == '/' )
-               {
-                  unverified = next + 1;
-                  while ( DIR_IS_SEP( *unverified ) )
-                     ++unverified; /* skip running slashes */
-                  glob_pattern += 2;
-               }
-               else
-                  return DIR_GLOB_NO_MATCH;
-               break;
-            default:
-               unverified = next;
-               ++glob_pattern;
-               break;
-            }
-         }
+      case DIR_GLOB_OP_ANY:
+         if ( path == path_end || DIR_IS_SEP( *path ) )
+            return DIR_GLOB_NO_MATCH;
+         ++path;
          break;
 
+      case DIR_GLOB_OP_CLASS:
+      {
+         const unsigned char* class_bits = glob->classes[op->offset];
+         unsigned char c;
+         if ( path == path_end )
+         {
+            if ( ( class_bits['/' >> 3] & ( 1 << ( '/' & 7 ) ) ) || ( class_bits['\\' >> 3] & ( 1 << ( '\\' & 7 ) ) ) )
+               return DIR_GLOB_PARTIAL_MATCH;
+            return DIR_GLOB_NO_MATCH;
          }
+         c = (unsigned char)*path;
+         if ( !( class_bits[c >> 3] & ( 1 << ( c & 7 ) ) ) )
+            return DIR_GLOB_NO_MATCH;
+         ++path;
       }
       break;
-      case '?':
+
+      case DIR_GLOB_OP_GROUP:
       {
-         if ( DIR_IS_SEP( *unverified ) )
+         const struct dir_glob_alternative* alt = glob->alternatives + op->offset;
+         const struct dir_glob_alternative* alt_end = alt + op->len;
+         unsigned int path_left = (unsigned int)( path_end - path );
+         for ( ; alt != alt_end; ++alt )
+         {
+            const char* alt_str = glob->strings + alt->offset;
+            if ( alt->len <= path_left )
+            {
+               if ( dir_glob_match_literal( alt_str, path, alt->len ) )
+                  break;
+            }
+            else if ( dir_glob_match_literal( alt_str, path, path_left ) && DIR_IS_SEP( alt_str[path_left] ) )
+               return DIR_GLOB_PARTIAL_MATCH; /* alternative continues past the separator */
+         }
+         if ( alt == alt_end )
             return DIR_GLOB_NO_MATCH;
-         ++unverified;
-         ++glob_pattern;
+         path += alt->len;
       }
       break;
 
-      case '[':
-      {
-         const char* range_start = glob_pattern + 1;
-         const char* range_end = strchr( range_start, ']' );
-         if ( range_end == 0x0 )
-            return DIR_GLOB_INVALID_PATTERN;
-
-         if ( !dir_glob_match_range( range_start, range_end - 1, *unverified ) )
+      case DIR_GLOB_OP_STAR:
+         path = dir_glob_find_sep_or( path, path_end, op->c );
+         if ( path == path_end || DIR_IS_SEP( *path ) )
             return DIR_GLOB_NO_MATCH;
+         break;
 
-         glob_pattern = range_end + 1;
-         ++unverified;
+      case DIR_GLOB_OP_STAR_SEP:
+         path = dir_glob_find_sep( path, path_end );
+         while ( path != path_end && DIR_IS_SEP( *path ) )
+            ++path;
+         if ( path == path_end )
+            return DIR_GLOB_PARTIAL_MATCH;
+         break;
+
+      case DIR_GLOB_OP_STAR_END:
+         return DIR_GLOB_NO_MATCH; /* there is always a separator after path */
+
+      case DIR_GLOB_OP_GLOBSTAR:
+      case DIR_GLOB_OP_GLOBSTAR_END:
+         return DIR_GLOB_PARTIAL_MATCH; /* the rest of the pattern might match any path-segment below path */
+
+      default:
+         return DIR_GLOB_INVALID_PATTERN;
       }
-      break;
+   }
 
-      case '{':
-      {
-         int match_len;
-         const char* group_start = glob_pattern + 1;
-         const char* group_end = group_start;
-         while ( group_end != glob_end && *group_end != '}' )
-            ++group_end;
+   /* the pattern ends before the separator after path */
+   return DIR_GLOB_NO_MATCH;
+}
 
-         match_len = dir_glob_match_groups( group_start, group_end - 1, unverified );
-         if ( match_len < 0 )
-            return DIR_GLOB_NO_MATCH;
+static enum dir_glob_result dir_glob_match_partial_impl( const struct dir_glob* glob, const char* path, unsigned int path_len )
+{
+   enum dir_glob_result res = dir_glob_match_compiled_impl( glob, path, path_len );
+   if ( res != DIR_GLOB_NO_MATCH )
+      return res;
+   return dir_glob_exec_partial( glob, glob->ops, path, path + path_len );
+}
 
-         glob_pattern = group_end + 1;
-         unverified += match_len;
+DIRUTIL_API enum dir_glob_result dir_glob_match_partial( const struct dir_glob* glob, const char* path )
+{
+   return dir_glob_match_partial_impl( glob, path, dir_strlen32( path ) );
+}
+
+struct dir_glob_set
+{
+   struct dir_glob** globs;
+   unsigned char* exclude;
+   unsigned int num_globs;
+   unsigned int num_includes;
+   unsigned int num_words; /* words per bitset */
+
+   /*
+      bitsets of the patterns that can match a path ending with a specific char, indexed by
+      that char, and a last extra bitset with all patterns used for the empty path.
+   */
+   unsigned int* candidates;
+};
+
+DIRUTIL_API struct dir_glob_set* dir_glob_set_compile( const char* const* glob_patterns, unsigned int num_patterns )
+{
+   struct dir_glob_set* set;
+   unsigned int i, c;
+   unsigned int num_words = ( num_patterns + 31 ) / 32;
+
+   set = (struct dir_glob_set*)DIRUTIL_MALLOC( sizeof( struct dir_glob_set ) +
+      num_patterns * sizeof( struct dir_glob* ) +
+      257 * num_words * sizeof( unsigned int ) +
+      num_patterns );
+   if ( set == 0x0 )
+      return 0x0;
+
+   set->globs = (struct dir_glob**)( set + 1 );
+   set->candidates = (unsigned int*)( set->globs + num_patterns );
+   set->exclude = (unsigned char*)( set->candidates + 257 * num_words );
+   set->num_globs = 0;
+   set->num_includes = 0;
+   set->num_words = num_words;
+   memset( set->candidates, 0, 257 * num_words * sizeof( unsigned int ) );
+
+   for ( i = 0; i < num_patterns; ++i )
+   {
+      const char* pattern = glob_patterns[i];
+      unsigned int word = i / 32, bit = 1u << ( i % 32 );
+
+      set->exclude[i] = *pattern == '!';
+      set->num_includes += !set->exclude[i];
+      set->globs[i] = dir_glob_compile( pattern + set->exclude[i] );
+      if ( set->globs[i] == 0x0 )
+      {
+         dir_glob_set_free( set );
+         return 0x0;
       }
-      break;
+      ++set->num_globs;
 
-      default:
+      if ( set->globs[i]->has_last_chars )
       {
-         if ( *unverified != *glob_pattern )
-            return DIR_GLOB_NO_MATCH;
-         ++unverified;
-         ++glob_pattern;
+         for ( c = 0; c < 256; ++c )
+            if ( set->globs[i]->last_chars[c >> 3] & ( 1 << ( c & 7 ) ) )
+               set->candidates[c * num_words + word] |= bit;
       }
-      break;
+      else
+      {
+         for ( c = 0; c < 256; ++c )
+            set->candidates[c * num_words + word] |= bit;
       }
+      set->candidates[256 * num_words + word] |= bit;
    }
+   return set;
+}
 
-   return *unverified == '\0' ? DIR_GLOB_MATCH : DIR_GLOB_NO_MATCH;
+DIRUTIL_API void dir_glob_set_free( struct dir_glob_set* set )
+{
+   unsigned int i;
+   if ( set == 0x0 )
+      return;
+   for ( i = 0; i < set->num_globs; ++i )
+      dir_glob_free( set->globs[i] );
+   DIRUTIL_FREE( set );
 }
 
-DIRUTIL_API enum dir_glob_result dir_glob_match( const char* glob_pattern, const char* path )
+static const unsigned int* dir_glob_set_candidates( const struct dir_glob_set* set, const char* path, unsigned int path_len )
 {
-   return dir_glob_match_impl( glob_pattern, glob_pattern + dir_strlen32( glob_pattern ), path );
+   unsigned int row = path_len ? (unsigned char)path[path_len - 1] : 256;
+   return &set->candidates[row * set->num_words];
+}
+
+static int dir_glob_set_match_first_impl( const struct dir_glob_set* set, const char* path, unsigned int path_len )
+{
+   const unsigned int* candidates = dir_glob_set_candidates( set, path, path_len );
+   unsigned int word;
+
+   for ( word = 0; word < set->num_words; ++word )
+   {
+      unsigned int bits = candidates[word];
+      while ( bits )
+      {
+         unsigned int index = word * 32 + dir_bit_index( bits );
+         if ( DIR_GLOB_MATCH == dir_glob_match_compiled_impl( set->globs[index], path, path_len ) )
+            return (int)index;
+         bits &= bits - 1;
+      }
+   }
+   return -1;
+}
+
+static int dir_glob_set_includes_impl( const struct dir_glob_set* set, const char* path, unsigned int path_len )
+{
+   int index = dir_glob_set_match_first_impl( set, path, path_len );
+   if ( index < 0 )
+      return set->num_includes == 0;
+   return !set->exclude[index];
+}
+
+DIRUTIL_API int dir_glob_set_match_first( const struct dir_glob_set* set, const char* path )
+{
+   return dir_glob_set_match_first_impl( set, path, dir_strlen32( path ) );
+}
+
+DIRUTIL_API unsigned int dir_glob_set_match_all( const struct dir_glob_set* set, const char* path, unsigned int* match_bits )
+{
+   unsigned int path_len = dir_strlen32( path );
+   const unsigned int* candidates = dir_glob_set_candidates( set, path, path_len );
+   unsigned int word, num_matches = 0;
+
+   for ( word = 0; word < set->num_words; ++word )
+   {
+      unsigned int bits = candidates[word];
+      match_bits[word] = 0;
+      while ( bits )
+      {
+         unsigned int bit_index = dir_bit_index( bits );
+         if ( DIR_GLOB_MATCH == dir_glob_match_compiled_impl( set->globs[word * 32 + bit_index], path, path_len ) )
+         {
+            match_bits[word] |= 1u << bit_index;
+            ++num_matches;
+         }
+         bits &= bits - 1;
+      }
+   }
+   return num_matches;
+}
+
+DIRUTIL_API int dir_glob_set_includes( const struct dir_glob_set* set, const char* path )
+{
+   return dir_glob_set_includes_impl( set, path, dir_strlen32( path ) );
 }
 
 #endif
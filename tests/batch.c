@@ -0,0 +1,299 @@
+/*
+   dir_walkex_batch, walks a tree in a mkdtemp directory, with a chain of directories deep enough to grow the stack of
+   open directories, with different flags, info fields and glob patterns and checks that the items are the same, with the
+   same type and information, as dir_walkex_info reports. also checks that each directory is passed in one batch with
+   only its own items, that a batch is passed before the batches of its sub-directories, or after them with
+   DIR_WALK_DEPTH_FIRST, that the names are in order with DIR_WALK_SORTED and that the inodes are the ones 'lstat'
+   returns. posix only.
+
+   build and run from the root of the repository:
+      cc -O2 -o test_batch tests/batch.c && ./test_batch
+*/
+#define _DEFAULT_SOURCE
+#define DIRUTIL_IMPLEMENTATION
+#include "../dirutil.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define TEST_MAX_ITEMS   512
+#define TEST_MAX_BATCHES 128
+#define TEST_DEEP        40 /* directories in the deep chain */
+
+struct test_walk
+{
+   unsigned int flags;
+   unsigned int info_fields;
+   const char* glob_directories;
+   const char* glob_files;
+};
+
+static const struct test_walk test_walks[] =
+{
+   { 0,                                                           0,                                         0x0,       0x0 },
+   { DIR_WALK_DEPTH_FIRST,                                        DIR_ITEM_INFO_SIZE,                        0x0,       0x0 },
+   { DIR_WALK_ONLY_FILES | DIR_WALK_ROOT_RELATIVE_PATHS,          DIR_ITEM_INFO_ALL,                         0x0,       0x0 },
+   { DIR_WALK_ONLY_DIRECTORIES | DIR_WALK_DEPTH_FIRST,            DIR_ITEM_INFO_MODE,                        0x0,       0x0 },
+   { DIR_WALK_IGNORE_DOT_FILES | DIR_WALK_IGNORE_DOT_DIRECTORIES, 0,                                         0x0,       0x0 },
+   { DIR_WALK_SINGLE_DIRECTORY,                                   DIR_ITEM_INFO_SYMLINK,                     0x0,       0x0 },
+   { DIR_WALK_MAX_DEPTH( 2 ) | DIR_WALK_ROOT_RELATIVE_PATHS,      DIR_ITEM_INFO_SIZE | DIR_ITEM_INFO_MTIME,  0x0,       0x0 },
+   { DIR_WALK_SORTED,                                             DIR_ITEM_INFO_INODE,                       0x0,       0x0 },
+   { DIR_WALK_SORTED | DIR_WALK_DEPTH_FIRST,                      0,                                         0x0,       0x0 },
+   { DIR_WALK_ROOT_RELATIVE_PATHS,                                0,                                         "d1/**",   "*.c" },
+   { 0,                                                           DIR_ITEM_INFO_ALL,                         "**/d0",   "{a,b}.*" }
+};
+
+struct test_item
+{
+   char* path;
+   enum dir_item_type type;
+   struct dir_item_info info;
+};
+
+struct test_result
+{
+   struct test_item items[TEST_MAX_ITEMS];
+   unsigned int num_items;
+
+   /* batches in the order they were passed */
+   char* batch_dirs[TEST_MAX_BATCHES];
+   unsigned int num_batches;
+
+   const char* root;
+   const struct test_walk* walk;
+   int ok;
+};
+
+static void test_add( struct test_result* result, const char* path, enum dir_item_type type, const struct dir_item_info* info )
+{
+   struct test_item* item;
+   if ( result->num_items >= TEST_MAX_ITEMS )
+      return;
+   item = &result->items[result->num_items++];
+   item->path = (char*)malloc( strlen( path ) + 1 );
+   strcpy( item->path, path );
+   item->type = type;
+   item->info = *info;
+}
+
+static int test_info_callback( const char* path, unsigned int path_len, enum dir_item_type type, const struct dir_item_info* info, void* userdata )
+{
+   (void)path_len;
+   test_add( (struct test_result*)userdata, path, type, info );
+   return DIR_WALK_CONTINUE;
+}
+
+static int test_batch_callback( const struct dir_item_batch* batch, void* userdata )
+{
+   struct test_result* result = (struct test_result*)userdata;
+   const struct test_walk* walk = result->walk;
+   unsigned int i;
+
+   if ( batch->count == 0 || batch->dir_path_len != strlen( batch->dir_path ) || result->num_batches == TEST_MAX_BATCHES ||
+        ( batch->infos != 0x0 ) != ( walk->info_fields != 0 ) )
+   {
+      printf( "flags 0x%x: batch '%s' has %u items, path length %u and infos %p\n", walk->flags, batch->dir_path, batch->count,
+              batch->dir_path_len, (const void*)batch->infos );
+      result->ok = 0;
+      return DIR_WALK_ABORT;
+   }
+   result->batch_dirs[result->num_batches] = (char*)malloc( batch->dir_path_len + 1 );
+   strcpy( result->batch_dirs[result->num_batches++], batch->dir_path );
+
+   for ( i = 0; i < batch->count; ++i )
+   {
+      const char* name = batch->names + batch->name_offsets[i];
+      struct dir_item_info info;
+      char path[1024], lstat_path[2048];
+      struct stat s;
+
+      sprintf( path, "%s%s%s", batch->dir_path, batch->dir_path_len ? "/" : "", name );
+      if ( walk->flags & DIR_WALK_ROOT_RELATIVE_PATHS )
+         sprintf( lstat_path, "%s/%s", result->root, path );
+      else
+         strcpy( lstat_path, path );
+
+      if ( batch->name_lens[i] != strlen( name ) || strchr( name, '/' ) || lstat( lstat_path, &s ) != 0 || batch->inodes[i] != (dir_uint64)s.st_ino )
+      {
+         printf( "flags 0x%x: '%s' in batch '%s' has name length %u and inode %lu\n", walk->flags, name, batch->dir_path,
+                 batch->name_lens[i], (unsigned long)batch->inodes[i] );
+         result->ok = 0;
+      }
+      if ( ( walk->flags & DIR_WALK_SORTED ) && i > 0 && strcmp( batch->names + batch->name_offsets[i - 1], name ) >= 0 )
+      {
+         printf( "flags 0x%x: '%s' is after '%s' in batch '%s'\n", walk->flags, name, batch->names + batch->name_offsets[i - 1], batch->dir_path );
+         result->ok = 0;
+      }
+
+      if ( batch->infos )
+         info = batch->infos[i];
+      else
+         info.valid = 0;
+      test_add( result, path, (enum dir_item_type)batch->types[i], &info );
+   }
+   return DIR_WALK_CONTINUE;
+}
+
+static int test_compare_items( const void* a, const void* b )
+{
+   return strcmp( ( (const struct test_item*)a )->path, ( (const struct test_item*)b )->path );
+}
+
+static void test_clear( struct test_result* result )
+{
+   unsigned int i;
+   for ( i = 0; i < result->num_items; ++i )
+      free( result->items[i].path );
+   for ( i = 0; i < result->num_batches; ++i )
+      free( result->batch_dirs[i] );
+   result->num_items = 0;
+   result->num_batches = 0;
+}
+
+/* the fields of info that are valid */
+static int test_same_info( const struct dir_item_info* a, const struct dir_item_info* b )
+{
+   if ( a->valid != b->valid )
+      return 0;
+   if ( ( a->valid & DIR_ITEM_INFO_SIZE ) && a->size != b->size )
+      return 0;
+   if ( ( a->valid & DIR_ITEM_INFO_MTIME ) && ( a->mtime != b->mtime || a->mtime_nsec != b->mtime_nsec ) )
+      return 0;
+   if ( ( a->valid & DIR_ITEM_INFO_INODE ) && ( a->inode != b->inode || a->device != b->device ) )
+      return 0;
+   if ( ( a->valid & DIR_ITEM_INFO_MODE ) && a->mode != b->mode )
+      return 0;
+   return !( a->valid & DIR_ITEM_INFO_SYMLINK ) || a->is_symlink == b->is_symlink;
+}
+
+/* each directory in one batch, before the batches of its sub-directories or after them with DIR_WALK_DEPTH_FIRST */
+static int test_batch_order( const struct test_result* result, unsigned int flags )
+{
+   unsigned int i, j;
+   for ( i = 0; i < result->num_batches; ++i )
+   {
+      const char* dir = result->batch_dirs[i];
+      size_t len = strlen( dir );
+      for ( j = 0; j < result->num_batches; ++j )
+      {
+         const char* other = result->batch_dirs[j];
+         int below = len == 0 ? other[0] != '\0' : strncmp( other, dir, len ) == 0 && other[len] == '/';
+         if ( ( i != j && strcmp( dir, other ) == 0 ) || ( below && ( ( flags & DIR_WALK_DEPTH_FIRST ) ? j > i : j < i ) ) )
+         {
+            printf( "flags 0x%x: batch '%s' is passed as number %u and batch '%s' as number %u\n", flags, dir, i, other, j );
+            return 0;
+         }
+      }
+   }
+   return 1;
+}
+
+static int test_walk( const char* root, const struct test_walk* walk, struct test_result* expected, struct test_result* result )
+{
+   enum dir_error err;
+   unsigned int i;
+   int ok;
+
+   result->root = root;
+   result->walk = walk;
+   result->ok = 1;
+   err = dir_walkex_info( root, walk->flags, walk->info_fields, walk->glob_directories, walk->glob_files, test_info_callback, expected );
+   ok = err == DIR_ERROR_OK && expected->num_items > 0;
+   err = dir_walkex_batch( root, walk->flags, walk->info_fields, walk->glob_directories, walk->glob_files, test_batch_callback, result );
+   ok &= err == DIR_ERROR_OK && result->ok && test_batch_order( result, walk->flags );
+
+   qsort( expected->items, expected->num_items, sizeof( struct test_item ), test_compare_items );
+   qsort( result->items, result->num_items, sizeof( struct test_item ), test_compare_items );
+   ok &= expected->num_items == result->num_items;
+   for ( i = 0; ok && i < expected->num_items; ++i )
+      ok = strcmp( expected->items[i].path, result->items[i].path ) == 0 && expected->items[i].type == result->items[i].type &&
+           test_same_info( &expected->items[i].info, &result->items[i].info );
+   if ( !ok )
+   {
+      printf( "flags 0x%x, info 0x%x, globs '%s' '%s': dir_walkex_batch returned %d and %u items in %u batches, dir_walkex_info %u items\n",
+              walk->flags, walk->info_fields, walk->glob_directories ? walk->glob_directories : "", walk->glob_files ? walk->glob_files : "",
+              (int)err, result->num_items, result->num_batches, expected->num_items );
+      for ( i = 0; i < expected->num_items || i < result->num_items; ++i )
+         printf( "   %-60s %s\n", i < expected->num_items ? expected->items[i].path : "", i < result->num_items ? result->items[i].path : "" );
+   }
+   test_clear( expected );
+   test_clear( result );
+   return ok;
+}
+
+/* directories d0, d1 and .d2 and files a.c, b.txt and .c.c in each directory, 'depth' levels below path */
+static int test_create_tree( char* path, unsigned int path_len, unsigned int depth )
+{
+   static const char* files[] = { "a.c", "b.txt", ".c.c" };
+   static const char* dirs[] = { "d0", "d1", ".d2" };
+   unsigned int i;
+
+   if ( dir_create( path ) != DIR_ERROR_OK )
+      return 0;
+   for ( i = 0; i < 3; ++i )
+   {
+      FILE* file;
+      sprintf( path + path_len, "/%s", files[i] );
+      file = fopen( path, "wb" );
+      if ( file == 0x0 )
+         return 0;
+      fputs( files[i], file );
+      fclose( file );
+   }
+   for ( i = 0; depth && i < 3; ++i )
+   {
+      unsigned int len = path_len + (unsigned int)sprintf( path + path_len, "/%s", dirs[i] );
+      if ( !test_create_tree( path, len, depth - 1 ) )
+         return 0;
+   }
+   path[path_len] = '\0';
+   return 1;
+}
+
+int main( void )
+{
+   static struct test_result expected, result;
+   char root[] = "dirutil_test_batch_XXXXXX";
+   char path[4096];
+   size_t len;
+   unsigned int i;
+   int ok = 1;
+
+   if ( mkdtemp( root ) == 0x0 )
+   {
+      printf( "failed to create a temporary directory\n" );
+      return 1;
+   }
+   sprintf( path, "%s/tree", root );
+   ok = test_create_tree( path, (unsigned int)strlen( path ), 2 );
+   len = (size_t)sprintf( path, "%s/tree/d0/deep", root );
+   for ( i = 0; i < TEST_DEEP; ++i )
+   {
+      FILE* file;
+      len += (size_t)sprintf( path + len, "/%u", i );
+      if ( dir_mktree( path ) != DIR_ERROR_OK )
+         break;
+      strcpy( path + len, "/x.c" );
+      file = fopen( path, "wb" );
+      if ( file == 0x0 )
+         break;
+      fclose( file );
+      path[len] = '\0';
+   }
+   if ( !ok || i != TEST_DEEP )
+   {
+      printf( "failed to create the tree\n" );
+      dir_rmtree( root );
+      return 1;
+   }
+
+   sprintf( path, "%s/tree", root );
+   for ( i = 0; i < sizeof( test_walks ) / sizeof( test_walks[0] ); ++i )
+      ok &= test_walk( path, &test_walks[i], &expected, &result );
+
+   dir_rmtree( root );
+   printf( "%s\n", ok ? "batch: OK" : "batch: FAILED" );
+   return ok ? 0 : 1;
+}
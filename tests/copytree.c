@@ -0,0 +1,365 @@
+/*
+   dir_copytree, copies a tree with glob patterns applied and checks that exactly the items dir_walkex reports with the
+   same flags and patterns, and the directories leading to them, are copied. file contents and symlink targets must
+   match, and with DIR_COPY_PRESERVE the permission bits and modification times of files and directories as well.
+   without it files get the permission bits of the source masked by the umask. posix only.
+
+   build and run from the root of the repository:
+      cc -O2 -pthread -o test_copytree tests/copytree.c && ./test_copytree
+*/
+#define _DEFAULT_SOURCE
+#define DIRUTIL_IMPLEMENTATION
+#include "../dirutil.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define TEST_MAX_ITEMS 64
+
+/* name, content and permission bits of each file in the tree, parent directories are created as needed */
+struct test_file
+{
+   const char* name;
+   const char* content;
+   unsigned int mode;
+};
+
+static const struct test_file test_files[] =
+{
+   { "a.txt",          "a",            0644 },
+   { "b.c",            "int b;",       0600 },
+   { "run.c",          "int main;",    0755 },
+   { ".hidden.c",      "",             0640 },
+   { "src/main.c",     "int main2;",   0644 },
+   { "src/main.h",     "#pragma once", 0444 },
+   { "src/lib/util.c", "int util;",    0604 },
+   { "src/lib/big.c",  0x0,            0644 }, /* larger than one read, to not only test the first chunk */
+   { "docs/readme.c",  "not code",     0644 },
+   { "empty/.keep",    "",             0644 }
+};
+
+/* directories with other permission bits than the default, to check that they are preserved */
+static const struct test_file test_dirs[] =
+{
+   { "src",     0x0, 0750 },
+   { "src/lib", 0x0, 0700 }
+};
+
+struct test_copy
+{
+   unsigned int flags;
+   const char* glob_directories;
+   const char* glob_files;
+};
+
+static const struct test_copy test_copies[] =
+{
+   { DIR_COPY_PRESERVE,                                   0x0,          0x0 },
+   { DIR_COPY_PRESERVE,                                   "src/**",     "*.c" },
+   { DIR_COPY_PRESERVE | DIR_WALK_IGNORE_DOT_FILES,       0x0,          "*.{c,h}" },
+   { DIR_COPY_PRESERVE | DIR_WALK_MAX_DEPTH( 1 ),         0x0,          0x0 },
+   { 0,                                                   "src/**",     0x0 },
+   { DIR_COPY_NO_REFLINK,                                 0x0,          "*.c" }
+};
+
+/* paths in the second copy, with the directory pattern matching below 'src' and '*.c' as file pattern, and if they are copied */
+static const char* test_filtered[] =
+{
+   "b.c",            "yes",
+   "a.txt",          "no",
+   ".hidden.c",      "no",
+   "docs",           "no",
+   "empty",          "no",
+   "src/main.c",     "no", /* only walked to reach 'src/lib' */
+   "src/lib/util.c", "yes",
+   "src/lib/big.c",  "yes"
+};
+
+struct test_items
+{
+   char* paths[TEST_MAX_ITEMS]; /* relative to the root of the walk */
+   unsigned int num_items;
+};
+
+static void test_add( struct test_items* items, const char* path, unsigned int path_len )
+{
+   unsigned int i;
+   for ( i = 0; i < items->num_items; ++i )
+      if ( strncmp( items->paths[i], path, path_len ) == 0 && items->paths[i][path_len] == '\0' )
+         return;
+   if ( items->num_items == TEST_MAX_ITEMS )
+      return;
+   items->paths[items->num_items] = (char*)malloc( path_len + 1 );
+   memcpy( items->paths[items->num_items], path, path_len );
+   items->paths[items->num_items][path_len] = '\0';
+   ++items->num_items;
+}
+
+/* adds the item and the directories leading to it */
+static int test_walk_callback( const char* path, unsigned int path_len, enum dir_item_type type, void* userdata )
+{
+   struct test_items* items = (struct test_items*)userdata;
+   unsigned int i;
+   (void)type;
+   for ( i = 0; i < path_len; ++i )
+      if ( path[i] == '/' )
+         test_add( items, path, i );
+   test_add( items, path, path_len );
+   return DIR_WALK_CONTINUE;
+}
+
+static int test_find( const struct test_items* items, const char* path )
+{
+   unsigned int i;
+   for ( i = 0; i < items->num_items; ++i )
+      if ( strcmp( items->paths[i], path ) == 0 )
+         return 1;
+   return 0;
+}
+
+static void test_clear( struct test_items* items )
+{
+   unsigned int i;
+   for ( i = 0; i < items->num_items; ++i )
+      free( items->paths[i] );
+   items->num_items = 0;
+}
+
+static int test_set_time( const char* path, long seconds )
+{
+   struct timespec times[2];
+   times[0].tv_sec = times[1].tv_sec = seconds;
+   times[0].tv_nsec = times[1].tv_nsec = 123456789;
+   return utimensat( AT_FDCWD, path, times, AT_SYMLINK_NOFOLLOW ) == 0;
+}
+
+static int test_create_tree( const char* src )
+{
+   char path[256];
+   unsigned int i;
+   for ( i = 0; i < sizeof( test_files ) / sizeof( test_files[0] ); ++i )
+   {
+      const struct test_file* f = &test_files[i];
+      char* slash;
+      FILE* file;
+
+      sprintf( path, "%s/%s", src, f->name );
+      slash = strrchr( path, '/' );
+      *slash = '\0';
+      if ( dir_mktree( path ) != DIR_ERROR_OK )
+         return 0;
+      *slash = '/';
+
+      file = fopen( path, "wb" );
+      if ( file == 0x0 )
+         return 0;
+      if ( f->content )
+         fputs( f->content, file );
+      else
+      {
+         unsigned int n;
+         for ( n = 0; n < 300000; ++n )
+            fputc( 'a' + n % 23, file );
+      }
+      fclose( file );
+      if ( chmod( path, f->mode ) != 0 || !test_set_time( path, 1000000000L + (long)i * 1000 ) )
+         return 0;
+   }
+
+   sprintf( path, "%s/src/link.c", src );
+   if ( symlink( "main.c", path ) != 0 || !test_set_time( path, 1100000000L ) )
+      return 0;
+
+   /* directories last, writing to them changes their times */
+   for ( i = 0; i < sizeof( test_dirs ) / sizeof( test_dirs[0] ); ++i )
+   {
+      sprintf( path, "%s/%s", src, test_dirs[i].name );
+      if ( chmod( path, test_dirs[i].mode ) != 0 || !test_set_time( path, 1200000000L + (long)i * 1000 ) )
+         return 0;
+   }
+   return 1;
+}
+
+static char* test_read_file( const char* path, size_t* size )
+{
+   FILE* file = fopen( path, "rb" );
+   char* data;
+   if ( file == 0x0 )
+      return 0x0;
+   fseek( file, 0, SEEK_END );
+   *size = (size_t)ftell( file );
+   fseek( file, 0, SEEK_SET );
+   data = (char*)malloc( *size + 1 );
+   if ( fread( data, 1, *size, file ) != *size )
+   {
+      free( data );
+      data = 0x0;
+   }
+   fclose( file );
+   return data;
+}
+
+/* compares one copied item with its source */
+static int test_same( const char* src_path, const char* dst_path, unsigned int flags, mode_t umask_bits )
+{
+   struct stat src, dst;
+   mode_t expected_mode;
+
+   if ( lstat( src_path, &src ) != 0 || lstat( dst_path, &dst ) != 0 )
+   {
+      printf( "   '%s' is not copied\n", dst_path );
+      return 0;
+   }
+   if ( ( src.st_mode & S_IFMT ) != ( dst.st_mode & S_IFMT ) )
+   {
+      printf( "   '%s' is another type than its source\n", dst_path );
+      return 0;
+   }
+
+   if ( S_ISLNK( src.st_mode ) )
+   {
+      char src_target[256], dst_target[256];
+      ssize_t src_len = readlink( src_path, src_target, sizeof( src_target ) );
+      ssize_t dst_len = readlink( dst_path, dst_target, sizeof( dst_target ) );
+      if ( src_len < 0 || src_len != dst_len || memcmp( src_target, dst_target, (size_t)src_len ) != 0 )
+      {
+         printf( "   '%s' links to another target than its source\n", dst_path );
+         return 0;
+      }
+   }
+   else if ( S_ISREG( src.st_mode ) )
+   {
+      size_t src_size, dst_size;
+      char* src_data = test_read_file( src_path, &src_size );
+      char* dst_data = test_read_file( dst_path, &dst_size );
+      int same = src_data && dst_data && src_size == dst_size && memcmp( src_data, dst_data, src_size ) == 0;
+      free( src_data );
+      free( dst_data );
+      if ( !same )
+      {
+         printf( "   '%s' has other contents than its source\n", dst_path );
+         return 0;
+      }
+   }
+
+   if ( S_ISLNK( src.st_mode ) )
+      expected_mode = dst.st_mode & 07777;
+   else if ( flags & DIR_COPY_PRESERVE )
+      expected_mode = src.st_mode & 07777;
+   else if ( S_ISREG( src.st_mode ) )
+      expected_mode = src.st_mode & 0777 & ~umask_bits;
+   else
+      expected_mode = 0777 & ~umask_bits;
+   if ( ( dst.st_mode & 07777 ) != expected_mode )
+   {
+      printf( "   '%s' has mode %o, expected %o\n", dst_path, (unsigned int)( dst.st_mode & 07777 ), (unsigned int)expected_mode );
+      return 0;
+   }
+
+   if ( ( flags & DIR_COPY_PRESERVE ) &&
+        ( DIR_STAT_MTIME( src ).tv_sec != DIR_STAT_MTIME( dst ).tv_sec || DIR_STAT_MTIME( src ).tv_nsec != DIR_STAT_MTIME( dst ).tv_nsec ) )
+   {
+      printf( "   '%s' has mtime %ld.%09ld, expected %ld.%09ld\n", dst_path, (long)DIR_STAT_MTIME( dst ).tv_sec, (long)DIR_STAT_MTIME( dst ).tv_nsec,
+              (long)DIR_STAT_MTIME( src ).tv_sec, (long)DIR_STAT_MTIME( src ).tv_nsec );
+      return 0;
+   }
+   return 1;
+}
+
+static int test_copy( const char* root, const char* src, const struct test_copy* copy, unsigned int index, mode_t umask_bits )
+{
+   struct test_items expected, copied;
+   char dst[256], src_path[512], dst_path[512];
+   unsigned int walk_flags = DIR_WALK_ROOT_RELATIVE_PATHS | ( copy->flags & ~( DIR_COPY_PRESERVE | DIR_COPY_NO_REFLINK ) );
+   unsigned int i;
+   enum dir_error err;
+   int ok = 1;
+
+   /* the copy is compared with the walk with the same flags and patterns, and the whole copy is walked to find extra items */
+   expected.num_items = 0;
+   copied.num_items = 0;
+   sprintf( dst, "%s/dst_%u", root, index );
+   err = dir_copytree( src, dst, copy->flags, copy->glob_directories, copy->glob_files, 3, 0x0, 0 );
+   if ( err != DIR_ERROR_OK ||
+        dir_walkex( src, walk_flags, copy->glob_directories, copy->glob_files, test_walk_callback, &expected ) != DIR_ERROR_OK ||
+        dir_walkex( dst, DIR_WALK_ROOT_RELATIVE_PATHS, 0x0, 0x0, test_walk_callback, &copied ) != DIR_ERROR_OK ||
+        expected.num_items == 0 )
+   {
+      printf( "copy %u: failed, returned %d\n", index, (int)err );
+      test_clear( &expected );
+      test_clear( &copied );
+      return 0;
+   }
+
+   for ( i = 0; i < expected.num_items; ++i )
+   {
+      sprintf( src_path, "%s/%s", src, expected.paths[i] );
+      sprintf( dst_path, "%s/%s", dst, expected.paths[i] );
+      ok &= test_same( src_path, dst_path, copy->flags, umask_bits );
+   }
+   for ( i = 0; i < copied.num_items; ++i )
+   {
+      if ( !test_find( &expected, copied.paths[i] ) )
+      {
+         printf( "   '%s/%s' is copied but not walked\n", dst, copied.paths[i] );
+         ok = 0;
+      }
+   }
+   ok &= test_same( src, dst, copy->flags, umask_bits );
+
+   if ( !ok )
+      printf( "copy %u: flags 0x%x, globs '%s' '%s' differs from its source\n", index, copy->flags,
+              copy->glob_directories ? copy->glob_directories : "", copy->glob_files ? copy->glob_files : "" );
+   test_clear( &expected );
+   test_clear( &copied );
+   return ok;
+}
+
+int main( void )
+{
+   char root[] = "dirutil_test_copytree_XXXXXX";
+   char src[64], path[128];
+   unsigned int i;
+   mode_t umask_bits;
+   int ok = 1;
+
+   if ( mkdtemp( root ) == 0x0 )
+   {
+      printf( "failed to create a temporary directory\n" );
+      return 1;
+   }
+   umask_bits = umask( 022 );
+   umask( umask_bits );
+
+   sprintf( src, "%s/src", root );
+   if ( !test_create_tree( src ) )
+   {
+      printf( "failed to create '%s'\n", src );
+      dir_rmtree( root );
+      return 1;
+   }
+
+   for ( i = 0; i < sizeof( test_copies ) / sizeof( test_copies[0] ); ++i )
+      ok &= test_copy( root, src, &test_copies[i], i, umask_bits );
+
+   /* the patterns are applied, not only compared with the walk */
+   for ( i = 0; i < sizeof( test_filtered ) / sizeof( test_filtered[0] ); i += 2 )
+   {
+      int expected = test_filtered[i + 1][0] == 'y';
+      sprintf( path, "%s/dst_1/%s", root, test_filtered[i] );
+      if ( ( access( path, F_OK ) == 0 ) != expected )
+      {
+         printf( "'%s' is %s\n", path, expected ? "not copied" : "copied" );
+         ok = 0;
+      }
+   }
+
+   /* copying again over the copy overwrites it */
+   ok &= test_copy( root, src, &test_copies[0], 0, umask_bits );
+
+   dir_rmtree( root );
+   printf( "%s\n", ok ? "copytree: OK" : "copytree: FAILED" );
+   return ok ? 0 : 1;
+}
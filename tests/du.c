@@ -0,0 +1,366 @@
+/*
+   dir_du/dir_du_top, sums up a tree in a mkdtemp directory with files of different sizes, a file with two hard links,
+   a symlink and dot files with 1, 2, 4 and one worker per hardware thread and checks the totals of each directory
+   against sums of what 'lstat' returns for the items dir_walkex reports with the same flags, the hard-linked file
+   counted once. also checks that each directory is reported once, after the directories below it and only down to
+   max_depth, that dir_du_top reports the largest directories in each order and that a missing path is reported.
+   posix only.
+
+   build and run from the root of the repository:
+      cc -O2 -pthread -o test_du tests/du.c && ./test_du
+*/
+#define _DEFAULT_SOURCE
+#define DIRUTIL_IMPLEMENTATION
+#include "../dirutil.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TEST_MAX_ITEMS 64
+
+/* name and size of each file in the tree, parent directories are created as needed */
+struct test_file
+{
+   const char* name;
+   unsigned int size;
+};
+
+static const struct test_file test_files[] =
+{
+   { "a.bin",            100 },
+   { ".hidden",          7000 },
+   { "src/main.c",       2500 },
+   { "src/lib/util.c",   40000 },
+   { "src/lib/big.bin",  300000 },
+   { "src/.git/HEAD",    41 },
+   { "docs/readme.md",   1 },
+   { "docs/img/x.png",   0 },
+   { "links/one",        5000 },
+   { "empty/.keep",      0 }
+};
+
+static const unsigned int test_threads[] = { 1, 2, 4, 0 };
+
+static const unsigned int test_flags[] =
+{
+   0,
+   DIR_WALK_IGNORE_DOT_FILES | DIR_WALK_IGNORE_DOT_DIRECTORIES,
+   DIR_WALK_MAX_DEPTH( 1 )
+};
+
+struct test_dir
+{
+   char* path; /* relative to the root, "" for the root */
+   unsigned int depth;
+   struct dir_du_totals totals;
+   long seq; /* order the directory was reported in */
+};
+
+struct test_dirs
+{
+   struct test_dir dirs[TEST_MAX_ITEMS];
+   volatile long count;
+};
+
+struct test_walked
+{
+   char* paths[TEST_MAX_ITEMS];
+   enum dir_item_type types[TEST_MAX_ITEMS];
+   unsigned int count;
+};
+
+static const char* test_root;
+
+static int test_walk_callback( const char* path, unsigned int path_len, enum dir_item_type type, void* userdata )
+{
+   struct test_walked* walked = (struct test_walked*)userdata;
+   if ( walked->count == TEST_MAX_ITEMS )
+      return DIR_WALK_ABORT;
+   walked->paths[walked->count] = (char*)malloc( path_len + 1 );
+   memcpy( walked->paths[walked->count], path, path_len + 1 );
+   walked->types[walked->count++] = type;
+   return DIR_WALK_CONTINUE;
+}
+
+static int test_du_callback( const char* path, unsigned int path_len, unsigned int depth, const struct dir_du_totals* totals, unsigned int worker_index, void* userdata )
+{
+   struct test_dirs* dirs = (struct test_dirs*)userdata;
+   long seq = dir_atomic_add( &dirs->count, 1 ) - 1;
+   struct test_dir* dir;
+   (void)worker_index;
+   if ( seq >= TEST_MAX_ITEMS )
+      return DIR_WALK_ABORT;
+   dir = &dirs->dirs[seq];
+   dir->path = (char*)malloc( path_len + 1 );
+   memcpy( dir->path, path, path_len + 1 );
+   dir->depth = depth;
+   dir->totals = *totals;
+   dir->seq = seq;
+   return DIR_WALK_CONTINUE;
+}
+
+static void test_clear( struct test_dirs* dirs )
+{
+   long i;
+   for ( i = 0; i < dirs->count && i < TEST_MAX_ITEMS; ++i )
+      free( dirs->dirs[i].path );
+   dirs->count = 0;
+}
+
+static int test_lstat( const char* path, struct stat* s )
+{
+   char full[256];
+   sprintf( full, "%s%s%s", test_root, path[0] ? "/" : "", path );
+   return lstat( full, s ) == 0;
+}
+
+static int test_below( const char* dir, const char* path )
+{
+   size_t len = strlen( dir );
+   return len == 0 || ( strncmp( path, dir, len ) == 0 && path[len] == '/' );
+}
+
+/* the totals of dir, summed up from lstat of the walked items below it, files with more than one link counted once */
+static void test_expected( const struct test_walked* walked, const char* dir, struct dir_du_totals* totals )
+{
+   dir_uint64 counted[TEST_MAX_ITEMS];
+   unsigned int num_counted = 0, i, j;
+   struct stat s;
+
+   memset( totals, 0, sizeof( *totals ) );
+   if ( test_lstat( dir, &s ) )
+   {
+      totals->size = (dir_uint64)s.st_size;
+      totals->allocated = (dir_uint64)s.st_blocks * 512;
+   }
+   for ( i = 0; i < walked->count; ++i )
+   {
+      if ( !test_below( dir, walked->paths[i] ) || !test_lstat( walked->paths[i], &s ) )
+         continue;
+      if ( walked->types[i] != DIR_ITEM_DIR && s.st_nlink > 1 )
+      {
+         for ( j = 0; j < num_counted && counted[j] != (dir_uint64)s.st_ino; ++j )
+            ;
+         if ( j < num_counted )
+            continue;
+         counted[num_counted++] = (dir_uint64)s.st_ino;
+      }
+      totals->size += (dir_uint64)s.st_size;
+      totals->allocated += (dir_uint64)s.st_blocks * 512;
+      if ( walked->types[i] == DIR_ITEM_DIR )
+         ++totals->num_dirs;
+      else
+         ++totals->num_files;
+   }
+}
+
+static int test_same_totals( const struct dir_du_totals* a, const struct dir_du_totals* b )
+{
+   return a->size == b->size && a->allocated == b->allocated && a->num_files == b->num_files && a->num_dirs == b->num_dirs;
+}
+
+static void test_print_totals( const char* what, const char* path, const struct dir_du_totals* totals )
+{
+   printf( "   %s '%s': size %lu, allocated %lu, %lu files, %lu directories\n", what, path, (unsigned long)totals->size,
+           (unsigned long)totals->allocated, (unsigned long)totals->num_files, (unsigned long)totals->num_dirs );
+}
+
+static unsigned int test_depth( const char* path )
+{
+   unsigned int depth = path[0] != '\0';
+   for ( ; *path; ++path )
+      depth += *path == '/';
+   return depth;
+}
+
+/* every walked directory down to max_depth is reported once, after the directories below it, with the expected totals */
+static int test_du( const struct test_walked* walked, unsigned int flags, unsigned int max_depth, unsigned int num_threads, struct test_dirs* dirs )
+{
+   struct dir_du_totals root_totals, expected;
+   unsigned int i, num_expected = 1;
+   long d, e;
+   int ok;
+
+   enum dir_error err = dir_du( test_root, flags | DIR_WALK_ROOT_RELATIVE_PATHS, max_depth, num_threads, test_du_callback, dirs, &root_totals );
+   test_expected( walked, "", &expected );
+   ok = err == DIR_ERROR_OK && test_same_totals( &root_totals, &expected );
+   if ( !ok )
+   {
+      printf( "flags 0x%x, max depth %u, %u workers: returned %d\n", flags, max_depth, num_threads, (int)err );
+      test_print_totals( "totals of", "", &root_totals );
+      test_print_totals( "expected for", "", &expected );
+   }
+   for ( i = 0; i < walked->count; ++i )
+      num_expected += walked->types[i] == DIR_ITEM_DIR && test_depth( walked->paths[i] ) <= max_depth;
+
+   for ( d = 0; ok && d < dirs->count; ++d )
+   {
+      const struct test_dir* dir = &dirs->dirs[d];
+      test_expected( walked, dir->path, &expected );
+      ok = dir->depth == test_depth( dir->path ) && dir->depth <= max_depth && test_same_totals( &dir->totals, &expected );
+      for ( e = 0; ok && e < dirs->count; ++e )
+         ok = e == d || ( strcmp( dirs->dirs[e].path, dir->path ) != 0 && ( !test_below( dir->path, dirs->dirs[e].path ) || dirs->dirs[e].seq < dir->seq ) );
+      if ( !ok )
+      {
+         printf( "flags 0x%x, max depth %u, %u workers: '%s' at depth %u reported as number %ld\n", flags, max_depth, num_threads, dir->path, dir->depth, dir->seq );
+         test_print_totals( "totals of", dir->path, &dir->totals );
+         test_print_totals( "expected for", dir->path, &expected );
+      }
+   }
+   if ( ok && dirs->count != (long)num_expected )
+   {
+      printf( "flags 0x%x, max depth %u, %u workers: %ld directories reported, expected %u\n", flags, max_depth, num_threads, dirs->count, num_expected );
+      ok = 0;
+   }
+   test_clear( dirs );
+   return ok;
+}
+
+static dir_uint64 test_order_value( const struct dir_du_totals* totals, enum dir_du_order order )
+{
+   switch ( order )
+   {
+      case DIR_DU_BY_ALLOCATED: return totals->allocated;
+      case DIR_DU_BY_SIZE:      return totals->size;
+      default:                  return totals->num_files;
+   }
+}
+
+static int test_compare_values( const void* a, const void* b )
+{
+   dir_uint64 va = *(const dir_uint64*)a, vb = *(const dir_uint64*)b;
+   return va < vb ? 1 : ( va > vb ? -1 : 0 );
+}
+
+/* the values of the reported directories are the num_top largest of all directories, largest first */
+static int test_top( const struct test_walked* walked, enum dir_du_order order, unsigned int num_top, struct test_dirs* dirs )
+{
+   dir_uint64 values[TEST_MAX_ITEMS];
+   struct dir_du_totals totals;
+   unsigned int num_values = 0, i;
+   enum dir_error err;
+   long d;
+   int ok;
+
+   test_expected( walked, "", &totals );
+   values[num_values++] = test_order_value( &totals, order );
+   for ( i = 0; i < walked->count; ++i )
+   {
+      if ( walked->types[i] != DIR_ITEM_DIR )
+         continue;
+      test_expected( walked, walked->paths[i], &totals );
+      values[num_values++] = test_order_value( &totals, order );
+   }
+   qsort( values, num_values, sizeof( dir_uint64 ), test_compare_values );
+
+   err = dir_du_top( test_root, DIR_WALK_ROOT_RELATIVE_PATHS, order, num_top, 4, test_du_callback, dirs, 0x0 );
+   ok = err == DIR_ERROR_OK && dirs->count == (long)( num_top < num_values ? num_top : num_values ) && dirs->dirs[0].path[0] == '\0';
+   for ( d = 0; ok && d < dirs->count; ++d )
+   {
+      test_expected( walked, dirs->dirs[d].path, &totals );
+      ok = test_same_totals( &dirs->dirs[d].totals, &totals ) && test_order_value( &totals, order ) == values[d];
+   }
+   if ( !ok )
+   {
+      printf( "top %u in order %d: returned %d and reported %ld directories\n", num_top, (int)order, (int)err, dirs->count );
+      for ( d = 0; d < dirs->count; ++d )
+         test_print_totals( "reported", dirs->dirs[d].path, &dirs->dirs[d].totals );
+   }
+   test_clear( dirs );
+   return ok;
+}
+
+static int test_create_tree( const char* root )
+{
+   char path[256], link_path[256];
+   unsigned int i, j;
+
+   for ( i = 0; i < sizeof( test_files ) / sizeof( test_files[0] ); ++i )
+   {
+      char* slash;
+      FILE* file;
+
+      sprintf( path, "%s/%s", root, test_files[i].name );
+      slash = strrchr( path, '/' );
+      if ( slash )
+      {
+         *slash = '\0';
+         if ( dir_mktree( path ) != DIR_ERROR_OK )
+            return 0;
+         *slash = '/';
+      }
+      file = fopen( path, "wb" );
+      if ( file == 0x0 )
+         return 0;
+      for ( j = 0; j < test_files[i].size; ++j )
+         fputc( 'a' + (int)( j % 26 ), file );
+      fclose( file );
+   }
+
+   /* a second link to a file in the same directory, counted in it once */
+   sprintf( path, "%s/links/one", root );
+   sprintf( link_path, "%s/links/two", root );
+   if ( link( path, link_path ) != 0 )
+      return 0;
+   sprintf( link_path, "%s/src/link", root );
+   return symlink( "lib/big.bin", link_path ) == 0;
+}
+
+int main( void )
+{
+   static struct test_dirs dirs;
+   char root[] = "dirutil_test_du_XXXXXX";
+   char missing[64];
+   struct test_walked walked;
+   unsigned int f, t, order;
+   int ok = 1;
+
+   if ( mkdtemp( root ) == 0x0 || !test_create_tree( root ) )
+   {
+      printf( "failed to create the tree\n" );
+      dir_rmtree( root );
+      return 1;
+   }
+   test_root = root;
+
+   for ( f = 0; f < sizeof( test_flags ) / sizeof( test_flags[0] ); ++f )
+   {
+      walked.count = 0;
+      if ( dir_walkex( root, test_flags[f] | DIR_WALK_ROOT_RELATIVE_PATHS, 0x0, 0x0, test_walk_callback, &walked ) != DIR_ERROR_OK )
+      {
+         printf( "flags 0x%x: walk failed\n", test_flags[f] );
+         ok = 0;
+      }
+      for ( t = 0; t < sizeof( test_threads ) / sizeof( test_threads[0] ); ++t )
+      {
+         ok &= test_du( &walked, test_flags[f], 100, test_threads[t], &dirs );
+         ok &= test_du( &walked, test_flags[f], 1, test_threads[t], &dirs );
+      }
+      if ( test_flags[f] == 0 )
+      {
+         for ( order = DIR_DU_BY_ALLOCATED; order <= DIR_DU_BY_FILES; ++order )
+         {
+            ok &= test_top( &walked, (enum dir_du_order)order, 1, &dirs );
+            ok &= test_top( &walked, (enum dir_du_order)order, 3, &dirs );
+            ok &= test_top( &walked, (enum dir_du_order)order, 100, &dirs );
+         }
+      }
+      for ( t = 0; t < walked.count; ++t )
+         free( walked.paths[t] );
+   }
+
+   sprintf( missing, "%s/missing", root );
+   if ( dir_du( missing, 0, 0, 2, test_du_callback, &dirs, 0x0 ) != DIR_ERROR_PATH_DO_NOT_EXIST || dirs.count != 0 )
+   {
+      printf( "missing path: not DIR_ERROR_PATH_DO_NOT_EXIST\n" );
+      ok = 0;
+   }
+   test_clear( &dirs );
+
+   dir_rmtree( root );
+   printf( "%s\n", ok ? "du: OK" : "du: FAILED" );
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,186 @@
+/*
+   DIR_WALK_GITIGNORE, walks a tree with nested '.gitignore' and '.ignore' files and checks that exactly the items that
+   are not ignored are reported. without the '.ignore' files, that git do not read, the files are the ones listed by
+   'git ls-files -o --exclude-standard'. names with several '.' and '_' check that '*' matches any part of a name.
+
+   build and run from the root of the repository:
+      cc -O2 -o test_gitignore tests/gitignore.c && ./test_gitignore
+*/
+#define _DEFAULT_SOURCE
+#define DIRUTIL_IMPLEMENTATION
+#include "../dirutil.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_ROOT "dirutil_test_gitignore"
+
+/* name and content of each file in the tree, parent directories are created as needed */
+static const char* test_files[] =
+{
+   ".gitignore",           "*.gz\n*_test.c\n!keep_test.c\nbuild/\n/top.txt\ndocs/**/*.md\n",
+   "a.tar.gz",             "",
+   "my_foo_test.c",        "",
+   "keep_test.c",          "",
+   "notes.tar",            "",
+   "top.txt",              "",
+   "a.b.c.d",              "",
+   ".git/HEAD",            "",
+   ".git/refs/heads/main", "",
+   "build/out.o",          "",
+   "src/.gitignore",       "!*.gz\r\n*.c\r\n",
+   "src/build",            "",
+   "src/top.txt",          "",
+   "src/x.tar.gz",         "",
+   "src/lib_foo_test.c",   "",
+   "src/main.h",           "",
+   "docs/readme.md",       "",
+   "docs/a/b/readme.md",   "",
+   "docs/a/b/image.png",   "",
+   "sub/.gitignore",       "!image.png\n",
+   "sub/.ignore",          "image*\n",
+   "sub/image.png",        "",
+   "sub/d/image.jpg",      "",
+   "sub/d/my.file_name_test.c", ""
+};
+
+/* sorted, directories end with '/' */
+static const char* test_expected[] =
+{
+   ".gitignore",
+   "a.b.c.d",
+   "docs/",
+   "docs/a/",
+   "docs/a/b/",
+   "docs/a/b/image.png",
+   "keep_test.c",
+   "notes.tar",
+   "src/",
+   "src/.gitignore",
+   "src/build",
+   "src/main.h",
+   "src/top.txt",
+   "src/x.tar.gz",
+   "sub/",
+   "sub/.gitignore",
+   "sub/.ignore",
+   "sub/d/"
+};
+
+#define TEST_NUM_EXPECTED ( sizeof( test_expected ) / sizeof( test_expected[0] ) )
+#define TEST_MAX_ITEMS 64
+
+struct test_result
+{
+   char* items[TEST_MAX_ITEMS];
+   unsigned int num_items;
+};
+
+static void test_add( struct test_result* result, const char* path, unsigned int path_len, int is_dir )
+{
+   char* item;
+   if ( result->num_items == TEST_MAX_ITEMS )
+      return;
+   item = (char*)malloc( path_len + 2 );
+   memcpy( item, path, path_len );
+   strcpy( item + path_len, is_dir ? "/" : "" );
+   result->items[result->num_items++] = item;
+}
+
+static int test_walk_callback( const char* path, unsigned int path_len, enum dir_item_type type, void* userdata )
+{
+   test_add( (struct test_result*)userdata, path, path_len, type == DIR_ITEM_DIR );
+   return DIR_WALK_CONTINUE;
+}
+
+static int test_batch_callback( const struct dir_item_batch* batch, void* userdata )
+{
+   char path[256];
+   unsigned int i;
+   for ( i = 0; i < batch->count; ++i )
+   {
+      int len = sprintf( path, "%s%s%s", batch->dir_path, batch->dir_path_len ? "/" : "", batch->names + batch->name_offsets[i] );
+      test_add( (struct test_result*)userdata, path, (unsigned int)len, batch->types[i] == DIR_ITEM_DIR );
+   }
+   return DIR_WALK_CONTINUE;
+}
+
+static int test_compare_items( const void* a, const void* b )
+{
+   return strcmp( *(const char* const*)a, *(const char* const*)b );
+}
+
+static int test_check( const char* name, struct test_result* result )
+{
+   unsigned int i;
+   int ok = result->num_items == TEST_NUM_EXPECTED;
+
+   qsort( result->items, result->num_items, sizeof( char* ), test_compare_items );
+   for ( i = 0; ok && i < TEST_NUM_EXPECTED; ++i )
+      ok = strcmp( result->items[i], test_expected[i] ) == 0;
+
+   if ( !ok )
+   {
+      printf( "%s: FAILED, reported:\n", name );
+      for ( i = 0; i < result->num_items; ++i )
+         printf( "   %s\n", result->items[i] );
+   }
+   for ( i = 0; i < result->num_items; ++i )
+      free( result->items[i] );
+   result->num_items = 0;
+   return ok;
+}
+
+static int test_create_tree( void )
+{
+   unsigned int i;
+   for ( i = 0; i < sizeof( test_files ) / sizeof( test_files[0] ); i += 2 )
+   {
+      char path[256];
+      char* slash;
+      FILE* file;
+
+      sprintf( path, "%s/%s", TEST_ROOT, test_files[i] );
+      slash = strrchr( path, '/' );
+      *slash = '\0';
+      if ( dir_mktree( path ) != DIR_ERROR_OK )
+         return 0;
+      *slash = '/';
+
+      file = fopen( path, "wb" );
+      if ( file == 0x0 )
+         return 0;
+      fputs( test_files[i + 1], file );
+      fclose( file );
+   }
+   return 1;
+}
+
+int main( void )
+{
+   struct test_result result;
+   unsigned int flags = DIR_WALK_GITIGNORE | DIR_WALK_ROOT_RELATIVE_PATHS | DIR_WALK_PATHS_SLASH_FORWARD;
+   int ok = 1;
+
+   result.num_items = 0;
+   dir_rmtree( TEST_ROOT );
+   if ( !test_create_tree() )
+   {
+      printf( "failed to create '%s'\n", TEST_ROOT );
+      return 1;
+   }
+
+   dir_walkex( TEST_ROOT, flags, 0x0, 0x0, test_walk_callback, &result );
+   ok &= test_check( "dir_walkex", &result );
+
+   dir_walkex( TEST_ROOT, flags | DIR_WALK_SORTED | DIR_WALK_DEPTH_FIRST, 0x0, 0x0, test_walk_callback, &result );
+   ok &= test_check( "dir_walkex sorted, depth first", &result );
+
+   dir_walkex_batch( TEST_ROOT, flags, 0, 0x0, 0x0, test_batch_callback, &result );
+   ok &= test_check( "dir_walkex_batch", &result );
+
+   dir_rmtree( TEST_ROOT );
+   printf( "%s\n", ok ? "gitignore: OK" : "gitignore: FAILED" );
+   return ok ? 0 : 1;
+}
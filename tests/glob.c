@@ -0,0 +1,259 @@
+/*
+   dir_glob_compile/dir_glob_match_compiled, checks that compiled patterns match exactly as dir_glob_match interprets
+   them, first on a list of patterns and paths with known results, then on random patterns, valid and invalid, against
+   random paths. then walks a tree in a mkdtemp directory with file patterns, that the walk compiles, and checks that
+   the files reported are the ones dir_glob_match matches.
+
+   build and run from the root of the repository, the second line checks the scalar build:
+      cc -O2 -o test_glob tests/glob.c && ./test_glob
+      cc -O2 -DDIRUTIL_NO_SIMD -o test_glob tests/glob.c && ./test_glob
+*/
+#define _DEFAULT_SOURCE
+#define DIRUTIL_IMPLEMENTATION
+#include "../dirutil.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_NUM_RANDOM 300000UL
+#define TEST_MAX_FILES  64
+
+struct test_case
+{
+   const char* pattern;
+   const char* path;
+   enum dir_glob_result expected;
+};
+
+static const struct test_case test_cases[] =
+{
+   { "*.txt",              "file.txt",                    DIR_GLOB_MATCH },
+   { "*.txt",              "file.txt.bak",                DIR_GLOB_NO_MATCH },
+   { "*.txt",              "dir/file.txt",                DIR_GLOB_NO_MATCH },
+   { "file.???",           "file.txt",                    DIR_GLOB_MATCH },
+   { "file.???",           "file.tx",                     DIR_GLOB_NO_MATCH },
+   { "a?c",                "a/c",                         DIR_GLOB_NO_MATCH },
+   { "[abx]",              "x",                           DIR_GLOB_MATCH },
+   { "[abx]",              "c",                           DIR_GLOB_NO_MATCH },
+   { "[0-9][0-9].log",     "42.log",                      DIR_GLOB_MATCH },
+   { "[0-9][0-9].log",     "4a.log",                      DIR_GLOB_NO_MATCH },
+   { "notes{.txt,.doc}",   "notes.doc",                   DIR_GLOB_MATCH },
+   { "notes{.txt,.doc}",   "notes.pdf",                   DIR_GLOB_NO_MATCH },
+   { "src/*/main.c",       "src/app/main.c",              DIR_GLOB_MATCH },
+   { "src/*/main.c",       "src/app/sub/main.c",          DIR_GLOB_NO_MATCH },
+   { "src/**/main.c",      "src/app/sub/main.c",          DIR_GLOB_MATCH },
+   { "src/**/main.c",      "src/main.c",                  DIR_GLOB_MATCH },
+   { "a/b/c**",            "a/b/c/d/e/file.txt",          DIR_GLOB_MATCH },
+   { "**",                 "any/thing/at/all",            DIR_GLOB_MATCH },
+   { "src/*.c",            "src\\main.c",                 DIR_GLOB_MATCH },
+   { "src/*.c",            "src//\\main.c",               DIR_GLOB_MATCH },
+   { "Makefile",           "Makefile",                    DIR_GLOB_MATCH },
+   { "Makefile",           "makefile",                    DIR_GLOB_NO_MATCH },
+   { "",                   "",                            DIR_GLOB_MATCH },
+   { "",                   "a",                           DIR_GLOB_NO_MATCH },
+   { "[abc",               "a",                           DIR_GLOB_INVALID_PATTERN },
+   { "{a,b",               "a",                           DIR_GLOB_INVALID_PATTERN }
+};
+
+static unsigned long test_seed = 1;
+
+/* same random sequence on every platform */
+static unsigned int test_rand( void )
+{
+   test_seed = test_seed * 1103515245UL + 12345UL;
+   return (unsigned int)( ( test_seed >> 16 ) & 0x7fff );
+}
+
+/* a pattern made from pieces that are each valid, and now and then one that is not */
+static void test_random_pattern( char* pattern )
+{
+   static const char* pieces[] = { "a", "b", "ab", "ba", ".", "/", "*", "**", "?", "[ab]", "[a-c]", "[!a]", "{a,bb}", "{.a,b.}", "**/", "/**" };
+   static const char* broken[] = { "[", "{", "[a", "{a,", "]", "}" };
+   unsigned int n = test_rand() % 7, i;
+   pattern[0] = '\0';
+   for ( i = 0; i < n; ++i )
+      strcat( pattern, pieces[test_rand() % ( sizeof( pieces ) / sizeof( pieces[0] ) )] );
+   if ( test_rand() % 20 == 0 )
+      strcat( pattern, broken[test_rand() % ( sizeof( broken ) / sizeof( broken[0] ) )] );
+}
+
+static void test_random_path( char* path )
+{
+   static const char chars[] = "aabb./\\c";
+   unsigned int len = test_rand() % 12, i;
+   for ( i = 0; i < len; ++i )
+      path[i] = chars[test_rand() % ( sizeof( chars ) - 1 )];
+   path[len] = '\0';
+}
+
+static int test_same( const char* pattern, const char* path, enum dir_glob_result* result )
+{
+   struct dir_glob* glob = dir_glob_compile( pattern );
+   enum dir_glob_result interpreted = dir_glob_match( pattern, path );
+   enum dir_glob_result compiled = glob ? dir_glob_match_compiled( glob, path ) : DIR_GLOB_FORCEINT;
+   dir_glob_free( glob );
+   *result = interpreted;
+   if ( interpreted != compiled )
+   {
+      printf( "'%s' vs '%s' is %d interpreted but %d compiled\n", pattern, path, (int)interpreted, (int)compiled );
+      return 0;
+   }
+   return 1;
+}
+
+static int test_known( void )
+{
+   unsigned int i;
+   int ok = 1;
+   for ( i = 0; i < sizeof( test_cases ) / sizeof( test_cases[0] ); ++i )
+   {
+      const struct test_case* c = &test_cases[i];
+      enum dir_glob_result result;
+      if ( !test_same( c->pattern, c->path, &result ) )
+         ok = 0;
+      else if ( result != c->expected )
+      {
+         printf( "'%s' vs '%s' is %d, expected %d\n", c->pattern, c->path, (int)result, (int)c->expected );
+         ok = 0;
+      }
+   }
+   return ok;
+}
+
+static int test_random( void )
+{
+   char pattern[256], path[16];
+   unsigned long n, matches = 0;
+   for ( n = 0; n < TEST_NUM_RANDOM; ++n )
+   {
+      enum dir_glob_result result;
+      test_random_pattern( pattern );
+      test_random_path( path );
+      if ( !test_same( pattern, path, &result ) )
+         return 0;
+      matches += result == DIR_GLOB_MATCH;
+   }
+
+   /* the random cases are not all one result */
+   if ( matches < TEST_NUM_RANDOM / 100 || matches > TEST_NUM_RANDOM / 2 )
+   {
+      printf( "random: %lu of %lu matched, the random cases do not test much\n", matches, TEST_NUM_RANDOM );
+      return 0;
+   }
+   return 1;
+}
+
+static const char* test_file_names[] =
+{
+   "main.c", "main.h", "util.c", "util.cpp", "README", "readme.md", "a1.log", "b22.log", ".hidden.c", "x", "notes.txt.bak"
+};
+
+static const char* test_file_patterns[] = { "*.c", "*.{c,h}", "*.??", "[a-b]*.log", "?", "*read*", "*.*.*", "[!m]*" };
+
+struct test_files
+{
+   char* names[TEST_MAX_FILES];
+   unsigned int count;
+};
+
+static int test_collect( const char* path, unsigned int path_len, enum dir_item_type type, void* userdata )
+{
+   struct test_files* files = (struct test_files*)userdata;
+   const char* name = strrchr( path, '/' ) ? strrchr( path, '/' ) + 1 : path;
+   (void)path_len; (void)type;
+   if ( files->count < TEST_MAX_FILES )
+   {
+      files->names[files->count] = (char*)malloc( strlen( name ) + 1 );
+      strcpy( files->names[files->count++], name );
+   }
+   return DIR_WALK_CONTINUE;
+}
+
+static int test_walk( const char* root )
+{
+   unsigned int p, i, j;
+   int ok = 1;
+
+   for ( p = 0; p < sizeof( test_file_patterns ) / sizeof( test_file_patterns[0] ); ++p )
+   {
+      const char* pattern = test_file_patterns[p];
+      struct test_files files;
+      unsigned int expected = 0;
+
+      files.count = 0;
+      if ( dir_walkex( root, DIR_WALK_ONLY_FILES, 0x0, pattern, test_collect, &files ) != DIR_ERROR_OK )
+      {
+         printf( "walk with '%s' failed\n", pattern );
+         ok = 0;
+      }
+
+      /* every file in both sub-directories that matches, and nothing else */
+      for ( i = 0; i < sizeof( test_file_names ) / sizeof( test_file_names[0] ); ++i )
+      {
+         unsigned int found = 0;
+         if ( dir_glob_match( pattern, test_file_names[i] ) != DIR_GLOB_MATCH )
+            continue;
+         expected += 2;
+         for ( j = 0; j < files.count; ++j )
+            found += strcmp( files.names[j], test_file_names[i] ) == 0;
+         if ( found != 2 )
+         {
+            printf( "walk with '%s' reported '%s' %u times, expected 2\n", pattern, test_file_names[i], found );
+            ok = 0;
+         }
+      }
+      if ( files.count != expected )
+      {
+         printf( "walk with '%s' reported %u files, expected %u\n", pattern, files.count, expected );
+         ok = 0;
+      }
+      for ( j = 0; j < files.count; ++j )
+         free( files.names[j] );
+   }
+   return ok;
+}
+
+static int test_create_tree( const char* root )
+{
+   static const char* dirs[] = { "one", "one/two" };
+   unsigned int d, i;
+   for ( d = 0; d < sizeof( dirs ) / sizeof( dirs[0] ); ++d )
+   {
+      char path[256];
+      sprintf( path, "%s/%s", root, dirs[d] );
+      if ( dir_mktree( path ) != DIR_ERROR_OK )
+         return 0;
+      for ( i = 0; i < sizeof( test_file_names ) / sizeof( test_file_names[0] ); ++i )
+      {
+         FILE* file;
+         sprintf( path, "%s/%s/%s", root, dirs[d], test_file_names[i] );
+         file = fopen( path, "wb" );
+         if ( file == 0x0 )
+            return 0;
+         fclose( file );
+      }
+   }
+   return 1;
+}
+
+int main( void )
+{
+   char root[] = "dirutil_test_glob_XXXXXX";
+   int ok = 1;
+
+   ok &= test_known();
+   ok &= test_random();
+
+   if ( mkdtemp( root ) == 0x0 || !test_create_tree( root ) )
+   {
+      printf( "failed to create the tree\n" );
+      ok = 0;
+   }
+   else
+      ok &= test_walk( root );
+
+   dir_rmtree( root );
+   printf( "%s\n", ok ? "glob: OK" : "glob: FAILED" );
+   return ok ? 0 : 1;
+}
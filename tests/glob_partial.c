@@ -0,0 +1,312 @@
+/*
+   dir_glob_match_partial, checks the result on a list of patterns and paths with known results, then on random
+   patterns and paths that a path that is not a partial match has nothing below it that matches and that a path that
+   dir_glob_match matches is a match. then walks a tree in a mkdtemp directory with directory patterns and checks that
+   the directories reported are the ones dir_glob_match matches, that the files reported are the ones in the root and
+   in those directories and that nothing is reported from the directories only walked to reach them.
+
+   build and run from the root of the repository:
+      cc -O2 -o test_glob_partial tests/glob_partial.c && ./test_glob_partial
+*/
+#define _DEFAULT_SOURCE
+#define DIRUTIL_IMPLEMENTATION
+#include "../dirutil.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_NUM_RANDOM 100000UL
+#define TEST_NUM_BELOW  8 /* paths below each random path checked against a path that is not a partial match */
+#define TEST_MAX_ITEMS  64
+
+struct test_case
+{
+   const char* pattern;
+   const char* path;
+   enum dir_glob_result expected;
+};
+
+static const struct test_case test_cases[] =
+{
+   { "src/{a,b}/core",     "src",                 DIR_GLOB_PARTIAL_MATCH },
+   { "src/{a,b}/core",     "src/a",               DIR_GLOB_PARTIAL_MATCH },
+   { "src/{a,b}/core",     "src/c",               DIR_GLOB_NO_MATCH },
+   { "src/{a,b}/core",     "src/b/core",          DIR_GLOB_MATCH },
+   { "src/{a,b}/core",     "src/b/core/more",     DIR_GLOB_NO_MATCH },
+   { "src/{a,b}/core",     "lib",                 DIR_GLOB_NO_MATCH },
+   { "src/*/main",         "src/app",             DIR_GLOB_PARTIAL_MATCH },
+   { "src/**",             "src",                 DIR_GLOB_PARTIAL_MATCH },
+   { "src/**",             "src/a/b/c",           DIR_GLOB_MATCH },
+   { "**/textures",        "any/thing",           DIR_GLOB_PARTIAL_MATCH },
+   { "**/textures",        "any/textures",        DIR_GLOB_MATCH },
+   { "a?/b",               "ax",                  DIR_GLOB_PARTIAL_MATCH },
+   { "a?/b",               "axy",                 DIR_GLOB_NO_MATCH },
+   { "[0-9]/x",            "7",                   DIR_GLOB_PARTIAL_MATCH },
+   { "[0-9]/x",            "a",                   DIR_GLOB_NO_MATCH },
+   { "build",              "build",               DIR_GLOB_MATCH },
+   { "build",              "src",                 DIR_GLOB_NO_MATCH },
+   { "{a,b",               "a",                   DIR_GLOB_INVALID_PATTERN }
+};
+
+static unsigned long test_seed = 1;
+
+/* same random sequence on every platform */
+static unsigned int test_rand( void )
+{
+   test_seed = test_seed * 1103515245UL + 12345UL;
+   return (unsigned int)( ( test_seed >> 16 ) & 0x7fff );
+}
+
+static void test_random_pattern( char* pattern )
+{
+   static const char* pieces[] = { "a", "b", "ab", ".", "/", "/", "*", "**", "?", "[ab]", "[!a]", "{a,bb}", "{a/b,b}", "**/", "/**" };
+   unsigned int n = test_rand() % 7, i;
+   pattern[0] = '\0';
+   for ( i = 0; i < n; ++i )
+      strcat( pattern, pieces[test_rand() % ( sizeof( pieces ) / sizeof( pieces[0] ) )] );
+}
+
+/* path-segments of 1 to 3 characters separated by '/' */
+static void test_random_segments( char* path, unsigned int num_segments )
+{
+   static const char chars[] = "aab.";
+   unsigned int s, i;
+   for ( s = 0; s < num_segments; ++s )
+   {
+      unsigned int len = 1 + test_rand() % 3;
+      if ( s > 0 )
+         *path++ = '/';
+      for ( i = 0; i < len; ++i )
+         *path++ = chars[test_rand() % ( sizeof( chars ) - 1 )];
+   }
+   *path = '\0';
+}
+
+static int test_known( void )
+{
+   unsigned int i;
+   int ok = 1;
+   for ( i = 0; i < sizeof( test_cases ) / sizeof( test_cases[0] ); ++i )
+   {
+      const struct test_case* c = &test_cases[i];
+      struct dir_glob* glob = dir_glob_compile( c->pattern );
+      enum dir_glob_result result = glob ? dir_glob_match_partial( glob, c->path ) : DIR_GLOB_FORCEINT;
+      dir_glob_free( glob );
+      if ( result != c->expected )
+      {
+         printf( "'%s' vs '%s' is %d, expected %d\n", c->pattern, c->path, (int)result, (int)c->expected );
+         ok = 0;
+      }
+   }
+   return ok;
+}
+
+static int test_random( void )
+{
+   char pattern[256], path[64], below[128];
+   unsigned long n, no_match = 0, partial = 0;
+   unsigned int i;
+
+   for ( n = 0; n < TEST_NUM_RANDOM; ++n )
+   {
+      struct dir_glob* glob;
+      enum dir_glob_result result, full;
+
+      test_random_pattern( pattern );
+      test_random_segments( path, 1 + test_rand() % 3 );
+      glob = dir_glob_compile( pattern );
+      if ( glob == 0x0 )
+         return 0;
+      result = dir_glob_match_partial( glob, path );
+      full = dir_glob_match( pattern, path );
+
+      if ( ( full == DIR_GLOB_MATCH ) != ( result == DIR_GLOB_MATCH ) )
+      {
+         printf( "'%s' vs '%s' is %d partially but %d by dir_glob_match\n", pattern, path, (int)result, (int)full );
+         dir_glob_free( glob );
+         return 0;
+      }
+      no_match += result == DIR_GLOB_NO_MATCH;
+      partial += result == DIR_GLOB_PARTIAL_MATCH;
+
+      /* nothing below a path that is not a partial match can match */
+      for ( i = 0; result == DIR_GLOB_NO_MATCH && i < TEST_NUM_BELOW; ++i )
+      {
+         unsigned int len = (unsigned int)sprintf( below, "%s/", path );
+         test_random_segments( below + len, 1 + test_rand() % 3 );
+         if ( dir_glob_match( pattern, below ) == DIR_GLOB_MATCH )
+         {
+            printf( "'%s' vs '%s' is not a partial match, but '%s' matches\n", pattern, path, below );
+            dir_glob_free( glob );
+            return 0;
+         }
+      }
+      dir_glob_free( glob );
+   }
+
+   /* the random cases are not all one result */
+   if ( no_match < TEST_NUM_RANDOM / 100 || partial < TEST_NUM_RANDOM / 100 )
+   {
+      printf( "random: %lu no match and %lu partial of %lu, the random cases do not test much\n", no_match, partial, TEST_NUM_RANDOM );
+      return 0;
+   }
+   return 1;
+}
+
+/* files in the tree, parent directories are created as needed */
+static const char* test_files[] =
+{
+   "top.txt",
+   "assets/a.txt",
+   "assets/one/b.txt",
+   "assets/one/textures/c.png",
+   "assets/one/textures/deep/d.png",
+   "assets/two/textures/e.png",
+   "assets/three/textures/f.png",
+   "lib/g.c",
+   "lib/textures/h.png"
+};
+
+static const char* test_dir_patterns[] =
+{
+   "assets/{one,two}/textures", "assets/*/textures/**", "**/textures", "assets", "lib/**", "*/t*", "missing/dir"
+};
+
+struct test_walk
+{
+   char* paths[TEST_MAX_ITEMS];
+   enum dir_item_type types[TEST_MAX_ITEMS];
+   unsigned int count;
+};
+
+static int test_collect( const char* path, unsigned int path_len, enum dir_item_type type, void* userdata )
+{
+   struct test_walk* walk = (struct test_walk*)userdata;
+   if ( walk->count >= TEST_MAX_ITEMS )
+      return DIR_WALK_ABORT;
+   walk->types[walk->count] = type;
+   walk->paths[walk->count] = (char*)malloc( path_len + 1 );
+   memcpy( walk->paths[walk->count++], path, path_len + 1 );
+   return DIR_WALK_CONTINUE;
+}
+
+static int test_find( const struct test_walk* walk, const char* path )
+{
+   unsigned int i, found = 0;
+   for ( i = 0; i < walk->count; ++i )
+      found += strcmp( walk->paths[i], path ) == 0;
+   return (int)found;
+}
+
+static void test_clear( struct test_walk* walk )
+{
+   unsigned int i;
+   for ( i = 0; i < walk->count; ++i )
+      free( walk->paths[i] );
+   walk->count = 0;
+}
+
+static int test_walk( const char* root )
+{
+   struct test_walk all, walk;
+   unsigned int p, i;
+   int ok = 1;
+
+   all.count = walk.count = 0;
+   if ( dir_walkex( root, DIR_WALK_ROOT_RELATIVE_PATHS, 0x0, 0x0, test_collect, &all ) != DIR_ERROR_OK )
+   {
+      printf( "walk without patterns failed\n" );
+      return 0;
+   }
+
+   for ( p = 0; p < sizeof( test_dir_patterns ) / sizeof( test_dir_patterns[0] ); ++p )
+   {
+      const char* pattern = test_dir_patterns[p];
+      unsigned int expected = 0;
+
+      if ( dir_walkex( root, DIR_WALK_ROOT_RELATIVE_PATHS, pattern, 0x0, test_collect, &walk ) != DIR_ERROR_OK )
+      {
+         printf( "walk with '%s' failed\n", pattern );
+         ok = 0;
+      }
+
+      /* directories that match, files in them or in the root, and nothing else */
+      for ( i = 0; i < all.count; ++i )
+      {
+         const char* item = all.paths[i];
+         const char* slash = strrchr( item, '/' );
+         char parent[256];
+         int reported = test_find( &walk, item ), report;
+
+         if ( all.types[i] == DIR_ITEM_DIR )
+            report = dir_glob_match( pattern, item ) == DIR_GLOB_MATCH;
+         else if ( slash == 0x0 )
+            report = 1;
+         else
+         {
+            sprintf( parent, "%.*s", (int)( slash - item ), item );
+            report = dir_glob_match( pattern, parent ) == DIR_GLOB_MATCH;
+         }
+         expected += (unsigned int)report;
+         if ( reported != report )
+         {
+            printf( "walk with '%s' reported '%s' %d times, expected %d\n", pattern, item, reported, report );
+            ok = 0;
+         }
+      }
+      if ( walk.count != expected )
+      {
+         printf( "walk with '%s' reported %u items, expected %u\n", pattern, walk.count, expected );
+         ok = 0;
+      }
+      test_clear( &walk );
+   }
+   test_clear( &all );
+   return ok;
+}
+
+static int test_create_tree( const char* root )
+{
+   unsigned int i;
+   for ( i = 0; i < sizeof( test_files ) / sizeof( test_files[0] ); ++i )
+   {
+      char path[256];
+      char* slash;
+      FILE* file;
+
+      sprintf( path, "%s/%s", root, test_files[i] );
+      slash = strrchr( path, '/' );
+      *slash = '\0';
+      if ( dir_mktree( path ) != DIR_ERROR_OK )
+         return 0;
+      *slash = '/';
+
+      file = fopen( path, "wb" );
+      if ( file == 0x0 )
+         return 0;
+      fclose( file );
+   }
+   return 1;
+}
+
+int main( void )
+{
+   char root[] = "dirutil_test_glob_partial_XXXXXX";
+   int ok = 1;
+
+   ok &= test_known();
+   ok &= test_random();
+
+   if ( mkdtemp( root ) == 0x0 || !test_create_tree( root ) )
+   {
+      printf( "failed to create the tree\n" );
+      ok = 0;
+   }
+   else
+      ok &= test_walk( root );
+
+   dir_rmtree( root );
+   printf( "%s\n", ok ? "glob_partial: OK" : "glob_partial: FAILED" );
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,326 @@
+/*
+   dir_walk_hash, hashes a tree in a mkdtemp directory with 1, 2, 4 and one worker per hardware thread and checks that
+   the hashes of all items and of the root are the same in every run, that files hash to the XXH64 of their content, also
+   files large enough to be mapped into memory, and symlinks to the XXH64 of the path they refer to. then checks that
+   identical directories hash the same whatever order they were created in, that changing the content or the name of a
+   file changes the hashes of the directories above it and nothing else, and that hashes returned by the cached callback
+   are used instead of reading the files. posix only.
+
+   build and run from the root of the repository:
+      cc -O2 -pthread -o test_hash tests/hash.c && ./test_hash
+*/
+#define _DEFAULT_SOURCE
+#define DIRUTIL_IMPLEMENTATION
+#include "../dirutil.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEST_MAX_ITEMS 64
+#define TEST_REPEAT    5 /* walks per number of workers */
+#define TEST_BIG_SIZE  ( 3 * DIRUTIL_HASH_BUFFER_SIZE + 17 ) /* mapped into memory, not a multiple of anything */
+
+/* name and content of each file in the identical directories, the big file is generated */
+static const char* test_files[] =
+{
+   "empty.txt",          "",
+   "abc.txt",            "abc",
+   "sub/spam.txt",       "Nobody inspects the spammish repetition",
+   "sub/deeper/big.bin", 0x0
+};
+
+/* XXH64, seed 0, of the contents above */
+static const dir_uint64 test_file_hashes[] =
+{
+   0xEF46DB3751D8E999ULL,
+   0x44BC2CF5AD770999ULL,
+   0xFBCEA83C8A378BF1ULL,
+   0
+};
+
+static const unsigned int test_threads[] = { 1, 2, 4, 0 };
+
+struct test_item
+{
+   char* path;
+   enum dir_item_type type;
+   dir_uint64 hash;
+   long seq; /* order the item was reported in */
+};
+
+struct test_hashes
+{
+   struct test_item items[TEST_MAX_ITEMS];
+   volatile long count;
+   dir_uint64 root;
+
+   /* for the cached callback, files named cached_name get cached_hash */
+   const char* cached_name;
+   dir_uint64 cached_hash;
+   volatile long num_cached;
+   int cached_info_ok;
+};
+
+static char* test_big;
+
+static int test_hash_callback( const char* path, unsigned int path_len, enum dir_item_type type, dir_uint64 hash,
+   const struct dir_item_info* info, unsigned int worker_index, void* userdata )
+{
+   struct test_hashes* hashes = (struct test_hashes*)userdata;
+   long seq = dir_atomic_add( &hashes->count, 1 ) - 1;
+   struct test_item* item;
+   (void)info; (void)worker_index;
+   if ( seq >= TEST_MAX_ITEMS )
+      return DIR_WALK_ABORT;
+   item = &hashes->items[seq];
+   item->path = (char*)malloc( path_len + 1 );
+   memcpy( item->path, path, path_len + 1 );
+   item->type = type;
+   item->hash = hash;
+   item->seq = seq;
+   return DIR_WALK_CONTINUE;
+}
+
+static int test_cached_callback( const char* path, unsigned int path_len, const struct dir_item_info* info, dir_uint64* hash, void* userdata )
+{
+   struct test_hashes* hashes = (struct test_hashes*)userdata;
+   size_t name_len = hashes->cached_name ? strlen( hashes->cached_name ) : 0;
+   if ( name_len == 0 || path_len < name_len || strcmp( path + path_len - name_len, hashes->cached_name ) != 0 )
+      return 0;
+   if ( !( info->valid & DIR_ITEM_INFO_SIZE ) || info->size != 3 )
+      hashes->cached_info_ok = 0;
+   dir_atomic_add( &hashes->num_cached, 1 );
+   *hash = hashes->cached_hash;
+   return 1;
+}
+
+static void test_clear( struct test_hashes* hashes )
+{
+   long i;
+   for ( i = 0; i < hashes->count && i < TEST_MAX_ITEMS; ++i )
+      free( hashes->items[i].path );
+   memset( hashes, 0, sizeof( *hashes ) );
+}
+
+static const struct test_item* test_find( const struct test_hashes* hashes, const char* path )
+{
+   long i;
+   for ( i = 0; i < hashes->count; ++i )
+      if ( strcmp( hashes->items[i].path, path ) == 0 )
+         return &hashes->items[i];
+   return 0x0;
+}
+
+static dir_uint64 test_hash_of( const struct test_hashes* hashes, const char* path )
+{
+   const struct test_item* item = test_find( hashes, path );
+   return item ? item->hash : 0;
+}
+
+static int test_hash( const char* root, unsigned int num_threads, struct test_hashes* hashes )
+{
+   long i;
+   enum dir_error err = dir_walk_hash( root, DIR_WALK_ROOT_RELATIVE_PATHS, 0x0, 0x0, num_threads, test_cached_callback, test_hash_callback, hashes, &hashes->root );
+   if ( err != DIR_ERROR_OK || hashes->count == 0 )
+   {
+      printf( "%u workers: returned %d and hashed %ld items\n", num_threads, (int)err, hashes->count );
+      return 0;
+   }
+
+   /* a directory after the items in it */
+   for ( i = 0; i < hashes->count; ++i )
+   {
+      const struct test_item* item = &hashes->items[i];
+      const char* slash = strrchr( item->path, '/' );
+      char parent[256];
+      const struct test_item* dir;
+      if ( slash == 0x0 )
+         continue;
+      sprintf( parent, "%.*s", (int)( slash - item->path ), item->path );
+      dir = test_find( hashes, parent );
+      if ( dir == 0x0 || dir->seq < item->seq )
+      {
+         printf( "%u workers: '%s' hashed before '%s'\n", num_threads, parent, item->path );
+         return 0;
+      }
+   }
+   return 1;
+}
+
+/* the same items with the same hashes */
+static int test_same( const char* what, const struct test_hashes* a, const struct test_hashes* b )
+{
+   long i;
+   int ok = a->count == b->count && a->root == b->root;
+   for ( i = 0; ok && i < a->count; ++i )
+   {
+      const struct test_item* item = test_find( b, a->items[i].path );
+      ok = item && item->type == a->items[i].type && item->hash == a->items[i].hash;
+   }
+   if ( !ok )
+      printf( "%s: %ld items hashed to root 0x%016lx, expected %ld items hashed to 0x%016lx\n", what, b->count,
+              (unsigned long)b->root, a->count, (unsigned long)a->root );
+   return ok;
+}
+
+/* items with changed hashes, or no longer there, are exactly the ones in changed, the directories above them included */
+static int test_changed( const char* what, const struct test_hashes* before, const struct test_hashes* after, const char** changed, unsigned int num_changed )
+{
+   long i;
+   unsigned int c;
+   int ok = before->root != after->root && before->count == after->count;
+   for ( i = 0; ok && i < before->count; ++i )
+   {
+      const struct test_item* item = &before->items[i];
+      int expect_change = 0;
+      for ( c = 0; c < num_changed; ++c )
+         expect_change |= strcmp( item->path, changed[c] ) == 0;
+      ok = ( test_find( after, item->path ) == 0x0 || test_hash_of( after, item->path ) != item->hash ) == expect_change;
+      if ( !ok )
+         printf( "%s: the hash of '%s' is %s\n", what, item->path, expect_change ? "not changed" : "changed" );
+   }
+   if ( before->root == after->root )
+      printf( "%s: the hash of the root is not changed\n", what );
+   return ok;
+}
+
+static int test_write_file( const char* root, const char* name, const char* content, size_t size )
+{
+   char path[256];
+   char* slash;
+   FILE* file;
+
+   sprintf( path, "%s/%s", root, name );
+   slash = strrchr( path, '/' );
+   *slash = '\0';
+   if ( dir_mktree( path ) != DIR_ERROR_OK )
+      return 0;
+   *slash = '/';
+
+   file = fopen( path, "wb" );
+   if ( file == 0x0 )
+      return 0;
+   fwrite( content, 1, size, file );
+   return fclose( file ) == 0;
+}
+
+/* the files, and a symlink to abc.txt, in dir, in reverse order if reverse is set */
+static int test_create_dir( const char* root, const char* dir, int reverse )
+{
+   unsigned int n = sizeof( test_files ) / sizeof( test_files[0] ) / 2, i;
+   char path[256], link_path[256];
+   for ( i = 0; i < n; ++i )
+   {
+      unsigned int f = reverse ? n - 1 - i : i;
+      const char* content = test_files[f * 2 + 1];
+      sprintf( path, "%s/%s", dir, test_files[f * 2] );
+      if ( !test_write_file( root, path, content ? content : test_big, content ? strlen( content ) : TEST_BIG_SIZE ) )
+         return 0;
+   }
+   sprintf( link_path, "%s/%s/link", root, dir );
+   return symlink( "abc.txt", link_path ) == 0;
+}
+
+static int test_known( const struct test_hashes* hashes )
+{
+   unsigned int i;
+   char path[256];
+   int ok = 1;
+
+   for ( i = 0; i < sizeof( test_file_hashes ) / sizeof( test_file_hashes[0] ); ++i )
+   {
+      dir_uint64 expected = test_file_hashes[i] ? test_file_hashes[i] : dir_hash64( test_big, TEST_BIG_SIZE, 0 );
+      sprintf( path, "one/%s", test_files[i * 2] );
+      if ( test_hash_of( hashes, path ) != expected )
+      {
+         printf( "'%s' hashed to 0x%016lx, expected 0x%016lx\n", path, (unsigned long)test_hash_of( hashes, path ), (unsigned long)expected );
+         ok = 0;
+      }
+   }
+   if ( test_hash_of( hashes, "one/link" ) != dir_hash64( "abc.txt", 7, 0 ) )
+   {
+      printf( "'one/link' is not hashed as the path it refers to\n" );
+      ok = 0;
+   }
+
+   /* identical, whatever order they were created in */
+   if ( test_hash_of( hashes, "one" ) == 0 || test_hash_of( hashes, "one" ) != test_hash_of( hashes, "two" ) ||
+        test_hash_of( hashes, "one" ) != test_hash_of( hashes, "reversed" ) || test_hash_of( hashes, "one/sub" ) != test_hash_of( hashes, "two/sub" ) )
+   {
+      printf( "identical directories hashed to 0x%016lx, 0x%016lx and 0x%016lx\n", (unsigned long)test_hash_of( hashes, "one" ),
+              (unsigned long)test_hash_of( hashes, "two" ), (unsigned long)test_hash_of( hashes, "reversed" ) );
+      ok = 0;
+   }
+   return ok;
+}
+
+int main( void )
+{
+   static struct test_hashes first, hashes;
+   static const char* content_changed[] = { "two/sub/spam.txt", "two/sub", "two" };
+   static const char* name_changed[] = { "two/sub/spam.txt", "two/sub", "two" };
+   char root[] = "dirutil_test_hash_XXXXXX";
+   char from[256], to[256];
+   unsigned int t, n;
+   size_t i;
+   int ok = 1;
+
+   test_big = (char*)malloc( TEST_BIG_SIZE );
+   for ( i = 0; i < TEST_BIG_SIZE; ++i )
+      test_big[i] = (char)( ( i * 2654435761u ) >> 13 );
+   if ( mkdtemp( root ) == 0x0 || !test_create_dir( root, "one", 0 ) || !test_create_dir( root, "two", 0 ) ||
+        !test_create_dir( root, "reversed", 1 ) || !test_write_file( root, "top.txt", "top", 3 ) )
+   {
+      printf( "failed to create the tree\n" );
+      dir_rmtree( root );
+      free( test_big );
+      return 1;
+   }
+
+   ok &= test_hash( root, 1, &first );
+   ok &= test_known( &first );
+   for ( t = 0; t < sizeof( test_threads ) / sizeof( test_threads[0] ); ++t )
+   {
+      for ( n = 0; n < TEST_REPEAT; ++n )
+      {
+         ok &= test_hash( root, test_threads[t], &hashes ) && test_same( "repeated", &first, &hashes );
+         test_clear( &hashes );
+      }
+   }
+
+   /* same size, other content */
+   ok &= test_write_file( root, "two/sub/spam.txt", "Nobody inspects the spammish repetitioN", 39 );
+   ok &= test_hash( root, 0, &hashes ) && test_changed( "content changed", &first, &hashes, content_changed, 3 );
+   test_clear( &hashes );
+   ok &= test_write_file( root, "two/sub/spam.txt", test_files[5], 39 );
+   ok &= test_hash( root, 0, &hashes ) && test_same( "content restored", &first, &hashes );
+   test_clear( &hashes );
+
+   sprintf( from, "%s/two/sub/spam.txt", root );
+   sprintf( to, "%s/two/sub/spam.md", root );
+   ok &= rename( from, to ) == 0;
+   ok &= test_hash( root, 0, &hashes ) && test_changed( "name changed", &first, &hashes, name_changed, 3 );
+   test_clear( &hashes );
+   ok &= rename( to, from ) == 0;
+
+   /* the cached hash is used for every abc.txt, and their size is passed to decide if it is still valid */
+   hashes.cached_name = "abc.txt";
+   hashes.cached_hash = 0x123456789ULL;
+   hashes.cached_info_ok = 1;
+   ok &= test_hash( root, 2, &hashes );
+   if ( hashes.num_cached != 3 || !hashes.cached_info_ok || test_hash_of( &hashes, "one/abc.txt" ) != 0x123456789ULL ||
+        test_hash_of( &hashes, "reversed/abc.txt" ) != 0x123456789ULL || hashes.root == first.root )
+   {
+      printf( "cached: asked for %ld files, 'one/abc.txt' hashed to 0x%016lx\n", hashes.num_cached, (unsigned long)test_hash_of( &hashes, "one/abc.txt" ) );
+      ok = 0;
+   }
+   test_clear( &hashes );
+
+   test_clear( &first );
+   free( test_big );
+   dir_rmtree( root );
+   printf( "%s\n", ok ? "hash: OK" : "hash: FAILED" );
+   return ok ? 0 : 1;
+}
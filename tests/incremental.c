@@ -0,0 +1,305 @@
+/*
+   dir_walk_incremental, saves a snapshot of a tree in a mkdtemp directory, adds, removes and modifies files and
+   directories and checks that exactly those changes are reported, with directories added before and removed after the
+   items in them, also with DIR_WALK_ONLY_FILES and DIR_WALK_ONLY_DIRECTORIES. then saves the new state over the snapshot
+   it was compared with and checks that nothing is reported against it, also after the tree is moved, that the new
+   snapshot replays as the tree is walked and that a missing path is reported.
+
+   build and run from the root of the repository:
+      cc -O2 -o test_incremental tests/incremental.c && ./test_incremental
+*/
+#define _DEFAULT_SOURCE
+#define DIRUTIL_IMPLEMENTATION
+#include "../dirutil.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_INFO      ( DIR_ITEM_INFO_SIZE | DIR_ITEM_INFO_MTIME )
+#define TEST_MAX_ITEMS 64
+
+/* name and content of each file in the tree, parent directories are created as needed */
+static const char* test_files[] =
+{
+   "a.txt",              "a",
+   "b.c",                "bb",
+   "src/main.c",         "ccc",
+   "src/lib/util.c",     "dddd",
+   "docs/readme.md",     "eeeee",
+   "docs/img/logo.png",  "ffffff"
+};
+
+struct test_change
+{
+   const char* path;
+   enum dir_item_type type;
+   enum dir_change change;
+   unsigned int size; /* stored in the snapshot for removed items, otherwise as it is now */
+};
+
+/* changes made by test_modify_tree */
+static const struct test_change test_changes[] =
+{
+   { "a.txt",             DIR_ITEM_FILE, DIR_CHANGE_REMOVED,  1 },
+   { "b.c",               DIR_ITEM_FILE, DIR_CHANGE_MODIFIED, 8 },
+   { "src/new.c",         DIR_ITEM_FILE, DIR_CHANGE_ADDED,    3 },
+   { "added",             DIR_ITEM_DIR,  DIR_CHANGE_ADDED,    0 },
+   { "added/sub",         DIR_ITEM_DIR,  DIR_CHANGE_ADDED,    0 },
+   { "added/sub/x.txt",   DIR_ITEM_FILE, DIR_CHANGE_ADDED,    1 },
+   { "docs",              DIR_ITEM_DIR,  DIR_CHANGE_REMOVED,  0 },
+   { "docs/readme.md",    DIR_ITEM_FILE, DIR_CHANGE_REMOVED,  5 },
+   { "docs/img",          DIR_ITEM_DIR,  DIR_CHANGE_REMOVED,  0 },
+   { "docs/img/logo.png", DIR_ITEM_FILE, DIR_CHANGE_REMOVED,  6 }
+};
+
+struct test_reported
+{
+   char* paths[TEST_MAX_ITEMS];
+   enum dir_item_type types[TEST_MAX_ITEMS];
+   enum dir_change changes[TEST_MAX_ITEMS];
+   struct dir_item_info infos[TEST_MAX_ITEMS];
+   unsigned int count;
+};
+
+static int test_change_callback( const char* path, unsigned int path_len, enum dir_item_type type, enum dir_change change,
+   const struct dir_item_info* info, void* userdata )
+{
+   struct test_reported* reported = (struct test_reported*)userdata;
+   if ( reported->count == TEST_MAX_ITEMS )
+      return DIR_WALK_ABORT;
+   reported->paths[reported->count] = (char*)malloc( path_len + 1 );
+   memcpy( reported->paths[reported->count], path, path_len + 1 );
+   reported->types[reported->count] = type;
+   reported->changes[reported->count] = change;
+   reported->infos[reported->count] = *info;
+   ++reported->count;
+   return DIR_WALK_CONTINUE;
+}
+
+static void test_clear( struct test_reported* reported )
+{
+   unsigned int i;
+   for ( i = 0; i < reported->count; ++i )
+      free( reported->paths[i] );
+   reported->count = 0;
+}
+
+static int test_index( const struct test_reported* reported, const char* path )
+{
+   unsigned int i;
+   for ( i = 0; i < reported->count; ++i )
+      if ( strcmp( reported->paths[i], path ) == 0 )
+         return (int)i;
+   return -1;
+}
+
+static int test_write_file( const char* root, const char* name, const char* content )
+{
+   char path[256];
+   char* slash;
+   FILE* file;
+
+   sprintf( path, "%s/%s", root, name );
+   slash = strrchr( path, '/' );
+   *slash = '\0';
+   if ( dir_mktree( path ) != DIR_ERROR_OK )
+      return 0;
+   *slash = '/';
+
+   file = fopen( path, "wb" );
+   if ( file == 0x0 )
+      return 0;
+   fputs( content, file );
+   return fclose( file ) == 0;
+}
+
+static int test_modify_tree( const char* tree )
+{
+   char path[256];
+   sprintf( path, "%s/a.txt", tree );
+   if ( remove( path ) != 0 )
+      return 0;
+   sprintf( path, "%s/docs", tree );
+   if ( dir_rmtree( path ) != DIR_ERROR_OK )
+      return 0;
+
+   return test_write_file( tree, "b.c", "modified" ) && test_write_file( tree, "src/new.c", "new" ) &&
+          test_write_file( tree, "added/sub/x.txt", "x" );
+}
+
+/* the changes of the items of type, or of all items if type is DIR_ITEM_UNHANDLED, and nothing else */
+static int test_check( const char* what, const struct test_reported* reported, enum dir_item_type type )
+{
+   unsigned int i, expected = 0;
+   int ok = 1;
+
+   for ( i = 0; i < sizeof( test_changes ) / sizeof( test_changes[0] ); ++i )
+   {
+      const struct test_change* c = &test_changes[i];
+      int index = test_index( reported, c->path ), at_index;
+      const char* slash = strrchr( c->path, '/' );
+      char parent[64];
+
+      if ( type != DIR_ITEM_UNHANDLED && c->type != type )
+         continue;
+      ++expected;
+      if ( index < 0 || reported->types[index] != c->type || reported->changes[index] != c->change ||
+           ( c->type == DIR_ITEM_FILE && ( !( reported->infos[index].valid & DIR_ITEM_INFO_SIZE ) || reported->infos[index].size != c->size ) ) )
+      {
+         printf( "%s: '%s' is not reported as change %d of type %d with size %u\n", what, c->path, (int)c->change, (int)c->type, c->size );
+         ok = 0;
+         continue;
+      }
+
+      /* added directories before the items in them, removed after */
+      if ( slash == 0x0 )
+         continue;
+      sprintf( parent, "%.*s", (int)( slash - c->path ), c->path );
+      at_index = test_index( reported, parent );
+      if ( at_index >= 0 && ( c->change == DIR_CHANGE_ADDED ? at_index > index : at_index < index ) && reported->changes[at_index] == c->change )
+      {
+         printf( "%s: '%s' is reported in the wrong order with '%s'\n", what, c->path, parent );
+         ok = 0;
+      }
+   }
+   if ( reported->count != expected )
+   {
+      printf( "%s: %u changes reported, expected %u\n", what, reported->count, expected );
+      for ( i = 0; i < reported->count; ++i )
+         printf( "   %d %s\n", (int)reported->changes[i], reported->paths[i] );
+      ok = 0;
+   }
+   return ok;
+}
+
+static int test_incremental( const char* tree, const struct dir_snapshot* snapshot, unsigned int flags, const char* snapshot_file,
+   const char* what, enum dir_item_type type, int expect_changes )
+{
+   struct test_reported reported;
+   enum dir_error err;
+   int ok;
+
+   reported.count = 0;
+   err = dir_walk_incremental( tree, snapshot, flags | DIR_WALK_ROOT_RELATIVE_PATHS, test_change_callback, &reported, snapshot_file );
+   if ( expect_changes )
+      ok = err == DIR_ERROR_OK && test_check( what, &reported, type );
+   else
+   {
+      ok = err == DIR_ERROR_OK && reported.count == 0;
+      if ( !ok )
+         printf( "%s: returned %d, %u changes reported, expected none\n", what, (int)err, reported.count );
+   }
+   test_clear( &reported );
+   return ok;
+}
+
+struct test_items
+{
+   char* paths[TEST_MAX_ITEMS];
+   unsigned int count;
+};
+
+static int test_walk_callback( const char* path, unsigned int path_len, enum dir_item_type type, const struct dir_item_info* info, void* userdata )
+{
+   struct test_items* items = (struct test_items*)userdata;
+   (void)type; (void)info;
+   if ( items->count == TEST_MAX_ITEMS )
+      return DIR_WALK_ABORT;
+   items->paths[items->count] = (char*)malloc( path_len + 1 );
+   memcpy( items->paths[items->count++], path, path_len + 1 );
+   return DIR_WALK_CONTINUE;
+}
+
+/* the snapshot replays as the tree is walked */
+static int test_replay( const char* tree, const struct dir_snapshot* snapshot )
+{
+   struct test_items live, replayed;
+   unsigned int i;
+   int ok;
+
+   live.count = replayed.count = 0;
+   ok = dir_walkex_info( tree, DIR_WALK_ROOT_RELATIVE_PATHS, 0, 0x0, 0x0, test_walk_callback, &live ) == DIR_ERROR_OK &&
+        dir_snapshot_walkex( snapshot, DIR_WALK_ROOT_RELATIVE_PATHS, 0, 0x0, 0x0, test_walk_callback, &replayed ) == DIR_ERROR_OK &&
+        live.count == replayed.count && live.count > 0;
+   for ( i = 0; ok && i < live.count; ++i )
+      ok = strcmp( live.paths[i], replayed.paths[i] ) == 0;
+   if ( !ok )
+      printf( "the saved snapshot replays %u items, the tree has %u\n", replayed.count, live.count );
+   for ( i = 0; i < live.count; ++i )
+      free( live.paths[i] );
+   for ( i = 0; i < replayed.count; ++i )
+      free( replayed.paths[i] );
+   return ok;
+}
+
+int main( void )
+{
+   char root[] = "dirutil_test_incremental_XXXXXX";
+   char tree[64], moved[64], file[64], missing[64];
+   struct dir_snapshot* snapshot = 0x0;
+   struct test_reported reported;
+   unsigned int i;
+   int ok = 1;
+
+   if ( mkdtemp( root ) == 0x0 )
+   {
+      printf( "failed to create a temporary directory\n" );
+      return 1;
+   }
+   sprintf( tree, "%s/tree", root );
+   sprintf( moved, "%s/moved", root );
+   sprintf( file, "%s/tree.snap", root );
+   for ( i = 0; ok && i < sizeof( test_files ) / sizeof( test_files[0] ); i += 2 )
+      ok = test_write_file( tree, test_files[i], test_files[i + 1] );
+   if ( !ok || dir_snapshot_save( tree, TEST_INFO, file ) != DIR_ERROR_OK || dir_snapshot_open( file, &snapshot ) != DIR_ERROR_OK )
+   {
+      printf( "failed to create the tree and save '%s'\n", file );
+      dir_rmtree( root );
+      return 1;
+   }
+
+   ok &= test_incremental( tree, snapshot, 0, 0x0, "unchanged", DIR_ITEM_UNHANDLED, 0 );
+   if ( !test_modify_tree( tree ) )
+   {
+      printf( "failed to modify the tree\n" );
+      ok = 0;
+   }
+   ok &= test_incremental( tree, snapshot, DIR_WALK_ONLY_FILES, 0x0, "only files", DIR_ITEM_FILE, 1 );
+   ok &= test_incremental( tree, snapshot, DIR_WALK_ONLY_DIRECTORIES, 0x0, "only directories", DIR_ITEM_DIR, 1 );
+
+   /* saved over the snapshot that is still open and compared with */
+   ok &= test_incremental( tree, snapshot, 0, file, "modified", DIR_ITEM_UNHANDLED, 1 );
+   dir_snapshot_close( snapshot );
+   snapshot = 0x0;
+   if ( dir_snapshot_open( file, &snapshot ) != DIR_ERROR_OK )
+   {
+      printf( "failed to open the saved '%s'\n", file );
+      dir_rmtree( root );
+      return 1;
+   }
+   ok &= test_incremental( tree, snapshot, 0, 0x0, "saved", DIR_ITEM_UNHANDLED, 0 );
+   ok &= test_replay( tree, snapshot );
+
+   /* directories are compared by their position in the tree */
+   if ( rename( tree, moved ) != 0 )
+   {
+      printf( "failed to move '%s'\n", tree );
+      ok = 0;
+   }
+   ok &= test_incremental( moved, snapshot, 0, 0x0, "moved", DIR_ITEM_UNHANDLED, 0 );
+
+   reported.count = 0;
+   sprintf( missing, "%s/missing", root );
+   if ( dir_walk_incremental( missing, snapshot, 0, test_change_callback, &reported, 0x0 ) != DIR_ERROR_PATH_DO_NOT_EXIST || reported.count != 0 )
+   {
+      printf( "missing path: not DIR_ERROR_PATH_DO_NOT_EXIST\n" );
+      ok = 0;
+   }
+   test_clear( &reported );
+
+   dir_snapshot_close( snapshot );
+   dir_rmtree( root );
+   printf( "%s\n", ok ? "incremental: OK" : "incremental: FAILED" );
+   return ok ? 0 : 1;
+}
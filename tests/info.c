@@ -0,0 +1,203 @@
+/*
+   dir_walkex_info, walks a tree in a mkdtemp directory with files of different sizes, permission bits and modification
+   times, directories and symlinks, also dangling, asking for each of enum dir_item_info_fields on its own, some of them
+   together and all of them. checks that exactly the requested fields are valid and that they are the same as 'lstat'
+   returns for the item, and the sizes, times and permission bits the tree was created with. posix only.
+
+   build and run from the root of the repository, the second line checks the statx build:
+      cc -O2 -o test_info tests/info.c && ./test_info
+      cc -O2 -DDIRUTIL_USE_STATX -o test_info tests/info.c && ./test_info
+*/
+#define _DEFAULT_SOURCE
+#define DIRUTIL_IMPLEMENTATION
+#include "../dirutil.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* name, size, permission bits and modification time of each file in the tree, parent directories are created as needed */
+struct test_file
+{
+   const char* name;
+   unsigned int size;
+   unsigned int mode;
+   long mtime;
+};
+
+static const struct test_file test_files[] =
+{
+   { "empty.txt",         0,      0644, 1000000000L },
+   { "one.txt",           1,      0600, 1234567890L },
+   { "run.sh",            100,    0755, 1500000000L },
+   { "sub/big.bin",       300000, 0444, 2000000000L },
+   { "sub/deeper/x.c",    17,     0640, 86400L },
+   { "sub/.hidden",       3,      0604, 1700000000L }
+};
+
+/* name and target of each symlink in the tree */
+static const char* test_links[] =
+{
+   "link_to_file",     "one.txt",
+   "sub/link_to_dir",  "deeper",
+   "dangling",         "does_not_exist"
+};
+
+/* files, symlinks and the directories 'sub' and 'sub/deeper' */
+#define TEST_NUM_ITEMS 11
+
+static const unsigned int test_masks[] =
+{
+   0,
+   DIR_ITEM_INFO_SIZE,
+   DIR_ITEM_INFO_MTIME,
+   DIR_ITEM_INFO_INODE,
+   DIR_ITEM_INFO_MODE,
+   DIR_ITEM_INFO_SYMLINK,
+   DIR_ITEM_INFO_SIZE | DIR_ITEM_INFO_MTIME,
+   DIR_ITEM_INFO_MODE | DIR_ITEM_INFO_SYMLINK,
+   DIR_ITEM_INFO_ALL
+};
+
+struct test_walk
+{
+   const char* root;
+   unsigned int mask;
+   unsigned int num_items;
+   int ok;
+};
+
+static const struct test_file* test_find_file( const char* root, const char* path )
+{
+   unsigned int i;
+   size_t root_len = strlen( root );
+   for ( i = 0; i < sizeof( test_files ) / sizeof( test_files[0] ); ++i )
+      if ( strcmp( path + root_len + 1, test_files[i].name ) == 0 )
+         return &test_files[i];
+   return 0x0;
+}
+
+static int test_check( const char* path, enum dir_item_type type, const struct dir_item_info* info, struct test_walk* walk )
+{
+   const struct test_file* file = test_find_file( walk->root, path );
+   unsigned int mask = walk->mask;
+   struct stat s;
+   int ok = 1;
+
+   if ( lstat( path, &s ) != 0 )
+   {
+      printf( "mask 0x%x: '%s' reported but can not be stat:ed\n", mask, path );
+      walk->ok = 0;
+      return DIR_WALK_CONTINUE;
+   }
+
+   ok &= ( type == DIR_ITEM_DIR ) == ( S_ISDIR( s.st_mode ) != 0 );
+   ok &= info->valid == mask;
+   if ( mask & DIR_ITEM_INFO_SIZE )
+      ok &= info->size == (dir_uint64)s.st_size && ( file == 0x0 || info->size == file->size );
+   if ( mask & DIR_ITEM_INFO_MTIME )
+      ok &= info->mtime == (dir_int64)DIR_STAT_MTIME( s ).tv_sec && info->mtime_nsec == (unsigned int)DIR_STAT_MTIME( s ).tv_nsec &&
+            ( file == 0x0 || ( info->mtime == file->mtime && info->mtime_nsec == 123456789 ) );
+   if ( mask & DIR_ITEM_INFO_INODE )
+      ok &= info->inode == (dir_uint64)s.st_ino && info->device == (dir_uint64)s.st_dev;
+   if ( mask & DIR_ITEM_INFO_MODE )
+      ok &= info->mode == (unsigned int)s.st_mode && ( file == 0x0 || info->mode == ( S_IFREG | file->mode ) );
+   if ( mask & DIR_ITEM_INFO_SYMLINK )
+      ok &= info->is_symlink == ( S_ISLNK( s.st_mode ) != 0 );
+
+   if ( !ok )
+   {
+      printf( "mask 0x%x: '%s' type %d, valid 0x%x, size %lu, mtime %ld.%09u, inode %lu, device %lu, mode 0%o, symlink %d\n",
+              mask, path, (int)type, info->valid, (unsigned long)info->size, (long)info->mtime, info->mtime_nsec,
+              (unsigned long)info->inode, (unsigned long)info->device, info->mode, info->is_symlink );
+      printf( "   expected size %lu, mtime %ld.%09ld, inode %lu, device %lu, mode 0%o\n", (unsigned long)s.st_size,
+              (long)DIR_STAT_MTIME( s ).tv_sec, (long)DIR_STAT_MTIME( s ).tv_nsec, (unsigned long)s.st_ino,
+              (unsigned long)s.st_dev, (unsigned int)s.st_mode );
+      walk->ok = 0;
+   }
+   ++walk->num_items;
+   return DIR_WALK_CONTINUE;
+}
+
+static int test_callback( const char* path, unsigned int path_len, enum dir_item_type type, const struct dir_item_info* info, void* userdata )
+{
+   (void)path_len;
+   return test_check( path, type, info, (struct test_walk*)userdata );
+}
+
+static int test_create_tree( const char* root )
+{
+   unsigned int i, j;
+   for ( i = 0; i < sizeof( test_files ) / sizeof( test_files[0] ); ++i )
+   {
+      const struct test_file* f = &test_files[i];
+      struct timespec times[2];
+      char path[256];
+      char* slash;
+      FILE* file;
+
+      sprintf( path, "%s/%s", root, f->name );
+      slash = strrchr( path, '/' );
+      *slash = '\0';
+      if ( dir_mktree( path ) != DIR_ERROR_OK )
+         return 0;
+      *slash = '/';
+
+      file = fopen( path, "wb" );
+      if ( file == 0x0 )
+         return 0;
+      for ( j = 0; j < f->size; ++j )
+         fputc( 'a' + (int)( j % 26 ), file );
+      fclose( file );
+
+      times[0].tv_sec = times[1].tv_sec = f->mtime;
+      times[0].tv_nsec = times[1].tv_nsec = 123456789;
+      if ( chmod( path, f->mode ) != 0 || utimensat( AT_FDCWD, path, times, 0 ) != 0 )
+         return 0;
+   }
+   for ( i = 0; i < sizeof( test_links ) / sizeof( test_links[0] ); i += 2 )
+   {
+      char path[256];
+      sprintf( path, "%s/%s", root, test_links[i] );
+      if ( symlink( test_links[i + 1], path ) != 0 )
+         return 0;
+   }
+   return 1;
+}
+
+int main( void )
+{
+   char root[] = "dirutil_test_info_XXXXXX";
+   unsigned int m;
+   int ok = 1;
+
+   if ( mkdtemp( root ) == 0x0 || !test_create_tree( root ) )
+   {
+      printf( "failed to create the tree\n" );
+      dir_rmtree( root );
+      return 1;
+   }
+
+   for ( m = 0; m < sizeof( test_masks ) / sizeof( test_masks[0] ); ++m )
+   {
+      struct test_walk walk;
+      enum dir_error err;
+      walk.root = root;
+      walk.mask = test_masks[m];
+      walk.num_items = 0;
+      walk.ok = 1;
+      err = dir_walkex_info( root, 0, test_masks[m], 0x0, 0x0, test_callback, &walk );
+      if ( err != DIR_ERROR_OK || walk.num_items != TEST_NUM_ITEMS )
+      {
+         printf( "mask 0x%x: returned %d and reported %u items, expected %d\n", test_masks[m], (int)err, walk.num_items, TEST_NUM_ITEMS );
+         walk.ok = 0;
+      }
+      ok &= walk.ok;
+   }
+
+   dir_rmtree( root );
+   printf( "%s\n", ok ? "info: OK" : "info: FAILED" );
+   return ok ? 0 : 1;
+}
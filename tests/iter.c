@@ -0,0 +1,304 @@
+/*
+   dir_iter, iterates over a tree in a mkdtemp directory, with a chain of directories deep and long enough to grow the
+   path buffer and the stack of open directories, with different flags, info fields and glob patterns and checks that
+   the items, and their order, are the same as dir_walkex_info reports. then checks that dir_iter_skip_subtree skips the
+   same items as returning DIR_WALK_SKIP_SUBTREE from a callback does, that the iterator can be closed at any item and
+   that opening a missing path or a file returns the same error as dir_walkex_info.
+
+   build and run from the root of the repository:
+      cc -O2 -o test_iter tests/iter.c && ./test_iter
+*/
+#define _DEFAULT_SOURCE
+#define DIRUTIL_IMPLEMENTATION
+#include "../dirutil.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_MAX_ITEMS 512
+#define TEST_DEEP      40 /* directories in the deep chain */
+
+struct test_walk
+{
+   unsigned int flags;
+   unsigned int info_fields;
+   const char* glob_directories;
+   const char* glob_files;
+};
+
+static const struct test_walk test_walks[] =
+{
+   { 0,                                                           0,                                         0x0,       0x0 },
+   { DIR_WALK_DEPTH_FIRST,                                        DIR_ITEM_INFO_SIZE,                        0x0,       0x0 },
+   { DIR_WALK_ONLY_FILES | DIR_WALK_ROOT_RELATIVE_PATHS,          DIR_ITEM_INFO_ALL,                         0x0,       0x0 },
+   { DIR_WALK_ONLY_DIRECTORIES | DIR_WALK_DEPTH_FIRST,            DIR_ITEM_INFO_MODE,                        0x0,       0x0 },
+   { DIR_WALK_IGNORE_DOT_FILES | DIR_WALK_IGNORE_DOT_DIRECTORIES, 0,                                         0x0,       0x0 },
+   { DIR_WALK_SINGLE_DIRECTORY,                                   DIR_ITEM_INFO_SYMLINK,                     0x0,       0x0 },
+   { DIR_WALK_MAX_DEPTH( 2 ),                                     DIR_ITEM_INFO_SIZE | DIR_ITEM_INFO_MTIME,  0x0,       0x0 },
+   { DIR_WALK_SORTED,                                             0,                                         0x0,       0x0 },
+   { DIR_WALK_SORTED | DIR_WALK_DEPTH_FIRST,                      DIR_ITEM_INFO_SIZE,                        0x0,       0x0 },
+   { DIR_WALK_ROOT_RELATIVE_PATHS,                                0,                                         "d1/**",   "*.c" },
+   { 0,                                                           DIR_ITEM_INFO_INODE,                       "**/d0",   "{a,b}.*" }
+};
+
+struct test_item
+{
+   char* path;
+   enum dir_item_type type;
+   struct dir_item_info info;
+};
+
+struct test_result
+{
+   struct test_item items[TEST_MAX_ITEMS];
+   unsigned int num_items;
+   const char* skip; /* return DIR_WALK_SKIP_SUBTREE for items ending with this name */
+};
+
+static int test_skip_item( const char* skip, const char* path )
+{
+   size_t len = strlen( path ), skip_len = skip ? strlen( skip ) : 0;
+   return skip && len >= skip_len && strcmp( path + len - skip_len, skip ) == 0;
+}
+
+static void test_add( struct test_result* result, const char* path, unsigned int path_len, enum dir_item_type type, const struct dir_item_info* info )
+{
+   struct test_item* item;
+   if ( result->num_items >= TEST_MAX_ITEMS )
+      return;
+   item = &result->items[result->num_items++];
+   item->path = (char*)malloc( path_len + 1 );
+   memcpy( item->path, path, path_len + 1 );
+   item->type = type;
+   item->info = *info;
+}
+
+static int test_callback( const char* path, unsigned int path_len, enum dir_item_type type, const struct dir_item_info* info, void* userdata )
+{
+   struct test_result* result = (struct test_result*)userdata;
+   test_add( result, path, path_len, type, info );
+   return test_skip_item( result->skip, path ) ? DIR_WALK_SKIP_SUBTREE : DIR_WALK_CONTINUE;
+}
+
+static void test_clear( struct test_result* result )
+{
+   unsigned int i;
+   for ( i = 0; i < result->num_items; ++i )
+      free( result->items[i].path );
+   result->num_items = 0;
+}
+
+/* the fields of info that are valid */
+static int test_same_info( const struct dir_item_info* a, const struct dir_item_info* b )
+{
+   if ( a->valid != b->valid )
+      return 0;
+   if ( ( a->valid & DIR_ITEM_INFO_SIZE ) && a->size != b->size )
+      return 0;
+   if ( ( a->valid & DIR_ITEM_INFO_MTIME ) && ( a->mtime != b->mtime || a->mtime_nsec != b->mtime_nsec ) )
+      return 0;
+   if ( ( a->valid & DIR_ITEM_INFO_INODE ) && ( a->inode != b->inode || a->device != b->device ) )
+      return 0;
+   if ( ( a->valid & DIR_ITEM_INFO_MODE ) && a->mode != b->mode )
+      return 0;
+   return !( a->valid & DIR_ITEM_INFO_SYMLINK ) || a->is_symlink == b->is_symlink;
+}
+
+static int test_compare( const struct test_walk* walk, const char* what, const struct test_result* expected, const struct test_result* result )
+{
+   unsigned int i;
+   int ok = expected->num_items == result->num_items && expected->num_items > 0;
+   for ( i = 0; ok && i < expected->num_items; ++i )
+      ok = strcmp( expected->items[i].path, result->items[i].path ) == 0 && expected->items[i].type == result->items[i].type &&
+           test_same_info( &expected->items[i].info, &result->items[i].info );
+   if ( !ok )
+   {
+      printf( "flags 0x%x, info 0x%x, globs '%s' '%s': %s returned %u items, dir_walkex_info %u\n", walk->flags, walk->info_fields,
+              walk->glob_directories ? walk->glob_directories : "", walk->glob_files ? walk->glob_files : "", what,
+              result->num_items, expected->num_items );
+      for ( i = 0; i < expected->num_items || i < result->num_items; ++i )
+         printf( "   %-60s %s\n", i < expected->num_items ? expected->items[i].path : "", i < result->num_items ? result->items[i].path : "" );
+   }
+   return ok;
+}
+
+static enum dir_error test_iterate( const char* root, const struct test_walk* walk, struct test_result* result )
+{
+   struct dir_iter* iter;
+   struct dir_iter_item item;
+   enum dir_error err = dir_iter_open( root, walk->flags, walk->info_fields, walk->glob_directories, walk->glob_files, &iter );
+   if ( err != DIR_ERROR_OK )
+      return err;
+   while ( dir_iter_next( iter, &item ) )
+   {
+      if ( item.path_len != strlen( item.path ) )
+         return DIR_ERROR_FAILED;
+      test_add( result, item.path, item.path_len, item.type, &item.info );
+      if ( test_skip_item( result->skip, item.path ) )
+         dir_iter_skip_subtree( iter );
+   }
+   return dir_iter_close( iter );
+}
+
+static int test_walk( const char* root, const struct test_walk* walk, const char* skip, struct test_result* expected, struct test_result* result )
+{
+   enum dir_error err;
+   int ok;
+
+   expected->skip = result->skip = skip;
+   err = dir_walkex_info( root, walk->flags, walk->info_fields, walk->glob_directories, walk->glob_files, test_callback, expected );
+   if ( err != DIR_ERROR_OK )
+   {
+      printf( "flags 0x%x: dir_walkex_info returned %d\n", walk->flags, (int)err );
+      test_clear( expected );
+      return 0;
+   }
+   err = test_iterate( root, walk, result );
+   ok = err == DIR_ERROR_OK;
+   if ( !ok )
+      printf( "flags 0x%x: iterating returned %d\n", walk->flags, (int)err );
+   ok &= test_compare( walk, skip ? "skipping with dir_iter" : "dir_iter", expected, result );
+   test_clear( expected );
+   test_clear( result );
+   return ok;
+}
+
+/* close after every number of items, the sanitizer build checks that nothing is leaked */
+static int test_close_early( const char* root )
+{
+   struct dir_iter* iter;
+   struct dir_iter_item item;
+   unsigned int total = 0, n, i;
+   int ok = 1;
+
+   if ( dir_iter_open( root, DIR_WALK_SORTED, DIR_ITEM_INFO_ALL, 0x0, 0x0, &iter ) != DIR_ERROR_OK )
+      return 0;
+   while ( dir_iter_next( iter, &item ) )
+      ++total;
+   ok &= dir_iter_close( iter ) == DIR_ERROR_OK && total > 0;
+
+   /* the walk stays done */
+   if ( dir_iter_open( root, 0, 0, 0x0, 0x0, &iter ) != DIR_ERROR_OK )
+      return 0;
+   while ( dir_iter_next( iter, &item ) )
+      ;
+   ok &= dir_iter_next( iter, &item ) == 0;
+   ok &= dir_iter_close( iter ) == DIR_ERROR_OK;
+
+   for ( n = 0; ok && n <= total; n += 7 )
+   {
+      if ( dir_iter_open( root, DIR_WALK_SORTED, DIR_ITEM_INFO_ALL, 0x0, 0x0, &iter ) != DIR_ERROR_OK )
+         return 0;
+      for ( i = 0; i < n; ++i )
+         ok &= dir_iter_next( iter, &item );
+      ok &= dir_iter_close( iter ) == DIR_ERROR_OK;
+   }
+   if ( !ok )
+      printf( "closing early failed\n" );
+   return ok;
+}
+
+static int test_errors( const char* root )
+{
+   struct test_result result;
+   char paths[2][256];
+   FILE* file;
+   int ok = 1, i;
+
+   result.num_items = 0;
+   result.skip = 0x0;
+   sprintf( paths[0], "%s/missing", root );
+   sprintf( paths[1], "%s/file", root );
+   file = fopen( paths[1], "wb" );
+   if ( file == 0x0 )
+      return 0;
+   fclose( file );
+
+   for ( i = 0; i < 2; ++i )
+   {
+      struct dir_iter* iter = 0x0;
+      enum dir_error expected = dir_walkex_info( paths[i], 0, 0, 0x0, 0x0, test_callback, &result );
+      enum dir_error err = dir_iter_open( paths[i], 0, 0, 0x0, 0x0, &iter );
+      if ( err != expected || err == DIR_ERROR_OK )
+      {
+         printf( "'%s': dir_iter_open returned %d, dir_walkex_info %d\n", paths[i], (int)err, (int)expected );
+         ok = 0;
+      }
+      if ( err == DIR_ERROR_OK )
+         dir_iter_close( iter );
+   }
+   test_clear( &result );
+   remove( paths[1] );
+   return ok;
+}
+
+/* directories d0, d1 and .d2 and files a.c, b.txt and .c.c in each directory, 'depth' levels below path */
+static int test_create_tree( char* path, unsigned int path_len, unsigned int depth )
+{
+   static const char* files[] = { "a.c", "b.txt", ".c.c" };
+   static const char* dirs[] = { "d0", "d1", ".d2" };
+   unsigned int i;
+
+   if ( dir_create( path ) != DIR_ERROR_OK )
+      return 0;
+   for ( i = 0; i < 3; ++i )
+   {
+      FILE* file;
+      sprintf( path + path_len, "/%s", files[i] );
+      file = fopen( path, "wb" );
+      if ( file == 0x0 )
+         return 0;
+      fputs( files[i], file );
+      fclose( file );
+   }
+   for ( i = 0; depth && i < 3; ++i )
+   {
+      unsigned int len = path_len + (unsigned int)sprintf( path + path_len, "/%s", dirs[i] );
+      if ( !test_create_tree( path, len, depth - 1 ) )
+         return 0;
+   }
+   path[path_len] = '\0';
+   return 1;
+}
+
+int main( void )
+{
+   static struct test_result expected, result;
+   static const struct test_walk all = { 0, 0, 0x0, 0x0 };
+   char root[] = "dirutil_test_iter_XXXXXX";
+   char path[4096];
+   size_t len;
+   unsigned int i;
+   int ok = 1;
+
+   if ( mkdtemp( root ) == 0x0 )
+   {
+      printf( "failed to create a temporary directory\n" );
+      return 1;
+   }
+   sprintf( path, "%s/tree", root );
+   ok = test_create_tree( path, (unsigned int)strlen( path ), 2 );
+   len = (size_t)sprintf( path, "%s/tree/d0/deep", root );
+   for ( i = 0; i < TEST_DEEP; ++i )
+      len += (size_t)sprintf( path + len, "/%u_a_rather_long_directory_name", i );
+   if ( !ok || dir_mktree( path ) != DIR_ERROR_OK )
+   {
+      printf( "failed to create the tree\n" );
+      dir_rmtree( root );
+      return 1;
+   }
+
+   sprintf( path, "%s/tree", root );
+   for ( i = 0; i < sizeof( test_walks ) / sizeof( test_walks[0] ); ++i )
+      ok &= test_walk( path, &test_walks[i], 0x0, &expected, &result );
+   ok &= test_walk( path, &all, "d1", &expected, &result );
+   ok &= test_walk( path, &all, "b.txt", &expected, &result );
+   ok &= test_walk( path, &test_walks[1], "d1", &expected, &result );
+   ok &= test_close_early( path );
+   ok &= test_errors( root );
+
+   dir_rmtree( root );
+   printf( "%s\n", ok ? "iter: OK" : "iter: FAILED" );
+   return ok ? 0 : 1;
+}
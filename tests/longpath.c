@@ -0,0 +1,122 @@
+/*
+   paths longer than PATH_MAX, creates a tree about 8000 chars deep with dir_mktree and a file at the bottom of it,
+   walks it and checks that every directory and the file are reported with their full path, then removes it with
+   dir_rmtree and dir_rmtree_parallel. POSIX only, as the file system calls take paths of at most 4096 chars.
+
+   build and run from the root of the repository:
+      cc -O2 -o test_longpath tests/longpath.c && ./test_longpath
+*/
+#define _DEFAULT_SOURCE
+#define DIRUTIL_IMPLEMENTATION
+#include "../dirutil.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEST_ROOT      "dirutil_test_longpath"
+#define TEST_DEPTH     40
+#define TEST_NAME_LEN  200
+#define TEST_FILE_NAME "file.txt"
+
+struct test_result
+{
+   unsigned int num_dirs;
+   unsigned int num_files;
+   unsigned int max_path_len;
+};
+
+static char test_name[TEST_NAME_LEN + 1];
+static char test_path[sizeof( TEST_ROOT ) + TEST_DEPTH * ( TEST_NAME_LEN + 1 )];
+
+static int test_walk_callback( const char* path, unsigned int path_len, enum dir_item_type type, void* userdata )
+{
+   struct test_result* result = (struct test_result*)userdata;
+   if ( type == DIR_ITEM_DIR )
+      ++result->num_dirs;
+   else
+      ++result->num_files;
+   if ( path_len > result->max_path_len && strlen( path ) == path_len )
+      result->max_path_len = path_len;
+   return DIR_WALK_CONTINUE;
+}
+
+/* the file is created from inside the deepest directory, its full path is too long for fopen */
+static int test_create_file( void )
+{
+   unsigned int i;
+   int ok = 1;
+   FILE* file;
+
+   if ( chdir( test_path ) == 0 )
+      return 0; /* the path should be too long */
+   if ( chdir( TEST_ROOT ) != 0 )
+      return 0;
+   for ( i = 0; i < TEST_DEPTH && ok; ++i )
+      ok = chdir( test_name ) == 0;
+
+   file = ok ? fopen( TEST_FILE_NAME, "wb" ) : 0x0;
+   if ( file )
+      fclose( file );
+
+   while ( i-- )
+      ok &= chdir( ".." ) == 0;
+   ok &= chdir( ".." ) == 0;
+   return ok && file != 0x0;
+}
+
+static int test_tree( const char* name, int parallel )
+{
+   struct test_result result;
+   unsigned int path_len = (unsigned int)strlen( test_path );
+   enum dir_error err;
+
+   if ( dir_mktree( test_path ) != DIR_ERROR_OK || dir_mktree( test_path ) != DIR_ERROR_OK || !test_create_file() )
+   {
+      printf( "%s: failed to create a tree %u chars deep\n", name, path_len );
+      return 0;
+   }
+
+   memset( &result, 0, sizeof( result ) );
+   err = dir_walkex( TEST_ROOT, DIR_WALK_PATHS_SLASH_FORWARD, 0x0, 0x0, test_walk_callback, &result );
+   if ( err != DIR_ERROR_OK || result.num_dirs != TEST_DEPTH || result.num_files != 1 || result.max_path_len != path_len + 1 + strlen( TEST_FILE_NAME ) )
+   {
+      printf( "%s: walk reported %u directories and %u files, longest path %u chars\n", name, result.num_dirs, result.num_files, result.max_path_len );
+      return 0;
+   }
+
+#if !defined( DIRUTIL_NO_THREADS )
+   if ( parallel )
+      err = dir_rmtree_parallel( TEST_ROOT, 2, 0x0, 0 );
+   else
+#endif
+      err = dir_rmtree( TEST_ROOT );
+   if ( err != DIR_ERROR_OK || dir_walkex( TEST_ROOT, 0, 0x0, 0x0, test_walk_callback, &result ) != DIR_ERROR_PATH_DO_NOT_EXIST )
+   {
+      printf( "%s: failed to remove the tree\n", name );
+      return 0;
+   }
+   return 1;
+}
+
+int main( void )
+{
+   unsigned int i;
+   char* p = test_path;
+   int ok = 1;
+
+   memset( test_name, 'd', TEST_NAME_LEN );
+   p += sprintf( p, "%s", TEST_ROOT );
+   for ( i = 0; i < TEST_DEPTH; ++i )
+      p += sprintf( p, "/%s", test_name );
+
+   dir_rmtree( TEST_ROOT );
+   ok &= test_tree( "dir_rmtree", 0 );
+#if !defined( DIRUTIL_NO_THREADS )
+   ok &= test_tree( "dir_rmtree_parallel", 1 );
+#endif
+
+   printf( "%s\n", ok ? "longpath: OK" : "longpath: FAILED" );
+   return ok ? 0 : 1;
+}
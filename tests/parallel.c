@@ -0,0 +1,247 @@
+/*
+   dir_walk_parallel, walks a tree in a mkdtemp directory with 1, 2, 4 and one worker per hardware thread and checks
+   that the same items are reported as by dir_walkex with the same flags and glob patterns. also checks the order
+   between a directory and the items in it, directory first and with DIR_WALK_DEPTH_FIRST directory last, that
+   DIR_WALK_ABORT stops the walk with DIR_ERROR_ABORTED and that a missing path is reported.
+
+   build and run from the root of the repository:
+      cc -O2 -pthread -o test_parallel tests/parallel.c && ./test_parallel
+*/
+#define _DEFAULT_SOURCE
+#define DIRUTIL_IMPLEMENTATION
+#include "../dirutil.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_MAX_ITEMS 512
+#define TEST_REPEAT    10 /* walks per flags and number of workers, to run into different schedules */
+
+struct test_walk
+{
+   unsigned int flags;
+   const char* glob_directories;
+   const char* glob_files;
+};
+
+static const struct test_walk test_walks[] =
+{
+   { 0,                                                           0x0,       0x0 },
+   { DIR_WALK_DEPTH_FIRST,                                        0x0,       0x0 },
+   { DIR_WALK_ONLY_FILES | DIR_WALK_ROOT_RELATIVE_PATHS,          0x0,       0x0 },
+   { DIR_WALK_ONLY_DIRECTORIES | DIR_WALK_DEPTH_FIRST,            0x0,       0x0 },
+   { DIR_WALK_IGNORE_DOT_FILES | DIR_WALK_IGNORE_DOT_DIRECTORIES, 0x0,       0x0 },
+   { DIR_WALK_SINGLE_DIRECTORY,                                   0x0,       0x0 },
+   { DIR_WALK_MAX_DEPTH( 2 ) | DIR_WALK_PATHS_SLASH_FORWARD,      0x0,       0x0 },
+   { DIR_WALK_ROOT_RELATIVE_PATHS,                                "d1/**",   "*.c" },
+   { 0,                                                           "**/d0",   "{a,b}.*" }
+};
+
+static const unsigned int test_threads[] = { 1, 2, 4, 0 };
+
+struct test_item
+{
+   char* path;
+   enum dir_item_type type;
+   long seq; /* order the item was reported in */
+};
+
+struct test_result
+{
+   struct test_item items[TEST_MAX_ITEMS];
+   volatile long num_items;
+   long abort_after; /* return DIR_WALK_ABORT from this item on, 0 to never abort */
+};
+
+static int test_add( struct test_result* result, const char* path, unsigned int path_len, enum dir_item_type type )
+{
+   long seq = dir_atomic_add( &result->num_items, 1 ) - 1;
+   struct test_item* item;
+   if ( seq >= TEST_MAX_ITEMS )
+      return DIR_WALK_ABORT;
+
+   item = &result->items[seq];
+   item->path = (char*)malloc( path_len + 1 );
+   memcpy( item->path, path, path_len + 1 );
+   item->type = type;
+   item->seq = seq;
+   return result->abort_after && seq + 1 >= result->abort_after ? DIR_WALK_ABORT : DIR_WALK_CONTINUE;
+}
+
+static int test_serial_callback( const char* path, unsigned int path_len, enum dir_item_type type, void* userdata )
+{
+   return test_add( (struct test_result*)userdata, path, path_len, type );
+}
+
+static int test_parallel_callback( const char* path, unsigned int path_len, enum dir_item_type type, unsigned int worker_index, void* userdata )
+{
+   (void)worker_index;
+   return test_add( (struct test_result*)userdata, path, path_len, type );
+}
+
+static int test_compare_items( const void* a, const void* b )
+{
+   return strcmp( ( (const struct test_item*)a )->path, ( (const struct test_item*)b )->path );
+}
+
+static void test_clear( struct test_result* result )
+{
+   long i;
+   for ( i = 0; i < result->num_items && i < TEST_MAX_ITEMS; ++i )
+      free( result->items[i].path );
+   result->num_items = 0;
+   result->abort_after = 0;
+}
+
+/* directories d0, d1 and .d2 and files a.c, b.txt and .c.c in each directory, 'depth' levels below path */
+static int test_create_tree( char* path, unsigned int path_len, unsigned int depth )
+{
+   static const char* files[] = { "a.c", "b.txt", ".c.c" };
+   static const char* dirs[] = { "d0", "d1", ".d2" };
+   unsigned int i;
+
+   if ( dir_create( path ) != DIR_ERROR_OK )
+      return 0;
+   for ( i = 0; i < 3; ++i )
+   {
+      FILE* file;
+      sprintf( path + path_len, "/%s", files[i] );
+      file = fopen( path, "wb" );
+      if ( file == 0x0 )
+         return 0;
+      fputs( files[i], file );
+      fclose( file );
+   }
+   for ( i = 0; depth && i < 3; ++i )
+   {
+      unsigned int len = path_len + (unsigned int)sprintf( path + path_len, "/%s", dirs[i] );
+      if ( !test_create_tree( path, len, depth - 1 ) )
+         return 0;
+   }
+   path[path_len] = '\0';
+   return 1;
+}
+
+/* the directory above item, if it was reported */
+static const struct test_item* test_find_parent( const struct test_result* result, const struct test_item* item )
+{
+   long i;
+   const char* last = strrchr( item->path, '/' );
+   size_t len;
+   if ( last == 0x0 )
+      return 0x0;
+
+   len = (size_t)( last - item->path );
+   for ( i = 0; i < result->num_items; ++i )
+      if ( result->items[i].type == DIR_ITEM_DIR && strncmp( result->items[i].path, item->path, len ) == 0 && result->items[i].path[len] == '\0' )
+         return &result->items[i];
+   return 0x0;
+}
+
+static int test_walk( const char* root, const struct test_walk* walk, struct test_result* serial, struct test_result* parallel )
+{
+   unsigned int t, n;
+   long i;
+   int ok = 1;
+
+   if ( dir_walkex( root, walk->flags, walk->glob_directories, walk->glob_files, test_serial_callback, serial ) != DIR_ERROR_OK || serial->num_items == 0 )
+   {
+      printf( "flags 0x%x: serial walk failed\n", walk->flags );
+      test_clear( serial );
+      return 0;
+   }
+   qsort( serial->items, (size_t)serial->num_items, sizeof( struct test_item ), test_compare_items );
+
+   for ( t = 0; ok && t < sizeof( test_threads ) / sizeof( test_threads[0] ); ++t )
+   {
+      for ( n = 0; ok && n < TEST_REPEAT; ++n )
+      {
+         enum dir_error err = dir_walk_parallel( root, walk->flags, walk->glob_directories, walk->glob_files, test_threads[t], test_parallel_callback, parallel );
+
+         /* a directory before the items in it, or after them with DIR_WALK_DEPTH_FIRST */
+         for ( i = 0; ok && i < parallel->num_items; ++i )
+         {
+            const struct test_item* parent = test_find_parent( parallel, &parallel->items[i] );
+            if ( parent && ( ( walk->flags & DIR_WALK_DEPTH_FIRST ) ? parent->seq < parallel->items[i].seq : parent->seq > parallel->items[i].seq ) )
+            {
+               printf( "flags 0x%x, %u workers: '%s' reported in the wrong order with '%s'\n", walk->flags, test_threads[t], parent->path, parallel->items[i].path );
+               ok = 0;
+            }
+         }
+
+         qsort( parallel->items, (size_t)parallel->num_items, sizeof( struct test_item ), test_compare_items );
+         ok &= err == DIR_ERROR_OK && parallel->num_items == serial->num_items;
+         for ( i = 0; ok && i < serial->num_items; ++i )
+            ok = strcmp( serial->items[i].path, parallel->items[i].path ) == 0 && serial->items[i].type == parallel->items[i].type;
+         if ( !ok )
+         {
+            printf( "flags 0x%x, globs '%s' '%s', %u workers: returned %d, reported %ld items, %ld walking serially\n", walk->flags,
+                    walk->glob_directories ? walk->glob_directories : "", walk->glob_files ? walk->glob_files : "",
+                    test_threads[t], (int)err, parallel->num_items, serial->num_items );
+            for ( i = 0; i < serial->num_items || i < parallel->num_items; ++i )
+               printf( "   %-50s %s\n", i < serial->num_items ? serial->items[i].path : "", i < parallel->num_items ? parallel->items[i].path : "" );
+         }
+         test_clear( parallel );
+      }
+   }
+   test_clear( serial );
+   return ok;
+}
+
+static int test_abort( const char* root, struct test_result* result )
+{
+   enum dir_error err;
+   long total;
+   int ok;
+
+   /* the walk stops, but items already being reported on other workers are completed */
+   err = dir_walk_parallel( root, 0, 0x0, 0x0, 4, test_parallel_callback, result );
+   total = result->num_items;
+   test_clear( result );
+   result->abort_after = 5;
+   err = err == DIR_ERROR_OK ? dir_walk_parallel( root, 0, 0x0, 0x0, 4, test_parallel_callback, result ) : err;
+   ok = err == DIR_ERROR_ABORTED && result->num_items >= 5 && result->num_items < total;
+   if ( !ok )
+      printf( "abort: returned %d after %ld of %ld items\n", (int)err, result->num_items, total );
+   test_clear( result );
+   return ok;
+}
+
+int main( void )
+{
+   static struct test_result serial, parallel;
+   char root[] = "dirutil_test_parallel_XXXXXX";
+   char path[256], missing[256];
+   unsigned int i;
+   int ok = 1;
+
+   if ( mkdtemp( root ) == 0x0 )
+   {
+      printf( "failed to create a temporary directory\n" );
+      return 1;
+   }
+   sprintf( path, "%s/tree", root );
+   if ( !test_create_tree( path, (unsigned int)strlen( path ), 3 ) )
+   {
+      printf( "failed to create '%s'\n", path );
+      dir_rmtree( root );
+      return 1;
+   }
+
+   for ( i = 0; i < sizeof( test_walks ) / sizeof( test_walks[0] ); ++i )
+      ok &= test_walk( path, &test_walks[i], &serial, &parallel );
+   ok &= test_abort( path, &parallel );
+
+   sprintf( missing, "%s/missing", root );
+   if ( dir_walk_parallel( missing, 0, 0x0, 0x0, 2, test_parallel_callback, &parallel ) != DIR_ERROR_PATH_DO_NOT_EXIST || parallel.num_items != 0 )
+   {
+      printf( "missing path: not DIR_ERROR_PATH_DO_NOT_EXIST\n" );
+      ok = 0;
+   }
+   test_clear( &parallel );
+
+   dir_rmtree( root );
+   printf( "%s\n", ok ? "parallel: OK" : "parallel: FAILED" );
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,219 @@
+/*
+   dir_rmtree_parallel, removes trees in a mkdtemp directory with 1, 2, 4 and one worker per hardware thread and checks
+   that nothing is left of them. the trees have wide directories, a deep chain of directories, empty directories, dot
+   files, read-only files and symlinks to a directory and a file outside the tree, that must be removed without removing
+   what they point to. then checks the errors for a missing path, a path that is a file and, when not running as root,
+   a directory that can not be written to.
+
+   build and run from the root of the repository:
+      cc -O2 -pthread -o test_rmtree tests/rmtree.c && ./test_rmtree
+*/
+#define _DEFAULT_SOURCE
+#define DIRUTIL_IMPLEMENTATION
+#include "../dirutil.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TEST_WIDE  500 /* files in the wide directory */
+#define TEST_DEEP  64  /* directories in the deep chain */
+
+static const unsigned int test_threads[] = { 1, 2, 4, 0 };
+
+static int test_write_file( const char* path, const char* content )
+{
+   FILE* file = fopen( path, "wb" );
+   if ( file == 0x0 )
+      return 0;
+   fputs( content, file );
+   return fclose( file ) == 0;
+}
+
+static int test_create_tree( const char* tree )
+{
+   char path[4096];
+   size_t len;
+   unsigned int i, j;
+
+   for ( i = 0; i < 4; ++i )
+   {
+      for ( j = 0; j < 4; ++j )
+      {
+         sprintf( path, "%s/d%u/e%u", tree, i, j );
+         if ( dir_mktree( path ) != DIR_ERROR_OK )
+            return 0;
+         sprintf( path, "%s/d%u/e%u/file.txt", tree, i, j );
+         if ( !test_write_file( path, "content" ) )
+            return 0;
+         sprintf( path, "%s/d%u/e%u/.dot", tree, i, j );
+         if ( !test_write_file( path, "" ) )
+            return 0;
+      }
+      sprintf( path, "%s/d%u/empty", tree, i );
+      if ( dir_create( path ) != DIR_ERROR_OK )
+         return 0;
+   }
+
+   for ( i = 0; i < TEST_WIDE; ++i )
+   {
+      sprintf( path, "%s/d0/file_%u", tree, i );
+      if ( !test_write_file( path, "x" ) )
+         return 0;
+   }
+
+   len = (size_t)sprintf( path, "%s/deep", tree );
+   for ( i = 0; i < TEST_DEEP; ++i )
+      len += (size_t)sprintf( path + len, "/%u", i );
+   if ( dir_mktree( path ) != DIR_ERROR_OK )
+      return 0;
+   strcpy( path + len, "/last.txt" );
+   if ( !test_write_file( path, "last" ) )
+      return 0;
+
+   sprintf( path, "%s/d1/read_only.txt", tree );
+   if ( !test_write_file( path, "read only" ) || chmod( path, 0444 ) != 0 )
+      return 0;
+
+   /* the links are relative to where they are */
+   sprintf( path, "%s/d2/link_to_dir", tree );
+   if ( symlink( "../../outside", path ) != 0 )
+      return 0;
+   sprintf( path, "%s/d2/e0/link_to_file", tree );
+   if ( symlink( "../../../outside/keep.txt", path ) != 0 )
+      return 0;
+   sprintf( path, "%s/d3/dangling", tree );
+   if ( symlink( "does_not_exist", path ) != 0 )
+      return 0;
+
+   return 1;
+}
+
+static int test_outside_intact( const char* outside )
+{
+   char path[256], content[16];
+   FILE* file;
+   size_t len;
+
+   sprintf( path, "%s/keep.txt", outside );
+   file = fopen( path, "rb" );
+   if ( file == 0x0 )
+      return 0;
+   len = fread( content, 1, sizeof( content ), file );
+   fclose( file );
+   return len == 4 && memcmp( content, "keep", 4 ) == 0;
+}
+
+static int test_remove( const char* tree, const char* outside, unsigned int num_threads )
+{
+   char failed_path[256];
+   enum dir_error err;
+   struct stat s;
+
+   if ( !test_create_tree( tree ) )
+   {
+      printf( "%u workers: failed to create '%s'\n", num_threads, tree );
+      return 0;
+   }
+
+   failed_path[0] = '\0';
+   err = dir_rmtree_parallel( tree, num_threads, failed_path, sizeof( failed_path ) );
+   if ( err != DIR_ERROR_OK || failed_path[0] != '\0' )
+   {
+      printf( "%u workers: returned %d, failed at '%s'\n", num_threads, (int)err, failed_path );
+      dir_rmtree( tree );
+      return 0;
+   }
+   if ( lstat( tree, &s ) == 0 )
+   {
+      printf( "%u workers: '%s' is not removed\n", num_threads, tree );
+      dir_rmtree( tree );
+      return 0;
+   }
+   if ( !test_outside_intact( outside ) )
+   {
+      printf( "%u workers: the target of a symlink in the tree is removed\n", num_threads );
+      return 0;
+   }
+   return 1;
+}
+
+static int test_errors( const char* root )
+{
+   char path[256], failed_path[256];
+   enum dir_error err;
+   int ok = 1;
+
+   sprintf( path, "%s/missing", root );
+   if ( dir_rmtree_parallel( path, 2, 0x0, 0 ) != DIR_ERROR_PATH_DO_NOT_EXIST )
+   {
+      printf( "missing path: not DIR_ERROR_PATH_DO_NOT_EXIST\n" );
+      ok = 0;
+   }
+
+   sprintf( path, "%s/file", root );
+   if ( !test_write_file( path, "file" ) || dir_rmtree_parallel( path, 2, 0x0, 0 ) != DIR_ERROR_PATH_DO_NOT_EXIST || access( path, F_OK ) != 0 )
+   {
+      printf( "file: removed or not DIR_ERROR_PATH_DO_NOT_EXIST\n" );
+      ok = 0;
+   }
+   remove( path );
+
+   /* root can remove items in a directory without write permission */
+   if ( geteuid() == 0 )
+   {
+      printf( "read-only directory: running as root, skipped\n" );
+      return ok;
+   }
+
+   sprintf( path, "%s/locked/inner", root );
+   if ( dir_mktree( path ) != DIR_ERROR_OK || !test_write_file( strcat( path, "/file.txt" ), "locked" ) )
+      return 0;
+   sprintf( path, "%s/locked/inner", root );
+   chmod( path, 0555 );
+
+   failed_path[0] = '\0';
+   sprintf( path, "%s/locked", root );
+   err = dir_rmtree_parallel( path, 2, failed_path, sizeof( failed_path ) );
+   if ( err != DIR_ERROR_FAILED || strstr( failed_path, "inner" ) == 0x0 )
+   {
+      printf( "read-only directory: returned %d, failed at '%s'\n", (int)err, failed_path );
+      ok = 0;
+   }
+   sprintf( path, "%s/locked/inner", root );
+   chmod( path, 0755 );
+   return ok;
+}
+
+int main( void )
+{
+   char root[] = "dirutil_test_rmtree_XXXXXX";
+   char tree[64], outside[64], path[128];
+   unsigned int i;
+   int ok = 1;
+
+   if ( mkdtemp( root ) == 0x0 )
+   {
+      printf( "failed to create a temporary directory\n" );
+      return 1;
+   }
+   sprintf( tree, "%s/tree", root );
+   sprintf( outside, "%s/outside", root );
+   sprintf( path, "%s/keep.txt", outside );
+   if ( dir_create( outside ) != DIR_ERROR_OK || !test_write_file( path, "keep" ) )
+   {
+      printf( "failed to create '%s'\n", outside );
+      dir_rmtree( root );
+      return 1;
+   }
+
+   for ( i = 0; i < sizeof( test_threads ) / sizeof( test_threads[0] ); ++i )
+      ok &= test_remove( tree, outside, test_threads[i] );
+   ok &= test_errors( root );
+
+   dir_rmtree( root );
+   printf( "%s\n", ok ? "rmtree: OK" : "rmtree: FAILED" );
+   return ok ? 0 : 1;
+}
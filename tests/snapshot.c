@@ -0,0 +1,283 @@
+/*
+   dir_snapshot_save/dir_snapshot_open/dir_snapshot_walkex, saves a tree to a snapshot, opens it and checks that replayed
+   walks report the same items, in the same order and with the same size and mtime, as live walks with the same flags and
+   glob patterns. then checks that a truncated file, a file with another version or size in its header and a file that is
+   not a snapshot are not opened.
+
+   build and run from the root of the repository:
+      cc -O2 -o test_snapshot tests/snapshot.c && ./test_snapshot
+*/
+#define _DEFAULT_SOURCE
+#define DIRUTIL_IMPLEMENTATION
+#include "../dirutil.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_ROOT      "dirutil_test_snapshot"
+#define TEST_FILE      "dirutil_test_snapshot.snap"
+#define TEST_BAD_FILE  "dirutil_test_snapshot_bad.snap"
+#define TEST_INFO      ( DIR_ITEM_INFO_SIZE | DIR_ITEM_INFO_MTIME )
+#define TEST_MAX_ITEMS 64
+
+/* name and content of each file in the tree, parent directories are created as needed */
+static const char* test_files[] =
+{
+   "a.txt",            "a",
+   "b.c",              "bb",
+   ".hidden",          "ccc",
+   "src/main.c",       "dddd",
+   "src/main.h",       "",
+   "src/lib/util.c",   "eeeee",
+   "src/lib/.git/x",   "",
+   "docs/readme.md",   "ffffff",
+   "docs/img/logo.png","ggggggg",
+   "empty/.keep",      ""
+};
+
+struct test_walk
+{
+   unsigned int flags;
+   const char* glob_directories;
+   const char* glob_files;
+};
+
+static const struct test_walk test_walks[] =
+{
+   { 0,                                                          0x0,      0x0 },
+   { DIR_WALK_DEPTH_FIRST,                                       0x0,      0x0 },
+   { DIR_WALK_ONLY_FILES | DIR_WALK_ROOT_RELATIVE_PATHS,         0x0,      0x0 },
+   { DIR_WALK_ONLY_DIRECTORIES | DIR_WALK_PATHS_SLASH_BACK,      0x0,      0x0 },
+   { DIR_WALK_IGNORE_DOT_FILES | DIR_WALK_IGNORE_DOT_DIRECTORIES, 0x0,      0x0 },
+   { DIR_WALK_SINGLE_DIRECTORY,                                  0x0,      0x0 },
+   { DIR_WALK_ROOT_RELATIVE_PATHS,                               "src/**", "*.c" },
+   { DIR_WALK_MAX_DEPTH( 2 ),                                    0x0,      "*.{md,png}" }
+};
+
+struct test_item
+{
+   char* path;
+   enum dir_item_type type;
+   struct dir_item_info info;
+};
+
+struct test_result
+{
+   struct test_item items[TEST_MAX_ITEMS];
+   unsigned int num_items;
+};
+
+static int test_walk_callback( const char* path, unsigned int path_len, enum dir_item_type type, const struct dir_item_info* info, void* userdata )
+{
+   struct test_result* result = (struct test_result*)userdata;
+   struct test_item* item;
+   if ( result->num_items == TEST_MAX_ITEMS )
+      return DIR_WALK_CONTINUE;
+
+   item = &result->items[result->num_items++];
+   item->path = (char*)malloc( path_len + 1 );
+   memcpy( item->path, path, path_len + 1 );
+   item->type = type;
+   item->info = *info;
+   return DIR_WALK_CONTINUE;
+}
+
+static void test_clear( struct test_result* result )
+{
+   unsigned int i;
+   for ( i = 0; i < result->num_items; ++i )
+      free( result->items[i].path );
+   result->num_items = 0;
+}
+
+static int test_same_item( const struct test_item* a, const struct test_item* b )
+{
+   if ( strcmp( a->path, b->path ) != 0 || a->type != b->type || ( a->info.valid & TEST_INFO ) != ( b->info.valid & TEST_INFO ) )
+      return 0;
+   if ( a->type == DIR_ITEM_FILE && ( a->info.size != b->info.size ) )
+      return 0;
+   return a->info.mtime == b->info.mtime && a->info.mtime_nsec == b->info.mtime_nsec;
+}
+
+static int test_replay( const struct dir_snapshot* snapshot, const struct test_walk* walk )
+{
+   struct test_result live, replayed;
+   unsigned int i;
+   enum dir_error live_err, replayed_err;
+   int ok;
+
+   live.num_items = 0;
+   replayed.num_items = 0;
+   live_err = dir_walkex_info( TEST_ROOT, walk->flags, TEST_INFO, walk->glob_directories, walk->glob_files, test_walk_callback, &live );
+   replayed_err = dir_snapshot_walkex( snapshot, walk->flags, TEST_INFO, walk->glob_directories, walk->glob_files, test_walk_callback, &replayed );
+
+   ok = live_err == DIR_ERROR_OK && replayed_err == DIR_ERROR_OK && live.num_items == replayed.num_items && live.num_items != 0;
+   for ( i = 0; ok && i < live.num_items; ++i )
+      ok = test_same_item( &live.items[i], &replayed.items[i] );
+
+   if ( !ok )
+   {
+      printf( "replay: flags 0x%x, globs '%s' '%s' differs from the live walk\n", walk->flags,
+              walk->glob_directories ? walk->glob_directories : "", walk->glob_files ? walk->glob_files : "" );
+      for ( i = 0; i < live.num_items || i < replayed.num_items; ++i )
+         printf( "   %-40s %s\n", i < live.num_items ? live.items[i].path : "", i < replayed.num_items ? replayed.items[i].path : "" );
+   }
+   test_clear( &live );
+   test_clear( &replayed );
+   return ok;
+}
+
+static int test_create_tree( void )
+{
+   unsigned int i;
+   for ( i = 0; i < sizeof( test_files ) / sizeof( test_files[0] ); i += 2 )
+   {
+      char path[256];
+      char* slash;
+      FILE* file;
+
+      sprintf( path, "%s/%s", TEST_ROOT, test_files[i] );
+      slash = strrchr( path, '/' );
+      *slash = '\0';
+      if ( dir_mktree( path ) != DIR_ERROR_OK )
+         return 0;
+      *slash = '/';
+
+      file = fopen( path, "wb" );
+      if ( file == 0x0 )
+         return 0;
+      fputs( test_files[i + 1], file );
+      fclose( file );
+   }
+   return 1;
+}
+
+static char* test_read_file( const char* path, size_t* size )
+{
+   FILE* file = fopen( path, "rb" );
+   char* data;
+   if ( file == 0x0 )
+      return 0x0;
+   fseek( file, 0, SEEK_END );
+   *size = (size_t)ftell( file );
+   fseek( file, 0, SEEK_SET );
+   data = (char*)malloc( *size );
+   if ( fread( data, 1, *size, file ) != *size )
+   {
+      free( data );
+      data = 0x0;
+   }
+   fclose( file );
+   return data;
+}
+
+/* writes size bytes of data to TEST_BAD_FILE and checks that it is not opened */
+static int test_rejected( const char* what, const char* data, size_t size )
+{
+   struct dir_snapshot* snapshot;
+   enum dir_error err;
+   FILE* file = fopen( TEST_BAD_FILE, "wb" );
+   if ( file == 0x0 )
+      return 0;
+   fwrite( data, 1, size, file );
+   fclose( file );
+
+   err = dir_snapshot_open( TEST_BAD_FILE, &snapshot );
+   if ( err != DIR_ERROR_FAILED || snapshot != 0x0 )
+   {
+      printf( "%s: opened, returned %d\n", what, (int)err );
+      dir_snapshot_close( snapshot );
+      return 0;
+   }
+   return 1;
+}
+
+static int test_damaged( void )
+{
+   struct dir_snapshot_header header;
+   size_t size, cut;
+   char* data = test_read_file( TEST_FILE, &size );
+   char* copy;
+   struct dir_snapshot* snapshot;
+   int ok = 1;
+
+   if ( data == 0x0 || size <= sizeof( header ) )
+   {
+      printf( "failed to read '%s'\n", TEST_FILE );
+      free( data );
+      return 0;
+   }
+   copy = (char*)malloc( size );
+
+   /* cut in the header, in the tables and in the names */
+   for ( cut = 0; cut < size; cut += cut < sizeof( header ) ? 8 : 61 )
+      ok &= test_rejected( "truncated", data, cut );
+   ok &= test_rejected( "truncated by one byte", data, size - 1 );
+
+   memcpy( copy, data, size );
+   memcpy( &header, copy, sizeof( header ) );
+   header.version = DIR_SNAPSHOT_VERSION + 1;
+   memcpy( copy, &header, sizeof( header ) );
+   ok &= test_rejected( "other version", copy, size );
+
+   memcpy( copy, data, size );
+   header.version = DIR_SNAPSHOT_VERSION;
+   header.file_size = size + 8;
+   memcpy( copy, &header, sizeof( header ) );
+   ok &= test_rejected( "other size", copy, size );
+
+   memcpy( copy, data, size );
+   copy[0] = 'X';
+   ok &= test_rejected( "not a snapshot", copy, size );
+
+   /* extra bytes at the end do not match the size in the header */
+   copy = (char*)realloc( copy, size + 8 );
+   memcpy( copy, data, size );
+   memset( copy + size, 0, 8 );
+   ok &= test_rejected( "appended to", copy, size + 8 );
+
+   if ( dir_snapshot_open( TEST_ROOT "/no_such_file", &snapshot ) != DIR_ERROR_PATH_DO_NOT_EXIST || snapshot != 0x0 )
+   {
+      printf( "missing file: not DIR_ERROR_PATH_DO_NOT_EXIST\n" );
+      ok = 0;
+   }
+
+   remove( TEST_BAD_FILE );
+   free( copy );
+   free( data );
+   return ok;
+}
+
+int main( void )
+{
+   struct dir_snapshot* snapshot;
+   unsigned int i;
+   int ok = 1;
+
+   dir_rmtree( TEST_ROOT );
+   if ( !test_create_tree() )
+   {
+      printf( "failed to create '%s'\n", TEST_ROOT );
+      return 1;
+   }
+
+   if ( dir_snapshot_save( TEST_ROOT, TEST_INFO, TEST_FILE ) != DIR_ERROR_OK || dir_snapshot_open( TEST_FILE, &snapshot ) != DIR_ERROR_OK )
+   {
+      printf( "failed to save and open '%s'\n", TEST_FILE );
+      dir_rmtree( TEST_ROOT );
+      return 1;
+   }
+
+   for ( i = 0; i < sizeof( test_walks ) / sizeof( test_walks[0] ); ++i )
+      ok &= test_replay( snapshot, &test_walks[i] );
+   dir_snapshot_close( snapshot );
+
+   ok &= test_damaged();
+
+   remove( TEST_FILE );
+   dir_rmtree( TEST_ROOT );
+   printf( "%s\n", ok ? "snapshot: OK" : "snapshot: FAILED" );
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,262 @@
+/*
+   DIR_WALK_SORTED, walks a tree in a mkdtemp directory with names that sort differently by path and by string, i.e.
+   "a", "a/b", "a-b", names with bytes above 0x7f, names with long common prefixes and a wide directory of random names,
+   and checks that the items are reported exactly in the order of their paths compared one path-segment at a time with
+   strcmp, directories before the items in them and with DIR_WALK_DEPTH_FIRST after. checked for dir_walkex,
+   dir_walkex_info, dir_iter and dir_snapshot_walkex with other flags that filter the items.
+
+   build and run from the root of the repository:
+      cc -O2 -o test_sorted tests/sorted.c && ./test_sorted
+*/
+#define _DEFAULT_SOURCE
+#define DIRUTIL_IMPLEMENTATION
+#include "../dirutil.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_MAX_ITEMS 1024
+#define TEST_WIDE      300 /* random names in the wide directory */
+
+/* files in the tree, parent directories are created as needed */
+static const char* test_files[] =
+{
+   "a/b",
+   "a/a-b/c",
+   "a-b",
+   "a.c",
+   "a0",
+   "B",
+   "_",
+   "ab",
+   ".dot",
+   "\xc3\xa9t\xc3\xa9",
+   "z",
+   "prefix_long_name_10",
+   "prefix_long_name_2",
+   "prefix_long_name_1.dir/x",
+   "prefix_long_name_1/y"
+};
+
+static const unsigned int test_flags[] =
+{
+   0,
+   DIR_WALK_DEPTH_FIRST,
+   DIR_WALK_ONLY_FILES,
+   DIR_WALK_ONLY_DIRECTORIES | DIR_WALK_DEPTH_FIRST,
+   DIR_WALK_ROOT_RELATIVE_PATHS | DIR_WALK_IGNORE_DOT_FILES,
+   DIR_WALK_MAX_DEPTH( 1 )
+};
+
+enum test_api
+{
+   TEST_WALKEX,
+   TEST_WALKEX_INFO,
+   TEST_ITER,
+   TEST_SNAPSHOT
+};
+
+static const char* test_api_names[] = { "dir_walkex", "dir_walkex_info", "dir_iter", "dir_snapshot_walkex" };
+
+struct test_items
+{
+   char* paths[TEST_MAX_ITEMS];
+   unsigned int count;
+};
+
+static unsigned int test_depth_first;
+
+static void test_add( struct test_items* items, const char* path, unsigned int path_len )
+{
+   if ( items->count == TEST_MAX_ITEMS )
+      return;
+   items->paths[items->count] = (char*)malloc( path_len + 1 );
+   memcpy( items->paths[items->count++], path, path_len + 1 );
+}
+
+static int test_callback( const char* path, unsigned int path_len, enum dir_item_type type, void* userdata )
+{
+   (void)type;
+   test_add( (struct test_items*)userdata, path, path_len );
+   return DIR_WALK_CONTINUE;
+}
+
+static int test_info_callback( const char* path, unsigned int path_len, enum dir_item_type type, const struct dir_item_info* info, void* userdata )
+{
+   (void)type; (void)info;
+   test_add( (struct test_items*)userdata, path, path_len );
+   return DIR_WALK_CONTINUE;
+}
+
+static void test_clear( struct test_items* items )
+{
+   unsigned int i;
+   for ( i = 0; i < items->count; ++i )
+      free( items->paths[i] );
+   items->count = 0;
+}
+
+/* one path-segment at a time with strcmp, a directory before the items in it or after them with DIR_WALK_DEPTH_FIRST */
+static int test_compare_paths( const void* pa, const void* pb )
+{
+   const unsigned char* a = *(const unsigned char* const*)pa;
+   const unsigned char* b = *(const unsigned char* const*)pb;
+   while ( *a == *b && *a )
+      ++a, ++b;
+   if ( *a == *b )
+      return 0;
+   if ( *a == '\0' && *b == '/' )
+      return test_depth_first ? 1 : -1;
+   if ( *a == '/' && *b == '\0' )
+      return test_depth_first ? -1 : 1;
+   if ( *a == '/' )
+      return -1;
+   if ( *b == '/' )
+      return 1;
+   return *a < *b ? -1 : 1;
+}
+
+static enum dir_error test_run( const char* root, const struct dir_snapshot* snapshot, enum test_api api, unsigned int flags, struct test_items* items )
+{
+   struct dir_iter* iter;
+   struct dir_iter_item item;
+   enum dir_error err;
+
+   switch ( api )
+   {
+      case TEST_WALKEX:      return dir_walkex( root, flags, 0x0, 0x0, test_callback, items );
+      case TEST_WALKEX_INFO: return dir_walkex_info( root, flags, DIR_ITEM_INFO_SIZE, 0x0, 0x0, test_info_callback, items );
+      case TEST_SNAPSHOT:    return dir_snapshot_walkex( snapshot, flags, 0, 0x0, 0x0, test_info_callback, items );
+      default:
+         err = dir_iter_open( root, flags, 0, 0x0, 0x0, &iter );
+         if ( err != DIR_ERROR_OK )
+            return err;
+         while ( dir_iter_next( iter, &item ) )
+            test_add( items, item.path, item.path_len );
+         return dir_iter_close( iter );
+   }
+}
+
+/* the items of an unsorted walk with the same flags, sorted by the test */
+static int test_sorted( const char* root, const struct dir_snapshot* snapshot, enum test_api api, unsigned int flags )
+{
+   static struct test_items expected, items;
+   unsigned int i;
+   enum dir_error err;
+   int ok;
+
+   if ( dir_walkex( root, flags, 0x0, 0x0, test_callback, &expected ) != DIR_ERROR_OK || expected.count == 0 )
+   {
+      printf( "flags 0x%x: unsorted walk failed\n", flags );
+      test_clear( &expected );
+      return 0;
+   }
+   test_depth_first = flags & DIR_WALK_DEPTH_FIRST;
+   qsort( expected.paths, expected.count, sizeof( char* ), test_compare_paths );
+
+   err = test_run( root, snapshot, api, flags | DIR_WALK_SORTED, &items );
+   ok = err == DIR_ERROR_OK && items.count == expected.count;
+   for ( i = 0; ok && i < expected.count; ++i )
+      ok = strcmp( expected.paths[i], items.paths[i] ) == 0;
+   if ( !ok )
+   {
+      printf( "%s, flags 0x%x: returned %d and %u items, expected %u in this order\n", test_api_names[api], flags, (int)err, items.count, expected.count );
+      for ( i = 0; i < expected.count || i < items.count; ++i )
+      {
+         const char* e = i < expected.count ? expected.paths[i] : "";
+         const char* r = i < items.count ? items.paths[i] : "";
+         printf( "   %s %-50s %s\n", strcmp( e, r ) == 0 ? " " : "*", e, r );
+      }
+   }
+   test_clear( &expected );
+   test_clear( &items );
+   return ok;
+}
+
+static unsigned long test_seed = 1;
+
+/* same random sequence on every platform */
+static unsigned int test_rand( void )
+{
+   test_seed = test_seed * 1103515245UL + 12345UL;
+   return (unsigned int)( ( test_seed >> 16 ) & 0x7fff );
+}
+
+static int test_write_file( const char* root, const char* name )
+{
+   char path[256];
+   char* slash;
+   FILE* file;
+
+   sprintf( path, "%s/%s", root, name );
+   slash = strrchr( path, '/' );
+   *slash = '\0';
+   if ( dir_mktree( path ) != DIR_ERROR_OK )
+      return 0;
+   *slash = '/';
+
+   file = fopen( path, "wb" );
+   if ( file == 0x0 )
+      return 0;
+   return fclose( file ) == 0;
+}
+
+static int test_create_tree( const char* root )
+{
+   /* one or two bytes each, a byte above 0x7f only as the first byte of a two byte utf-8 sequence */
+   static const char* pieces[] = { "a", "b", "A", "-", ".", "_", "0", "9", "z", "\xc3\xa9", "\xe2\x82\xac" };
+   char name[64];
+   unsigned int i, j;
+
+   for ( i = 0; i < sizeof( test_files ) / sizeof( test_files[0] ); ++i )
+      if ( !test_write_file( root, test_files[i] ) )
+         return 0;
+
+   /* long enough to be sorted in more than one pass, names with common prefixes of 8 bytes and more */
+   for ( i = 0; i < TEST_WIDE; ++i )
+   {
+      unsigned int len = 1 + test_rand() % 20;
+      strcpy( name, test_rand() % 2 ? "wide/common_prefix_" : "wide/" );
+      for ( j = 0; j < len; ++j )
+         strcat( name, pieces[test_rand() % ( sizeof( pieces ) / sizeof( pieces[0] ) )] );
+      if ( strcmp( name + strlen( name ) - 1, "." ) == 0 )
+         strcat( name, "x" );
+      if ( !test_write_file( root, name ) )
+         return 0;
+   }
+   return 1;
+}
+
+int main( void )
+{
+   char root[] = "dirutil_test_sorted_XXXXXX";
+   char file[64];
+   struct dir_snapshot* snapshot = 0x0;
+   unsigned int api, f;
+   int ok = 1;
+
+   if ( mkdtemp( root ) == 0x0 )
+   {
+      printf( "failed to create a temporary directory\n" );
+      return 1;
+   }
+   sprintf( file, "%s.snap", root );
+   if ( !test_create_tree( root ) || dir_snapshot_save( root, 0, file ) != DIR_ERROR_OK || dir_snapshot_open( file, &snapshot ) != DIR_ERROR_OK )
+   {
+      printf( "failed to create the tree and snapshot it\n" );
+      dir_rmtree( root );
+      remove( file );
+      return 1;
+   }
+
+   for ( api = TEST_WALKEX; api <= TEST_SNAPSHOT; ++api )
+      for ( f = 0; f < sizeof( test_flags ) / sizeof( test_flags[0] ); ++f )
+         ok &= test_sorted( root, snapshot, (enum test_api)api, test_flags[f] );
+
+   dir_snapshot_close( snapshot );
+   remove( file );
+   dir_rmtree( root );
+   printf( "%s\n", ok ? "sorted: OK" : "sorted: FAILED" );
+   return ok ? 0 : 1;
+}
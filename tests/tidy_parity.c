@@ -0,0 +1,255 @@
+/*
+   dir_path_tidy, checks the SSE2 and AVX2 separator conversion against the scalar one on random paths, in place and
+   moved down as dir_path_tidy does after trimming, with every alignment, lengths around the block sizes and
+   null-terminators inside the range. then dir_path_tidy, with each of the scalar, SSE2 and AVX2 conversions, is
+   checked against the three-pass tidy it replaced (copied below as test_tidy_old, as in bench/tidy.c).
+
+   build and run from the root of the repository, the second line checks the scalar build:
+      cc -O2 -o test_tidy_parity tests/tidy_parity.c && ./test_tidy_parity
+      cc -O2 -DDIRUTIL_NO_SIMD -o test_tidy_parity tests/tidy_parity.c && ./test_tidy_parity
+*/
+#define _DEFAULT_SOURCE
+#define DIRUTIL_IMPLEMENTATION
+#include "../dirutil.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_NUM_CASES 2000000UL
+#define TEST_MAX_LEN   300
+#define TEST_BUF_SIZE  ( TEST_MAX_LEN + 128 )
+
+typedef char* (*test_tidy_func)( char* dest, const char* src, const char* end, char slash );
+
+static unsigned long test_seed = 1;
+
+/* same random sequence on every platform */
+static unsigned int test_rand( void )
+{
+   test_seed = test_seed * 1103515245UL + 12345UL;
+   return (unsigned int)( ( test_seed >> 16 ) & 0x7fff );
+}
+
+/* mostly separators, whitespace and quotes to hit the runs and the trimming */
+static void test_random_path( char* path, unsigned int len )
+{
+   static const char chars[] = "/\\\" \tab.";
+   unsigned int i;
+   for ( i = 0; i < len; ++i )
+   {
+      unsigned int r = test_rand();
+      if ( r % 3 == 0 )
+         path[i] = (char)( 'a' + r % 26 );
+      else if ( r % 97 == 1 )
+         path[i] = '\0';
+      else
+         path[i] = chars[ ( r >> 4 ) % ( sizeof( chars ) - 1 ) ];
+   }
+   path[len] = '\0';
+}
+
+/* the tidy before the single pass, copied as is apart from the names */
+static int test_iswhite_old( int c )
+{
+   return   ( ' '  == c ) ||
+            ( '\t' == c ) ||
+            ( '\n' == c ) ||
+            ( '\v' == c ) ||
+            ( '\f' == c ) ||
+            ( '\r' == c );
+}
+
+static unsigned int test_trimwhite_unquote_old( char* path_buffer, unsigned int path_len )
+{
+   char* p = path_buffer;
+   while ( ( path_len && test_iswhite_old( path_buffer[path_len - 1] ) ) || ( path_buffer[path_len - 1] == '"' ) )
+      --path_len;
+
+   while ( ( path_len && test_iswhite_old( *p ) ) || *p == '"' )
+      --path_len, ++p;
+
+   if ( p != path_buffer )
+      memmove( path_buffer, p, path_len );
+
+   path_buffer[path_len] = '\0';
+   return path_len;
+}
+
+static unsigned test_convert_slashes_old( char* dest, char slash_substitute )
+{
+   char c;
+   char *runner = dest, *odest = dest;
+#if defined( _WIN32 )
+   /* handle UNC paths */
+   if ( runner[0] == DIR_SEP_PLATFORM && runner[1] == DIR_SEP_PLATFORM )
+   {
+      *dest++ = *runner++;
+      *dest++ = *runner++;
+      while ( DIR_IS_SEP( *runner ) )
+         ++runner;
+   }
+#endif
+   while ( ( c = *runner++ ) )
+   {
+      switch ( c ) {
+      case '/':
+      case '\\': {
+         c = slash_substitute;
+         /* next is slash ? */
+         if ( DIR_IS_SEP( *runner ) )
+            break;
+      }
+      /* FALLTHRU */
+      default:
+         *dest++ = c;
+      }
+   }
+
+   *dest = '\0';
+   return (unsigned)(dest - odest);
+}
+
+static unsigned int test_tidy_old( char* path, char slash, unsigned int path_len )
+{
+   path_len = path_len ? path_len : (unsigned int)strlen( path );
+   path_len = test_trimwhite_unquote_old( path, path_len );
+   path_len = test_convert_slashes_old( path, slash );
+
+   if ( path_len && DIR_IS_SEP( path[path_len - 1] ) )
+   {
+      --path_len;
+      path[path_len] = '\0';
+   }
+   return path_len;
+}
+
+/*
+   the old tidy reads the byte before the path when all of it is trimmed, and then runs past its end if it starts with
+   a quote. such paths are tidied to the empty string, which is what the old tidy meant to do.
+*/
+static int test_trims_to_empty( const char* path, unsigned int path_len )
+{
+   unsigned int i;
+   path_len = path_len ? path_len : (unsigned int)strlen( path );
+   for ( i = 0; i < path_len; ++i )
+      if ( !test_iswhite_old( path[i] ) && path[i] != '"' )
+         return 0;
+   return 1;
+}
+
+static int test_failed( const char* what, const char* input, unsigned int len, unsigned int offset, unsigned int shift )
+{
+   unsigned int i;
+   printf( "%s: mismatch, length %u, offset %u, moved %u, input '", what, len, offset, shift );
+   for ( i = 0; i < len; ++i )
+      printf( input[i] ? "%c" : "\\0", input[i] );
+   printf( "'\n" );
+   return 0;
+}
+
+/*
+   runs 'func' on [src, src + len) moved 'shift' bytes down, both start at 'offset' from a 64 byte boundary. returns
+   the 64 byte aligned start of the test area and the number of bytes written in 'written'. what is left between the
+   written bytes and the end of the input is undefined and cleared, the rest of the area is compared as well to catch
+   stores outside the range.
+*/
+static char* test_run( test_tidy_func func, char* buf, const char* input, unsigned int len, unsigned int offset, unsigned int shift, char slash, size_t* written )
+{
+   char* aligned = buf + ( 64 - ( (size_t)buf & 63 ) ) % 64;
+   char* base = aligned + offset;
+   char* end;
+   memset( buf, 'x', TEST_BUF_SIZE + 64 );
+   memcpy( base + shift, input, len );
+   end = func( base, base + shift, base + shift + len, slash );
+   memset( end, '-', (size_t)( base + shift + len - end ) );
+   *written = (size_t)( end - base );
+   return aligned;
+}
+
+static int test_separators( const char* name, test_tidy_func func, unsigned long num_cases )
+{
+   static char input[TEST_MAX_LEN + 1], expected_buf[TEST_BUF_SIZE + 64], actual_buf[TEST_BUF_SIZE + 64];
+   unsigned long n;
+
+   for ( n = 0; n < num_cases; ++n )
+   {
+      /* lengths around the 16 and 32 byte blocks and the 64 byte AVX2 threshold are the interesting ones */
+      unsigned int len = n % 8 == 0 ? test_rand() % TEST_MAX_LEN : test_rand() % 100;
+      unsigned int offset = test_rand() % 64;
+      unsigned int shift = test_rand() % 4 == 0 ? test_rand() % 8 : 0;
+      char slash = ( test_rand() & 1 ) ? '/' : '\\';
+      size_t expected_len, actual_len;
+      const char *expected, *actual;
+
+      test_random_path( input, len );
+      expected = test_run( dir_path_tidy_scalar, expected_buf, input, len, offset, shift, slash, &expected_len );
+      actual = test_run( func, actual_buf, input, len, offset, shift, slash, &actual_len );
+      if ( expected_len != actual_len || memcmp( expected, actual, TEST_BUF_SIZE ) != 0 )
+         return test_failed( name, input, len, offset, shift );
+   }
+   return 1;
+}
+
+static int test_path_tidy( const char* name, test_tidy_func separators, unsigned long num_cases )
+{
+   /* the byte before each path is not a quote, the old tidy reads it */
+   static char input[TEST_MAX_LEN + 1], expected[TEST_BUF_SIZE + 1], actual[TEST_BUF_SIZE];
+   unsigned long n;
+
+   expected[0] = 'x';
+   for ( n = 0; n < num_cases; ++n )
+   {
+      unsigned int len = n % 8 == 0 ? test_rand() % TEST_MAX_LEN : test_rand() % 100;
+      unsigned int given_len = test_rand() & 1 ? len : 0;
+      char slash = ( test_rand() & 1 ) ? '/' : '\\';
+      unsigned int expected_len, actual_len;
+
+      test_random_path( input, len );
+      memcpy( expected + 1, input, len + 1 );
+      memcpy( actual, input, len + 1 );
+      expected_len = 0;
+      if ( test_trims_to_empty( input, given_len ) )
+         expected[1] = '\0';
+      else
+         expected_len = test_tidy_old( expected + 1, slash, given_len );
+      actual_len = dir_path_tidy_with( actual, slash, given_len, separators );
+      if ( expected_len != actual_len || strcmp( expected + 1, actual ) != 0 )
+         return test_failed( name, input, len, 0, 0 );
+   }
+   return 1;
+}
+
+int main( void )
+{
+   int ok = 1;
+
+#if defined( DIR_SIMD_SSE2 )
+   ok &= test_separators( "sse2", dir_path_tidy_sse2, TEST_NUM_CASES );
+#else
+   printf( "sse2: not compiled in, skipped\n" );
+#endif
+#if defined( DIR_SIMD_AVX2 )
+   if ( __builtin_cpu_supports( "avx2" ) )
+      ok &= test_separators( "avx2", dir_path_tidy_avx2, TEST_NUM_CASES );
+   else
+      printf( "avx2: not supported by this cpu, skipped\n" );
+#else
+   printf( "avx2: not compiled in, skipped\n" );
+#endif
+   ok &= test_separators( "dir_path_tidy_separators", dir_path_tidy_separators, TEST_NUM_CASES );
+
+   /* dir_path_tidy as a whole, with each conversion, against the old tidy */
+   ok &= test_path_tidy( "dir_path_tidy scalar", dir_path_tidy_scalar, TEST_NUM_CASES );
+#if defined( DIR_SIMD_SSE2 )
+   ok &= test_path_tidy( "dir_path_tidy sse2", dir_path_tidy_sse2, TEST_NUM_CASES );
+#endif
+#if defined( DIR_SIMD_AVX2 )
+   if ( __builtin_cpu_supports( "avx2" ) )
+      ok &= test_path_tidy( "dir_path_tidy avx2", dir_path_tidy_avx2, TEST_NUM_CASES );
+#endif
+   ok &= test_path_tidy( "dir_path_tidy", dir_path_tidy_separators, TEST_NUM_CASES );
+
+   printf( "%s\n", ok ? "tidy_parity: OK" : "tidy_parity: FAILED" );
+   return ok ? 0 : 1;
+}
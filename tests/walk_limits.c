@@ -0,0 +1,258 @@
+/*
+   DIR_WALK_MAX_DEPTH, DIR_WALK_SAME_FILESYSTEM and DIR_WALK_FOLLOW_SYMLINKS, walks a tree in a mkdtemp directory with
+   symlinks to the root, to the directory the link is in, to a directory above it, to a sibling directory, to a file and
+   to nothing. checks, with dir_walkex and dir_walk_parallel on 1, 2, 4 and one worker per hardware thread, that:
+      - each max depth reports exactly the items at that depth and above, items in the root are at depth 1.
+      - with DIR_WALK_FOLLOW_SYMLINKS the walk terminates, links to the directories they are reached through are
+        reported as directories but not walked and the link to the sibling directory is walked.
+      - DIR_WALK_SAME_FILESYSTEM reports the same items, as the tree is on one file system.
+   also walks /dev with DIR_WALK_SAME_FILESYSTEM and checks that directories on another file system are reported but
+   not walked, skipped if there are none.
+
+   build and run from the root of the repository:
+      cc -O2 -pthread -o test_walk_limits tests/walk_limits.c && ./test_walk_limits
+*/
+#define _DEFAULT_SOURCE
+#define DIRUTIL_IMPLEMENTATION
+#include "../dirutil.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define TEST_MAX_ITEMS 4096
+
+struct test_expected
+{
+   const char* path;
+   const char* link; /* target if the item is a symlink */
+   enum dir_item_type type;
+   enum dir_item_type followed_type; /* with DIR_WALK_FOLLOW_SYMLINKS */
+   int only_followed;                /* below a followed link */
+};
+
+/* sorted by path, directories are created by the items in them */
+static const struct test_expected test_items[] =
+{
+   { "d",           0x0,       DIR_ITEM_DIR,  DIR_ITEM_DIR,  0 },
+   { "d/e",         0x0,       DIR_ITEM_DIR,  DIR_ITEM_DIR,  0 },
+   { "d/e/f",       0x0,       DIR_ITEM_DIR,  DIR_ITEM_DIR,  0 },
+   { "d/e/f/g.txt", 0x0,       DIR_ITEM_FILE, DIR_ITEM_FILE, 0 },
+   { "d/e/self",    ".",       DIR_ITEM_FILE, DIR_ITEM_DIR,  0 },
+   { "d/loop",      "../d",    DIR_ITEM_FILE, DIR_ITEM_DIR,  0 },
+   { "d/up",        "..",      DIR_ITEM_FILE, DIR_ITEM_DIR,  0 },
+   { "d/x.txt",     0x0,       DIR_ITEM_FILE, DIR_ITEM_FILE, 0 },
+   { "dangling",    "nowhere", DIR_ITEM_FILE, DIR_ITEM_FILE, 0 },
+   { "file_link",   "top.txt", DIR_ITEM_FILE, DIR_ITEM_FILE, 0 },
+   { "sib",         "d/e",     DIR_ITEM_FILE, DIR_ITEM_DIR,  0 },
+   { "sib/f",       0x0,       DIR_ITEM_DIR,  DIR_ITEM_DIR,  1 },
+   { "sib/f/g.txt", 0x0,       DIR_ITEM_FILE, DIR_ITEM_FILE, 1 },
+   { "sib/self",    0x0,       DIR_ITEM_DIR,  DIR_ITEM_DIR,  1 },
+   { "top.txt",     0x0,       DIR_ITEM_FILE, DIR_ITEM_FILE, 0 }
+};
+
+#define TEST_NUM_ITEMS ( sizeof( test_items ) / sizeof( test_items[0] ) )
+
+static const unsigned int test_threads[] = { 1, 2, 4, 0 };
+
+struct test_item
+{
+   char* path;
+   enum dir_item_type type;
+};
+
+struct test_result
+{
+   struct test_item items[TEST_MAX_ITEMS];
+   volatile long num_items;
+};
+
+static int test_add( struct test_result* result, const char* path, unsigned int path_len, enum dir_item_type type )
+{
+   long index = dir_atomic_add( &result->num_items, 1 ) - 1;
+   struct test_item* item;
+   if ( index >= TEST_MAX_ITEMS )
+      return DIR_WALK_ABORT;
+
+   item = &result->items[index];
+   item->path = (char*)malloc( path_len + 1 );
+   memcpy( item->path, path, path_len + 1 );
+   item->type = type;
+   return DIR_WALK_CONTINUE;
+}
+
+static int test_serial_callback( const char* path, unsigned int path_len, enum dir_item_type type, void* userdata )
+{
+   return test_add( (struct test_result*)userdata, path, path_len, type );
+}
+
+static int test_parallel_callback( const char* path, unsigned int path_len, enum dir_item_type type, unsigned int worker_index, void* userdata )
+{
+   (void)worker_index;
+   return test_add( (struct test_result*)userdata, path, path_len, type );
+}
+
+static int test_compare_items( const void* a, const void* b )
+{
+   return strcmp( ( (const struct test_item*)a )->path, ( (const struct test_item*)b )->path );
+}
+
+static void test_clear( struct test_result* result )
+{
+   long i;
+   for ( i = 0; i < result->num_items && i < TEST_MAX_ITEMS; ++i )
+      free( result->items[i].path );
+   result->num_items = 0;
+}
+
+static unsigned int test_depth( const char* path )
+{
+   unsigned int depth = 1;
+   for ( ; *path; ++path )
+      depth += *path == '/';
+   return depth;
+}
+
+/* the walk reported exactly the expected items for the flags */
+static int test_check( const char* name, unsigned int flags, unsigned int threads, enum dir_error err, struct test_result* result )
+{
+   unsigned int max_depth = ( flags & DIR_WALK_MAX_DEPTH_MASK ) >> 20;
+   int follow = ( flags & DIR_WALK_FOLLOW_SYMLINKS ) != 0;
+   unsigned int i;
+   long n = 0;
+   int ok = err == DIR_ERROR_OK && result->num_items <= TEST_MAX_ITEMS;
+
+   qsort( result->items, (size_t)( ok ? result->num_items : 0 ), sizeof( struct test_item ), test_compare_items );
+   for ( i = 0; ok && i < TEST_NUM_ITEMS; ++i )
+   {
+      const struct test_expected* expected = &test_items[i];
+      if ( ( expected->only_followed && !follow ) || ( max_depth && test_depth( expected->path ) > max_depth ) )
+         continue;
+      ok = n < result->num_items && strcmp( result->items[n].path, expected->path ) == 0 &&
+           result->items[n].type == ( follow ? expected->followed_type : expected->type );
+      ++n;
+   }
+   ok &= n == result->num_items;
+   if ( !ok )
+   {
+      printf( "%s, flags 0x%x, %u workers: returned %d, reported %ld items\n", name, flags, threads, (int)err, result->num_items );
+      for ( n = 0; n < result->num_items && n < TEST_MAX_ITEMS; ++n )
+         printf( "   %d %s\n", (int)result->items[n].type, result->items[n].path );
+   }
+   test_clear( result );
+   return ok;
+}
+
+static int test_walk( const char* root, unsigned int flags, struct test_result* result )
+{
+   unsigned int t;
+   int ok;
+
+   ok = test_check( "dir_walkex", flags, 1, dir_walkex( root, flags, 0x0, 0x0, test_serial_callback, result ), result );
+   for ( t = 0; ok && t < sizeof( test_threads ) / sizeof( test_threads[0] ); ++t )
+      ok = test_check( "dir_walk_parallel", flags, test_threads[t],
+                       dir_walk_parallel( root, flags, 0x0, 0x0, test_threads[t], test_parallel_callback, result ), result );
+   return ok;
+}
+
+/* directories on another file system than /dev, i.e. /dev/pts or /dev/shm, are reported but nothing in them */
+static int test_mount_points( struct test_result* result )
+{
+   struct stat root_stat, item_stat;
+   long i, j, mounts = 0;
+   enum dir_error err;
+   int ok;
+
+   if ( stat( "/dev", &root_stat ) != 0 )
+   {
+      printf( "no /dev, mount points skipped\n" );
+      return 1;
+   }
+   err = dir_walkex( "/dev", DIR_WALK_SAME_FILESYSTEM | DIR_WALK_MAX_DEPTH( 2 ), 0x0, 0x0, test_serial_callback, result );
+   ok = err == DIR_ERROR_OK && result->num_items <= TEST_MAX_ITEMS;
+   for ( i = 0; ok && i < result->num_items; ++i )
+   {
+      const char* path = result->items[i].path;
+      size_t len = strlen( path );
+      if ( result->items[i].type != DIR_ITEM_DIR || lstat( path, &item_stat ) != 0 || item_stat.st_dev == root_stat.st_dev )
+         continue;
+
+      ++mounts;
+      for ( j = 0; ok && j < result->num_items; ++j )
+      {
+         if ( strncmp( result->items[j].path, path, len ) == 0 && result->items[j].path[len] == '/' )
+         {
+            printf( "DIR_WALK_SAME_FILESYSTEM: '%s' walked below the mount point '%s'\n", result->items[j].path, path );
+            ok = 0;
+         }
+      }
+   }
+   if ( err != DIR_ERROR_OK )
+      printf( "DIR_WALK_SAME_FILESYSTEM: walking /dev returned %d\n", (int)err );
+   else if ( ok && mounts == 0 )
+      printf( "no mount points in /dev, skipped\n" );
+   test_clear( result );
+   return ok;
+}
+
+static int test_write_file( const char* path )
+{
+   FILE* file = fopen( path, "wb" );
+   if ( file == 0x0 )
+      return 0;
+   fputs( path, file );
+   return fclose( file ) == 0;
+}
+
+static int test_create_tree( const char* root )
+{
+   char path[256];
+   unsigned int i;
+
+   sprintf( path, "%s/d/e/f", root );
+   if ( dir_mktree( path ) != DIR_ERROR_OK )
+      return 0;
+   for ( i = 0; i < TEST_NUM_ITEMS; ++i )
+   {
+      const struct test_expected* item = &test_items[i];
+      if ( item->only_followed || item->type == DIR_ITEM_DIR )
+         continue;
+      sprintf( path, "%s/%s", root, item->path );
+      if ( item->link ? symlink( item->link, path ) != 0 : !test_write_file( path ) )
+         return 0;
+   }
+   return 1;
+}
+
+int main( void )
+{
+   static struct test_result result;
+   static const unsigned int other_flags[] = { 0, DIR_WALK_DEPTH_FIRST, DIR_WALK_SAME_FILESYSTEM, DIR_WALK_SAME_FILESYSTEM | DIR_WALK_DEPTH_FIRST };
+   char root[] = "dirutil_test_walk_limits_XXXXXX";
+   unsigned int f, follow, depth;
+   int ok = 1;
+
+   if ( mkdtemp( root ) == 0x0 )
+   {
+      printf( "failed to create a temporary directory\n" );
+      return 1;
+   }
+   if ( !test_create_tree( root ) )
+   {
+      printf( "failed to create the tree\n" );
+      dir_rmtree( root );
+      return 1;
+   }
+
+   for ( f = 0; f < sizeof( other_flags ) / sizeof( other_flags[0] ); ++f )
+      for ( follow = 0; follow < 2; ++follow )
+         for ( depth = 0; depth <= 5; ++depth )
+            ok &= test_walk( root, DIR_WALK_ROOT_RELATIVE_PATHS | other_flags[f] | ( follow ? DIR_WALK_FOLLOW_SYMLINKS : 0 ) | DIR_WALK_MAX_DEPTH( depth ), &result );
+   ok &= test_mount_points( &result );
+
+   dir_rmtree( root );
+   printf( "%s\n", ok ? "walk_limits: OK" : "walk_limits: FAILED" );
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,274 @@
+/*
+   enum dir_walk_result, walks a tree in a mkdtemp directory with callbacks returning DIR_WALK_SKIP_SUBTREE for one
+   directory and checks that nothing below it is reported while everything else is, also when returned for a file or
+   with DIR_WALK_DEPTH_FIRST where it is the same as DIR_WALK_CONTINUE. then checks that DIR_WALK_ABORT, and any other
+   value, stops the walk after exactly that item and returns DIR_ERROR_ABORTED. checked for dir_walkex, dir_walkex_info,
+   dir_walkex_batch, where DIR_WALK_SKIP_SUBTREE returned for a batch skips the sub-directories in it, and
+   dir_walk_parallel, where items already being reported on other workers are completed after DIR_WALK_ABORT.
+
+   build and run from the root of the repository:
+      cc -O2 -pthread -o test_walk_result tests/walk_result.c && ./test_walk_result
+*/
+#define _DEFAULT_SOURCE
+#define DIRUTIL_IMPLEMENTATION
+#include "../dirutil.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_MAX_ITEMS 64
+
+/* files in the tree, parent directories are created as needed */
+static const char* test_files[] =
+{
+   "top.txt",
+   "skip/a.txt",
+   "skip/deeper/b.txt",
+   "skip/deeper/deepest/c.txt",
+   "keep/d.txt",
+   "keep/skip/e.txt", /* not skipped, only the directory at the top is */
+   "keep/more/f.txt"
+};
+
+/* total number of items in the tree, files and directories */
+#define TEST_NUM_ITEMS 13
+
+enum test_api
+{
+   TEST_WALKEX,
+   TEST_WALKEX_INFO,
+   TEST_WALKEX_BATCH,
+   TEST_PARALLEL
+};
+
+static const char* test_api_names[] = { "dir_walkex", "dir_walkex_info", "dir_walkex_batch", "dir_walk_parallel" };
+
+struct test_walk
+{
+   const char* skip_path;    /* return skip_result for this item */
+   int skip_result;
+   long abort_after;         /* return abort_result for the item with this number, counted from 1, 0 to not abort */
+   int abort_result;
+
+   char* paths[TEST_MAX_ITEMS];
+   volatile long num_items;
+};
+
+static int test_item( struct test_walk* walk, const char* path, unsigned int path_len )
+{
+   long n = dir_atomic_add( &walk->num_items, 1 );
+   if ( n > TEST_MAX_ITEMS )
+      return DIR_WALK_ABORT;
+   walk->paths[n - 1] = (char*)malloc( path_len + 1 );
+   memcpy( walk->paths[n - 1], path, path_len + 1 );
+
+   if ( walk->abort_after == n )
+      return walk->abort_result;
+   if ( walk->skip_path && strcmp( path, walk->skip_path ) == 0 )
+      return walk->skip_result;
+   return DIR_WALK_CONTINUE;
+}
+
+static int test_callback( const char* path, unsigned int path_len, enum dir_item_type type, void* userdata )
+{
+   (void)type;
+   return test_item( (struct test_walk*)userdata, path, path_len );
+}
+
+static int test_info_callback( const char* path, unsigned int path_len, enum dir_item_type type, const struct dir_item_info* info, void* userdata )
+{
+   (void)type; (void)info;
+   return test_item( (struct test_walk*)userdata, path, path_len );
+}
+
+static int test_parallel_callback( const char* path, unsigned int path_len, enum dir_item_type type, unsigned int worker_index, void* userdata )
+{
+   (void)type; (void)worker_index;
+   return test_item( (struct test_walk*)userdata, path, path_len );
+}
+
+/* a batch is handled as its directory, the result returned for the directory is returned for the batch */
+static int test_batch_callback( const struct dir_item_batch* batch, void* userdata )
+{
+   struct test_walk* walk = (struct test_walk*)userdata;
+   unsigned int i;
+   int result = DIR_WALK_CONTINUE;
+   for ( i = 0; i < batch->count; ++i )
+   {
+      char path[256];
+      int item_result;
+      unsigned int len = (unsigned int)sprintf( path, "%.*s%s%s", (int)batch->dir_path_len, batch->dir_path,
+                                                batch->dir_path_len ? "/" : "", batch->names + batch->name_offsets[i] );
+      item_result = test_item( walk, path, len );
+      if ( item_result != DIR_WALK_CONTINUE && item_result != DIR_WALK_SKIP_SUBTREE )
+         return item_result;
+   }
+   if ( walk->skip_path && batch->dir_path_len && strcmp( batch->dir_path, walk->skip_path ) == 0 )
+      result = walk->skip_result;
+   return result;
+}
+
+static void test_clear( struct test_walk* walk )
+{
+   long i;
+   for ( i = 0; i < walk->num_items && i < TEST_MAX_ITEMS; ++i )
+      free( walk->paths[i] );
+   memset( walk, 0, sizeof( *walk ) );
+}
+
+static int test_reported( const struct test_walk* walk, const char* path )
+{
+   long i;
+   for ( i = 0; i < walk->num_items; ++i )
+      if ( strcmp( walk->paths[i], path ) == 0 )
+         return 1;
+   return 0;
+}
+
+static enum dir_error test_run( const char* root, enum test_api api, unsigned int flags, struct test_walk* walk )
+{
+   flags |= DIR_WALK_ROOT_RELATIVE_PATHS;
+   switch ( api )
+   {
+      case TEST_WALKEX:       return dir_walkex( root, flags, 0x0, 0x0, test_callback, walk );
+      case TEST_WALKEX_INFO:  return dir_walkex_info( root, flags, DIR_ITEM_INFO_SIZE, 0x0, 0x0, test_info_callback, walk );
+      case TEST_WALKEX_BATCH: return dir_walkex_batch( root, flags, 0, 0x0, 0x0, test_batch_callback, walk );
+      default:                return dir_walk_parallel( root, flags, 0x0, 0x0, 2, test_parallel_callback, walk );
+   }
+}
+
+static int test_skip( const char* root, enum test_api api )
+{
+   struct test_walk walk;
+   enum dir_error err;
+   int ok;
+
+   /* nothing below 'skip', or for a batch nothing below the sub-directories of 'skip' */
+   memset( &walk, 0, sizeof( walk ) );
+   walk.skip_path = "skip";
+   walk.skip_result = DIR_WALK_SKIP_SUBTREE;
+   err = test_run( root, api, 0, &walk );
+   if ( api == TEST_WALKEX_BATCH )
+      ok = err == DIR_ERROR_OK && walk.num_items == TEST_NUM_ITEMS - 3 && test_reported( &walk, "skip/deeper" ) &&
+           !test_reported( &walk, "skip/deeper/b.txt" ) && test_reported( &walk, "keep/skip/e.txt" );
+   else
+      ok = err == DIR_ERROR_OK && walk.num_items == TEST_NUM_ITEMS - 5 && test_reported( &walk, "skip" ) &&
+           !test_reported( &walk, "skip/a.txt" ) && test_reported( &walk, "keep/skip/e.txt" );
+   if ( !ok )
+      printf( "%s: skipping a directory returned %d and reported %ld items\n", test_api_names[api], (int)err, walk.num_items );
+   test_clear( &walk );
+
+   /* everything, the directory is already walked when it is reported */
+   walk.skip_path = "skip";
+   walk.skip_result = DIR_WALK_SKIP_SUBTREE;
+   err = test_run( root, api, DIR_WALK_DEPTH_FIRST, &walk );
+   if ( err != DIR_ERROR_OK || walk.num_items != TEST_NUM_ITEMS )
+   {
+      printf( "%s: skipping with DIR_WALK_DEPTH_FIRST returned %d and reported %ld items\n", test_api_names[api], (int)err, walk.num_items );
+      ok = 0;
+   }
+   test_clear( &walk );
+
+   /* everything, there is nothing below a file */
+   if ( api != TEST_WALKEX_BATCH )
+   {
+      walk.skip_path = "keep/d.txt";
+      walk.skip_result = DIR_WALK_SKIP_SUBTREE;
+      err = test_run( root, api, 0, &walk );
+      if ( err != DIR_ERROR_OK || walk.num_items != TEST_NUM_ITEMS )
+      {
+         printf( "%s: skipping a file returned %d and reported %ld items\n", test_api_names[api], (int)err, walk.num_items );
+         ok = 0;
+      }
+      test_clear( &walk );
+   }
+   return ok;
+}
+
+static int test_abort( const char* root, enum test_api api )
+{
+   static const int results[] = { DIR_WALK_ABORT, 7, -1 };
+   struct test_walk walk;
+   unsigned int i;
+   long after;
+   int ok = 1;
+
+   for ( i = 0; i < sizeof( results ) / sizeof( results[0] ); ++i )
+   {
+      for ( after = 1; after <= TEST_NUM_ITEMS; after += 4 )
+      {
+         enum dir_error err;
+         memset( &walk, 0, sizeof( walk ) );
+         walk.abort_after = after;
+         walk.abort_result = results[i];
+         err = test_run( root, api, 0, &walk );
+
+         /* items already being reported on other workers are completed */
+         if ( err != DIR_ERROR_ABORTED || walk.num_items < after || ( api != TEST_PARALLEL && walk.num_items != after ) )
+         {
+            printf( "%s: returning %d for item %ld returned %d and reported %ld items\n", test_api_names[api], results[i], after, (int)err, walk.num_items );
+            ok = 0;
+         }
+         test_clear( &walk );
+      }
+   }
+   return ok;
+}
+
+static int test_create_tree( const char* root )
+{
+   unsigned int i;
+   for ( i = 0; i < sizeof( test_files ) / sizeof( test_files[0] ); ++i )
+   {
+      char path[256];
+      char* slash;
+      FILE* file;
+
+      sprintf( path, "%s/%s", root, test_files[i] );
+      slash = strrchr( path, '/' );
+      *slash = '\0';
+      if ( dir_mktree( path ) != DIR_ERROR_OK )
+         return 0;
+      *slash = '/';
+
+      file = fopen( path, "wb" );
+      if ( file == 0x0 )
+         return 0;
+      fclose( file );
+   }
+   return 1;
+}
+
+int main( void )
+{
+   char root[] = "dirutil_test_walk_result_XXXXXX";
+   struct test_walk walk;
+   unsigned int api;
+   int ok = 1;
+
+   if ( mkdtemp( root ) == 0x0 || !test_create_tree( root ) )
+   {
+      printf( "failed to create the tree\n" );
+      dir_rmtree( root );
+      return 1;
+   }
+
+   memset( &walk, 0, sizeof( walk ) );
+   if ( dir_walkex( root, 0, 0x0, 0x0, test_callback, &walk ) != DIR_ERROR_OK || walk.num_items != TEST_NUM_ITEMS )
+   {
+      printf( "the tree has %ld items, expected %d\n", walk.num_items, TEST_NUM_ITEMS );
+      ok = 0;
+   }
+   test_clear( &walk );
+
+   for ( api = TEST_WALKEX; api <= TEST_PARALLEL; ++api )
+   {
+      ok &= test_skip( root, (enum test_api)api );
+      ok &= test_abort( root, (enum test_api)api );
+   }
+
+   dir_rmtree( root );
+   printf( "%s\n", ok ? "walk_result: OK" : "walk_result: FAILED" );
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,315 @@
+/*
+   dir_watch_open/dir_watch_poll, watches a tree in a mkdtemp directory and checks that the items found by the walk are
+   the ones dir_walkex reports, that adding, modifying and removing files and directories is reported as one batch with
+   directories added before and removed after the items in them, also for items in directories added since the watch was
+   opened, and that changes to the same item are coalesced. then checks that a file glob pattern filters the changes
+   and that removing the watched directory reports everything in it as removed and returns DIR_ERROR_PATH_DO_NOT_EXIST.
+   linux only.
+
+   build and run from the root of the repository:
+      cc -O2 -o test_watch tests/watch.c && ./test_watch
+*/
+#define _DEFAULT_SOURCE
+#define DIRUTIL_IMPLEMENTATION
+#include "../dirutil.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_MAX_ITEMS 64
+#define TEST_TIMEOUT   2000 /* ms to wait for the first change of a batch */
+
+/* name and content of each file in the tree, parent directories are created as needed */
+static const char* test_files[] =
+{
+   "a.txt",          "a",
+   "b.c",            "bb",
+   "src/main.c",     "ccc",
+   "src/lib/util.c", "dddd",
+   "docs/readme.md", "eeeee"
+};
+
+struct test_change
+{
+   const char* path;
+   enum dir_item_type type;
+   enum dir_change change;
+};
+
+struct test_reported
+{
+   char* paths[TEST_MAX_ITEMS];
+   enum dir_item_type types[TEST_MAX_ITEMS];
+   enum dir_change changes[TEST_MAX_ITEMS];
+   unsigned int count;
+};
+
+static int test_change_callback( const char* path, unsigned int path_len, enum dir_item_type type, enum dir_change change,
+   const struct dir_item_info* info, void* userdata )
+{
+   struct test_reported* reported = (struct test_reported*)userdata;
+   (void)info;
+   if ( reported->count == TEST_MAX_ITEMS )
+      return DIR_WALK_ABORT;
+   reported->paths[reported->count] = (char*)malloc( path_len + 1 );
+   memcpy( reported->paths[reported->count], path, path_len + 1 );
+   reported->types[reported->count] = type;
+   reported->changes[reported->count] = change;
+   ++reported->count;
+   return DIR_WALK_CONTINUE;
+}
+
+static int test_walk_callback( const char* path, unsigned int path_len, enum dir_item_type type, void* userdata )
+{
+   return test_change_callback( path, path_len, type, DIR_CHANGE_ADDED, 0x0, userdata );
+}
+
+static void test_clear( struct test_reported* reported )
+{
+   unsigned int i;
+   for ( i = 0; i < reported->count; ++i )
+      free( reported->paths[i] );
+   reported->count = 0;
+}
+
+static int test_index( const struct test_reported* reported, const char* path )
+{
+   unsigned int i;
+   for ( i = 0; i < reported->count; ++i )
+      if ( strcmp( reported->paths[i], path ) == 0 )
+         return (int)i;
+   return -1;
+}
+
+static int test_write_file( const char* root, const char* name, const char* content )
+{
+   char path[256];
+   char* slash;
+   FILE* file;
+
+   sprintf( path, "%s/%s", root, name );
+   slash = strrchr( path, '/' );
+   *slash = '\0';
+   if ( dir_mktree( path ) != DIR_ERROR_OK )
+      return 0;
+   *slash = '/';
+
+   file = fopen( path, "wb" );
+   if ( file == 0x0 )
+      return 0;
+   fputs( content, file );
+   return fclose( file ) == 0;
+}
+
+static int test_remove( const char* root, const char* name )
+{
+   char path[256];
+   sprintf( path, "%s/%s", root, name );
+   return dir_rmtree( path ) == DIR_ERROR_OK || remove( path ) == 0;
+}
+
+/* exactly the changes, added directories before the items in them and removed ones after */
+static int test_check( const char* what, const struct test_reported* reported, const struct test_change* changes, unsigned int num_changes )
+{
+   unsigned int i;
+   int ok = reported->count == num_changes;
+
+   for ( i = 0; ok && i < num_changes; ++i )
+   {
+      const struct test_change* c = &changes[i];
+      int index = test_index( reported, c->path ), at_index;
+      const char* slash = strrchr( c->path, '/' );
+      char parent[64];
+
+      if ( index < 0 || reported->types[index] != c->type || reported->changes[index] != c->change )
+      {
+         ok = 0;
+         break;
+      }
+      if ( slash == 0x0 )
+         continue;
+      sprintf( parent, "%.*s", (int)( slash - c->path ), c->path );
+      at_index = test_index( reported, parent );
+      if ( at_index >= 0 && reported->changes[at_index] == c->change && ( c->change == DIR_CHANGE_ADDED ? at_index > index : at_index < index ) )
+         ok = 0;
+   }
+   if ( !ok )
+   {
+      printf( "%s: %u changes reported, expected:\n", what, reported->count );
+      for ( i = 0; i < num_changes; ++i )
+         printf( "   %d %s\n", (int)changes[i].change, changes[i].path );
+      printf( "   reported:\n" );
+      for ( i = 0; i < reported->count; ++i )
+         printf( "   %d %s\n", (int)reported->changes[i], reported->paths[i] );
+   }
+   return ok;
+}
+
+static int test_poll( const char* what, struct dir_watch* watch, const struct test_change* changes, unsigned int num_changes, enum dir_error expected )
+{
+   struct test_reported reported;
+   enum dir_error err;
+   int ok;
+
+   reported.count = 0;
+   err = dir_watch_poll( watch, num_changes ? TEST_TIMEOUT : 100, test_change_callback, &reported );
+   ok = err == expected;
+   if ( !ok )
+      printf( "%s: returned %d, expected %d\n", what, (int)err, (int)expected );
+   ok &= test_check( what, &reported, changes, num_changes );
+   test_clear( &reported );
+   return ok;
+}
+
+static const struct test_change test_batch[] =
+{
+   { "a.txt",             DIR_ITEM_FILE, DIR_CHANGE_REMOVED },
+   { "b.c",               DIR_ITEM_FILE, DIR_CHANGE_MODIFIED },
+   { "src/new.c",         DIR_ITEM_FILE, DIR_CHANGE_ADDED },
+   { "added",             DIR_ITEM_DIR,  DIR_CHANGE_ADDED },
+   { "added/sub",         DIR_ITEM_DIR,  DIR_CHANGE_ADDED },
+   { "added/sub/x.txt",   DIR_ITEM_FILE, DIR_CHANGE_ADDED },
+   { "docs",              DIR_ITEM_DIR,  DIR_CHANGE_REMOVED },
+   { "docs/readme.md",    DIR_ITEM_FILE, DIR_CHANGE_REMOVED }
+};
+
+/* in a directory added in the last batch */
+static const struct test_change test_later[] =
+{
+   { "added/sub/later.txt", DIR_ITEM_FILE, DIR_CHANGE_ADDED }
+};
+
+/* added then modified, added then removed and removed then added again */
+static const struct test_change test_coalesced[] =
+{
+   { "one.txt",        DIR_ITEM_FILE, DIR_CHANGE_ADDED },
+   { "src/main.c",     DIR_ITEM_FILE, DIR_CHANGE_MODIFIED }
+};
+
+/* only the .c files with the pattern '*.c' */
+static const struct test_change test_filtered[] =
+{
+   { "src/lib/new.c",  DIR_ITEM_FILE, DIR_CHANGE_ADDED }
+};
+
+/* and both without it */
+static const struct test_change test_both[] =
+{
+   { "src/lib/new.c",   DIR_ITEM_FILE, DIR_CHANGE_ADDED },
+   { "src/lib/new.txt", DIR_ITEM_FILE, DIR_CHANGE_ADDED }
+};
+
+/* everything left when the watched directory is removed */
+static const struct test_change test_removed[] =
+{
+   { "b.c",                 DIR_ITEM_FILE, DIR_CHANGE_REMOVED },
+   { "one.txt",             DIR_ITEM_FILE, DIR_CHANGE_REMOVED },
+   { "src",                 DIR_ITEM_DIR,  DIR_CHANGE_REMOVED },
+   { "src/main.c",          DIR_ITEM_FILE, DIR_CHANGE_REMOVED },
+   { "src/new.c",           DIR_ITEM_FILE, DIR_CHANGE_REMOVED },
+   { "src/lib",             DIR_ITEM_DIR,  DIR_CHANGE_REMOVED },
+   { "src/lib/util.c",      DIR_ITEM_FILE, DIR_CHANGE_REMOVED },
+   { "src/lib/new.c",       DIR_ITEM_FILE, DIR_CHANGE_REMOVED },
+   { "src/lib/new.txt",     DIR_ITEM_FILE, DIR_CHANGE_REMOVED },
+   { "added",               DIR_ITEM_DIR,  DIR_CHANGE_REMOVED },
+   { "added/sub",           DIR_ITEM_DIR,  DIR_CHANGE_REMOVED },
+   { "added/sub/x.txt",     DIR_ITEM_FILE, DIR_CHANGE_REMOVED },
+   { "added/sub/later.txt", DIR_ITEM_FILE, DIR_CHANGE_REMOVED }
+};
+
+#define TEST_COUNT( changes ) ( sizeof( changes ) / sizeof( changes[0] ) )
+
+/* the items found by the walk are the ones dir_walkex reports, with the same flags */
+static int test_open( const char* tree, struct dir_watch** watch )
+{
+   struct test_reported found, walked;
+   enum dir_error err;
+   unsigned int i;
+   int ok;
+
+   found.count = walked.count = 0;
+   err = dir_watch_open( tree, DIR_WALK_ROOT_RELATIVE_PATHS, 0x0, 0x0, test_change_callback, &found, watch );
+   ok = err == DIR_ERROR_OK && dir_watch_fd( *watch ) >= 0 &&
+        dir_walkex( tree, DIR_WALK_ROOT_RELATIVE_PATHS, 0x0, 0x0, test_walk_callback, &walked ) == DIR_ERROR_OK &&
+        found.count == walked.count;
+   for ( i = 0; ok && i < walked.count; ++i )
+   {
+      int index = test_index( &found, walked.paths[i] );
+      ok = index >= 0 && found.types[index] == walked.types[i] && found.changes[index] == DIR_CHANGE_ADDED;
+   }
+   if ( !ok )
+      printf( "open: returned %d and found %u items, dir_walkex reports %u\n", (int)err, found.count, walked.count );
+   test_clear( &found );
+   test_clear( &walked );
+   return ok;
+}
+
+int main( void )
+{
+   char root[] = "dirutil_test_watch_XXXXXX";
+   char tree[64];
+   struct dir_watch* watch = 0x0;
+   struct dir_watch* filtered = 0x0;
+   unsigned int i;
+   int ok = 1;
+
+   if ( mkdtemp( root ) == 0x0 )
+   {
+      printf( "failed to create a temporary directory\n" );
+      return 1;
+   }
+   sprintf( tree, "%s/tree", root );
+   for ( i = 0; ok && i < sizeof( test_files ) / sizeof( test_files[0] ); i += 2 )
+      ok = test_write_file( tree, test_files[i], test_files[i + 1] );
+   if ( !ok || !test_open( tree, &watch ) )
+   {
+      printf( "failed to create and watch the tree\n" );
+      dir_rmtree( root );
+      return 1;
+   }
+   if ( dir_watch_open( tree, DIR_WALK_ROOT_RELATIVE_PATHS, 0x0, "*.c", 0x0, 0x0, &filtered ) != DIR_ERROR_OK )
+   {
+      printf( "failed to watch the tree with a file pattern\n" );
+      ok = 0;
+   }
+
+   ok &= test_poll( "unchanged", watch, 0x0, 0, DIR_ERROR_OK );
+
+   ok &= test_remove( tree, "a.txt" ) && test_remove( tree, "docs" ) && test_write_file( tree, "b.c", "modified" ) &&
+         test_write_file( tree, "src/new.c", "new" ) && test_write_file( tree, "added/sub/x.txt", "x" );
+   ok &= test_poll( "changed", watch, test_batch, TEST_COUNT( test_batch ), DIR_ERROR_OK );
+
+   ok &= test_write_file( tree, "added/sub/later.txt", "later" );
+   ok &= test_poll( "added later", watch, test_later, TEST_COUNT( test_later ), DIR_ERROR_OK );
+
+   ok &= test_write_file( tree, "one.txt", "1" ) && test_write_file( tree, "one.txt", "11" ) &&
+         test_write_file( tree, "two.txt", "2" ) && test_remove( tree, "two.txt" ) &&
+         test_remove( tree, "src/main.c" ) && test_write_file( tree, "src/main.c", "again" );
+   ok &= test_poll( "coalesced", watch, test_coalesced, TEST_COUNT( test_coalesced ), DIR_ERROR_OK );
+
+   /* the changes so far are not checked for the watch with the pattern */
+   if ( filtered )
+   {
+      struct test_reported reported;
+      reported.count = 0;
+      ok &= dir_watch_poll( filtered, 100, test_change_callback, &reported ) == DIR_ERROR_OK;
+      test_clear( &reported );
+   }
+   ok &= test_write_file( tree, "src/lib/new.c", "c" ) && test_write_file( tree, "src/lib/new.txt", "txt" );
+   if ( filtered )
+   {
+      ok &= test_poll( "file pattern", filtered, test_filtered, TEST_COUNT( test_filtered ), DIR_ERROR_OK );
+      dir_watch_close( filtered );
+   }
+   ok &= test_poll( "both files", watch, test_both, TEST_COUNT( test_both ), DIR_ERROR_OK );
+
+   if ( dir_rmtree( tree ) != DIR_ERROR_OK )
+      ok = 0;
+   ok &= test_poll( "removed", watch, test_removed, TEST_COUNT( test_removed ), DIR_ERROR_PATH_DO_NOT_EXIST );
+   dir_watch_close( watch );
+
+   dir_rmtree( root );
+   printf( "%s\n", ok ? "watch: OK" : "watch: FAILED" );
+   return ok ? 0 : 1;
+}